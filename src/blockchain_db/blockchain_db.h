@@ -19,6 +19,15 @@ typedef struct output_data_t
 } output_data_t;
 #pragma pack(pop)
 
+/**
+ * @brief where an output is in m_output_amounts: its amount and its index among outputs of that amount
+ */
+typedef struct output_index_t
+{
+    uint64_t amount;
+    uint64_t index;
+} output_index_t;
+
 #pragma pack(push, 1)
 typedef struct tx_data_t
 {
@@ -58,6 +67,8 @@ typedef struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+// read only with MDB_NOTLS, following the writer of the db in another process
+#define DBF_REPLICA 0x20
 
 typedef struct BlockchainDB {
     bool m_open;  //!< Whether or not the BlockchainDB is open/ready for use
@@ -0,0 +1,249 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "event_feed.h"
+
+G_STATIC_ASSERT(CHAIN_EVENT_WIRE_SIZE == 4 + 8 + sizeof(hash) + 8);
+
+// how often the bridge looks for new events, writers never wake it
+#define BRIDGE_POLL_MS 20
+
+/*
+ * Each slot is a seqlock: the writer marks it odd, copies the event in and
+ * marks it with its position, and a reader trusts a copy only if the mark
+ * it read before is the one it reads after. The fences keep the copy
+ * between the two marks.
+ */
+void event_feed_publish(event_feed *feed, const chain_event *event) {
+    const gsize pos = (gsize)g_atomic_pointer_add(&feed->head, 1);
+    event_feed_slot *slot = &feed->slots[pos % EVENT_FEED_SLOTS];
+    const guint seq = (guint)(2 * pos + 2);
+
+    g_atomic_int_set(&slot->seq, (gint)(seq - 1));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->event = *event;
+    g_atomic_int_set(&slot->seq, (gint)seq);
+}
+
+void event_feed_subscribe(event_feed *feed, event_cursor *cursor) {
+    cursor->next = (gsize)g_atomic_pointer_get(&feed->head);
+    cursor->lost = 0;
+}
+
+static void put_le(uint8_t *out, uint64_t v, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        out[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *data, size_t size) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < size; i++) {
+        v |= (uint64_t)data[i] << (8 * i);
+    }
+    return v;
+}
+
+void chain_event_encode(const chain_event *event, uint8_t out[CHAIN_EVENT_WIRE_SIZE]) {
+    put_le(out, event->type, 4);
+    put_le(out + 4, event->height, 8);
+    memcpy(out + 12, &event->hash, sizeof(event->hash));
+    put_le(out + 12 + sizeof(event->hash), event->commit, 8);
+}
+
+bool chain_event_decode(const uint8_t *data, size_t size, chain_event *event) {
+    if (size != CHAIN_EVENT_WIRE_SIZE) {
+        return false;
+    }
+    memset(event, 0, sizeof(*event));
+    event->type = (uint32_t)get_le(data, 4);
+    event->height = get_le(data + 4, 8);
+    memcpy(&event->hash, data + 12, sizeof(event->hash));
+    event->commit = get_le(data + 12 + sizeof(event->hash), 8);
+    return true;
+}
+
+int event_feed_next(event_feed *feed, event_cursor *cursor, chain_event *event) {
+    event_feed_slot *slot = &feed->slots[cursor->next % EVENT_FEED_SLOTS];
+    const guint want = (guint)(2 * cursor->next + 2);
+    // positions are compared by their distance, which the 32 bit marks keep
+    const gint ahead = (gint)((guint)g_atomic_int_get(&slot->seq) - want);
+
+    if (ahead < 0) {
+        return -1;
+    }
+    if (ahead == 0) {
+        *event = slot->event;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((guint)g_atomic_int_get(&slot->seq) == want) {
+            cursor->next++;
+            return 0;
+        }
+    }
+    // the slot was taken by a later lap
+    const uint64_t head = (gsize)g_atomic_pointer_get(&feed->head);
+    const uint64_t oldest = head > EVENT_FEED_SLOTS ? head - EVENT_FEED_SLOTS : 0;
+    if (oldest > cursor->next) {
+        cursor->lost += oldest - cursor->next;
+        cursor->next = oldest;
+    } else {
+        // overwritten between the head read and here, the oldest is past it
+        cursor->lost++;
+        cursor->next++;
+    }
+    return -2;
+}
+
+typedef struct bridge_client {
+    int fd;
+    event_cursor cursor;
+    uint64_t lost_sent;
+} bridge_client;
+
+struct event_bridge {
+    event_feed *feed;
+    char *path;
+    int listen_fd;
+    int wake[2];
+    GThread *thread;
+    GArray *clients;
+};
+
+static bool bridge_send(int fd, const chain_event *event, bool *full) {
+    uint8_t packet[CHAIN_EVENT_WIRE_SIZE];
+    chain_event_encode(event, packet);
+    *full = false;
+    if (send(fd, packet, sizeof(packet), MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)sizeof(packet)) {
+        return true;
+    }
+    *full = errno == EAGAIN || errno == EWOULDBLOCK;
+    return false;
+}
+
+// false if the connection is gone
+static bool bridge_pump(event_bridge *bridge, bridge_client *c) {
+    chain_event event;
+    bool full;
+    for (;;) {
+        if (c->cursor.lost > c->lost_sent) {
+            const chain_event overrun = { .type = CHAIN_EVENT_OVERRUN, .height = c->cursor.lost - c->lost_sent };
+            if (!bridge_send(c->fd, &overrun, &full)) {
+                return full;
+            }
+            c->lost_sent = c->cursor.lost;
+        }
+        const int result = event_feed_next(bridge->feed, &c->cursor, &event);
+        if (result == -1) {
+            return true;
+        }
+        if (result == 0 && !bridge_send(c->fd, &event, &full)) {
+            // sent when the connection has room again, if still in the feed
+            c->cursor.next--;
+            return full;
+        }
+    }
+}
+
+static void bridge_accept(event_bridge *bridge) {
+    int fd;
+    while ((fd = accept(bridge->listen_fd, NULL, NULL)) >= 0) {
+        bridge_client c = { .fd = fd };
+        event_feed_subscribe(bridge->feed, &c.cursor);
+        g_array_append_val(bridge->clients, c);
+    }
+}
+
+static gpointer bridge_run(gpointer data) {
+    event_bridge *bridge = data;
+    GArray *fds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+
+    for (;;) {
+        struct pollfd pfd = { .fd = bridge->wake[0], .events = POLLIN };
+        g_array_set_size(fds, 0);
+        g_array_append_val(fds, pfd);
+        pfd.fd = bridge->listen_fd;
+        g_array_append_val(fds, pfd);
+        for (guint i = 0; i < bridge->clients->len; i++) {
+            // nothing is read from a client, this only hears it hang up
+            struct pollfd client = { .fd = g_array_index(bridge->clients, bridge_client, i).fd };
+            g_array_append_val(fds, client);
+        }
+        if (poll((struct pollfd *)fds->data, fds->len, BRIDGE_POLL_MS) < 0 && errno != EINTR) {
+            break;
+        }
+        if (g_array_index(fds, struct pollfd, 0).revents) {
+            break;
+        }
+        if (g_array_index(fds, struct pollfd, 1).revents & POLLIN) {
+            bridge_accept(bridge);
+        }
+        // from the back, so removing a client keeps the indexes of the rest
+        for (guint i = bridge->clients->len; i-- > 0;) {
+            bridge_client *c = &g_array_index(bridge->clients, bridge_client, i);
+            const short revents = i + 2 < fds->len ? g_array_index(fds, struct pollfd, i + 2).revents : 0;
+            if ((revents & (POLLHUP | POLLERR)) || !bridge_pump(bridge, c)) {
+                close(c->fd);
+                g_array_remove_index_fast(bridge->clients, i);
+            }
+        }
+    }
+    g_array_free(fds, TRUE);
+    return NULL;
+}
+
+event_bridge *event_bridge_new(event_feed *feed, const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    event_bridge *bridge;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        g_info("event bridge: socket path too long: %s", path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+    bridge = g_new0(event_bridge, 1);
+    bridge->feed = feed;
+    bridge->wake[0] = bridge->wake[1] = -1;
+    // a socket left behind by a process that is gone
+    unlink(path);
+    if ((bridge->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0
+        || bind(bridge->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(bridge->listen_fd, 16) != 0
+        || fcntl(bridge->listen_fd, F_SETFL, O_NONBLOCK) != 0
+        || pipe(bridge->wake) != 0) {
+        g_info("event bridge: failed to listen on %s: %s", path, strerror(errno));
+        if (bridge->listen_fd >= 0) {
+            close(bridge->listen_fd);
+            unlink(path);
+        }
+        g_free(bridge);
+        return NULL;
+    }
+    bridge->path = g_strdup(path);
+    bridge->clients = g_array_new(FALSE, FALSE, sizeof(bridge_client));
+    bridge->thread = g_thread_new("event_bridge", bridge_run, bridge);
+    return bridge;
+}
+
+void event_bridge_free(event_bridge *bridge) {
+    if (bridge == NULL) {
+        return;
+    }
+    if (write(bridge->wake[1], "", 1) != 1) {
+        g_warning("event bridge: failed to stop its thread");
+    }
+    g_thread_join(bridge->thread);
+    for (guint i = 0; i < bridge->clients->len; i++) {
+        close(g_array_index(bridge->clients, bridge_client, i).fd);
+    }
+    g_array_free(bridge->clients, TRUE);
+    close(bridge->wake[0]);
+    close(bridge->wake[1]);
+    close(bridge->listen_fd);
+    unlink(bridge->path);
+    g_free(bridge->path);
+    g_free(bridge);
+}
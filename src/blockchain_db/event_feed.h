@@ -0,0 +1,88 @@
+#ifndef MONERO_BLOCKCHAIN_DB_EVENT_FEED_H_
+#define MONERO_BLOCKCHAIN_DB_EVENT_FEED_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+#include "crypto/hash.h"
+
+#define EVENT_FEED_SLOTS 1024
+
+typedef enum chain_event_type {
+    CHAIN_EVENT_BLOCK_ADDED = 1,
+    CHAIN_EVENT_BLOCK_POPPED = 2,
+    // only on a bridge connection: height is the number of events lost
+    CHAIN_EVENT_OVERRUN = 0x80,
+} chain_event_type;
+
+/*
+ * A change a write txn made, published once it committed. commit is the id
+ * of the txn (mdb_txn_id), the first snapshot a read txn sees it in.
+ */
+typedef struct chain_event {
+    uint32_t type;
+    uint64_t height;
+    hash hash;
+    uint64_t commit;
+} chain_event;
+
+/*
+ * A chain_event as the bridge sends it: type in 4 bytes, height in 8, the
+ * hash, then commit in 8, the integers little endian and nothing between.
+ */
+#define CHAIN_EVENT_WIRE_SIZE 52
+
+void chain_event_encode(const chain_event *event, uint8_t out[CHAIN_EVENT_WIRE_SIZE]);
+
+// false unless size is CHAIN_EVENT_WIRE_SIZE
+bool chain_event_decode(const uint8_t *data, size_t size, chain_event *event);
+
+typedef struct event_feed_slot {
+    // low 32 bits of 2 * position + 2 once written, one less while being written
+    volatile gint seq;
+    chain_event event;
+} event_feed_slot;
+
+/*
+ * The last EVENT_FEED_SLOTS events, for any number of readers each at a
+ * cursor of its own. Writers take a position with one atomic add and never
+ * wait for readers; a reader the writers lapped finds out on its next read
+ * instead. All zero is an empty feed.
+ */
+typedef struct event_feed {
+    volatile gsize head;    // positions given to writers
+    event_feed_slot slots[EVENT_FEED_SLOTS];
+} event_feed;
+
+typedef struct event_cursor {
+    uint64_t next;
+    uint64_t lost;          // events the writers lapped this cursor by, in all
+} event_cursor;
+
+void event_feed_publish(event_feed *feed, const chain_event *event);
+
+// a cursor from the next event published on
+void event_feed_subscribe(event_feed *feed, event_cursor *cursor);
+
+/*
+ * 0 and the event at the cursor, -1 if it is not published yet, -2 if the
+ * writers lapped the cursor: it is moved to the oldest event still in the
+ * feed and lost counts the ones skipped.
+ */
+int event_feed_next(event_feed *feed, event_cursor *cursor, chain_event *event);
+
+/*
+ * The feed on a unix SOCK_SEQPACKET socket at path, for readers in other
+ * processes. Every connection is sent the events published after it was
+ * accepted, a chain_event per packet as chain_event_encode lays it out. A
+ * connection that does not keep up is sent a CHAIN_EVENT_OVERRUN packet
+ * where it lost events. The feed must outlive the bridge.
+ */
+typedef struct event_bridge event_bridge;
+
+// NULL if the socket could not be made
+event_bridge *event_bridge_new(event_feed *feed, const char *path);
+void event_bridge_free(event_bridge *bridge);
+
+#endif //MONERO_BLOCKCHAIN_DB_EVENT_FEED_H_
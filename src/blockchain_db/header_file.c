@@ -0,0 +1,228 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "header_file.h"
+
+#define HEADER_FILE_MAGIC "MHEADERS"
+#define HEADER_FILE_VERSION 1
+// the file grows by this many records at a time, each growth maps the new part
+#define HEADER_FILE_CHUNK_RECORDS 65536
+// address space kept for the map, 16M blocks
+#define HEADER_FILE_RESERVE ((size_t)HEADER_RECORD_SIZE << 24)
+// tries a reader spins through while the writer is busy, before it yields
+#define HEADER_FILE_READ_SPINS 64
+
+G_STATIC_ASSERT(sizeof(header_record) == HEADER_RECORD_SIZE);
+
+typedef struct header_file_head {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t seq;           // odd while records are written, zero in files from before it
+    uint8_t reserved[HEADER_RECORD_SIZE - 32];
+} header_file_head;
+
+G_STATIC_ASSERT(sizeof(header_file_head) == HEADER_RECORD_SIZE);
+
+#define HEADER_FILE_CHUNK ((size_t)HEADER_RECORD_SIZE * HEADER_FILE_CHUNK_RECORDS)
+
+static const header_file_head *header_file_head_of(const header_file *f) {
+    return (const header_file_head *)f->base;
+}
+
+// records a file of size bytes has room for
+static uint64_t header_file_room(size_t size) {
+    return size < sizeof(header_file_head) ? 0 : (size - sizeof(header_file_head)) / HEADER_RECORD_SIZE;
+}
+
+static bool header_file_write(int fd, const void *data, size_t size, off_t offset) {
+    while (size > 0) {
+        const ssize_t n = pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data = (const uint8_t *)data + n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// maps the file up to size, past what is mapped already
+static bool header_file_map(header_file *f, size_t size) {
+    if (size <= f->mapped) {
+        return true;
+    }
+    if (size > HEADER_FILE_RESERVE) {
+        return false;
+    }
+    if (mmap(f->base + f->mapped, size - f->mapped, PROT_READ, MAP_SHARED | MAP_FIXED, f->fd, f->mapped) == MAP_FAILED) {
+        return false;
+    }
+    f->mapped = size;
+    return true;
+}
+
+// the writer's sequence number, from the map
+static uint64_t header_file_seq(const header_file *f) {
+    if (f->mapped < sizeof(header_file_head)) {
+        return 0;
+    }
+    return __atomic_load_n(&header_file_head_of(f)->seq, __ATOMIC_ACQUIRE);
+}
+
+static bool header_file_set_seq(header_file *f, uint64_t seq) {
+    return header_file_write(f->fd, &seq, sizeof(seq), offsetof(header_file_head, seq));
+}
+
+// a new file, or an old one of another format over again
+static bool header_file_init(int fd) {
+    header_file_head head = { .version = HEADER_FILE_VERSION, .record_size = HEADER_RECORD_SIZE };
+    memcpy(head.magic, HEADER_FILE_MAGIC, sizeof(head.magic));
+    return ftruncate(fd, 0) == 0 && header_file_write(fd, &head, sizeof(head), 0)
+        && ftruncate(fd, HEADER_FILE_CHUNK) == 0;
+}
+
+int header_file_open(header_file *f, const char *dir, bool read_only) {
+    char *path = g_build_filename(dir, HEADER_FILE_NAME, NULL);
+    header_file_head head;
+    struct stat st;
+    int result = 0;
+
+    memset(f, 0, sizeof(*f));
+    f->read_only = read_only;
+    f->fd = open(path, read_only ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    g_free(path);
+    if (f->fd < 0) {
+        return -1;
+    }
+    const bool valid = pread(f->fd, &head, sizeof(head), 0) == (ssize_t)sizeof(head)
+        && memcmp(head.magic, HEADER_FILE_MAGIC, sizeof(head.magic)) == 0
+        && head.version == HEADER_FILE_VERSION && head.record_size == HEADER_RECORD_SIZE;
+    if (!valid && (read_only || !header_file_init(f->fd))) {
+        result = read_only ? -2 : -1;
+    } else if (valid && !read_only && (head.seq & 1) && !header_file_set_seq(f, head.seq + 1)) {
+        // a writer stopped in the middle of an append, readers would wait on it
+        result = -1;
+    } else if (fstat(f->fd, &st) != 0) {
+        result = -1;
+    } else if ((f->base = mmap(NULL, HEADER_FILE_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) == MAP_FAILED) {
+        f->base = NULL;
+        result = -3;
+    } else if (!header_file_map(f, (size_t)st.st_size / HEADER_FILE_CHUNK * HEADER_FILE_CHUNK)) {
+        result = -3;
+    }
+    if (result) {
+        if (f->base) {
+            munmap(f->base, HEADER_FILE_RESERVE);
+            f->base = NULL;
+        }
+        close(f->fd);
+        f->fd = -1;
+        return result;
+    }
+    const uint64_t count = valid ? head.count : 0;
+    f->count = MIN(count, header_file_room(f->mapped));
+    return 0;
+}
+
+void header_file_close(header_file *f) {
+    if (!f->base) {
+        return;
+    }
+    __atomic_store_n(&f->count, 0, __ATOMIC_RELEASE);
+    munmap(f->base, HEADER_FILE_RESERVE);
+    close(f->fd);
+    f->base = NULL;
+    f->fd = -1;
+    f->mapped = 0;
+    f->stale = false;
+}
+
+uint64_t header_file_count(header_file *f) {
+    return __atomic_load_n(&f->count, __ATOMIC_ACQUIRE);
+}
+
+bool header_file_read(header_file *f, uint64_t height, uint64_t n, header_record *records) {
+    for (int spins = 0;; spins++) {
+        const uint64_t seq = header_file_seq(f);
+        const uint64_t count = header_file_count(f);
+        if (!f->base || height > count || n > count - height) {
+            return false;
+        }
+        if (!(seq & 1)) {
+            memcpy(records, (const header_record *)(f->base + sizeof(header_file_head)) + height, n * HEADER_RECORD_SIZE);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (header_file_seq(f) == seq) {
+                return true;
+            }
+        }
+        if (spins >= HEADER_FILE_READ_SPINS) {
+            g_thread_yield();
+        }
+    }
+}
+
+int header_file_append(header_file *f, const header_record *records, size_t n) {
+    const uint64_t count = header_file_count(f);
+    const size_t end = sizeof(header_file_head) + (count + n) * HEADER_RECORD_SIZE;
+    const size_t size = (end + HEADER_FILE_CHUNK - 1) / HEADER_FILE_CHUNK * HEADER_FILE_CHUNK;
+
+    if (f->read_only || f->stale || !f->base) {
+        return -1;
+    }
+    if (size > HEADER_FILE_RESERVE) {
+        return -2;
+    }
+    if (size > f->mapped && (ftruncate(f->fd, size) != 0 || !header_file_map(f, size))) {
+        return -1;
+    }
+    // the records, then the count that takes them in, with the sequence odd around both
+    const uint64_t new_count = count + n;
+    const uint64_t seq = header_file_seq(f);
+    const bool written = header_file_set_seq(f, seq + 1)
+        && header_file_write(f->fd, records, n * HEADER_RECORD_SIZE, sizeof(header_file_head) + count * HEADER_RECORD_SIZE)
+        && header_file_write(f->fd, &new_count, sizeof(new_count), offsetof(header_file_head, count));
+    if (!header_file_set_seq(f, seq + 2) || !written) {
+        return -1;
+    }
+    __atomic_store_n(&f->count, new_count, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int header_file_truncate(header_file *f, uint64_t height) {
+    if (!f->base || height > header_file_count(f)) {
+        return -1;
+    }
+    __atomic_store_n(&f->count, height, __ATOMIC_RELEASE);
+    if (!f->read_only && (!header_file_write(f->fd, &height, sizeof(height), offsetof(header_file_head, count))
+                          || !header_file_set_seq(f, header_file_seq(f) + 2))) {
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t header_file_follow(header_file *f, uint64_t limit) {
+    struct stat st;
+    if (!f->base || !f->read_only) {
+        return header_file_count(f);
+    }
+    if (fstat(f->fd, &st) == 0) {
+        header_file_map(f, (size_t)st.st_size / HEADER_FILE_CHUNK * HEADER_FILE_CHUNK);
+    }
+    if (f->mapped < sizeof(header_file_head)) {
+        // the writer has not grown the file to its first chunk yet
+        return 0;
+    }
+    const uint64_t count = __atomic_load_n(&header_file_head_of(f)->count, __ATOMIC_ACQUIRE);
+    const uint64_t n = MIN(MIN(count, limit), header_file_room(f->mapped));
+    __atomic_store_n(&f->count, n, __ATOMIC_RELEASE);
+    return n;
+}
@@ -0,0 +1,89 @@
+#ifndef MONERO_BLOCKCHAIN_DB_HEADER_FILE_H_
+#define MONERO_BLOCKCHAIN_DB_HEADER_FILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+#include "crypto/hash.h"
+#include "cryptonote_basic/difficulty.h"
+
+#define HEADER_FILE_NAME "headers.bin"
+
+/*
+ * The header of a block with what it took a walk of the chain to know:
+ * its hash and height and the cumulative difficulty up to it. One per
+ * height, HEADER_RECORD_SIZE bytes apart, so record h is at a fixed offset.
+ */
+#define HEADER_RECORD_SIZE 128
+
+typedef struct header_record {
+    uint64_t height;
+    uint64_t timestamp;
+    difficulty_type cumulative_difficulty;
+    hash hash;
+    hash prev_id;
+    uint32_t nonce;
+    uint8_t major_version;
+    uint8_t minor_version;
+    uint8_t reserved[HEADER_RECORD_SIZE - 94];
+} header_record;
+
+/*
+ * A file of header_records, mapped read only at an address that stays the
+ * same as it grows. Truncating and appending again rewrites the records
+ * past the cut in place, so readers copy records out under a sequence
+ * number in the file's header: odd while the writer appends, moved on by
+ * every append and truncate, and read again after the copy. The header
+ * also gives the number of records, written after them; the file grows
+ * a chunk at a time. It only mirrors the
+ * chain, it is not synced and whoever opens it checks it against the db.
+ * One process writes; the others open it read only and follow it.
+ */
+typedef struct header_file {
+    int fd;
+    bool read_only;
+    uint8_t *base;          // the reserved address range, NULL if closed
+    size_t mapped;          // bytes of the file mapped at base
+    uint64_t count;         // records readers of this handle see, read and written atomically
+    bool stale;             // appends refused, the records in it are still read
+} header_file;
+
+// -1 if the file could not be opened, -2 if it is not a header file (read only), -3 if it could not be mapped
+int header_file_open(header_file *f, const char *dir, bool read_only);
+void header_file_close(header_file *f);
+
+static inline bool header_file_is_open(const header_file *f) {
+    return f->base != NULL;
+}
+
+// stops appends until close, for a file that missed a record; it stays mapped for readers
+static inline void header_file_set_stale(header_file *f) {
+    f->stale = true;
+}
+
+uint64_t header_file_count(header_file *f);
+
+/*
+ * Copies the records from height to height + n - 1 to records, false
+ * unless all of them are in. Retried until no append or truncate of the
+ * writer ran under the copy.
+ */
+bool header_file_read(header_file *f, uint64_t height, uint64_t n, header_record *records);
+
+// records for the heights from header_file_count on, in order; -1 on a write error or if stale, -2 past the reserved range
+int header_file_append(header_file *f, const header_record *records, size_t n);
+
+/*
+ * Drops the records from height up, of a read only file only from this
+ * handle's view. Records appended after are written over the dropped ones.
+ */
+int header_file_truncate(header_file *f, uint64_t height);
+
+/*
+ * Read only: maps what the writer added since and sets the view to the
+ * writer's records, but no more than limit. Returns the new count.
+ */
+uint64_t header_file_follow(header_file *f, uint64_t limit);
+
+#endif //MONERO_BLOCKCHAIN_DB_HEADER_FILE_H_
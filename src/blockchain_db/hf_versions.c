@@ -0,0 +1,54 @@
+#include "hf_versions.h"
+
+void hf_version_map_init(hf_version_map *m) {
+    g_rw_lock_init(&m->lock);
+    m->versions = g_byte_array_new();
+}
+
+void hf_version_map_clear(hf_version_map *m) {
+    g_byte_array_free(m->versions, TRUE);
+    m->versions = NULL;
+    g_rw_lock_clear(&m->lock);
+}
+
+void hf_version_map_reset(hf_version_map *m) {
+    g_rw_lock_writer_lock(&m->lock);
+    g_byte_array_set_size(m->versions, 0);
+    g_rw_lock_writer_unlock(&m->lock);
+}
+
+void hf_version_map_push(hf_version_map *m, uint8_t version) {
+    g_rw_lock_writer_lock(&m->lock);
+    g_byte_array_append(m->versions, &version, 1);
+    g_rw_lock_writer_unlock(&m->lock);
+}
+
+bool hf_version_map_truncate(hf_version_map *m, uint64_t height) {
+    bool ret = false;
+    g_rw_lock_writer_lock(&m->lock);
+    if (height <= m->versions->len) {
+        g_byte_array_set_size(m->versions, height);
+        ret = true;
+    }
+    g_rw_lock_writer_unlock(&m->lock);
+    return ret;
+}
+
+uint64_t hf_version_map_height(hf_version_map *m) {
+    uint64_t height;
+    g_rw_lock_reader_lock(&m->lock);
+    height = m->versions->len;
+    g_rw_lock_reader_unlock(&m->lock);
+    return height;
+}
+
+bool hf_version_map_get(hf_version_map *m, uint64_t height, uint8_t *version) {
+    bool ret = false;
+    g_rw_lock_reader_lock(&m->lock);
+    if (height < m->versions->len) {
+        *version = m->versions->data[height];
+        ret = true;
+    }
+    g_rw_lock_reader_unlock(&m->lock);
+    return ret;
+}
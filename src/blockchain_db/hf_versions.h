@@ -0,0 +1,33 @@
+#ifndef MONERO_BLOCKCHAIN_DB_HF_VERSIONS_H_
+#define MONERO_BLOCKCHAIN_DB_HF_VERSIONS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * The hard fork version of every height, one byte each, mirroring the
+ * hf_versions table. It is loaded when the db opens and follows blocks as
+ * they are added and popped, so a version query is an array index with no
+ * read txn. The table stays the source of truth.
+ */
+typedef struct hf_version_map {
+    GRWLock lock;
+    GByteArray *versions;   // by height
+} hf_version_map;
+
+void hf_version_map_init(hf_version_map *m);
+void hf_version_map_clear(hf_version_map *m);
+// forget every height, as when the db is reset
+void hf_version_map_reset(hf_version_map *m);
+
+void hf_version_map_push(hf_version_map *m, uint8_t version);
+// drop every height from height up, false if there are fewer
+bool hf_version_map_truncate(hf_version_map *m, uint64_t height);
+uint64_t hf_version_map_height(hf_version_map *m);
+
+// false if height is above the chain
+bool hf_version_map_get(hf_version_map *m, uint64_t height, uint8_t *version);
+
+#endif //MONERO_BLOCKCHAIN_DB_HF_VERSIONS_H_
@@ -1,14 +1,32 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <string.h>
+#include <unistd.h>
 #include "common/file_util.h"
 #include "db_lmdb.h"
-#include "cryptonote_basic/difficulty.h"
+#include "common/arena.h"
+#include "common/threadpool.h"
+#include "ringct/rctOps.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 
 // Increase when the DB structure changes
 #define VERSION 3
+// records converted per write txn when migrating
+#define MIGRATE_BATCH 10000
+#define DEFAULT_READERS 126
+#define READER_CHECK_INTERVAL 60
+// blocks lmdb_for_blocks_range_blobs reads in one snapshot before it lets the map move
+#define RANGE_RENEW_BLOCKS 4096
 static GPrivate thread_info_key;
+// BlockchainLMDB -> read txns of this thread, which share one hold of its m_map_lock
+static GPrivate map_holds_key = G_PRIVATE_INIT((GDestroyNotify)g_hash_table_destroy);
 
 #pragma pack(push, 1)
 // This MUST be identical to output_data_t, without the extra rct data at the end
@@ -24,15 +42,17 @@ typedef struct pre_rct_output_data_t
 
 MDB_val* mdb_val_from_char_array(char* val) {
     MDB_val *mdb_val = malloc(sizeof(MDB_val));
-    mdb_val->mv_size = sizeof(strlen(val) + 1);
+    mdb_val->mv_size = strlen(val) + 1;
     mdb_val->mv_data = val;
     return mdb_val;
 }
 
 MDB_val* mdb_val_from_uint32_t(uint32_t val) {
-    MDB_val *mdb_val = malloc(sizeof(MDB_val));
+    // the value lives right after the MDB_val, in the same allocation
+    MDB_val *mdb_val = malloc(sizeof(MDB_val) + sizeof(uint32_t));
     mdb_val->mv_size = sizeof(uint32_t);
-    mdb_val->mv_data = &val;
+    mdb_val->mv_data = mdb_val + 1;
+    memcpy(mdb_val->mv_data, &val, sizeof(uint32_t));
     return mdb_val;
 }
 
@@ -78,53 +98,304 @@ void mdb_txn_safe_abort(mdb_txn_safe* txn) {
         g_warning("WARNING: mdb_txn_safe: abort() called, but m_txn is NULL");
     }
 }
-static void mdb_txn_safe_prevent_new_txns() {
-    //TODO
+typedef struct lmdb_io_profile_info {
+    const char *name;
+    unsigned int open_flags;    // only taken at open
+    unsigned int set_flags;     // ones mdb_env_set_flags can change on an open env
+    int advice[2];              // for the map, on solid state and on a spinning disk
+    bool drop_resident;
+} lmdb_io_profile_info;
+
+/*
+ * A spinning disk pays a seek for every page read on its own, so readahead
+ * is worth what it wastes there, but not on solid state. MDB_WRITEMAP saves
+ * a copy of every page written while syncing; serving, a stray write
+ * through a pointer into the map would corrupt the db instead of faulting.
+ */
+static const lmdb_io_profile_info lmdb_io_profiles[LMDB_IO_PROFILES] = {
+    [LMDB_IO_DEFAULT] = { "default", 0, 0, { MADV_RANDOM, MADV_RANDOM }, false },
+    [LMDB_IO_SYNC] = { "sync", MDB_WRITEMAP, MDB_NOMEMINIT, { MADV_RANDOM, MADV_NORMAL }, false },
+    [LMDB_IO_SERVE] = { "serve", 0, 0, { MADV_RANDOM, MADV_NORMAL }, false },
+    [LMDB_IO_LOW_MEMORY] = { "low-memory", 0, 0, { MADV_RANDOM, MADV_RANDOM }, true },
+};
+
+const char *lmdb_io_profile_name(lmdb_io_profile profile) {
+    return profile < LMDB_IO_PROFILES ? lmdb_io_profiles[profile].name : NULL;
 }
-static void mdb_txn_safe_wait_no_active_txns() {
-    //TODO
+
+bool lmdb_io_profile_from_name(const char *name, lmdb_io_profile *profile) {
+    for (int i = 0; i < LMDB_IO_PROFILES; i++) {
+        if (strcmp(name, lmdb_io_profiles[i].name) == 0) {
+            *profile = (lmdb_io_profile)i;
+            return true;
+        }
+    }
+    return false;
 }
-static void mdb_txn_safe_allow_new_txns() {
-    //TODO
+
+static const lmdb_io_profile_info *lmdb_io_profile_get(BlockchainLMDB *lmdb) {
+    return &lmdb_io_profiles[lmdb->m_io_profile < LMDB_IO_PROFILES ? lmdb->m_io_profile : LMDB_IO_DEFAULT];
+}
+
+static int lmdb_io_advice(BlockchainLMDB *lmdb) {
+    return lmdb_io_profile_get(lmdb)->advice[lmdb->m_rotational == 1];
+}
+
+/*
+ * Where the map of the data file starts. mdb_env_info has the address only
+ * for MDB_FIXEDMAP, so it is looked up in /proc/self/maps by the device and
+ * inode of the file: the run of mappings of it from offset 0 as long as the
+ * map.
+ */
+static bool lmdb_map_start(BlockchainLMDB *lmdb, size_t mapsize, uintptr_t *addr) {
+    struct stat sb;
+    mdb_filehandle_t fd;
+    FILE *f;
+    char line[PATH_MAX + 128];
+    uintptr_t start = 0, end = 0;
+    bool found = false;
+
+    if (mdb_env_get_fd(lmdb->m_env, &fd) || fstat(fd, &sb) || !(f = fopen("/proc/self/maps", "r"))) {
+        return false;
+    }
+    while (!found && fgets(line, sizeof(line), f)) {
+        unsigned long long lo, hi, offset, inode;
+        unsigned int dev_major, dev_minor;
+        if (sscanf(line, "%llx-%llx %*s %llx %x:%x %llu", &lo, &hi, &offset, &dev_major, &dev_minor, &inode) != 6
+            || inode != sb.st_ino || dev_major != major(sb.st_dev) || dev_minor != minor(sb.st_dev)) {
+            continue;
+        }
+        // a mapping is split where hints on it differ
+        if (end == lo && offset == end - start) {
+            end = hi;
+        } else if (offset == 0) {
+            start = lo;
+            end = hi;
+        } else {
+            continue;
+        }
+        found = end - start == mapsize;
+    }
+    fclose(f);
+    if (found) {
+        *addr = start;
+    }
+    return found;
+}
+
+/*
+ * m_map_lock is taken shared once per thread, however many read txns the
+ * thread has open: a second shared lock queued behind a resize would wait
+ * for the first for good.
+ */
+static guint lmdb_map_holds(BlockchainLMDB *lmdb) {
+    GHashTable *holds = g_private_get(&map_holds_key);
+    return holds ? GPOINTER_TO_UINT(g_hash_table_lookup(holds, lmdb)) : 0;
+}
+
+static void lmdb_map_hold(BlockchainLMDB *lmdb) {
+    GHashTable *holds = g_private_get(&map_holds_key);
+    guint n;
+    if (!holds) {
+        holds = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_private_set(&map_holds_key, holds);
+    }
+    n = GPOINTER_TO_UINT(g_hash_table_lookup(holds, lmdb));
+    if (n == 0) {
+        g_rw_lock_reader_lock(&lmdb->m_map_lock);
+    }
+    g_hash_table_insert(holds, lmdb, GUINT_TO_POINTER(n + 1));
+}
+
+static void lmdb_map_release(BlockchainLMDB *lmdb) {
+    GHashTable *holds = g_private_get(&map_holds_key);
+    const guint n = lmdb_map_holds(lmdb);
+    if (n > 1) {
+        g_hash_table_insert(holds, lmdb, GUINT_TO_POINTER(n - 1));
+        return;
+    }
+    g_hash_table_remove(holds, lmdb);
+    g_rw_lock_reader_unlock(&lmdb->m_map_lock);
+}
+
+/*
+ * Hints the whole map by the profile. A new map has lmdb's own hint, so
+ * this runs again after every move, between read txns.
+ */
+static void lmdb_io_advise(BlockchainLMDB *lmdb) {
+    MDB_envinfo mei;
+    uintptr_t map;
+    lmdb_map_hold(lmdb);
+    mdb_env_info(lmdb->m_env, &mei);
+    if (!lmdb_map_start(lmdb, mei.me_mapsize, &map)) {
+        g_debug("The map of the db was not found, its I/O hints are left as they are");
+        lmdb_map_release(lmdb);
+        return;
+    }
+    if (madvise((void *)map, mei.me_mapsize, lmdb_io_advice(lmdb))) {
+        g_debug("madvise on the map failed");
+    }
+    // shared pages of a file: a read faults them back in, written ones stay dirty in the page cache
+    if (lmdb_io_profile_get(lmdb)->drop_resident && madvise((void *)map, mei.me_mapsize, MADV_DONTNEED)) {
+        g_debug("madvise on the map failed");
+    }
+    lmdb_map_release(lmdb);
+}
+
+int lmdb_set_io_profile(BlockchainLMDB *lmdb, lmdb_io_profile profile, unsigned int flags) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    if (profile >= LMDB_IO_PROFILES) {
+        g_info("Unknown I/O profile: %d", profile);
+        return -3;
+    }
+    if (!lmdb_is_read_only(lmdb)) {
+        const unsigned int from = lmdb_io_profile_get(lmdb)->set_flags, to = lmdb_io_profiles[profile].set_flags;
+        unsigned int env_flags;
+        int result;
+        if ((result = mdb_env_get_flags(lmdb->m_env, &env_flags))) {
+            g_info("Failed to get the flags of the db: %d", result);
+            return -2;
+        }
+        if ((env_flags & MDB_WRITEMAP) != (lmdb_io_profiles[profile].open_flags & MDB_WRITEMAP)) {
+            if ((env_flags & MDB_WRITEMAP) && !(flags & LMDB_IO_REOPEN)) {
+                g_info("The map is writable until the db is reopened, not switching to the %s I/O profile",
+                       lmdb_io_profiles[profile].name);
+                return -4;
+            }
+            g_info("MDB_WRITEMAP follows the %s I/O profile only once the db is reopened", lmdb_io_profiles[profile].name);
+        }
+        if ((from & ~to) && (result = mdb_env_set_flags(lmdb->m_env, from & ~to, 0))) {
+            g_info("Failed to clear the flags of the I/O profile: %d", result);
+            return -2;
+        }
+        if (to && (result = mdb_env_set_flags(lmdb->m_env, to, 1))) {
+            g_info("Failed to set the flags of the I/O profile: %d", result);
+            return -2;
+        }
+    }
+    lmdb->m_io_profile = profile;
+    lmdb_io_advise(lmdb);
+    g_info("LMDB I/O profile: %s", lmdb_io_profiles[profile].name);
+    return 0;
 }
 
 void lmdb_resized(MDB_env* env) {
-    mdb_txn_safe_prevent_new_txns();
+    BlockchainLMDB *lmdb = mdb_env_get_userctx(env);
     g_info("LMDB map resize detected.");
     MDB_envinfo mei;
     
     mdb_env_info(env, &mei);
     uint64_t old = mei.me_mapsize;
     
-    mdb_txn_safe_wait_no_active_txns();
-    
+    // the map moves: wait for the read txns of every thread to end, and hold off new ones
+    if (lmdb) {
+        g_rw_lock_writer_lock(&lmdb->m_map_lock);
+    }
     int result = mdb_env_set_mapsize(env, 0);
+    if (lmdb) {
+        g_rw_lock_writer_unlock(&lmdb->m_map_lock);
+        lmdb_io_advise(lmdb);
+    }
     if (result) {
         g_error("Failed to set new mapsize: %d", result);
     }
     
     mdb_env_info(env, &mei);
     uint64_t new_mapsize = mei.me_mapsize;
-    g_info("LMDB Mapsize increased. Old: %llu MiB, New: %llu MiB", old / (1024 * 1024), new_mapsize/(1024 * 1024));
-    
-    mdb_txn_safe_allow_new_txns();
+    g_info("LMDB Mapsize increased. Old: %llu MiB, New: %llu MiB", (unsigned long long)(old / (1024 * 1024)),
+           (unsigned long long)(new_mapsize / (1024 * 1024)));
+}
+
+/*
+ * Follows a map the writer of another process grew, for a txn that got
+ * MDB_MAP_RESIZED. held is whether that txn holds m_map_lock already. When
+ * another read txn of this thread holds the old map, moving it would wait
+ * for that txn for good: false, and the caller is to end its txns and
+ * retry.
+ */
+static bool lmdb_map_follow(MDB_env *env, bool held) {
+    BlockchainLMDB *lmdb = mdb_env_get_userctx(env);
+    if (lmdb && lmdb_map_holds(lmdb) > (held ? 1 : 0)) {
+        g_info("The map of the db moved under a read txn of this thread, not following it");
+        return false;
+    }
+    if (lmdb && held) {
+        lmdb_map_release(lmdb);
+    }
+    lmdb_resized(env);
+    if (lmdb && held) {
+        lmdb_map_hold(lmdb);
+    }
+    return true;
 }
 
+/*
+ * Read txns hold m_map_lock shared until lmdb_rtxn_abort, so the map is
+ * only moved between them. A txn that finds the writer grew the file past
+ * the map lets go of it to follow, then tries again, unless the thread has
+ * other read txns open: then it fails with MDB_MAP_RESIZED.
+ */
 static inline int lmdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **txn) {
+    BlockchainLMDB *lmdb = (flags & MDB_RDONLY) ? mdb_env_get_userctx(env) : NULL;
+    if (lmdb) {
+        lmdb_map_hold(lmdb);
+    }
     int res = mdb_txn_begin(env, parent, flags, txn);
-    if (res == MDB_MAP_RESIZED) {
-        lmdb_resized(env);
+    if (res == MDB_MAP_RESIZED && lmdb_map_follow(env, lmdb != NULL)) {
         res = mdb_txn_begin(env, parent, flags, txn);
     }
+    if (res == MDB_READERS_FULL) {
+        // counted, and worth one more go if a dead process held some of the slots
+        BlockchainLMDB *owner = mdb_env_get_userctx(env);
+        if (owner) {
+            __atomic_fetch_add(&owner->m_readers_full, 1, __ATOMIC_RELAXED);
+            if (lmdb_check_readers(owner) > 0) {
+                res = mdb_txn_begin(env, parent, flags, txn);
+            }
+        }
+    }
+    if (res && lmdb) {
+        lmdb_map_release(lmdb);
+    }
     return res;
 }
 
+// ends a read txn of lmdb_txn_begin
+static inline void lmdb_rtxn_abort(MDB_txn *txn) {
+    BlockchainLMDB *lmdb = mdb_env_get_userctx(mdb_txn_env(txn));
+    mdb_txn_abort(txn);
+    if (lmdb) {
+        lmdb_map_release(lmdb);
+    }
+}
+
+// lets go of the snapshot of a read txn of lmdb_txn_begin, and of the map, to be renewed later
+static inline void lmdb_rtxn_reset(MDB_txn *txn) {
+    BlockchainLMDB *lmdb = mdb_env_get_userctx(mdb_txn_env(txn));
+    mdb_txn_reset(txn);
+    if (lmdb) {
+        lmdb_map_release(lmdb);
+    }
+}
+
+// renews a reset read txn on the terms of lmdb_txn_begin
 static inline int lmdb_txn_renew(MDB_txn *txn) {
+    MDB_env *env = mdb_txn_env(txn);
+    BlockchainLMDB *lmdb = mdb_env_get_userctx(env);
+    if (lmdb) {
+        lmdb_map_hold(lmdb);
+    }
     int res = mdb_txn_renew(txn);
-    if (res == MDB_MAP_RESIZED) {
-        lmdb_resized(mdb_txn_env(txn));
+    if (res == MDB_MAP_RESIZED && lmdb_map_follow(env, lmdb != NULL)) {
         res = mdb_txn_renew(txn);
     }
+    if (res && lmdb) {
+        lmdb_map_release(lmdb);
+    }
     return res;
 }
 
@@ -180,10 +451,19 @@ const char* const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char* const LMDB_HF_VERSIONS = "hf_versions";
 
 const char* const LMDB_PROPERTIES = "properties";
+// only while migrating from version 1
+const char* const LMDB_BLOCK_INFO_TMP = "block_info_tmp";
 
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
+// integer keys are only 2 byte aligned in the pages
+static uint64_t read_uint64(const void *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
 const char* lmdb_error(const char* error_string, int mdb_res) {
     char* mdb_error_string = mdb_strerror(mdb_res);
     char* full_string = malloc(sizeof(char) *(strlen(error_string) + strlen(mdb_error_string) + 4));
@@ -276,19 +556,415 @@ void mdb_txn_safe_uncheck(mdb_txn_safe* txn) {
     txn->m_check = false;
 }
 
-int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
+// the tip at the top of block_info in txn, but for its commit
+static int lmdb_tip_read(BlockchainLMDB *lmdb, MDB_txn *txn, lmdb_tip *tip) {
+    MDB_cursor *cur_block_info;
+    MDB_val k = zerokval, v;
     int result;
-    int mdb_flags = MDB_NORDAHEAD;
-    
-    if (lmdb != NULL && lmdb->db->m_open) {
-        /* code */
-        g_info("Attempted to open db, but it's already open");
+
+    memset(tip, 0, sizeof(*tip));
+    if ((result = mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info))) {
+        return result;
+    }
+    if (!(result = mdb_cursor_get(cur_block_info, &k, &v, MDB_SET))
+        && !(result = mdb_cursor_get(cur_block_info, &k, &v, MDB_LAST_DUP))) {
+        const mdb_block_info *bi = (const mdb_block_info *)v.mv_data;
+        tip->height = bi->bi_height + 1;
+        tip->top = bi->bi_hash;
+        tip->cumulative_difficulty = bi->bi_diff;
+        MDB_val_set(hk, bi->bi_height);
+        if (!(result = mdb_get(txn, lmdb->m_hf_versions, &hk, &v))) {
+            tip->hf_version = *(const uint8_t *)v.mv_data;
+        }
+    }
+    mdb_cursor_close(cur_block_info);
+    return result == MDB_NOTFOUND ? 0 : result;
+}
+
+/*
+ * The writer's half of the seqlock. Writers are serialized by m_tip_lock
+ * only, so one that committed earlier may come second and is ignored.
+ */
+// tries lmdb_get_tip spins through while a tip is published, before it yields
+#define TIP_READ_SPINS 64
+
+static void lmdb_tip_publish(BlockchainLMDB *lmdb, const lmdb_tip *tip) {
+    g_mutex_lock(&lmdb->m_tip_lock);
+    if (tip->commit >= lmdb->m_tip.commit) {
+        g_atomic_int_inc(&lmdb->m_tip_seq);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(&lmdb->m_tip, tip, sizeof(*tip));
+        g_atomic_int_inc(&lmdb->m_tip_seq);
+    }
+    g_mutex_unlock(&lmdb->m_tip_lock);
+}
+
+int lmdb_get_tip(BlockchainLMDB* lmdb, lmdb_tip *tip) {
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    for (int spins = 0;; spins++) {
+        const gint seq = g_atomic_int_get(&lmdb->m_tip_seq);
+        if (!(seq & 1)) {
+            // copied as bytes, the struct may be torn until the seq is checked again
+            memcpy(tip, &lmdb->m_tip, sizeof(*tip));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (g_atomic_int_get(&lmdb->m_tip_seq) == seq) {
+                return 0;
+            }
+        }
+        if (spins >= TIP_READ_SPINS) {
+            g_thread_yield();
+        }
+    }
+}
+
+// header records between one and the next append
+#define HEADER_BATCH 1024
+
+// the height the header file agrees with block_info up to, trusting records below the LMDB_TIP_HASHES it checks
+static uint64_t lmdb_headers_check(BlockchainLMDB *lmdb, MDB_txn *txn, uint64_t height) {
+    MDB_cursor *cur_block_info;
+    uint64_t n = MIN(header_file_count(&lmdb->m_headers), height);
+    if (mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info)) {
+        return 0;
+    }
+    for (int checked = 0; n > 0; checked++, n--) {
+        const uint64_t top = n - 1;
+        header_record r;
+        MDB_val_set(v, top);
+        if (checked == LMDB_TIP_HASHES || !header_file_read(&lmdb->m_headers, top, 1, &r)
+            || mdb_cursor_get(cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH)) {
+            n = 0;
+            break;
+        }
+        const mdb_block_info *bi = (const mdb_block_info *)v.mv_data;
+        if (r.height == top && memcmp(&r.hash, &bi->bi_hash, sizeof(hash)) == 0
+            && r.cumulative_difficulty == bi->bi_diff) {
+            break;
+        }
+    }
+    mdb_cursor_close(cur_block_info);
+    return n;
+}
+
+// appends the headers of the blocks from header_file_count up to height, parsed from m_blocks
+static int lmdb_headers_rebuild(BlockchainLMDB *lmdb, MDB_txn *txn, uint64_t height) {
+    MDB_cursor *cur_blocks, *cur_block_info;
+    header_record *batch = g_new0(header_record, HEADER_BATCH);
+    uint64_t next = header_file_count(&lmdb->m_headers);
+    size_t n = 0;
+    int result;
+
+    if ((result = mdb_cursor_open(txn, lmdb->m_blocks, &cur_blocks))) {
+        g_free(batch);
+        return result;
+    }
+    if ((result = mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info))) {
+        mdb_cursor_close(cur_blocks);
+        g_free(batch);
+        return result;
+    }
+    MDB_val_set(k, next);
+    MDB_val_set(v, next);
+    MDB_val blob, ki = zerokval;
+    result = next < height ? mdb_cursor_get(cur_block_info, &ki, &v, MDB_GET_BOTH) : MDB_NOTFOUND;
+    if (!result) {
+        result = mdb_cursor_get(cur_blocks, &k, &blob, MDB_SET);
+    }
+    while (!result) {
+        const mdb_block_info *bi = (const mdb_block_info *)v.mv_data;
+        header_record *r = &batch[n];
+        block_header header;
+        blob_reader br;
+        blob_reader_init(&br, blob.mv_data, blob.mv_size);
+        if (read_uint64(k.mv_data) != next || bi->bi_height != next || !parse_block_header(&br, &header)) {
+            result = MDB_CORRUPTED;
+            break;
+        }
+        r->height = next;
+        r->timestamp = header.timestamp;
+        r->cumulative_difficulty = bi->bi_diff;
+        r->hash = bi->bi_hash;
+        r->prev_id = header.prev_id;
+        r->nonce = header.nonce;
+        r->major_version = header.major_version;
+        r->minor_version = header.minor_version;
+        next++;
+        if (++n == HEADER_BATCH || next == height) {
+            if (header_file_append(&lmdb->m_headers, batch, n)) {
+                result = EIO;
+                break;
+            }
+            n = 0;
+        }
+        if (next == height) {
+            result = MDB_NOTFOUND;
+        } else if (!(result = mdb_cursor_get(cur_blocks, &k, &blob, MDB_NEXT))) {
+            result = mdb_cursor_get(cur_block_info, &ki, &v, MDB_NEXT_DUP);
+        }
+    }
+    mdb_cursor_close(cur_block_info);
+    mdb_cursor_close(cur_blocks);
+    g_free(batch);
+    // the loop only stops short with an error
+    return next == height ? 0 : result;
+}
+
+/*
+ * Opens the header file and makes it agree with the chain in txn, height
+ * blocks high: records the db does not have are dropped and missing ones
+ * parsed from the blocks. A read only one is only cut to what it agrees
+ * with. Without a header file the db works as before, so nothing here
+ * fails the open.
+ */
+static void lmdb_headers_open(BlockchainLMDB *lmdb, MDB_txn *txn, uint64_t height, bool read_only) {
+    int result = header_file_open(&lmdb->m_headers, lmdb->m_folder, read_only);
+    if (result) {
+        if (!read_only) {
+            g_warning("Failed to open the header file in %s: %d", lmdb->m_folder, result);
+        }
+        return;
+    }
+    const uint64_t had = header_file_count(&lmdb->m_headers);
+    const uint64_t agreed = lmdb_headers_check(lmdb, txn, height);
+    header_file_truncate(&lmdb->m_headers, agreed);
+    if (read_only || agreed == height) {
+        return;
+    }
+    if ((result = lmdb_headers_rebuild(lmdb, txn, height))) {
+        // the records it has agree with the chain, they are served without the rest
+        g_warning("%s", lmdb_error("Failed to rebuild the header file: ", result));
+        header_file_set_stale(&lmdb->m_headers);
+        return;
+    }
+    g_info("Header file: kept %llu of %llu records, read %llu from the blocks", (unsigned long long)agreed,
+           (unsigned long long)had, (unsigned long long)(height - agreed));
+}
+
+/*
+ * The record of a block lmdb_add_block committed. A header file that missed
+ * one is left stale rather than closed: readers may hold pointers into its
+ * map, so it is unmapped only by lmdb_close, and the next open rebuilds it.
+ */
+static void lmdb_headers_add(BlockchainLMDB *lmdb, uint64_t height, const block_header *header, const hash *h,
+                             difficulty_type cumulative_difficulty) {
+    const header_record r = {
+        .height = height,
+        .timestamp = header->timestamp,
+        .cumulative_difficulty = cumulative_difficulty,
+        .hash = *h,
+        .prev_id = header->prev_id,
+        .nonce = header->nonce,
+        .major_version = header->major_version,
+        .minor_version = header->minor_version,
+    };
+    if (!header_file_is_open(&lmdb->m_headers) || lmdb->m_headers.stale) {
+        return;
+    }
+    if (header_file_count(&lmdb->m_headers) != height || header_file_append(&lmdb->m_headers, &r, 1)) {
+        g_warning("The header file fell behind at height %llu, no longer adding to it", (unsigned long long)height);
+        header_file_set_stale(&lmdb->m_headers);
+    }
+}
+
+int lmdb_get_headers(BlockchainLMDB* lmdb, uint64_t start, uint64_t n, header_record *records) {
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    if (!header_file_is_open(&lmdb->m_headers)) {
+        return -2;
+    }
+    return header_file_read(&lmdb->m_headers, start, n, records) ? 0 : -3;
+}
+
+// reads bi_cum_rct of every block into the in memory distribution
+static int lmdb_load_rct_distribution(BlockchainLMDB *lmdb, MDB_txn *txn) {
+    MDB_cursor *cur_block_info;
+    MDB_val key = zerokval, v;
+    int result;
+
+    output_distribution_reset(&lmdb->m_rct_distribution);
+    if ((result = mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        return result;
+    }
+    result = mdb_cursor_get(cur_block_info, &key, &v, MDB_SET);
+    while (!result) {
+        const mdb_block_info *bi = (const mdb_block_info *)v.mv_data;
+        if (bi->bi_height != output_distribution_height(&lmdb->m_rct_distribution)) {
+            g_info("Block info out of order at height %llu", (unsigned long long)bi->bi_height);
+            result = MDB_CORRUPTED;
+            break;
+        }
+        output_distribution_push(&lmdb->m_rct_distribution, bi->bi_cum_rct);
+        lmdb->m_tip_hashes[bi->bi_height % LMDB_TIP_HASHES] = bi->bi_hash;
+        result = mdb_cursor_get(cur_block_info, &key, &v, MDB_NEXT_DUP);
+    }
+    mdb_cursor_close(cur_block_info);
+    return result == MDB_NOTFOUND ? 0 : result;
+}
+
+/*
+ * reads hf_versions into memory and checks it against the blocks: one
+ * version per block, never going down, and the last one the major version
+ * of the top block
+ */
+static int lmdb_load_hf_versions(BlockchainLMDB *lmdb, MDB_txn *txn) {
+    MDB_cursor *cur_hf_versions;
+    MDB_stat st;
+    MDB_val k, v;
+    uint64_t height;
+    uint8_t version = 0;
+    int result;
+
+    hf_version_map_reset(&lmdb->m_hf_version_map);
+    if ((result = mdb_stat(txn, lmdb->m_blocks, &st))) {
+        return result;
+    }
+    if ((result = mdb_cursor_open(txn, lmdb->m_hf_versions, &cur_hf_versions))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        return result;
+    }
+    result = mdb_cursor_get(cur_hf_versions, &k, &v, MDB_FIRST);
+    while (!result) {
+        memcpy(&height, k.mv_data, sizeof(height));
+        if (height != hf_version_map_height(&lmdb->m_hf_version_map) || v.mv_size != 1 || *(const uint8_t *)v.mv_data < version) {
+            g_info("Hard fork version out of order at height %llu", (unsigned long long)height);
+            result = MDB_CORRUPTED;
+            break;
+        }
+        version = *(const uint8_t *)v.mv_data;
+        hf_version_map_push(&lmdb->m_hf_version_map, version);
+        result = mdb_cursor_get(cur_hf_versions, &k, &v, MDB_NEXT);
+    }
+    mdb_cursor_close(cur_hf_versions);
+    if (result != MDB_NOTFOUND) {
+        return result;
+    }
+
+    height = hf_version_map_height(&lmdb->m_hf_version_map);
+    if (height != st.ms_entries) {
+        g_info("%llu hard fork versions for %llu blocks", (unsigned long long)height, (unsigned long long)st.ms_entries);
+        return MDB_CORRUPTED;
+    }
+    if (height > 0) {
+        uint64_t major;
+        blob_reader r;
+        k.mv_size = sizeof(height);
+        k.mv_data = &height;
+        height--;
+        if ((result = mdb_get(txn, lmdb->m_blocks, &k, &v))) {
+            return result;
+        }
+        blob_reader_init(&r, v.mv_data, v.mv_size);
+        if (!blob_read_varint(&r, &major) || major != version) {
+            g_info("The top block is not hard fork version %u", version);
+            return MDB_CORRUPTED;
+        }
+    }
+    return 0;
+}
+
+/*
+ * A slot per thread that may hold a read txn: the shared pool has one
+ * worker per core, the caller says how many threads of its own read, and
+ * the rest of the process gets a few. Never below the LMDB default.
+ */
+static unsigned int lmdb_reader_slots(BlockchainLMDB *lmdb) {
+    const unsigned int threads = g_get_num_processors() + lmdb->m_reader_threads;
+    return MAX(threads + 16, DEFAULT_READERS);
+}
+
+int lmdb_check_readers(BlockchainLMDB *lmdb) {
+    int dead = 0;
+    int result = mdb_reader_check(lmdb->m_env, &dead);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to check for stale readers: ", result));
+        return -1;
+    }
+    if (dead > 0) {
+        __atomic_fetch_add(&lmdb->m_readers_reaped, (uint64_t)dead, __ATOMIC_RELAXED);
+        g_info("Cleared %d reader slot(s) of dead processes", dead);
+    }
+    return dead;
+}
+
+// sweeps the reader table every m_reader_check_interval seconds until lmdb_close
+static gpointer lmdb_reader_reaper(gpointer data) {
+    BlockchainLMDB *lmdb = data;
+    const guint interval = lmdb->m_reader_check_interval ? lmdb->m_reader_check_interval : READER_CHECK_INTERVAL;
+
+    g_mutex_lock(&lmdb->m_reaper_lock);
+    while (!lmdb->m_reaper_stop) {
+        const gint64 until = g_get_monotonic_time() + interval * G_TIME_SPAN_SECOND;
+        while (!lmdb->m_reaper_stop && g_cond_wait_until(&lmdb->m_reaper_cond, &lmdb->m_reaper_lock, until)) {
+        }
+        if (!lmdb->m_reaper_stop) {
+            g_mutex_unlock(&lmdb->m_reaper_lock);
+            lmdb_check_readers(lmdb);
+            g_mutex_lock(&lmdb->m_reaper_lock);
+        }
+    }
+    g_mutex_unlock(&lmdb->m_reaper_lock);
+    return NULL;
+}
+
+static int lmdb_count_reader(const char *msg, void *ctx) {
+    // a header line, then one line per slot: pid, thread and txn id
+    const char c = msg[strspn(msg, " ")];
+    if (c >= '0' && c <= '9') {
+        (*(unsigned int *)ctx)++;
+    }
+    return 0;
+}
+
+int lmdb_get_reader_stats(BlockchainLMDB *lmdb, lmdb_reader_stats *stats) {
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
         return -1;
     }
+    MDB_envinfo mei;
+    memset(stats, 0, sizeof(*stats));
+    if (mdb_env_info(lmdb->m_env, &mei) || mdb_reader_list(lmdb->m_env, lmdb_count_reader, &stats->used) < 0) {
+        g_info("Failed to read the reader table");
+        return -2;
+    }
+    stats->max_readers = mei.me_maxreaders;
+    stats->high_water = mei.me_numreaders;
+    stats->reaped = __atomic_load_n(&lmdb->m_readers_reaped, __ATOMIC_RELAXED);
+    stats->full = __atomic_load_n(&lmdb->m_readers_full, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// the locks live from lmdb_open to lmdb_close, or to the return of an open that failed
+static void lmdb_locks_init(BlockchainLMDB *lmdb) {
+    g_mutex_init(&lmdb->m_reaper_lock);
+    g_cond_init(&lmdb->m_reaper_cond);
+    g_rw_lock_init(&lmdb->m_map_lock);
+    g_mutex_init(&lmdb->m_refresh_lock);
+    g_mutex_init(&lmdb->m_prefetch_lock);
+    g_mutex_init(&lmdb->m_tip_lock);
+}
+
+static void lmdb_locks_clear(BlockchainLMDB *lmdb) {
+    g_cond_clear(&lmdb->m_reaper_cond);
+    g_mutex_clear(&lmdb->m_reaper_lock);
+    g_rw_lock_clear(&lmdb->m_map_lock);
+    g_mutex_clear(&lmdb->m_refresh_lock);
+    g_mutex_clear(&lmdb->m_prefetch_lock);
+    g_mutex_clear(&lmdb->m_tip_lock);
+}
+
+static int lmdb_open_env(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
+    int result;
+    int mdb_flags = 0;
     
     struct stat sb;
     if (stat(filename, &sb) != 0) {
-        if ((result = mkdir(filename, 0777))) {
+        if ((result = mkdir(filename, 0777)) || stat(filename, &sb) != 0) {
             g_info("Create file failed, filename: %s, result: %d", filename, result);
             return -2;
         }
@@ -299,13 +975,14 @@ int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
     }
     
     int index = (int)(strrchr(filename, '/') - filename);
-    char oldFiles[index+1];
+    char oldFiles[index+2];
     strncpy(oldFiles, filename, index+1);
+    oldFiles[index+1] = '\0';
     
-    char block_data_file_path[strlen(oldFiles) + strlen(CRYPTONOTE_BLOCKCHAINDATA_FILENAME)];
+    char block_data_file_path[strlen(oldFiles) + strlen(CRYPTONOTE_BLOCKCHAINDATA_FILENAME) + 1];
     strcpy(block_data_file_path, oldFiles);
     strcat(block_data_file_path, CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
-    char block_lock_file_path[strlen(oldFiles) + strlen(CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME)];
+    char block_lock_file_path[strlen(oldFiles) + strlen(CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME) + 1];
     strcpy(block_lock_file_path, oldFiles);
     strcat(block_lock_file_path, CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME);
     if (is_file_exists(block_data_file_path) || is_file_exists(block_lock_file_path)) {
@@ -314,16 +991,18 @@ int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
         return -4;
     }
     
-    //TODO check is hdd.
-    //    boost::optional<bool> is_hdd_result = tools::is_hdd(filename.c_str());
-    //    if (is_hdd_result)
-    //    {
-    //        if (is_hdd_result.value())
-    //            MCLOG_RED(el::Level::Warning, "global", "The blockchain is on a rotating drive: this will be very slow, use a SSD if possible");
-    //    }
+    lmdb->m_rotational = is_rotational(filename);
+    if (lmdb->m_rotational == 1) {
+        g_warning("The blockchain is on a rotating drive: this will be very slow, use a SSD if possible");
+    }
+    // lmdb hints MADV_RANDOM itself for MDB_NORDAHEAD, the other hints are lmdb_io_advise's
+    const lmdb_io_profile_info *profile = lmdb_io_profile_get(lmdb);
+    if (lmdb_io_advice(lmdb) == MADV_RANDOM) {
+        mdb_flags |= MDB_NORDAHEAD;
+    }
     
     lmdb->m_folder = malloc(strlen(filename) + 1);
-    strncpy(lmdb->m_folder, filename, strlen(filename));
+    strcpy(lmdb->m_folder, filename);
     
     if((result = mdb_env_create(&(lmdb->m_env)))) {
         g_info("Failed to create lmdb environment: %d", result);
@@ -335,22 +1014,26 @@ int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
         return -6;
     }
     
-    //TODO need to calculate from core of CPU
-    int threads = 20;
-    if (threads > 110
-        && (result = mdb_env_set_maxreaders(lmdb->m_env, threads + 16))) {
+    mdb_env_set_userctx(lmdb->m_env, lmdb);
+    if ((result = mdb_env_set_maxreaders(lmdb->m_env, lmdb_reader_slots(lmdb)))) {
         g_info("Failed to set max number of readers: %d", result);
         return -7;
     }
     
-    size_t mapsize = DEFAULT_MAPSIZE;
+    size_t mapsize = lmdb->m_map_size ? lmdb->m_map_size : DEFAULT_MAPSIZE;
     
     if (db_flags & DBF_FAST)
         mdb_flags |= MDB_NOSYNC;
     if (db_flags & DBF_FASTEST)
         mdb_flags |= MDB_NOSYNC | MDB_WRITEMAP | MDB_MAPASYNC;
-    if (db_flags & DBF_RDONLY)
-        mdb_flags = MDB_RDONLY;
+    if (!(db_flags & (DBF_RDONLY | DBF_REPLICA)))
+        mdb_flags |= profile->open_flags | profile->set_flags;
+    if (db_flags & (DBF_RDONLY | DBF_REPLICA))
+        mdb_flags = MDB_RDONLY | (mdb_flags & MDB_NORDAHEAD);
+    // the threads of a replica serve reads from a pool, each may take up any txn
+    if (db_flags & DBF_REPLICA)
+        mdb_flags |= MDB_NOTLS;
+    lmdb->m_replica = (db_flags & DBF_REPLICA) != 0;
     if (db_flags & DBF_SALVAGE)
         mdb_flags |= MDB_PREVSNAPSHOT;
     
@@ -358,30 +1041,37 @@ int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
         g_info("Failed to open lmdb environment: %d", result);
         return -8;
     }
+    // the slots a crashed process left behind
+    lmdb_check_readers(lmdb);
     
     MDB_envinfo mei;
     mdb_env_info(lmdb->m_env, &mei);
     uint64_t cur_mapsize = (double)mei.me_mapsize;
     
-    if (cur_mapsize < mapsize) {
+    // a read only map follows the one the writer sets
+    if (cur_mapsize < mapsize && !(mdb_flags & MDB_RDONLY)) {
         if ((result = mdb_env_set_mapsize(lmdb->m_env, mapsize))) {
             g_info("Failed to set max memory map size: %d", result);
             return -9;
         }
         mdb_env_info(lmdb->m_env, &mei);
         cur_mapsize = (double)mei.me_mapsize;
-        g_info("LMDB memory map size: %llu", cur_mapsize);
+        g_info("LMDB memory map size: %llu", (unsigned long long)cur_mapsize);
     }
     
-    if (lmdb_need_resize(lmdb, 0)) {
+    if (!(mdb_flags & MDB_RDONLY) && lmdb_need_resize(lmdb, 0)) {
         lmdb_do_resize(lmdb, 0);
     }
+    lmdb_io_advise(lmdb);
     
     int txn_flags = 0;
     if (mdb_flags & MDB_RDONLY) {
         txn_flags |= MDB_RDONLY;
     }
     
+    output_distribution_init(&lmdb->m_rct_distribution);
+    hf_version_map_init(&lmdb->m_hf_version_map);
+
     // get a read/write MDB_txn, depending on mdb_flags
     mdb_txn_safe txn_safe;
     int mdb_res = mdb_txn_begin(lmdb->m_env, NULL, txn_flags, &txn_safe.m_txn);
@@ -464,14 +1154,29 @@ int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
             compatible = false;
         }
 #if VERSION > 0
-        else if (db_version < VERSION) {
+        else if (db_version < VERSION && (mdb_flags & MDB_RDONLY)) {
+            g_warning("Existing lmdb database is version %d and needs migrating, which it can't be read-only.", db_version);
+            compatible = false;
+        } else if (db_version < VERSION) {
             // Note that there was a schema change within version 0 as well.
             // See commit e5d2680094ee15889934fe28901e4e133cda56f2 2015/07/10
             // We don't handle the old format previous to that commit.
+            // The tables are open: migrate in write txns of its own, then carry on in a new one.
             mdb_txn_safe_commit(&txn_safe, NULL);
-            lmdb->db->m_open = true;
-            lmdb_migrate(lmdb, 0);
-            return 0;
+            if (lmdb_migrate(lmdb, db_version)) {
+                mdb_env_close(lmdb->m_env);
+                output_distribution_clear(&lmdb->m_rct_distribution);
+                hf_version_map_clear(&lmdb->m_hf_version_map);
+                return -17;
+            }
+            if ((mdb_res = mdb_txn_begin(lmdb->m_env, NULL, txn_flags, &txn_safe.m_txn))) {
+                g_info("Failed to create a transaction for the db: %d", mdb_res);
+                mdb_env_close(lmdb->m_env);
+                output_distribution_clear(&lmdb->m_rct_distribution);
+                hf_version_map_clear(&lmdb->m_hf_version_map);
+                return -10;
+            }
+            txn = txn_safe.m_txn;
         }
 #endif
     } else {
@@ -506,14 +1211,67 @@ int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
         }
     }
     
-    // commit the transaction
-    mdb_txn_safe_commit(&txn_safe, NULL);
-    
-    lmdb->db->m_open = true;
-    // from here, init should be finished
-    return 0;
-}
-
+    if ((result = lmdb_load_rct_distribution(lmdb, txn))) {
+        g_info("%s", lmdb_error("Failed to load the rct output distribution: ", result));
+        mdb_txn_safe_abort(&txn_safe);
+        mdb_env_close(lmdb->m_env);
+        output_distribution_clear(&lmdb->m_rct_distribution);
+        hf_version_map_clear(&lmdb->m_hf_version_map);
+        return -15;
+    }
+    if ((result = lmdb_load_hf_versions(lmdb, txn))) {
+        g_info("%s", lmdb_error("Failed to load the hard fork versions: ", result));
+        mdb_txn_safe_abort(&txn_safe);
+        mdb_env_close(lmdb->m_env);
+        output_distribution_clear(&lmdb->m_rct_distribution);
+        hf_version_map_clear(&lmdb->m_hf_version_map);
+        return -16;
+    }
+
+    lmdb_tip tip;
+    if ((result = lmdb_tip_read(lmdb, txn, &tip))) {
+        g_info("%s", lmdb_error("Failed to read the top block: ", result));
+        mdb_txn_safe_abort(&txn_safe);
+        mdb_env_close(lmdb->m_env);
+        output_distribution_clear(&lmdb->m_rct_distribution);
+        hf_version_map_clear(&lmdb->m_hf_version_map);
+        return -18;
+    }
+
+    lmdb_headers_open(lmdb, txn, tip.height, mdb_flags & MDB_RDONLY);
+
+    // the snapshot a read txn saw; a write txn that changed nothing does not take its own id
+    tip.commit = mdb_txn_id(txn);
+
+    // commit the transaction
+    mdb_txn_safe_commit(&txn_safe, NULL);
+    if (!(mdb_flags & MDB_RDONLY)) {
+        mdb_env_info(lmdb->m_env, &mei);
+        tip.commit = mei.me_last_txnid;
+    }
+    lmdb_tip_publish(lmdb, &tip);
+    
+    lmdb->db->m_open = true;
+    lmdb->m_reaper_stop = false;
+    lmdb->m_reader_reaper = g_thread_new("lmdb_readers", lmdb_reader_reaper, lmdb);
+    // from here, init should be finished
+    return 0;
+}
+
+int lmdb_open(BlockchainLMDB *lmdb, const char* filename, const int db_flags) {
+    if (lmdb != NULL && lmdb->db->m_open) {
+        /* code */
+        g_info("Attempted to open db, but it's already open");
+        return -1;
+    }
+    lmdb_locks_init(lmdb);
+    const int result = lmdb_open_env(lmdb, filename, db_flags);
+    if (result) {
+        lmdb_locks_clear(lmdb);
+    }
+    return result;
+}
+
 bool lmdb_is_read_only(BlockchainLMDB *lmdb) {
     unsigned int flags;
     int result = mdb_env_get_flags(lmdb->m_env, &flags);
@@ -527,7 +1285,27 @@ bool lmdb_is_read_only(BlockchainLMDB *lmdb) {
     }
 }
 
+// the cached read txn of this thread, if it is of this env, before the env closes
+static void lmdb_block_rtxn_free(BlockchainLMDB* lmdb) {
+    mdb_threadinfo *tinfo = g_private_get(&thread_info_key);
+    if (tinfo == NULL || mdb_txn_env(tinfo->m_ti_rtxn) != lmdb->m_env) {
+        return;
+    }
+    if (tinfo->m_ti_rflags.m_rf_txn) {
+        lmdb_rtxn_abort(tinfo->m_ti_rtxn);
+    } else {
+        mdb_txn_abort(tinfo->m_ti_rtxn);
+    }
+    g_private_replace(&thread_info_key, NULL);
+    free(tinfo);
+    if (lmdb->m_tinfo == tinfo) {
+        lmdb->m_tinfo = NULL;
+    }
+}
+
 int lmdb_close(BlockchainLMDB *lmdb) {
+    // the locks of an open that failed are cleared already
+    const bool was_open = lmdb->db->m_open;
     if (lmdb->m_batch_active) {
         g_warning("close() first calling batch_abort() due to active batch transaction");
         lmdb_batch_abort(lmdb);
@@ -535,8 +1313,35 @@ int lmdb_close(BlockchainLMDB *lmdb) {
     lmdb_sync(lmdb);
     //TODO
     //    m_tinfo.reset();
+    if (lmdb->m_reader_reaper) {
+        g_mutex_lock(&lmdb->m_reaper_lock);
+        lmdb->m_reaper_stop = true;
+        g_cond_signal(&lmdb->m_reaper_cond);
+        g_mutex_unlock(&lmdb->m_reaper_lock);
+        g_thread_join(lmdb->m_reader_reaper);
+        lmdb->m_reader_reaper = NULL;
+    }
+    lmdb_block_rtxn_free(lmdb);
     mdb_env_close(lmdb->m_env);
+    if (lmdb->m_rct_distribution.cumulative) {
+        output_distribution_clear(&lmdb->m_rct_distribution);
+    }
+    if (lmdb->m_hf_version_map.versions) {
+        hf_version_map_clear(&lmdb->m_hf_version_map);
+    }
+    header_file_close(&lmdb->m_headers);
     lmdb->db->m_open = false;
+    if (was_open) {
+        // txn ids are per environment, the next open starts over
+        g_mutex_lock(&lmdb->m_tip_lock);
+        g_atomic_int_inc(&lmdb->m_tip_seq);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memset(&lmdb->m_tip, 0, sizeof(lmdb->m_tip));
+        g_atomic_int_inc(&lmdb->m_tip_seq);
+        g_mutex_unlock(&lmdb->m_tip_lock);
+        __atomic_fetch_add(&lmdb->m_generation, 1, __ATOMIC_RELEASE);
+        lmdb_locks_clear(lmdb);
+    }
     return 0;
 }
 
@@ -597,7 +1402,14 @@ int lmdb_reset(BlockchainLMDB* lmdb) {
     if (result) {
         g_error("%s", lmdb_error("Failed to write version to database: ", result));
     }
+    const lmdb_tip empty = { .commit = mdb_txn_id(txn) };
     mdb_txn_safe_commit(&txn_safe, NULL);
+    output_distribution_reset(&lmdb->m_rct_distribution);
+    hf_version_map_reset(&lmdb->m_hf_version_map);
+    lmdb_tip_publish(lmdb, &empty);
+    if (header_file_is_open(&lmdb->m_headers)) {
+        header_file_truncate(&lmdb->m_headers, 0);
+    }
     return 0;
 }
 
@@ -640,7 +1452,9 @@ bool my_rtxn = lmdb_block_rtxn_start(lmdb, &m_txn, &m_cursors); \
 if (my_rtxn) auto_txn.m_tinfo = g_private_get(&thread_info_key); \
 else mdb_txn_safe_uncheck(&auto_txn);
 
-#define TXN_POSTFIX_RDONLY()
+// the cached read txn is reset on the way out, so it does not keep the map from moving
+#define TXN_POSTFIX_RDONLY(lmdb) \
+if (my_rtxn) lmdb_block_rtxn_stop(lmdb);
 
 bool lmdb_block_exists(BlockchainLMDB* lmdb, const hash* h, uint64_t *height) {
     g_debug("BlockchainLMDB::%s", __func__);
@@ -649,17 +1463,18 @@ bool lmdb_block_exists(BlockchainLMDB* lmdb, const hash* h, uint64_t *height) {
         return false;
     }
     TXN_PREFIX_RDONLY(lmdb);
+    if (!m_txn) {
+        return false;
+    }
     RCURSOR(lmdb, block_heights);
     
     bool ret = false;
-    MDB_val_set(key, h);
+    MDB_val key = {sizeof(*h), (void *)h};
     int get_result = mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
     if (get_result == MDB_NOTFOUND) {
-        g_info("Block with hash %s not found in db.", h->data);
-        return false;
+        g_info("Block with hash not found in db.");
     } else if (get_result) {
         g_warning("%s",  lmdb_error("DB error attempting to fetch block index from hash", get_result));
-        return -2;
     } else {
         if (height) {
             const blk_height *bhp = (const blk_height *)key.mv_data;
@@ -667,7 +1482,7 @@ bool lmdb_block_exists(BlockchainLMDB* lmdb, const hash* h, uint64_t *height) {
         }
         ret = true;
     }
-    TXN_POSTFIX_RDONLY();
+    TXN_POSTFIX_RDONLY(lmdb);
     return ret;
 }
 
@@ -678,20 +1493,26 @@ int lmdb_get_block_height(BlockchainLMDB* lmdb, const hash* h, uint64_t* height)
         return -1;
     }
     TXN_PREFIX_RDONLY(lmdb);
+    if (!m_txn) {
+        return -4;
+    }
     RCURSOR(lmdb, block_heights);
     
-    MDB_val_set(key, h);
+    int ret = 0;
+    MDB_val key = {sizeof(*h), (void *)h};
     int get_result = mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
     if (get_result == MDB_NOTFOUND) {
-        g_info("Attempted to retrieve non-existent block height. hash: %s", h->data);
-        return -2;
+        g_info("Attempted to retrieve non-existent block height.");
+        ret = -2;
     } else if (get_result) {
-        g_info("Error attempting to retrieve a block height from the db, hash: %s", h->data);
-        return -3;
+        g_info("%s", lmdb_error("Error attempting to retrieve a block height from the db: ", get_result));
+        ret = -3;
+    } else {
+        const blk_height *bhp = (const blk_height *)key.mv_data;
+        *height = bhp->bh_height;
     }
-    blk_height *bhp = (blk_height *)key.mv_data;
-    *height = bhp->bh_height;
-    return 0;
+    TXN_POSTFIX_RDONLY(lmdb);
+    return ret;
 }
 
 int lmdb_get_block(BlockchainLMDB* lmdb, const hash* h) {
@@ -747,150 +1568,2196 @@ int lmdb_batch_abort(BlockchainLMDB* lmdb) {
 }
 
 
-bool lmdb_block_rtxn_start(BlockchainLMDB* lmdb, MDB_txn **mtxn, mdb_txn_cursors **mcur) {
-    bool ret = false;
-    mdb_threadinfo *tinfo;
-    if (lmdb->m_write_txn && lmdb->m_writer == g_thread_self()) {
-        *mtxn = lmdb->m_write_txn->m_txn;
-        *mcur = (mdb_txn_cursors *)&lmdb->m_wcursors;
-        return ret;
+// pages of [data, data + size) not in memory, by mincore
+static size_t lmdb_pages_out(const void *data, size_t size, uintptr_t page) {
+    uintptr_t start = (uintptr_t)data & ~(page - 1);
+    const uintptr_t end = ((uintptr_t)data + size + page - 1) & ~(page - 1);
+    unsigned char vec[64];
+    size_t out = 0;
+    while (start < end) {
+        const size_t n = MIN((end - start) / page, sizeof(vec));
+        if (mincore((void *)start, n * page, vec)) {
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            out += !(vec[i] & 1);
+        }
+        start += n * page;
     }
-    /* Check for existing info and force reset if env doesn't match -
-     * only happens if env was opened/closed multiple times in same process
-     */
-    tinfo = g_private_get(&thread_info_key);
-    if (tinfo != NULL || mdb_txn_env(tinfo->m_ti_rtxn) != lmdb->m_env) {
-        tinfo = malloc(sizeof(mdb_threadinfo));
-        //maybe memory leak.
-        g_private_replace(&thread_info_key, tinfo);
-        memset(&tinfo->m_ti_rcursors, 0, sizeof(tinfo->m_ti_rcursors));
-        memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
-        int mdb_res = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &tinfo->m_ti_rtxn);
-        if (mdb_res) {
-            g_warning("%s", lmdb_error("Failed to create a read transaction for the db: ", mdb_res));
-            return false;
+    return out;
+}
+
+// the block at height and its txs other than the miner tx, which is in the block blob
+static int lmdb_get_block_blobs(MDB_cursor *cur_blocks, MDB_cursor *cur_tx_indices, MDB_cursor *cur_txs_pruned,
+                                uint64_t height, MDB_val *block, block_ref *b, GArray *txs) {
+    MDB_val_set(k, height);
+    MDB_val v;
+    blob_reader r;
+    int result;
+    if ((result = mdb_cursor_get(cur_blocks, &k, block, MDB_SET))) {
+        g_info("Attempted to get block at height %llu: %s", (unsigned long long)height, mdb_strerror(result));
+        return -4;
+    }
+    blob_reader_init(&r, block->mv_data, block->mv_size);
+    g_array_set_size(b->miner_tx.vout, 0);
+    if (!parse_block_ref(&r, b)) {
+        g_info("Failed to parse block at height %llu", (unsigned long long)height);
+        return -5;
+    }
+
+    g_array_set_size(txs, 0);
+    for (size_t i = 0; i < b->tx_hashes_size; i++) {
+        MDB_val hk = { sizeof(hash), (void *)&b->tx_hashes[i] };
+        if ((result = mdb_cursor_get(cur_tx_indices, (MDB_val *)&zerokval, &hk, MDB_GET_BOTH))) {
+            g_info("Failed to get tx index %zu of block %llu: %s", i, (unsigned long long)height, mdb_strerror(result));
+            return -6;
         }
-        return true;
-    } else if (!tinfo->m_ti_rflags.m_rf_txn) {
-        int mdb_res = lmdb_txn_renew(tinfo->m_ti_rtxn);
-        if (mdb_res) {
-            g_warning("%s", lmdb_error("Failed to create a read transaction for the db: ", mdb_res));
-            return false;
+        const txindex *tip = (const txindex *)hk.mv_data;
+        MDB_val_set(tk, tip->data.tx_id);
+        if ((result = mdb_cursor_get(cur_txs_pruned, &tk, &v, MDB_SET))) {
+            g_info("Failed to get tx %llu: %s", (unsigned long long)tip->data.tx_id, mdb_strerror(result));
+            return -7;
         }
-        return true;
+        g_array_append_val(txs, v);
     }
-    
-    if (ret) {
-        tinfo->m_ti_rflags.m_rf_txn = true;
+    return 0;
+}
+
+static int lmdb_block_cursors_open(BlockchainLMDB *lmdb, MDB_txn *txn, MDB_cursor **cur_blocks, MDB_cursor **cur_tx_indices,
+                                   MDB_cursor **cur_txs_pruned) {
+    int result;
+    *cur_blocks = *cur_tx_indices = *cur_txs_pruned = NULL;
+    if ((result = mdb_cursor_open(txn, lmdb->m_blocks, cur_blocks))
+        || (result = mdb_cursor_open(txn, lmdb->m_tx_indices, cur_tx_indices))
+        || (result = mdb_cursor_open(txn, lmdb->m_txs_pruned, cur_txs_pruned))) {
+        if (*cur_tx_indices) mdb_cursor_close(*cur_tx_indices);
+        if (*cur_blocks) mdb_cursor_close(*cur_blocks);
     }
-    *mtxn = tinfo->m_ti_rtxn;
-    *mcur = &tinfo->m_ti_rcursors;
-    return false;
+    return result;
 }
 
+// major faults of the calling thread so far: reads it waited on the disk for
+static uint64_t lmdb_thread_faults(void) {
+    struct rusage ru;
+    return getrusage(RUSAGE_THREAD, &ru) == 0 ? (uint64_t)ru.ru_majflt : 0;
+}
 
 /*
- * LMDB PRIVATE METHOD
- *
+ * Reads ahead of lmdb_for_blocks_range_blobs on a thread of its own, at
+ * most distance blocks. Looking the blocks up in a read txn of its own
+ * faults in their pages there rather than in the reader, and the pages of
+ * blobs not in memory yet are asked for with MADV_WILLNEED. It is woken
+ * when the reader has left it room for a batch of blocks, not per block.
+ * The reader's read txn holds m_map_lock shared until after it joins the
+ * thread, so the thread's txn does not take the lock again: a resize
+ * waiting on the lock would hold off a second shared lock for good.
  */
+typedef struct lmdb_prefetch {
+    BlockchainLMDB *lmdb;
+    uint64_t next, last, distance, batch;
+    uint64_t reading;
+    uintptr_t page;
+    uint64_t stalls_taken;
+    GMutex lock;
+    GCond cond;
+    bool waiting;
+    bool stop;
+    GThread *thread;
+} lmdb_prefetch;
 
-bool lmdb_check_open(BlockchainLMDB* lmdb) {
-    return lmdb->db->m_open;
+static void lmdb_prefetch_advise(lmdb_prefetch *p, const MDB_val *v, uint64_t *out) {
+    const uintptr_t start = (uintptr_t)v->mv_data & ~(p->page - 1);
+    const size_t n = lmdb_pages_out(v->mv_data, v->mv_size, p->page);
+    if (n) {
+        madvise((void *)start, (uintptr_t)v->mv_data + v->mv_size - start, MADV_WILLNEED);
+        *out += n;
+    }
 }
 
-bool lmdb_need_resize(BlockchainLMDB *lmdb, uint64_t threshold_size) {
-#if defined(ENABLE_AUTO_RESIZE)
-    MDB_envinfo mei;
-    mdb_env_info(lmdb->m_env, &mei);
-    
-    MDB_stat mst;
-    mdb_env_stat(lmdb->m_env, &mst);
-    
-    // size_used doesn't include data yet to be committed, which can be
-    // significant size during batch transactions. For that, we estimate the size
-    // needed at the beginning of the batch transaction and pass in the
-    // additional size needed.
-    uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
-    
-    g_info("DB map size:     %zu", mei.me_mapsize);
-    g_info("Space used:      %llu", size_used);
-    g_info("Space remaining: %llu", mei.me_mapsize - size_used);
-    g_info("Size threshold:  %llu", threshold_size);
-    float resize_percent = RESIZE_PERCENT;
-    g_info("Percent used: %f  Percent threshold: %f",  ((double)size_used/mei.me_mapsize) , resize_percent);
-    
-    if (threshold_size > 0) {
-        if (mei.me_mapsize - size_used < threshold_size) {
-            g_debug("Threshold met (size-based)");
-            return true;
-        } else {
-            return false;
+static gpointer lmdb_prefetch_run(gpointer data) {
+    lmdb_prefetch *p = data;
+    MDB_txn *txn;
+    MDB_cursor *cur_blocks, *cur_tx_indices, *cur_txs_pruned;
+    GArray *txs = g_array_new(FALSE, FALSE, sizeof(MDB_val));
+    block_ref b;
+    const uint64_t faults = lmdb_thread_faults();
+    uint64_t advised = 0;
+
+    // a map that moved or a full reader table is left to the reader's txn, it only reads ahead
+    if (mdb_txn_begin(p->lmdb->m_env, NULL, MDB_RDONLY, &txn)) {
+        g_array_free(txs, TRUE);
+        return NULL;
+    }
+    if (lmdb_block_cursors_open(p->lmdb, txn, &cur_blocks, &cur_tx_indices, &cur_txs_pruned)) {
+        mdb_txn_abort(txn);
+        g_array_free(txs, TRUE);
+        return NULL;
+    }
+    b.miner_tx.vout = g_array_new(FALSE, FALSE, sizeof(tx_out_ref));
+    for (;;) {
+        MDB_val block;
+        uint64_t height;
+        bool stop;
+
+        g_mutex_lock(&p->lock);
+        // the block being read is too late to fetch
+        if (p->next <= p->reading) {
+            p->next = p->reading + 1;
+        }
+        while (!p->stop && p->next <= p->last && p->next >= p->reading + p->distance) {
+            p->waiting = true;
+            g_cond_wait(&p->cond, &p->lock);
+            p->waiting = false;
+        }
+        height = p->next++;
+        stop = p->stop;
+        g_mutex_unlock(&p->lock);
+        if (stop || height > p->last) {
+            break;
+        }
+
+        // the block blob is parsed for its txs, so it is asked for before
+        MDB_val_set(k, height);
+        if (mdb_cursor_get(cur_blocks, &k, &block, MDB_SET)) {
+            break;
+        }
+        lmdb_prefetch_advise(p, &block, &advised);
+        if (lmdb_get_block_blobs(cur_blocks, cur_tx_indices, cur_txs_pruned, height, &block, &b, txs)) {
+            break;
+        }
+        for (guint i = 0; i < txs->len; i++) {
+            lmdb_prefetch_advise(p, &g_array_index(txs, MDB_val, i), &advised);
         }
     }
-    
-    if ((double)size_used / mei.me_mapsize  > resize_percent) {
-        g_debug("Threshold met (percent-based)");
-        return true;
+    p->stalls_taken = lmdb_thread_faults() - faults + advised;
+    g_array_free(b.miner_tx.vout, TRUE);
+    g_array_free(txs, TRUE);
+    mdb_cursor_close(cur_txs_pruned);
+    mdb_cursor_close(cur_tx_indices);
+    mdb_cursor_close(cur_blocks);
+    mdb_txn_abort(txn);
+    return NULL;
+}
+
+static void lmdb_prefetch_start(lmdb_prefetch *p, BlockchainLMDB *lmdb, uint64_t h1, uint64_t h2) {
+    memset(p, 0, sizeof(*p));
+    p->lmdb = lmdb;
+    p->next = h1 + 1;
+    p->last = h2;
+    p->distance = lmdb->m_prefetch_distance;
+    p->batch = MAX(p->distance / 4, 1);
+    p->reading = h1;
+    p->page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    g_mutex_init(&p->lock);
+    g_cond_init(&p->cond);
+    p->thread = g_thread_new("lmdb_prefetch", lmdb_prefetch_run, p);
+}
+
+// joins the thread, whose txn must end before the reader's lets go of the map
+static void lmdb_prefetch_stop(lmdb_prefetch *p, lmdb_prefetch_stats *stats) {
+    g_mutex_lock(&p->lock);
+    p->stop = true;
+    g_cond_signal(&p->cond);
+    g_mutex_unlock(&p->lock);
+    g_thread_join(p->thread);
+    p->thread = NULL;
+    stats->stalls_avoided += p->stalls_taken;
+    g_cond_clear(&p->cond);
+    g_mutex_clear(&p->lock);
+}
+
+static void lmdb_prefetch_reading(lmdb_prefetch *p, uint64_t height) {
+    g_mutex_lock(&p->lock);
+    p->reading = height;
+    if (p->waiting && p->next + p->batch <= height + p->distance) {
+        g_cond_signal(&p->cond);
     }
-    return false;
-#else
-    return false;
-#endif
+    g_mutex_unlock(&p->lock);
 }
 
-void lmdb_do_resize(BlockchainLMDB *lmdb, uint64_t increase_size) {
-    g_debug("BlockchainLMDB#lmdb_do_resize");
-    const uint64_t add_size = 1LL << 30;
-    // check disk capacity
-    long available_space = get_available_space(lmdb->m_folder);
-    if (available_space < add_size) {
-        g_error("!! WARNING: Insufficient free space to extend database : %ld MB avaliable, %llu MB needed", (available_space >> 20L), (add_size >> 20L));
-        return;
+int lmdb_for_blocks_range_blobs(BlockchainLMDB* lmdb, uint64_t h1, uint64_t h2, lmdb_block_blobs_func f, void *user) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
     }
-    
-    MDB_envinfo mei;
-    mdb_env_info(lmdb->m_env, &mei);
-    
-    MDB_stat mst;
-    mdb_env_stat(lmdb->m_env, &mst);
-    
-    // add 1Gb per resize, instead of doing a percentage increase
-    uint64_t new_mapsize = (double) mei.me_mapsize + add_size;
-    
-    // If given, use increase_size instead of above way of resizing.
-    // This is currently used for increasing by an estimated size at start of new
-    // batch txn.
-    if (increase_size > 0) {
-        new_mapsize = mei.me_mapsize + increase_size;
+    MDB_txn *txn;
+    MDB_cursor *cur_blocks, *cur_tx_indices, *cur_txs_pruned;
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a read transaction for the db: ", result));
+        return -2;
     }
-    
-    new_mapsize += (new_mapsize % mst.ms_psize);
-    
-    //TODO impl
-    mdb_txn_safe_prevent_new_txns();
-    
-    if (lmdb->m_write_txn != NULL) {
-        if (lmdb->m_batch_active) {
-            g_error("lmdb resizing not yet supported when batch transactions enabled!");
-        } else {
-            g_error("attempting resize with write transaction in progress, this should not happen!");
+    if ((result = lmdb_block_cursors_open(lmdb, txn, &cur_blocks, &cur_tx_indices, &cur_txs_pruned))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        lmdb_rtxn_abort(txn);
+        return -3;
+    }
+
+    lmdb_prefetch p;
+    lmdb_prefetch_stats stats = { 0 };
+    const bool prefetch = lmdb->m_prefetch_distance > 0 && h2 >= h1 && h2 - h1 >= lmdb->m_prefetch_distance;
+    const uint64_t renew = lmdb->m_range_renew ? lmdb->m_range_renew : RANGE_RENEW_BLOCKS;
+    const uint64_t generation = lmdb_get_generation(lmdb);
+    bool held = true;
+    if (prefetch) {
+        lmdb_prefetch_start(&p, lmdb, h1, h2);
+    }
+
+    int ret = 0;
+    GArray *txs = g_array_new(FALSE, FALSE, sizeof(MDB_val));
+    block_ref b;
+    b.miner_tx.vout = g_array_new(FALSE, FALSE, sizeof(tx_out_ref));
+    for (uint64_t height = h1; height <= h2; height++) {
+        MDB_val block;
+        const uint64_t faults = prefetch ? lmdb_thread_faults() : 0;
+        if (prefetch) {
+            lmdb_prefetch_reading(&p, height);
+        }
+        if ((ret = lmdb_get_block_blobs(cur_blocks, cur_tx_indices, cur_txs_pruned, height, &block, &b, txs))) {
+            break;
+        }
+        if (prefetch) {
+            // the faults of the lookups and the tx blob pages f would wait for, not f's own
+            uint64_t stalls = lmdb_thread_faults() - faults;
+            for (guint i = 0; i < txs->len; i++) {
+                const MDB_val *v = &g_array_index(txs, MDB_val, i);
+                stalls += lmdb_pages_out(v->mv_data, v->mv_size, p.page);
+            }
+            stats.blocks++;
+            stats.hits += stalls == 0;
+            stats.stalls += stalls;
+        }
+        if (!f(height, &block, (const MDB_val *)txs->data, txs->len, user)) {
+            break;
+        }
+        if ((height - h1 + 1) % renew == 0 && height < h2) {
+            // a new snapshot lets a resize through and the pages of the old one be reused
+            if (prefetch) {
+                lmdb_prefetch_stop(&p, &stats);
+            }
+            lmdb_rtxn_reset(txn);
+            if ((result = lmdb_txn_renew(txn))) {
+                g_info("%s", lmdb_error("Failed to renew the read transaction: ", result));
+                held = false;
+                ret = -2;
+                break;
+            }
+            if ((result = mdb_cursor_renew(txn, cur_blocks)) || (result = mdb_cursor_renew(txn, cur_tx_indices))
+                || (result = mdb_cursor_renew(txn, cur_txs_pruned))) {
+                g_info("%s", lmdb_error("Failed to renew cursor: ", result));
+                ret = -3;
+                break;
+            }
+            if (lmdb_get_generation(lmdb) != generation) {
+                g_info("Blocks were popped during the range, stopping at height %llu", (unsigned long long)height);
+                ret = -8;
+                break;
+            }
+            if (prefetch) {
+                lmdb_prefetch_start(&p, lmdb, height + 1, h2);
+            }
         }
     }
-    //TODO impl
-    mdb_txn_safe_wait_no_active_txns();
-    
-    int result = mdb_env_set_mapsize(lmdb->m_env, new_mapsize);
+    if (prefetch && p.thread) {
+        lmdb_prefetch_stop(&p, &stats);
+    }
+    if (prefetch) {
+        g_mutex_lock(&lmdb->m_prefetch_lock);
+        lmdb->m_prefetch_stats.blocks += stats.blocks;
+        lmdb->m_prefetch_stats.hits += stats.hits;
+        lmdb->m_prefetch_stats.stalls += stats.stalls;
+        lmdb->m_prefetch_stats.stalls_avoided += stats.stalls_avoided;
+        g_mutex_unlock(&lmdb->m_prefetch_lock);
+    }
+    g_array_free(b.miner_tx.vout, TRUE);
+    g_array_free(txs, TRUE);
+    mdb_cursor_close(cur_txs_pruned);
+    mdb_cursor_close(cur_tx_indices);
+    mdb_cursor_close(cur_blocks);
+    if (held) {
+        lmdb_rtxn_abort(txn);
+    } else {
+        // a renew that failed left it reset, off the map
+        mdb_txn_abort(txn);
+    }
+    return ret;
+}
+
+void lmdb_get_prefetch_stats(BlockchainLMDB *lmdb, lmdb_prefetch_stats *stats) {
+    g_mutex_lock(&lmdb->m_prefetch_lock);
+    *stats = lmdb->m_prefetch_stats;
+    g_mutex_unlock(&lmdb->m_prefetch_lock);
+}
+
+int lmdb_get_difficulty_window(BlockchainLMDB* lmdb, difficulty_window *w) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    MDB_txn *txn;
+    MDB_cursor *cur_block_info;
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn);
     if (result) {
-        g_error("Failed to set new mapsize: %d", result);
-        return;
+        g_info("%s", lmdb_error("Failed to create a read transaction for the db: ", result));
+        return -2;
     }
-    
-    g_info("LMDB Mapsize increased. Old: %luMiB, New: %lluMiB.", mei.me_mapsize / (1024 * 1024), new_mapsize / (1024 * 1024));
-    
-    mdb_txn_safe_allow_new_txns();
-    
+    if ((result = mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        lmdb_rtxn_abort(txn);
+        return -3;
+    }
+
+    int ret = 0;
+    MDB_val v;
+    result = mdb_cursor_get(cur_block_info, (MDB_val *)&zerokval, &v, MDB_SET);
+    if (result == MDB_NOTFOUND) {
+        difficulty_window_reset(w, 0);
+    } else if (result || (result = mdb_cursor_get(cur_block_info, (MDB_val *)&zerokval, &v, MDB_LAST_DUP))) {
+        g_info("%s", lmdb_error("Failed to get the top block info: ", result));
+        ret = -4;
+    } else {
+        const uint64_t height = ((const mdb_block_info *)v.mv_data)->bi_height + 1;
+        uint64_t start = height - MIN(height, w->capacity);
+        MDB_val key = zerokval;
+        MDB_val_set(k, start);
+        difficulty_window_reset(w, start);
+        result = mdb_cursor_get(cur_block_info, (MDB_val *)&zerokval, &k, MDB_GET_BOTH);
+        while (!result) {
+            const mdb_block_info *bi = (const mdb_block_info *)k.mv_data;
+            if (bi->bi_height != w->height) {
+                break;
+            }
+            difficulty_window_push(w, bi->bi_timestamp, bi->bi_diff);
+            result = mdb_cursor_get(cur_block_info, &key, &k, MDB_NEXT_DUP);
+        }
+        if (w->height != height) {
+            g_info("Failed to read block info at height %llu: %s", (unsigned long long)w->height, result ? mdb_strerror(result) : "height mismatch");
+            ret = -5;
+        }
+    }
+    mdb_cursor_close(cur_block_info);
+    lmdb_rtxn_abort(txn);
+    return ret;
+}
+
+int lmdb_get_output_data(BlockchainLMDB* lmdb, const output_index_t *outputs, size_t n, output_data_t *data) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    MDB_txn *txn;
+    MDB_cursor *cur_output_amounts;
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a read transaction for the db: ", result));
+        return -2;
+    }
+    if ((result = mdb_cursor_open(txn, lmdb->m_output_amounts, &cur_output_amounts))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        lmdb_rtxn_abort(txn);
+        return -3;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < n; i++) {
+        MDB_val_set(k, outputs[i].amount);
+        MDB_val_set(v, outputs[i].index);
+        if (i > 0 && outputs[i].amount == outputs[i - 1].amount && outputs[i].index == outputs[i - 1].index + 1) {
+            result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_NEXT_DUP);
+            if (!result && *(const uint64_t *)v.mv_data != outputs[i].index) {
+                result = MDB_NOTFOUND;
+            }
+        } else {
+            result = mdb_cursor_get(cur_output_amounts, &k, &v, MDB_GET_BOTH);
+        }
+        if (result) {
+            g_info("Attempted to get output %llu of amount %llu: %s", (unsigned long long)outputs[i].index,
+                   (unsigned long long)outputs[i].amount, mdb_strerror(result));
+            ret = -4;
+            break;
+        }
+        if (outputs[i].amount == 0) {
+            data[i] = ((const outkey *)v.mv_data)->data;
+        } else {
+            memcpy(&data[i], &((const pre_rct_outkey *)v.mv_data)->data, sizeof(pre_rct_output_data_t));
+            memset(&data[i].commitment, 0, sizeof(data[i].commitment));
+        }
+    }
+    mdb_cursor_close(cur_output_amounts);
+    lmdb_rtxn_abort(txn);
+    return ret;
 }
 
-void lmdb_migrate(BlockchainLMDB *lmdb, const uint32_t oldversion) {
-    g_error("not support migrate now!");
+enum {
+    W_BLOCKS, W_BLOCK_INFO, W_BLOCK_HEIGHTS, W_HF_VERSIONS, W_TXS_PRUNED, W_TXS_PRUNABLE, W_TXS_PRUNABLE_HASH,
+    W_TX_INDICES, W_TX_OUTPUTS, W_OUTPUT_TXS, W_OUTPUT_AMOUNTS, W_SPENT_KEYS, W_COUNT
+};
+
+static void lmdb_block_dbis(BlockchainLMDB *lmdb, MDB_dbi *dbis) {
+    dbis[W_BLOCKS] = lmdb->m_blocks;
+    dbis[W_BLOCK_INFO] = lmdb->m_block_info;
+    dbis[W_BLOCK_HEIGHTS] = lmdb->m_block_heights;
+    dbis[W_HF_VERSIONS] = lmdb->m_hf_versions;
+    dbis[W_TXS_PRUNED] = lmdb->m_txs_pruned;
+    dbis[W_TXS_PRUNABLE] = lmdb->m_txs_prunable;
+    dbis[W_TXS_PRUNABLE_HASH] = lmdb->m_txs_prunable_hash;
+    dbis[W_TX_INDICES] = lmdb->m_tx_indices;
+    dbis[W_TX_OUTPUTS] = lmdb->m_tx_outputs;
+    dbis[W_OUTPUT_TXS] = lmdb->m_output_txs;
+    dbis[W_OUTPUT_AMOUNTS] = lmdb->m_output_amounts;
+    dbis[W_SPENT_KEYS] = lmdb->m_spent_keys;
+}
+
+// the state of one lmdb_add_block: the next ids, and the cursors every put goes through
+typedef struct lmdb_block_writer {
+    MDB_cursor *cur[W_COUNT];
+    uint64_t height;
+    uint64_t tx_id;
+    uint64_t output_id;
+    uint64_t rct_outputs;
+    bool plain;
+    const char *what;
+} lmdb_block_writer;
+
+/*
+ * Puts size bytes under id, which is above every key of the table. The
+ * data is copied straight into the page with MDB_RESERVE, after MDB_APPEND
+ * skipped the search for the key.
+ */
+static int lmdb_append(lmdb_block_writer *w, int table, uint64_t id, const void *data, size_t size) {
+    MDB_val_set(k, id);
+    MDB_val v = { size, (void *)data };
+    int result;
+
+    if (w->plain) {
+        return mdb_cursor_put(w->cur[table], &k, &v, 0);
+    }
+    if (!(result = mdb_cursor_put(w->cur[table], &k, &v, MDB_APPEND | MDB_RESERVE))) {
+        memcpy(v.mv_data, data, size);
+    }
+    return result;
+}
+
+// the dups of zerokval tables sorted by a growing id go last
+static int lmdb_append_dup(lmdb_block_writer *w, int table, const MDB_val *k, const void *data, size_t size) {
+    MDB_val v = { size, (void *)data };
+    return mdb_cursor_put(w->cur[table], (MDB_val *)k, &v, w->plain ? 0 : MDB_APPENDDUP);
+}
+
+// a tx of the block at w->height: its index, blobs, outputs and key images
+static int lmdb_add_tx(lmdb_block_writer *w, transaction *tx, const hash *tx_hash, arena *a) {
+    const size_t pruned_size = tx->prefix_size + tx->rct_base_size;
+    uint64_t *amount_indices;
+    txindex ti;
+    hash prunable_hash;
+    int result;
+
+    ti.key = *tx_hash;
+    ti.data.tx_id = w->tx_id;
+    ti.data.unlock_time = tx->prefix.unlock_time;
+    ti.data.block_id = w->height;
+    if ((result = mdb_cursor_put(w->cur[W_TX_INDICES], (MDB_val *)&zerokval, &(MDB_val){ sizeof(ti), &ti }, MDB_NODUPDATA))) {
+        w->what = "m_tx_indices";
+        return result;
+    }
+    if ((result = lmdb_append(w, W_TXS_PRUNED, w->tx_id, tx->blob, pruned_size))) {
+        w->what = "m_txs_pruned";
+        return result;
+    }
+    if ((result = lmdb_append(w, W_TXS_PRUNABLE, w->tx_id, tx->blob + pruned_size, tx->blob_size - pruned_size))) {
+        w->what = "m_txs_prunable";
+        return result;
+    }
+    if (get_transaction_prunable_hash(tx, &prunable_hash)
+        && (result = lmdb_append(w, W_TXS_PRUNABLE_HASH, w->tx_id, &prunable_hash, sizeof(prunable_hash)))) {
+        w->what = "m_txs_prunable_hash";
+        return result;
+    }
+
+    // the rct base ends with the output commitments
+    const key *out_pk = tx->rct_type != RCT_TYPE_NULL ? (const key *)(tx->blob + pruned_size) - tx->prefix.vout_size : NULL;
+    amount_indices = arena_new(a, uint64_t, tx->prefix.vout_size);
+    for (size_t i = 0; i < tx->prefix.vout_size; i++) {
+        const tx_out *out = &tx->prefix.vout[i];
+        const uint64_t amount = tx->prefix.version >= 2 ? 0 : out->amount;
+        outtx ot;
+        if (out->target.tag != TXOUT_TO_KEY_TAG) {
+            w->what = "m_output_amounts (not a txout_to_key)";
+            return MDB_INCOMPATIBLE;
+        }
+        ot.output_id = w->output_id;
+        ot.tx_hash = *tx_hash;
+        ot.local_index = i;
+        if ((result = lmdb_append_dup(w, W_OUTPUT_TXS, &zerokval, &ot, sizeof(ot)))) {
+            w->what = "m_output_txs";
+            return result;
+        }
+
+        MDB_val_set(k, amount);
+        if (amount == 0) {
+            outkey ok;
+            ok.amount_index = w->rct_outputs++;
+            ok.output_id = w->output_id;
+            ok.data.pubkey = out->target.key.key;
+            ok.data.unlock_time = tx->prefix.unlock_time;
+            ok.data.height = w->height;
+            if (out_pk) {
+                ok.data.commitment = out_pk[i];
+            } else {
+                zeroCommit(&ok.data.commitment, out->amount);
+            }
+            amount_indices[i] = ok.amount_index;
+            result = lmdb_append_dup(w, W_OUTPUT_AMOUNTS, &k, &ok, sizeof(ok));
+        } else {
+            pre_rct_outkey ok;
+            mdb_size_t count = 0;
+            MDB_val v;
+            if (!(result = mdb_cursor_get(w->cur[W_OUTPUT_AMOUNTS], &k, &v, MDB_SET))) {
+                result = mdb_cursor_count(w->cur[W_OUTPUT_AMOUNTS], &count);
+            } else if (result == MDB_NOTFOUND) {
+                result = 0;
+            }
+            ok.amount_index = count;
+            ok.output_id = w->output_id;
+            ok.data.pubkey = out->target.key.key;
+            ok.data.unlock_time = tx->prefix.unlock_time;
+            ok.data.height = w->height;
+            amount_indices[i] = ok.amount_index;
+            if (!result) {
+                result = lmdb_append_dup(w, W_OUTPUT_AMOUNTS, &k, &ok, sizeof(ok));
+            }
+        }
+        if (result) {
+            w->what = "m_output_amounts";
+            return result;
+        }
+        w->output_id++;
+    }
+    if ((result = lmdb_append(w, W_TX_OUTPUTS, w->tx_id, amount_indices, tx->prefix.vout_size * sizeof(uint64_t)))) {
+        w->what = "m_tx_outputs";
+        return result;
+    }
+
+    for (size_t i = 0; i < tx->prefix.vin_size; i++) {
+        if (tx->prefix.vin[i].tag != TXIN_TO_KEY_TAG) {
+            continue;
+        }
+        MDB_val v = { sizeof(key_image), &tx->prefix.vin[i].key.k_image };
+        if ((result = mdb_cursor_put(w->cur[W_SPENT_KEYS], (MDB_val *)&zerokval, &v, MDB_NODUPDATA))) {
+            w->what = "m_spent_keys";
+            return result;
+        }
+    }
+    w->tx_id++;
+    return 0;
+}
+
+int lmdb_get_hard_fork_version(BlockchainLMDB* lmdb, uint64_t height, uint8_t *version) {
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    return hf_version_map_get(&lmdb->m_hf_version_map, height, version) ? 0 : -2;
+}
+
+// what adding the blobs may take of the map: themselves, as much again for the tables over them, and page splits
+static uint64_t lmdb_add_block_estimate(const MDB_val *blob, const MDB_val *txs, size_t txs_size) {
+    uint64_t size = blob->mv_size;
+    for (size_t i = 0; i < txs_size; i++) {
+        size += txs[i].mv_size;
+    }
+    return 2 * size + 2 * W_COUNT * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+int lmdb_add_block(BlockchainLMDB* lmdb, const MDB_val *blob, const MDB_val *txs, size_t txs_size, uint64_t weight,
+                   difficulty_type cumulative_difficulty, uint64_t coins_generated) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    if (lmdb->m_write_txn) {
+        g_info("Attempted to add a block with a write transaction in progress");
+        return -3;
+    }
+
+    arena a;
+    block b;
+    hash block_hash, miner_hash;
+    transaction *parsed;
+
+    arena_init(&a, 4096);
+    if (!parse_and_validate_block_from_blob(blob->mv_data, blob->mv_size, &a, &b) || b.tx_hashes_size != txs_size
+        || !get_block_hash(&b, &block_hash) || !get_transaction_hash(&b.miner_tx, &miner_hash)) {
+        g_info("Failed to parse the block to add");
+        arena_clear(&a);
+        return -4;
+    }
+    // hashed before the txn, the txs must be the ones the block names
+    parsed = arena_new(&a, transaction, txs_size);
+    for (size_t i = 0; i < txs_size; i++) {
+        hash h;
+        if (!parse_and_validate_tx_from_blob(txs[i].mv_data, txs[i].mv_size, &a, &parsed[i])
+            || !get_transaction_hash(&parsed[i], &h) || memcmp(&h, &b.tx_hashes[i], sizeof(h)) != 0) {
+            g_info("Tx %zu does not match the hashes of the block", i);
+            arena_clear(&a);
+            return -6;
+        }
+    }
+
+    MDB_txn *txn;
+    MDB_stat st;
+    MDB_val k, v;
+    lmdb_block_writer w;
+    MDB_dbi dbis[W_COUNT];
+    bool resized = false;
+    int result;
+
+    // grown between write txns, the map can not move under one
+    if (lmdb_need_resize(lmdb, 0) || lmdb_need_resize(lmdb, lmdb_add_block_estimate(blob, txs, txs_size))) {
+        lmdb_do_resize(lmdb, 0);
+    }
+retry:
+    result = lmdb_txn_begin(lmdb->m_env, NULL, 0, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a transaction for the db: ", result));
+        arena_clear(&a);
+        return -2;
+    }
+    memset(&w, 0, sizeof(w));
+    w.plain = lmdb->m_plain_puts;
+    lmdb_block_dbis(lmdb, dbis);
+    for (int i = 0; i < W_COUNT && !result; i++) {
+        result = mdb_cursor_open(txn, dbis[i], &w.cur[i]);
+    }
+    // the next ids are the sizes of their tables
+    if (!result && !(result = mdb_stat(txn, lmdb->m_blocks, &st))) {
+        w.height = st.ms_entries;
+    }
+    if (!result && !(result = mdb_stat(txn, lmdb->m_txs_pruned, &st))) {
+        w.tx_id = st.ms_entries;
+    }
+    if (!result && !(result = mdb_stat(txn, lmdb->m_output_txs, &st))) {
+        w.output_id = st.ms_entries;
+    }
+    if (result) {
+        g_info("%s", lmdb_error("Failed to open cursors: ", result));
+        mdb_txn_abort(txn);
+        arena_clear(&a);
+        return -2;
+    }
+    if (w.height > 0 && !output_distribution_count(&lmdb->m_rct_distribution, 0, w.height - 1, &w.rct_outputs)) {
+        g_info("The rct distribution is behind the chain");
+        mdb_txn_abort(txn);
+        arena_clear(&a);
+        return -5;
+    }
+
+    int ret = -7;
+    if (w.height > 0) {
+        k = zerokval;
+        if ((result = mdb_cursor_get(w.cur[W_BLOCK_INFO], &k, &v, MDB_SET))
+            || (result = mdb_cursor_get(w.cur[W_BLOCK_INFO], &k, &v, MDB_LAST_DUP))) {
+            w.what = "m_block_info";
+            goto fail;
+        }
+        if (memcmp(&((const mdb_block_info *)v.mv_data)->bi_hash, &b.header.prev_id, sizeof(hash)) != 0) {
+            g_info("Top block is not the parent of the block to add");
+            ret = -5;
+            goto fail;
+        }
+    }
+
+    // the miner tx first, then the others in block order
+    if ((result = lmdb_add_tx(&w, &b.miner_tx, &miner_hash, &a))) {
+        goto fail;
+    }
+    for (size_t i = 0; i < txs_size; i++) {
+        if ((result = lmdb_add_tx(&w, &parsed[i], &b.tx_hashes[i], &a))) {
+            goto fail;
+        }
+    }
+
+    mdb_block_info bi;
+    blk_height bh;
+    bi.bi_height = w.height;
+    bi.bi_timestamp = b.header.timestamp;
+    bi.bi_coins = coins_generated;
+    bi.bi_weight = weight;
+    bi.bi_diff = cumulative_difficulty;
+    bi.bi_hash = block_hash;
+    bi.bi_cum_rct = w.rct_outputs;
+    bh.bh_hash = block_hash;
+    bh.bh_height = w.height;
+    const uint64_t commit = mdb_txn_id(txn);
+    if ((result = lmdb_append(&w, W_BLOCKS, w.height, blob->mv_data, blob->mv_size))) {
+        w.what = "m_blocks";
+    } else if ((result = lmdb_append_dup(&w, W_BLOCK_INFO, &zerokval, &bi, sizeof(bi)))) {
+        w.what = "m_block_info";
+    } else if ((result = mdb_cursor_put(w.cur[W_BLOCK_HEIGHTS], (MDB_val *)&zerokval, &(MDB_val){ sizeof(bh), &bh }, MDB_NODUPDATA))) {
+        w.what = "m_block_heights";
+    } else if ((result = lmdb_append(&w, W_HF_VERSIONS, w.height, &b.header.major_version, sizeof(uint8_t)))) {
+        w.what = "m_hf_versions";
+    } else if ((result = mdb_txn_commit(txn))) {
+        txn = NULL;
+        w.what = "the transaction";
+    }
+    if (result) {
+        goto fail;
+    }
+    output_distribution_push(&lmdb->m_rct_distribution, w.rct_outputs);
+    hf_version_map_push(&lmdb->m_hf_version_map, b.header.major_version);
+    lmdb_tip_publish(lmdb, &(lmdb_tip){ w.height + 1, block_hash, cumulative_difficulty, b.header.major_version, commit });
+    lmdb_headers_add(lmdb, w.height, &b.header, &block_hash, cumulative_difficulty);
+    event_feed_publish(&lmdb->m_events, &(chain_event){ CHAIN_EVENT_BLOCK_ADDED, w.height, block_hash, commit });
+    arena_clear(&a);
+    return 0;
+
+fail:
+    if (result == MDB_MAP_FULL && !resized) {
+        // more than the estimate took, the txn is gone: grow the map and add it again, once
+        g_info("The map filled up adding block %llu, growing it", (unsigned long long)w.height);
+        if (txn) {
+            mdb_txn_abort(txn);
+        }
+        lmdb_do_resize(lmdb, 0);
+        resized = true;
+        goto retry;
+    }
+    if (result == MDB_KEYEXIST) {
+        g_info("Attempting to add a block with a tx or key image already in %s", w.what);
+        ret = -8;
+    } else if (result) {
+        g_info("Failed to add block %llu to %s: %s", (unsigned long long)w.height, w.what, mdb_strerror(result));
+    }
+    if (txn) {
+        mdb_txn_abort(txn);
+    }
+    arena_clear(&a);
+    return ret;
+}
+
+void lmdb_set_pop_notify(BlockchainLMDB* lmdb, lmdb_pop_func f, void* user) {
+    lmdb->m_pop_notify = f;
+    lmdb->m_pop_notify_user = user;
+}
+
+uint64_t lmdb_get_generation(BlockchainLMDB* lmdb) {
+    return __atomic_load_n(&lmdb->m_generation, __ATOMIC_ACQUIRE);
+}
+
+// qsort and bsearch in the order of compare_hash32, so deletes walk forward
+static int sort_hash32(const void *a, const void *b) {
+    const MDB_val va = { sizeof(hash), (void *)a };
+    const MDB_val vb = { sizeof(hash), (void *)b };
+    return compare_hash32(&va, &vb);
+}
+
+static int sort_uint64(const void *a, const void *b) {
+    const uint64_t va = *(const uint64_t *)a, vb = *(const uint64_t *)b;
+    return (va < vb) ? -1 : va > vb;
+}
+
+// deletes the records of an integer keyed table from key first up
+static int lmdb_del_tail(MDB_cursor *cur, uint64_t first) {
+    MDB_val k, v;
+    int result = mdb_cursor_get(cur, &k, &v, MDB_LAST);
+    while (!result && read_uint64(k.mv_data) >= first) {
+        if ((result = mdb_cursor_del(cur, 0))) {
+            return result;
+        }
+        result = mdb_cursor_get(cur, &k, &v, MDB_PREV);
+    }
+    return result == MDB_NOTFOUND ? 0 : result;
+}
+
+// deletes sorted items from the zerokval dups of a table, each must exist
+static int lmdb_del_sorted(MDB_cursor *cur, const GArray *items, size_t size) {
+    for (guint i = 0; i < items->len; i++) {
+        MDB_val v = { size, items->data + i * size };
+        int result = mdb_cursor_get(cur, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+        if (result || (result = mdb_cursor_del(cur, 0))) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+int lmdb_pop_blocks(BlockchainLMDB* lmdb, uint64_t height) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    if (lmdb->m_write_txn) {
+        g_info("Attempted to pop blocks with a write transaction in progress");
+        return -3;
+    }
+
+    MDB_txn *txn;
+    MDB_stat st;
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, 0, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a transaction for the db: ", result));
+        return -2;
+    }
+    if ((result = mdb_stat(txn, lmdb->m_blocks, &st))) {
+        g_info("%s", lmdb_error("Failed to query m_blocks: ", result));
+        mdb_txn_abort(txn);
+        return -4;
+    }
+    const uint64_t old_height = st.ms_entries;
+    if (height >= old_height) {
+        mdb_txn_abort(txn);
+        return height == old_height ? 0 : -6;
+    }
+
+    enum { C_BLOCKS, C_BLOCK_INFO, C_BLOCK_HEIGHTS, C_HF_VERSIONS, C_TXS, C_TXS_PRUNED, C_TXS_PRUNABLE,
+           C_TXS_PRUNABLE_HASH, C_TX_INDICES, C_TX_OUTPUTS, C_OUTPUT_TXS, C_OUTPUT_AMOUNTS, C_SPENT_KEYS, C_COUNT };
+    const MDB_dbi dbis[C_COUNT] = {
+        lmdb->m_blocks, lmdb->m_block_info, lmdb->m_block_heights, lmdb->m_hf_versions, lmdb->m_txs,
+        lmdb->m_txs_pruned, lmdb->m_txs_prunable, lmdb->m_txs_prunable_hash, lmdb->m_tx_indices,
+        lmdb->m_tx_outputs, lmdb->m_output_txs, lmdb->m_output_amounts, lmdb->m_spent_keys
+    };
+    MDB_cursor *cur[C_COUNT] = { NULL };
+    for (int i = 0; i < C_COUNT; i++) {
+        if ((result = mdb_cursor_open(txn, dbis[i], &cur[i]))) {
+            g_info("%s", lmdb_error("Failed to open cursor: ", result));
+            mdb_txn_abort(txn);
+            return -5;
+        }
+    }
+
+    GArray *block_hashes = g_array_new(FALSE, FALSE, sizeof(hash));
+    hash *top_down = NULL;
+    GArray *tx_hashes = g_array_new(FALSE, FALSE, sizeof(hash));
+    GArray *key_images = g_array_new(FALSE, FALSE, sizeof(key_image));
+    GArray *amounts = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+    uint64_t num_txs = 0, first_tx_id = UINT64_MAX, first_output_id = UINT64_MAX;
+    const char *what = NULL;
+    arena a;
+    MDB_val k, v;
+
+    arena_init(&a, 4096);
+
+    // the blocks, for the hashes of their txs
+    result = mdb_cursor_get(cur[C_BLOCKS], &k, &v, MDB_LAST);
+    while (!result && read_uint64(k.mv_data) >= height) {
+        block b;
+        hash miner_hash;
+        arena_reset(&a);
+        if (!parse_and_validate_block_from_blob(v.mv_data, v.mv_size, &a, &b) || !get_transaction_hash(&b.miner_tx, &miner_hash)) {
+            result = MDB_CORRUPTED;
+            break;
+        }
+        g_array_append_val(tx_hashes, miner_hash);
+        g_array_append_vals(tx_hashes, b.tx_hashes, b.tx_hashes_size);
+        num_txs += 1 + b.tx_hashes_size;
+        if ((result = mdb_cursor_del(cur[C_BLOCKS], 0))) {
+            break;
+        }
+        result = mdb_cursor_get(cur[C_BLOCKS], &k, &v, MDB_PREV);
+    }
+    if (result && result != MDB_NOTFOUND) {
+        what = "m_blocks";
+        goto fail;
+    }
+
+    // block_info is one run of dups sorted by height, its tail goes
+    k = zerokval;
+    result = mdb_cursor_get(cur[C_BLOCK_INFO], &k, &v, MDB_SET);
+    if (!result) {
+        result = mdb_cursor_get(cur[C_BLOCK_INFO], &k, &v, MDB_LAST_DUP);
+    }
+    while (!result && ((const mdb_block_info *)v.mv_data)->bi_height >= height) {
+        g_array_append_val(block_hashes, ((const mdb_block_info *)v.mv_data)->bi_hash);
+        if ((result = mdb_cursor_del(cur[C_BLOCK_INFO], 0))) {
+            break;
+        }
+        result = mdb_cursor_get(cur[C_BLOCK_INFO], &k, &v, MDB_PREV);
+    }
+    if ((result && result != MDB_NOTFOUND) || block_hashes->len != old_height - height) {
+        what = "m_block_info";
+        goto fail;
+    }
+    if ((result = lmdb_del_tail(cur[C_HF_VERSIONS], height))) {
+        what = "m_hf_versions";
+        goto fail;
+    }
+
+    // the txs of the popped blocks are the last num_txs tx ids
+    result = mdb_cursor_get(cur[C_TXS_PRUNED], &k, &v, MDB_LAST);
+    for (uint64_t i = 0; i < num_txs && !result; i++) {
+        transaction_prefix prefix;
+        arena_reset(&a);
+        if (!parse_tx_prefix_from_blob(v.mv_data, v.mv_size, &a, &prefix)) {
+            result = MDB_CORRUPTED;
+            break;
+        }
+        for (size_t j = 0; j < prefix.vin_size; j++) {
+            if (prefix.vin[j].tag == TXIN_TO_KEY_TAG) {
+                g_array_append_val(key_images, prefix.vin[j].key.k_image);
+            }
+        }
+        for (size_t j = 0; j < prefix.vout_size; j++) {
+            const uint64_t amount = prefix.version >= 2 ? 0 : prefix.vout[j].amount;
+            g_array_append_val(amounts, amount);
+        }
+        first_tx_id = read_uint64(k.mv_data);
+        if ((result = mdb_cursor_del(cur[C_TXS_PRUNED], 0))) {
+            break;
+        }
+        if (i + 1 < num_txs) {
+            result = mdb_cursor_get(cur[C_TXS_PRUNED], &k, &v, MDB_PREV);
+        }
+    }
+    if (result) {
+        what = "m_txs_pruned";
+        goto fail;
+    }
+    if (num_txs > 0) {
+        if ((result = lmdb_del_tail(cur[C_TXS], first_tx_id))
+            || (result = lmdb_del_tail(cur[C_TXS_PRUNABLE], first_tx_id))
+            || (result = lmdb_del_tail(cur[C_TXS_PRUNABLE_HASH], first_tx_id))
+            || (result = lmdb_del_tail(cur[C_TX_OUTPUTS], first_tx_id))) {
+            what = "the tx tables";
+            goto fail;
+        }
+    }
+
+    // from the top down, for the events
+    top_down = g_memdup2(block_hashes->data, block_hashes->len * sizeof(hash));
+    g_array_sort(block_hashes, sort_hash32);
+    g_array_sort(tx_hashes, sort_hash32);
+    g_array_sort(key_images, sort_hash32);
+    if ((result = lmdb_del_sorted(cur[C_TX_INDICES], tx_hashes, sizeof(hash)))) {
+        what = "m_tx_indices";
+        goto fail;
+    }
+    if ((result = lmdb_del_sorted(cur[C_BLOCK_HEIGHTS], block_hashes, sizeof(hash)))) {
+        what = "m_block_heights";
+        goto fail;
+    }
+    if ((result = lmdb_del_sorted(cur[C_SPENT_KEYS], key_images, sizeof(key_image)))) {
+        what = "m_spent_keys";
+        goto fail;
+    }
+
+    // output ids were given out in tx order, so the popped ones are a tail
+    k = zerokval;
+    result = mdb_cursor_get(cur[C_OUTPUT_TXS], &k, &v, MDB_SET);
+    if (!result) {
+        result = mdb_cursor_get(cur[C_OUTPUT_TXS], &k, &v, MDB_LAST_DUP);
+    }
+    while (!result && bsearch(&((const outtx *)v.mv_data)->tx_hash, tx_hashes->data, tx_hashes->len, sizeof(hash), sort_hash32)) {
+        first_output_id = ((const outtx *)v.mv_data)->output_id;
+        if ((result = mdb_cursor_del(cur[C_OUTPUT_TXS], 0))) {
+            break;
+        }
+        result = mdb_cursor_get(cur[C_OUTPUT_TXS], &k, &v, MDB_PREV);
+    }
+    if (result && result != MDB_NOTFOUND) {
+        what = "m_output_txs";
+        goto fail;
+    }
+    result = 0;
+
+    // and a tail of the dups of every amount they had
+    g_array_sort(amounts, sort_uint64);
+    for (guint i = 0; i < amounts->len && !result; i++) {
+        uint64_t amount = g_array_index(amounts, uint64_t, i);
+        if (i > 0 && amount == g_array_index(amounts, uint64_t, i - 1)) {
+            continue;
+        }
+        MDB_val_set(ka, amount);
+        result = mdb_cursor_get(cur[C_OUTPUT_AMOUNTS], &ka, &v, MDB_SET);
+        if (!result) {
+            result = mdb_cursor_get(cur[C_OUTPUT_AMOUNTS], &ka, &v, MDB_LAST_DUP);
+        }
+        // both outkey and pre_rct_outkey start with amount_index, output_id
+        while (!result && read_uint64(ka.mv_data) == amount
+               && read_uint64((const uint8_t *)v.mv_data + sizeof(uint64_t)) >= first_output_id) {
+            if ((result = mdb_cursor_del(cur[C_OUTPUT_AMOUNTS], 0))) {
+                break;
+            }
+            result = mdb_cursor_get(cur[C_OUTPUT_AMOUNTS], &ka, &v, MDB_PREV);
+        }
+        if (result == MDB_NOTFOUND) {
+            result = 0;
+        }
+    }
+    if (result) {
+        what = "m_output_amounts";
+        goto fail;
+    }
+
+    lmdb_tip tip;
+    if ((result = lmdb_tip_read(lmdb, txn, &tip))) {
+        what = "the new top block";
+        goto fail;
+    }
+    tip.commit = mdb_txn_id(txn);
+    if ((result = mdb_txn_commit(txn))) {
+        txn = NULL;
+        what = "the transaction";
+        goto fail;
+    }
+    lmdb_tip_publish(lmdb, &tip);
+    __atomic_fetch_add(&lmdb->m_generation, 1, __ATOMIC_RELEASE);
+    if (header_file_count(&lmdb->m_headers) > height) {
+        header_file_truncate(&lmdb->m_headers, height);
+    }
+    g_info("Popped blocks %llu to %llu, %llu txs", (unsigned long long)height, (unsigned long long)old_height - 1,
+           (unsigned long long)num_txs);
+    output_distribution_truncate(&lmdb->m_rct_distribution, height);
+    hf_version_map_truncate(&lmdb->m_hf_version_map, height);
+    if (lmdb->m_pop_notify) {
+        lmdb_popped popped = {
+            height, old_height,
+            (const hash *)block_hashes->data, block_hashes->len,
+            (const hash *)tx_hashes->data, tx_hashes->len,
+            (const key_image *)key_images->data, key_images->len
+        };
+        lmdb->m_pop_notify(&popped, lmdb->m_pop_notify_user);
+    }
+    for (uint64_t h = old_height; h-- > height;) {
+        event_feed_publish(&lmdb->m_events, &(chain_event){ CHAIN_EVENT_BLOCK_POPPED, h, top_down[old_height - 1 - h], tip.commit });
+    }
+    g_free(top_down);
+    arena_clear(&a);
+    g_array_free(block_hashes, TRUE);
+    g_array_free(tx_hashes, TRUE);
+    g_array_free(key_images, TRUE);
+    g_array_free(amounts, TRUE);
+    return 0;
+
+fail:
+    g_info("Failed to pop blocks from %s: %s", what, mdb_strerror(result));
+    if (txn) {
+        mdb_txn_abort(txn);
+    }
+    g_free(top_down);
+    arena_clear(&a);
+    g_array_free(block_hashes, TRUE);
+    g_array_free(tx_hashes, TRUE);
+    g_array_free(key_images, TRUE);
+    g_array_free(amounts, TRUE);
+    return -7;
+}
+
+// the hash of the block at height, from block_info
+static int lmdb_block_info_hash(MDB_cursor *cur_block_info, uint64_t height, hash *h) {
+    MDB_val_set(v, height);
+    int result = mdb_cursor_get(cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+    if (!result) {
+        memcpy(h, &((const mdb_block_info *)v.mv_data)->bi_hash, sizeof(hash));
+    }
+    return result;
+}
+
+int lmdb_replica_refresh(BlockchainLMDB* lmdb, lmdb_replica_tip *tip) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    if (!lmdb->m_replica) {
+        g_info("Attempted to refresh a db that is not a replica");
+        return -3;
+    }
+
+    MDB_txn *txn;
+    MDB_cursor *cur_block_info = NULL, *cur_hf_versions = NULL;
+    MDB_val k = zerokval, v;
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a read transaction for the db: ", result));
+        return -2;
+    }
+    if ((result = mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info))
+        || (result = mdb_cursor_open(txn, lmdb->m_hf_versions, &cur_hf_versions))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        if (cur_block_info) mdb_cursor_close(cur_block_info);
+        lmdb_rtxn_abort(txn);
+        return -2;
+    }
+
+    g_mutex_lock(&lmdb->m_refresh_lock);
+    memset(tip, 0, sizeof(*tip));
+    const uint64_t old_height = output_distribution_height(&lmdb->m_rct_distribution);
+    if (!(result = mdb_cursor_get(cur_block_info, &k, &v, MDB_SET))
+        && !(result = mdb_cursor_get(cur_block_info, &k, &v, MDB_LAST_DUP))) {
+        const mdb_block_info *bi = (const mdb_block_info *)v.mv_data;
+        tip->height = bi->bi_height + 1;
+        memcpy(&tip->top, &bi->bi_hash, sizeof(hash));
+    } else if (result == MDB_NOTFOUND) {
+        result = 0;
+    }
+
+    // down from the old top to the first block that is still the one the mirrors were loaded with
+    uint64_t fork = MIN(old_height, tip->height);
+    const uint64_t known = old_height - MIN(old_height, LMDB_TIP_HASHES);
+    bool found = fork == 0 || (fork == tip->height
+        && memcmp(&tip->top, &lmdb->m_tip_hashes[(fork - 1) % LMDB_TIP_HASHES], sizeof(hash)) == 0);
+    while (!result && !found && fork > known) {
+        hash h;
+        if (!(result = lmdb_block_info_hash(cur_block_info, fork - 1, &h))) {
+            found = memcmp(&h, &lmdb->m_tip_hashes[(fork - 1) % LMDB_TIP_HASHES], sizeof(hash)) == 0;
+            fork -= found ? 0 : 1;
+        }
+    }
+    if (!found && fork > 0) {
+        // a reorg deeper than the hashes kept
+        fork = 0;
+    }
+    tip->changed_from = fork;
+    tip->reorg = fork < old_height;
+
+    if (!result && tip->reorg) {
+        __atomic_fetch_add(&lmdb->m_generation, 1, __ATOMIC_RELEASE);
+        output_distribution_truncate(&lmdb->m_rct_distribution, fork);
+        hf_version_map_truncate(&lmdb->m_hf_version_map, fork);
+    }
+    if (!result && fork < tip->height) {
+        MDB_val_set(hv, fork);
+        result = mdb_cursor_get(cur_block_info, &k, &hv, MDB_GET_BOTH);
+        while (!result) {
+            const mdb_block_info *bi = (const mdb_block_info *)hv.mv_data;
+            if (bi->bi_height != output_distribution_height(&lmdb->m_rct_distribution)) {
+                result = MDB_CORRUPTED;
+                break;
+            }
+            output_distribution_push(&lmdb->m_rct_distribution, bi->bi_cum_rct);
+            memcpy(&lmdb->m_tip_hashes[bi->bi_height % LMDB_TIP_HASHES], &bi->bi_hash, sizeof(hash));
+            result = mdb_cursor_get(cur_block_info, &k, &hv, MDB_NEXT_DUP);
+        }
+        MDB_val_set(vk, fork);
+        if (result == MDB_NOTFOUND) {
+            result = mdb_cursor_get(cur_hf_versions, &vk, &v, MDB_SET);
+        }
+        while (!result) {
+            if (read_uint64(vk.mv_data) != hf_version_map_height(&lmdb->m_hf_version_map) || v.mv_size != sizeof(uint8_t)) {
+                result = MDB_CORRUPTED;
+                break;
+            }
+            hf_version_map_push(&lmdb->m_hf_version_map, *(const uint8_t *)v.mv_data);
+            result = mdb_cursor_get(cur_hf_versions, &vk, &v, MDB_NEXT);
+        }
+        if (result == MDB_NOTFOUND && (output_distribution_height(&lmdb->m_rct_distribution) != tip->height
+            || hf_version_map_height(&lmdb->m_hf_version_map) != tip->height)) {
+            result = MDB_CORRUPTED;
+        }
+    }
+    lmdb_tip now;
+    if ((!result || result == MDB_NOTFOUND) && !(result = lmdb_tip_read(lmdb, txn, &now))) {
+        now.commit = mdb_txn_id(txn);
+        lmdb_tip_publish(lmdb, &now);
+        // the writer may have made the header file since
+        if (header_file_is_open(&lmdb->m_headers) || !header_file_open(&lmdb->m_headers, lmdb->m_folder, true)) {
+            header_file_follow(&lmdb->m_headers, now.height);
+            header_file_truncate(&lmdb->m_headers, lmdb_headers_check(lmdb, txn, now.height));
+        }
+    }
+    g_mutex_unlock(&lmdb->m_refresh_lock);
+    mdb_cursor_close(cur_hf_versions);
+    mdb_cursor_close(cur_block_info);
+    lmdb_rtxn_abort(txn);
+
+    if (result && result != MDB_NOTFOUND) {
+        g_info("%s", lmdb_error("Failed to follow the writer: ", result));
+        return -4;
+    }
+    return 0;
+}
+
+#define VERIFY_LOG_LIMIT 16
+
+static const char *const lmdb_block_tables[W_COUNT] = {
+    "m_blocks", "m_block_info", "m_block_heights", "m_hf_versions", "m_txs_pruned", "m_txs_prunable",
+    "m_txs_prunable_hash", "m_tx_indices", "m_tx_outputs", "m_output_txs", "m_output_amounts", "m_spent_keys"
+};
+
+// one range of heights of lmdb_verify, checked in its own read txn
+typedef struct lmdb_verify_range {
+    BlockchainLMDB *lmdb;
+    // the txn the table sizes were taken in, which the range's must see too
+    uint64_t snapshot;
+    bool stale;
+    uint64_t start;
+    uint64_t end;
+    // the ids the range starts at, UINT64_MAX until seen, and the next ones after it
+    uint64_t first_tx_id;
+    uint64_t next_tx_id;
+    uint64_t first_output_id;
+    uint64_t next_output_id;
+    uint64_t blocks;
+    uint64_t txs;
+    uint64_t outputs;
+    uint64_t key_images;
+    uint64_t errors;
+    uint64_t first_bad_height;
+    // an lmdb error that stopped the range
+    int result;
+} lmdb_verify_range;
+
+// counts a finding at height, true while it should still be logged
+static bool lmdb_verify_found(lmdb_verify_range *r, uint64_t height) {
+    r->first_bad_height = MIN(r->first_bad_height, height);
+    return r->errors++ < VERIFY_LOG_LIMIT;
+}
+
+#define VERIFY_FAIL(r, height, fmt, ...) \
+    do { \
+        if (lmdb_verify_found(r, height)) \
+            g_warning("Block %llu: " fmt, (unsigned long long)(height), ##__VA_ARGS__); \
+    } while (0)
+
+// a missing record is a finding and skips the rest of the tx or block, any other error stops the range
+#define VERIFY_GET(r, height, what, get) \
+    if ((result = (get))) { \
+        if (result != MDB_NOTFOUND) \
+            return result; \
+        VERIFY_FAIL(r, height, "missing from %s", what); \
+        return 0; \
+    }
+
+// the records a tx of the block at height points to, and the ones pointing back at it
+static int lmdb_verify_tx(lmdb_verify_range *r, MDB_cursor *const *cur, uint64_t height, const hash *tx_hash,
+                          uint64_t *rct, arena *a) {
+    MDB_val hk = { sizeof(hash), (void *)tx_hash };
+    MDB_val v;
+    transaction_prefix prefix;
+    txindex ti;
+    int result;
+
+    VERIFY_GET(r, height, "m_tx_indices", mdb_cursor_get(cur[W_TX_INDICES], (MDB_val *)&zerokval, &hk, MDB_GET_BOTH));
+    memcpy(&ti, hk.mv_data, sizeof(ti));
+    r->txs++;
+    if (ti.data.block_id != height) {
+        VERIFY_FAIL(r, height, "tx %llu is indexed in block %llu", (unsigned long long)ti.data.tx_id,
+                    (unsigned long long)ti.data.block_id);
+    }
+    if (r->next_tx_id == UINT64_MAX) {
+        r->first_tx_id = ti.data.tx_id;
+    } else if (ti.data.tx_id != r->next_tx_id) {
+        VERIFY_FAIL(r, height, "tx id %llu, expected %llu", (unsigned long long)ti.data.tx_id,
+                    (unsigned long long)r->next_tx_id);
+    }
+    r->next_tx_id = ti.data.tx_id + 1;
+
+    MDB_val_set(tk, ti.data.tx_id);
+    VERIFY_GET(r, height, "m_txs_pruned", mdb_cursor_get(cur[W_TXS_PRUNED], &tk, &v, MDB_SET));
+    if (!parse_tx_prefix_from_blob(v.mv_data, v.mv_size, a, &prefix)) {
+        VERIFY_FAIL(r, height, "tx %llu does not parse", (unsigned long long)ti.data.tx_id);
+        return 0;
+    }
+    if (prefix.unlock_time != ti.data.unlock_time) {
+        VERIFY_FAIL(r, height, "tx %llu has another unlock time in m_tx_indices", (unsigned long long)ti.data.tx_id);
+    }
+    VERIFY_GET(r, height, "m_txs_prunable", mdb_cursor_get(cur[W_TXS_PRUNABLE], &tk, &v, MDB_SET));
+    VERIFY_GET(r, height, "m_tx_outputs", mdb_cursor_get(cur[W_TX_OUTPUTS], &tk, &v, MDB_SET));
+    if (v.mv_size != prefix.vout_size * sizeof(uint64_t)) {
+        VERIFY_FAIL(r, height, "tx %llu has %zu amount indices for %zu outputs", (unsigned long long)ti.data.tx_id,
+                    v.mv_size / sizeof(uint64_t), prefix.vout_size);
+        return 0;
+    }
+    const uint8_t *amount_indices = v.mv_data;
+
+    for (size_t i = 0; i < prefix.vout_size; i++) {
+        const tx_out *out = &prefix.vout[i];
+        const uint64_t amount = prefix.version >= 2 ? 0 : out->amount;
+        const uint64_t amount_index = read_uint64(amount_indices + i * sizeof(uint64_t));
+        pre_rct_outkey ok;
+        outtx ot;
+
+        // rct outputs are numbered in chain order
+        if (amount == 0) {
+            if (amount_index != *rct) {
+                VERIFY_FAIL(r, height, "rct output %llu, expected %llu", (unsigned long long)amount_index,
+                            (unsigned long long)*rct);
+            }
+            *rct = amount_index + 1;
+        }
+        MDB_val_set(ak, amount);
+        MDB_val_set(av, amount_index);
+        VERIFY_GET(r, height, "m_output_amounts", mdb_cursor_get(cur[W_OUTPUT_AMOUNTS], &ak, &av, MDB_GET_BOTH));
+        // an outkey starts with a pre_rct_outkey
+        memcpy(&ok, av.mv_data, sizeof(ok));
+        r->outputs++;
+        if (ok.data.height != height || (out->target.tag == TXOUT_TO_KEY_TAG
+            && memcmp(&ok.data.pubkey, &out->target.key.key, sizeof(ok.data.pubkey)) != 0)) {
+            VERIFY_FAIL(r, height, "output %llu of amount %llu is not output %zu of tx %llu",
+                        (unsigned long long)amount_index, (unsigned long long)amount, i,
+                        (unsigned long long)ti.data.tx_id);
+        }
+        if (r->next_output_id == UINT64_MAX) {
+            r->first_output_id = ok.output_id;
+        } else if (ok.output_id != r->next_output_id) {
+            VERIFY_FAIL(r, height, "output id %llu, expected %llu", (unsigned long long)ok.output_id,
+                        (unsigned long long)r->next_output_id);
+        }
+        r->next_output_id = ok.output_id + 1;
+
+        MDB_val_set(ov, ok.output_id);
+        VERIFY_GET(r, height, "m_output_txs", mdb_cursor_get(cur[W_OUTPUT_TXS], (MDB_val *)&zerokval, &ov, MDB_GET_BOTH));
+        memcpy(&ot, ov.mv_data, sizeof(ot));
+        if (memcmp(&ot.tx_hash, tx_hash, sizeof(hash)) != 0 || ot.local_index != i) {
+            VERIFY_FAIL(r, height, "output id %llu is not output %zu of tx %llu", (unsigned long long)ok.output_id, i,
+                        (unsigned long long)ti.data.tx_id);
+        }
+    }
+
+    for (size_t i = 0; i < prefix.vin_size; i++) {
+        if (prefix.vin[i].tag != TXIN_TO_KEY_TAG) {
+            continue;
+        }
+        MDB_val kv = { sizeof(key_image), &prefix.vin[i].key.k_image };
+        VERIFY_GET(r, height, "m_spent_keys", mdb_cursor_get(cur[W_SPENT_KEYS], (MDB_val *)&zerokval, &kv, MDB_GET_BOTH));
+        r->key_images++;
+    }
+    return 0;
+}
+
+// the block at height against the block before it (prev_hash, rct) and every table that names it
+static int lmdb_verify_block(lmdb_verify_range *r, MDB_cursor *const *cur, uint64_t height, hash *prev_hash,
+                             uint64_t *rct, arena *a) {
+    MDB_val_set(k, height);
+    MDB_val_set(hv, height);
+    MDB_val v;
+    block b;
+    hash block_hash, miner_hash;
+    mdb_block_info bi;
+    blk_height bh;
+    int result;
+
+    VERIFY_GET(r, height, "m_blocks", mdb_cursor_get(cur[W_BLOCKS], &k, &v, MDB_SET));
+    if (!parse_and_validate_block_from_blob(v.mv_data, v.mv_size, a, &b) || !get_block_hash(&b, &block_hash)
+        || !get_transaction_hash(&b.miner_tx, &miner_hash)) {
+        VERIFY_FAIL(r, height, "does not parse");
+        return 0;
+    }
+    r->blocks++;
+    if (height > 0 && memcmp(&b.header.prev_id, prev_hash, sizeof(hash)) != 0) {
+        VERIFY_FAIL(r, height, "not a child of the block below");
+    }
+    *prev_hash = block_hash;
+
+    VERIFY_GET(r, height, "m_block_info", mdb_cursor_get(cur[W_BLOCK_INFO], (MDB_val *)&zerokval, &hv, MDB_GET_BOTH));
+    memcpy(&bi, hv.mv_data, sizeof(bi));
+    if (memcmp(&bi.bi_hash, &block_hash, sizeof(hash)) != 0) {
+        VERIFY_FAIL(r, height, "m_block_info has another hash");
+    }
+    MDB_val bk = { sizeof(hash), &block_hash };
+    VERIFY_GET(r, height, "m_block_heights", mdb_cursor_get(cur[W_BLOCK_HEIGHTS], (MDB_val *)&zerokval, &bk, MDB_GET_BOTH));
+    memcpy(&bh, bk.mv_data, sizeof(bh));
+    if (bh.bh_height != height) {
+        VERIFY_FAIL(r, height, "m_block_heights has it at %llu", (unsigned long long)bh.bh_height);
+    }
+    VERIFY_GET(r, height, "m_hf_versions", mdb_cursor_get(cur[W_HF_VERSIONS], &k, &v, MDB_SET));
+    if (v.mv_size != sizeof(uint8_t) || *(const uint8_t *)v.mv_data != b.header.major_version) {
+        VERIFY_FAIL(r, height, "m_hf_versions does not have its major version");
+    }
+
+    // the miner tx first, then the others in block order
+    const uint64_t rct_below = *rct;
+    for (size_t i = 0; i <= b.tx_hashes_size; i++) {
+        if ((result = lmdb_verify_tx(r, cur, height, i == 0 ? &miner_hash : &b.tx_hashes[i - 1], rct, a))) {
+            return result;
+        }
+    }
+    if (bi.bi_cum_rct < rct_below) {
+        VERIFY_FAIL(r, height, "bi_cum_rct goes down to %llu from %llu", (unsigned long long)bi.bi_cum_rct,
+                    (unsigned long long)rct_below);
+    } else if (bi.bi_cum_rct != *rct) {
+        VERIFY_FAIL(r, height, "bi_cum_rct is %llu with %llu rct outputs up to it", (unsigned long long)bi.bi_cum_rct,
+                    (unsigned long long)*rct);
+    }
+    // a finding does not carry over to the blocks above
+    *rct = bi.bi_cum_rct;
+    return 0;
+}
+
+static void lmdb_verify_job(gpointer data) {
+    lmdb_verify_range *r = data;
+    BlockchainLMDB *lmdb = r->lmdb;
+    MDB_cursor *cur[W_COUNT] = { NULL };
+    MDB_dbi dbis[W_COUNT];
+    MDB_txn *txn;
+    hash prev_hash;
+    uint64_t rct = 0;
+    arena a;
+    int result;
+
+    if ((result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn))) {
+        r->result = result;
+        return;
+    }
+    if (mdb_txn_id(txn) != r->snapshot) {
+        r->stale = true;
+        lmdb_rtxn_abort(txn);
+        return;
+    }
+    lmdb_block_dbis(lmdb, dbis);
+    for (int i = 0; i < W_COUNT && !result; i++) {
+        result = mdb_cursor_open(txn, dbis[i], &cur[i]);
+    }
+    // the block below the range is where its hashes and rct outputs follow on from
+    memset(&prev_hash, 0, sizeof(prev_hash));
+    if (!result && r->start > 0) {
+        const uint64_t below = r->start - 1;
+        MDB_val_set(v, below);
+        if (!(result = mdb_cursor_get(cur[W_BLOCK_INFO], (MDB_val *)&zerokval, &v, MDB_GET_BOTH))) {
+            mdb_block_info bi;
+            memcpy(&bi, v.mv_data, sizeof(bi));
+            prev_hash = bi.bi_hash;
+            rct = bi.bi_cum_rct;
+        } else if (result == MDB_NOTFOUND) {
+            VERIFY_FAIL(r, below, "missing from m_block_info");
+            result = 0;
+        }
+    }
+
+    arena_init(&a, 4096);
+    for (uint64_t height = r->start; height < r->end && !result; height++) {
+        result = lmdb_verify_block(r, cur, height, &prev_hash, &rct, &a);
+        arena_reset(&a);
+    }
+    arena_clear(&a);
+    r->result = result;
+    for (int i = 0; i < W_COUNT; i++) {
+        if (cur[i]) {
+            mdb_cursor_close(cur[i]);
+        }
+    }
+    lmdb_rtxn_abort(txn);
+}
+
+int lmdb_verify(BlockchainLMDB* lmdb, threadpool *pool, uint64_t range_size, lmdb_verify_report *report) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+
+    MDB_txn *txn;
+    MDB_dbi dbis[W_COUNT];
+    MDB_stat st[W_COUNT];
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a read transaction for the db: ", result));
+        return -2;
+    }
+    // the sizes of the tables, in the snapshot the ranges are cut from
+    const uint64_t snapshot = mdb_txn_id(txn);
+    lmdb_block_dbis(lmdb, dbis);
+    for (int i = 0; i < W_COUNT && !result; i++) {
+        result = mdb_stat(txn, dbis[i], &st[i]);
+    }
+    lmdb_rtxn_abort(txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to query the tables: ", result));
+        return -2;
+    }
+
+    const uint64_t height = st[W_BLOCKS].ms_entries;
+    if (!pool) {
+        pool = threadpool_get_instance();
+    }
+    if (range_size == 0) {
+        // a few ranges per thread, so a slow one does not hold up the rest
+        const uint64_t nranges = 4 * (uint64_t)MAX(threadpool_get_max_concurrency(pool), 1);
+        range_size = MAX((height + nranges - 1) / nranges, 1);
+    }
+    const size_t nranges = (height + range_size - 1) / range_size;
+    lmdb_verify_range *ranges = g_new0(lmdb_verify_range, nranges);
+    tpool_waiter waiter;
+
+    tpool_waiter_init(&waiter);
+    for (size_t i = 0; i < nranges; i++) {
+        lmdb_verify_range *r = &ranges[i];
+        r->lmdb = lmdb;
+        r->snapshot = snapshot;
+        r->start = i * range_size;
+        r->end = MIN(r->start + range_size, height);
+        r->first_tx_id = r->next_tx_id = UINT64_MAX;
+        r->first_output_id = r->next_output_id = UINT64_MAX;
+        r->first_bad_height = UINT64_MAX;
+        threadpool_submit(pool, &waiter, lmdb_verify_job, r);
+    }
+    threadpool_wait(pool, &waiter);
+    tpool_waiter_clear(&waiter);
+
+    int ret = 0;
+    uint64_t tx_id = 0, output_id = 0;
+    memset(report, 0, sizeof(*report));
+    report->first_bad_height = UINT64_MAX;
+    for (size_t i = 0; i < nranges; i++) {
+        if (ranges[i].stale) {
+            // the ranges would be checked against sizes of another chain, and each other
+            g_info("The db was written to after txn %llu, while it was being verified", (unsigned long long)snapshot);
+            g_free(ranges);
+            return -5;
+        }
+    }
+    for (size_t i = 0; i < nranges; i++) {
+        lmdb_verify_range *r = &ranges[i];
+        if (r->result) {
+            g_info("Failed to verify blocks %llu to %llu: %s", (unsigned long long)r->start,
+                   (unsigned long long)r->end - 1, mdb_strerror(r->result));
+            ret = -2;
+        }
+        // the ids of a range follow on from the range below
+        if (r->first_tx_id != UINT64_MAX) {
+            if (r->first_tx_id != tx_id) {
+                VERIFY_FAIL(r, r->start, "tx id %llu, expected %llu", (unsigned long long)r->first_tx_id,
+                            (unsigned long long)tx_id);
+            }
+            tx_id = r->next_tx_id;
+        }
+        if (r->first_output_id != UINT64_MAX) {
+            if (r->first_output_id != output_id) {
+                VERIFY_FAIL(r, r->start, "output id %llu, expected %llu", (unsigned long long)r->first_output_id,
+                            (unsigned long long)output_id);
+            }
+            output_id = r->next_output_id;
+        }
+        report->blocks += r->blocks;
+        report->txs += r->txs;
+        report->outputs += r->outputs;
+        report->key_images += r->key_images;
+        report->errors += r->errors;
+        report->first_bad_height = MIN(report->first_bad_height, r->first_bad_height);
+    }
+    g_free(ranges);
+
+    // every record was reached from a block, so a table bigger than that has records nothing points to
+    const uint64_t expected[W_COUNT] = {
+        height, height, height, height, report->txs, report->txs, st[W_TXS_PRUNABLE_HASH].ms_entries, report->txs,
+        report->txs, report->outputs, report->outputs, report->key_images
+    };
+    for (int i = 0; i < W_COUNT && ret == 0; i++) {
+        if (st[i].ms_entries != expected[i]) {
+            g_warning("%s has %llu records, %llu expected", lmdb_block_tables[i], (unsigned long long)st[i].ms_entries,
+                      (unsigned long long)expected[i]);
+            report->errors++;
+        }
+    }
+    if (ret == 0 && report->errors > 0) {
+        ret = -4;
+    }
+    return ret;
+}
+
+// one key range of lmdb_for_each_partitioned, walked in its own read txn
+typedef struct lmdb_partition {
+    BlockchainLMDB *lmdb;
+    MDB_dbi dbi;
+    uint64_t first;
+    uint64_t last;
+    bool empty;
+    lmdb_record_func f;
+    void *part;
+    int result;
+} lmdb_partition;
+
+static void lmdb_partition_job(gpointer data) {
+    lmdb_partition *p = data;
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    MDB_val_set(k, p->first);
+    MDB_val v;
+    int result;
+
+    if ((result = lmdb_txn_begin(p->lmdb->m_env, NULL, MDB_RDONLY, &txn))) {
+        p->result = result;
+        return;
+    }
+    if ((result = mdb_cursor_open(txn, p->dbi, &cur))) {
+        lmdb_rtxn_abort(txn);
+        p->result = result;
+        return;
+    }
+    result = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+    while (!result) {
+        const uint64_t key = read_uint64(k.mv_data);
+        if (key > p->last || !p->f(key, &v, p->part)) {
+            break;
+        }
+        result = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+    }
+    p->result = result == MDB_NOTFOUND ? 0 : result;
+    mdb_cursor_close(cur);
+    lmdb_rtxn_abort(txn);
+}
+
+int lmdb_for_each_partitioned(BlockchainLMDB* lmdb, MDB_dbi dbi, threadpool *pool, void *parts, size_t part_size,
+                              size_t nparts, lmdb_record_func f, lmdb_part_merge_func merge, void *user) {
+    g_debug("BlockchainLMDB::%s", __func__);
+    if (!lmdb_check_open(lmdb)) {
+        g_info("lmdb not open!");
+        return -1;
+    }
+    if (nparts == 0) {
+        return 0;
+    }
+
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    MDB_val k, v;
+    unsigned int flags;
+    int result = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to create a read transaction for the db: ", result));
+        return -2;
+    }
+    if ((result = mdb_dbi_flags(txn, dbi, &flags)) || (result = mdb_cursor_open(txn, dbi, &cur))) {
+        g_info("%s", lmdb_error("Failed to open cursor: ", result));
+        lmdb_rtxn_abort(txn);
+        return -3;
+    }
+    if (!(flags & MDB_INTEGERKEY)) {
+        g_info("Attempted to partition a table without integer keys");
+        mdb_cursor_close(cur);
+        lmdb_rtxn_abort(txn);
+        return -4;
+    }
+
+    /*
+     * LMDB does not expose its pages, so the span from the first to the last
+     * key is cut evenly and each cut moved up to the next key that exists.
+     * The tables keyed by height or id are dense, which makes the parts
+     * about the same size.
+     */
+    lmdb_partition *ranges = g_new0(lmdb_partition, nparts);
+    uint64_t first = 0, last = 0;
+    bool empty = false;
+    if ((result = mdb_cursor_get(cur, &k, &v, MDB_FIRST)) == MDB_NOTFOUND) {
+        empty = true;
+        result = 0;
+    } else if (!result) {
+        first = read_uint64(k.mv_data);
+        if (!(result = mdb_cursor_get(cur, &k, &v, MDB_LAST))) {
+            last = read_uint64(k.mv_data);
+        }
+    }
+    const uint64_t span = last - first;
+    uint64_t next = first;
+    for (size_t i = 0; i < nparts && !result; i++) {
+        lmdb_partition *p = &ranges[i];
+        p->lmdb = lmdb;
+        p->dbi = dbi;
+        p->f = f;
+        p->part = (uint8_t *)parts + i * part_size;
+        p->first = next;
+        p->last = last;
+        p->empty = empty || next > last;
+        if (i + 1 < nparts && !p->empty) {
+            uint64_t cut = first + span / nparts * (i + 1) + span % nparts * (i + 1) / nparts;
+            MDB_val_set(ck, cut);
+            if ((result = mdb_cursor_get(cur, &ck, &v, MDB_SET_RANGE))) {
+                break;
+            }
+            // the cut starts the next part, the span to it is this one
+            cut = MAX(read_uint64(ck.mv_data), next + 1);
+            p->last = cut - 1;
+            next = cut;
+        } else {
+            next = last + 1;
+            if (next == 0) {
+                // the last key is UINT64_MAX: the parts above this one are empty
+                empty = true;
+            }
+        }
+    }
+    mdb_cursor_close(cur);
+    lmdb_rtxn_abort(txn);
+    if (result) {
+        g_info("%s", lmdb_error("Failed to find the partition keys: ", result));
+        g_free(ranges);
+        return -2;
+    }
+
+    tpool_waiter waiter;
+    if (!pool) {
+        pool = threadpool_get_instance();
+    }
+    tpool_waiter_init(&waiter);
+    for (size_t i = 0; i < nparts; i++) {
+        if (!ranges[i].empty) {
+            threadpool_submit(pool, &waiter, lmdb_partition_job, &ranges[i]);
+        }
+    }
+    threadpool_wait(pool, &waiter);
+    tpool_waiter_clear(&waiter);
+
+    int ret = 0;
+    for (size_t i = 0; i < nparts; i++) {
+        if (ranges[i].result) {
+            g_info("Failed to walk keys %llu to %llu: %s", (unsigned long long)ranges[i].first,
+                   (unsigned long long)ranges[i].last, mdb_strerror(ranges[i].result));
+            ret = -5;
+        }
+    }
+    for (size_t i = 0; i < nparts && merge && ret == 0; i++) {
+        merge(i, ranges[i].part, user);
+    }
+    g_free(ranges);
+    return ret;
+}
+
+bool lmdb_block_rtxn_start(BlockchainLMDB* lmdb, MDB_txn **mtxn, mdb_txn_cursors **mcur) {
+    mdb_threadinfo *tinfo;
+    int mdb_res;
+    if (lmdb->m_write_txn && lmdb->m_writer == g_thread_self()) {
+        *mtxn = lmdb->m_write_txn->m_txn;
+        *mcur = (mdb_txn_cursors *)&lmdb->m_wcursors;
+        return false;
+    }
+    /* Check for existing info and force reset if env doesn't match -
+     * only happens if env was opened/closed multiple times in same process
+     */
+    tinfo = g_private_get(&thread_info_key);
+    if (tinfo == NULL || mdb_txn_env(tinfo->m_ti_rtxn) != lmdb->m_env) {
+        tinfo = malloc(sizeof(mdb_threadinfo));
+        //maybe memory leak.
+        g_private_replace(&thread_info_key, tinfo);
+        memset(&tinfo->m_ti_rcursors, 0, sizeof(tinfo->m_ti_rcursors));
+        memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
+        // kept across calls, but holds m_map_lock like any other read txn until lmdb_block_rtxn_stop resets it
+        if ((mdb_res = lmdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &tinfo->m_ti_rtxn))) {
+            g_private_replace(&thread_info_key, NULL);
+            free(tinfo);
+        }
+    } else if (!tinfo->m_ti_rflags.m_rf_txn) {
+        mdb_res = lmdb_txn_renew(tinfo->m_ti_rtxn);
+    } else {
+        mdb_res = 0;
+    }
+    if (mdb_res) {
+        g_warning("%s", lmdb_error("Failed to create a read transaction for the db: ", mdb_res));
+        *mtxn = NULL;
+        *mcur = NULL;
+        return false;
+    }
+    tinfo->m_ti_rflags.m_rf_txn = true;
+    lmdb->m_tinfo = tinfo;
+    *mtxn = tinfo->m_ti_rtxn;
+    *mcur = &tinfo->m_ti_rcursors;
+    return true;
+}
+
+void lmdb_block_rtxn_stop(BlockchainLMDB* lmdb) {
+    mdb_threadinfo *tinfo = g_private_get(&thread_info_key);
+    if (tinfo == NULL || !tinfo->m_ti_rflags.m_rf_txn || mdb_txn_env(tinfo->m_ti_rtxn) != lmdb->m_env) {
+        return;
+    }
+    lmdb_rtxn_reset(tinfo->m_ti_rtxn);
+    memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
+}
+
+
+/*
+ * LMDB PRIVATE METHOD
+ *
+ */
+
+bool lmdb_check_open(BlockchainLMDB* lmdb) {
+    return lmdb->db->m_open;
+}
+
+bool lmdb_need_resize(BlockchainLMDB *lmdb, uint64_t threshold_size) {
+#if defined(ENABLE_AUTO_RESIZE)
+    MDB_envinfo mei;
+    mdb_env_info(lmdb->m_env, &mei);
+    
+    MDB_stat mst;
+    mdb_env_stat(lmdb->m_env, &mst);
+    
+    // size_used doesn't include data yet to be committed, which can be
+    // significant size during batch transactions. For that, we estimate the size
+    // needed at the beginning of the batch transaction and pass in the
+    // additional size needed.
+    uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+    
+    g_debug("DB map size:     %zu", mei.me_mapsize);
+    g_debug("Space used:      %llu", (unsigned long long)size_used);
+    g_debug("Space remaining: %llu", (unsigned long long)(mei.me_mapsize - size_used));
+    g_debug("Size threshold:  %llu", (unsigned long long)threshold_size);
+    float resize_percent = RESIZE_PERCENT;
+    g_debug("Percent used: %f  Percent threshold: %f",  ((double)size_used/mei.me_mapsize) , resize_percent);
+    
+    if (threshold_size > 0) {
+        if (mei.me_mapsize - size_used < threshold_size) {
+            g_debug("Threshold met (size-based)");
+            return true;
+        } else {
+            return false;
+        }
+    }
+    
+    if ((double)size_used / mei.me_mapsize  > resize_percent) {
+        g_debug("Threshold met (percent-based)");
+        return true;
+    }
+    return false;
+#else
+    return false;
+#endif
+}
+
+void lmdb_do_resize(BlockchainLMDB *lmdb, uint64_t increase_size) {
+    g_debug("BlockchainLMDB#lmdb_do_resize");
+    const uint64_t add_size = 1LL << 30;
+    if (lmdb_map_holds(lmdb) > 0) {
+        // the writer lock would wait for this thread's own read txns
+        g_info("Not resizing the map under a read txn of this thread");
+        return;
+    }
+    // check disk capacity, -1 if it could not be read
+    long available_space = get_available_space(lmdb->m_folder);
+    if (available_space >= 0 && (uint64_t)available_space < add_size) {
+        g_error("!! WARNING: Insufficient free space to extend database : %ld MB avaliable, %llu MB needed", (available_space >> 20L), (unsigned long long)(add_size >> 20L));
+        return;
+    }
+    
+    MDB_envinfo mei;
+    mdb_env_info(lmdb->m_env, &mei);
+    
+    MDB_stat mst;
+    mdb_env_stat(lmdb->m_env, &mst);
+    
+    // add 1Gb per resize, instead of doing a percentage increase
+    uint64_t new_mapsize = (double) mei.me_mapsize + add_size;
+    
+    // If given, use increase_size instead of above way of resizing.
+    // This is currently used for increasing by an estimated size at start of new
+    // batch txn.
+    if (increase_size > 0) {
+        new_mapsize = mei.me_mapsize + increase_size;
+    }
+    
+    new_mapsize += (new_mapsize % mst.ms_psize);
+    
+    // no read txn of any thread may see the map move
+    g_rw_lock_writer_lock(&lmdb->m_map_lock);
+    
+    if (lmdb->m_write_txn != NULL) {
+        if (lmdb->m_batch_active) {
+            g_error("lmdb resizing not yet supported when batch transactions enabled!");
+        } else {
+            g_error("attempting resize with write transaction in progress, this should not happen!");
+        }
+    }
+    int result = mdb_env_set_mapsize(lmdb->m_env, new_mapsize);
+    g_rw_lock_writer_unlock(&lmdb->m_map_lock);
+    if (result) {
+        g_error("Failed to set new mapsize: %d", result);
+        return;
+    }
+    lmdb_io_advise(lmdb);
+    
+    g_info("LMDB Mapsize increased. Old: %zuMiB, New: %lluMiB.", mei.me_mapsize / (1024 * 1024), (unsigned long long)(new_mapsize / (1024 * 1024)));
+    
+}
+
+// where a migration stopped, in m_properties under "migration"
+typedef struct lmdb_migration_checkpoint {
+    uint32_t version;   // migrating from this version to the next
+    uint32_t phase;
+    uint64_t position;  // records converted in this phase
+    uint64_t aux;       // state a step carries from one chunk to the next
+} lmdb_migration_checkpoint;
+
+/*
+ * A step converts at most batch records in txn from the checkpoint on and
+ * moves it forward, setting done after the last one. total is the number
+ * of records in the current phase, for the progress report.
+ */
+typedef int (*lmdb_migration_step)(BlockchainLMDB *lmdb, MDB_txn *txn, lmdb_migration_checkpoint *cp, size_t batch, uint64_t *total, bool *done);
+
+// moves the first dup of src to the end of the dups of dst, for the two passes over block_info
+static int lmdb_move_first_dup(MDB_cursor *src, MDB_cursor *dst, const void *data, size_t size) {
+    MDB_val v = { size, (void *)data };
+    int result = mdb_cursor_put(dst, (MDB_val *)&zerokval, &v, MDB_APPENDDUP);
+    return result ? result : mdb_cursor_del(src, 0);
+}
+
+/*
+ * 1 to 2: block_info gains bi_cum_rct. Dups of one key must have the same
+ * size, so phase 0 moves the old records to a temporary table with the rct
+ * outputs counted in, and phase 1 moves them back. aux is the number of rct
+ * outputs counted so far, which is also the amount index of the next one.
+ */
+static int lmdb_migrate_1_2(BlockchainLMDB *lmdb, MDB_txn *txn, lmdb_migration_checkpoint *cp, size_t batch, uint64_t *total, bool *done) {
+    MDB_dbi tmp;
+    MDB_cursor *cur_block_info = NULL, *cur_tmp = NULL, *cur_output_amounts = NULL;
+    MDB_val k, v;
+    mdb_size_t count = 0;
+    int result;
+
+    if ((result = mdb_dbi_open(txn, LMDB_BLOCK_INFO_TMP, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, &tmp))) {
+        return result;
+    }
+    mdb_set_dupsort(txn, tmp, compare_uint64);
+    if ((result = mdb_cursor_open(txn, lmdb->m_block_info, &cur_block_info))
+        || (result = mdb_cursor_open(txn, tmp, &cur_tmp))
+        || (result = mdb_cursor_open(txn, lmdb->m_output_amounts, &cur_output_amounts))) {
+        goto done;
+    }
+    MDB_cursor *src = cp->phase == 0 ? cur_block_info : cur_tmp;
+    MDB_cursor *dst = cp->phase == 0 ? cur_tmp : cur_block_info;
+
+    k = zerokval;
+    if (!(result = mdb_cursor_get(src, &k, &v, MDB_SET))) {
+        result = mdb_cursor_count(src, &count);
+    }
+    if (result && result != MDB_NOTFOUND) {
+        goto done;
+    }
+    *total = cp->position + count;
+
+    // the next rct output not counted yet, if there is one
+    uint64_t zero = 0;
+    MDB_val ka = { sizeof(zero), &zero }, va = { sizeof(cp->aux), &cp->aux };
+    int rct = cp->phase == 0 ? mdb_cursor_get(cur_output_amounts, &ka, &va, MDB_GET_BOTH) : MDB_NOTFOUND;
+
+    result = 0;
+    for (size_t i = 0; i < batch && !result; i++) {
+        k = zerokval;
+        if ((result = mdb_cursor_get(src, &k, &v, MDB_SET))) {
+            if (result != MDB_NOTFOUND) {
+                break;
+            }
+            result = 0;
+            if (cp->phase == 0) {
+                cp->phase = 1;
+                cp->position = 0;
+            } else {
+                result = mdb_drop(txn, tmp, 1);
+                *done = true;
+            }
+            break;
+        }
+        if (cp->phase == 0) {
+            mdb_block_info_old old;
+            mdb_block_info bi;
+            if (v.mv_size != sizeof(old)) {
+                result = MDB_BAD_VALSIZE;
+                break;
+            }
+            memcpy(&old, v.mv_data, sizeof(old));
+            // amount indices follow the chain, so the outputs of a block are a run
+            while (!rct && ((const outkey *)va.mv_data)->data.height <= old.bi_height) {
+                cp->aux++;
+                rct = mdb_cursor_get(cur_output_amounts, &ka, &va, MDB_NEXT_DUP);
+            }
+            if (rct && rct != MDB_NOTFOUND) {
+                result = rct;
+                break;
+            }
+            bi.bi_height = old.bi_height;
+            bi.bi_timestamp = old.bi_timestamp;
+            bi.bi_coins = old.bi_coins;
+            bi.bi_weight = old.bi_weight;
+            bi.bi_diff = old.bi_diff;
+            bi.bi_hash = old.bi_hash;
+            bi.bi_cum_rct = cp->aux;
+            result = lmdb_move_first_dup(src, dst, &bi, sizeof(bi));
+        } else {
+            mdb_block_info bi;
+            memcpy(&bi, v.mv_data, sizeof(bi));
+            result = lmdb_move_first_dup(src, dst, &bi, sizeof(bi));
+        }
+        cp->position++;
+    }
+
+done:
+    if (cur_output_amounts) {
+        mdb_cursor_close(cur_output_amounts);
+    }
+    if (cur_tmp) {
+        mdb_cursor_close(cur_tmp);
+    }
+    if (cur_block_info) {
+        mdb_cursor_close(cur_block_info);
+    }
+    return result;
+}
+
+/*
+ * 2 to 3: the whole tx blobs of txs move to txs_pruned and txs_prunable,
+ * with the prunable hash of v2 txs. The txs are moved lowest id first and
+ * deleted as they go, so what is left of txs is where to resume.
+ */
+static int lmdb_migrate_2_3(BlockchainLMDB *lmdb, MDB_txn *txn, lmdb_migration_checkpoint *cp, size_t batch, uint64_t *total, bool *done) {
+    MDB_cursor *cur_txs;
+    MDB_stat st;
+    MDB_val k, v;
+    arena a;
+    int result;
+
+    if ((result = mdb_stat(txn, lmdb->m_txs, &st))) {
+        return result;
+    }
+    *total = cp->position + st.ms_entries;
+    if ((result = mdb_cursor_open(txn, lmdb->m_txs, &cur_txs))) {
+        return result;
+    }
+    arena_init(&a, 4096);
+    for (size_t i = 0; i < batch; i++) {
+        transaction tx;
+        hash prunable_hash;
+        if ((result = mdb_cursor_get(cur_txs, &k, &v, MDB_FIRST))) {
+            if (result == MDB_NOTFOUND) {
+                result = 0;
+                *done = true;
+            }
+            break;
+        }
+        arena_reset(&a);
+        if (!parse_and_validate_tx_from_blob(v.mv_data, v.mv_size, &a, &tx)) {
+            result = MDB_CORRUPTED;
+            break;
+        }
+        const size_t pruned_size = tx.prefix_size + tx.rct_base_size;
+        MDB_val pruned = { pruned_size, v.mv_data };
+        MDB_val prunable = { v.mv_size - pruned_size, (uint8_t *)v.mv_data + pruned_size };
+        MDB_val hv = { sizeof(prunable_hash), &prunable_hash };
+        if ((result = mdb_put(txn, lmdb->m_txs_pruned, &k, &pruned, MDB_APPEND))
+            || (result = mdb_put(txn, lmdb->m_txs_prunable, &k, &prunable, MDB_APPEND))
+            || (get_transaction_prunable_hash(&tx, &prunable_hash)
+                && (result = mdb_put(txn, lmdb->m_txs_prunable_hash, &k, &hv, MDB_APPEND)))
+            || (result = mdb_cursor_del(cur_txs, 0))) {
+            break;
+        }
+        cp->position++;
+    }
+    arena_clear(&a);
+    mdb_cursor_close(cur_txs);
+    return result;
+}
+
+static const struct {
+    uint32_t from;
+    const char *what;
+    lmdb_migration_step step;
+} lmdb_migrations[] = {
+    { 1, "adding rct output counts to block_info", lmdb_migrate_1_2 },
+    { 2, "splitting txs into pruned and prunable parts", lmdb_migrate_2_3 },
+};
+
+int lmdb_migrate(BlockchainLMDB *lmdb, const uint32_t oldversion) {
+    const size_t batch = lmdb->m_migrate_batch ? lmdb->m_migrate_batch : MIGRATE_BATCH;
+    uint32_t phase = UINT32_MAX;
+    uint64_t phase_start = 0;
+    gint64 start = 0;
+    bool grown = false;
+
+    g_info("Migrating blockchain from DB version %u to %u - this may take a while", oldversion, VERSION);
+    for (;;) {
+        MDB_txn *txn;
+        MDB_val k = { sizeof("version"), "version" }, ck = { sizeof("migration"), "migration" }, v;
+        lmdb_migration_checkpoint cp;
+        uint32_t version;
+        uint64_t total = 0;
+        bool done = false;
+        size_t m;
+        int result;
+
+        // between txns, a step copies whole tables and the map can not move under one
+        if (lmdb_need_resize(lmdb, 0)) {
+            lmdb_do_resize(lmdb, 0);
+        }
+        if ((result = lmdb_txn_begin(lmdb->m_env, NULL, 0, &txn))) {
+            g_info("%s", lmdb_error("Failed to create a transaction for the db: ", result));
+            return -2;
+        }
+        if ((result = mdb_get(txn, lmdb->m_properties, &k, &v)) || v.mv_size != sizeof(version)) {
+            g_info("Failed to read the DB version");
+            mdb_txn_abort(txn);
+            return -2;
+        }
+        memcpy(&version, v.mv_data, sizeof(version));
+        if (version >= VERSION) {
+            mdb_txn_abort(txn);
+            return 0;
+        }
+        for (m = 0; m < G_N_ELEMENTS(lmdb_migrations) && lmdb_migrations[m].from != version; m++);
+        if (m == G_N_ELEMENTS(lmdb_migrations)) {
+            g_info("No migration from DB version %u", version);
+            mdb_txn_abort(txn);
+            return -1;
+        }
+
+        // resume where the last run stopped, if it was migrating this version
+        memset(&cp, 0, sizeof(cp));
+        cp.version = version;
+        if (!mdb_get(txn, lmdb->m_properties, &ck, &v) && v.mv_size == sizeof(cp)) {
+            memcpy(&cp, v.mv_data, sizeof(cp));
+            if (cp.version != version) {
+                memset(&cp, 0, sizeof(cp));
+                cp.version = version;
+            }
+        }
+        if (cp.phase != phase) {
+            phase = cp.phase;
+            phase_start = cp.position;
+            start = g_get_monotonic_time();
+            g_info("Migrating from DB version %u, phase %u: %s", version, phase, lmdb_migrations[m].what);
+        }
+
+        if (!(result = lmdb_migrations[m].step(lmdb, txn, &cp, batch, &total, &done))) {
+            if (done) {
+                const uint32_t next = version + 1;
+                MDB_val nv = { sizeof(next), (void *)&next };
+                result = mdb_put(txn, lmdb->m_properties, &k, &nv, 0);
+                if (!result && (result = mdb_del(txn, lmdb->m_properties, &ck, NULL)) == MDB_NOTFOUND) {
+                    result = 0;
+                }
+            } else {
+                MDB_val cv = { sizeof(cp), &cp };
+                result = mdb_put(txn, lmdb->m_properties, &ck, &cv, 0);
+            }
+        }
+        if (result == MDB_MAP_FULL && !grown) {
+            // the checkpoint did not move: grow the map and do the chunk over, once
+            mdb_txn_abort(txn);
+            lmdb_do_resize(lmdb, 0);
+            grown = true;
+            continue;
+        }
+        if (result) {
+            g_info("Failed to migrate from DB version %u: %s", version, mdb_strerror(result));
+            mdb_txn_abort(txn);
+            return -2;
+        }
+        if ((result = mdb_txn_commit(txn))) {
+            if (result == MDB_MAP_FULL && !grown) {
+                lmdb_do_resize(lmdb, 0);
+                grown = true;
+                continue;
+            }
+            g_info("%s", lmdb_error("Failed to commit a migration chunk: ", result));
+            return -2;
+        }
+        grown = false;
+
+        // a step that finished its phase already moved the checkpoint to the next one
+        lmdb_migrate_progress progress;
+        const double secs = (g_get_monotonic_time() - start) / 1e6;
+        progress.version = version;
+        progress.phase = phase;
+        progress.done = done || cp.phase != phase ? total : cp.position;
+        progress.total = total;
+        progress.records_per_sec = secs > 0 ? (progress.done - phase_start) / secs : 0;
+        g_info("Migrating from DB version %u, phase %u: %llu/%llu records, %.1f records/s", version, phase,
+               (unsigned long long)progress.done, (unsigned long long)progress.total, progress.records_per_sec);
+        if (lmdb->m_migrate_progress && !lmdb->m_migrate_progress(&progress, lmdb->m_migrate_progress_user)) {
+            g_info("Migration stopped, it resumes at the next open");
+            return -3;
+        }
+    }
 }
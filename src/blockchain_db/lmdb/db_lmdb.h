@@ -6,13 +6,22 @@
 #include <lmdb.h>
 #include <glib.h>
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/event_feed.h"
+#include "blockchain_db/header_file.h"
+#include "blockchain_db/hf_versions.h"
+#include "blockchain_db/output_distribution.h"
+#include "common/threadpool.h"
 #include "cryptonote_config.h"
 #include "crypto/hash.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/difficulty.h"
 
 
 #define ENABLE_AUTO_RESIZE
 
+// how deep a reorg a replica follows without reloading everything
+#define LMDB_TIP_HASHES 64
+
 typedef struct mdb_txn_cursors
 {
   MDB_cursor *m_txc_blocks;
@@ -124,16 +133,125 @@ void mdb_txn_safe_abort(mdb_txn_safe* txn);
 void mdb_txn_safe_uncheck(mdb_txn_safe* txn);
 uint64_t mdb_txn_safe_num_active_tx();
 
-static void mdb_txn_safe_prevent_new_txns();
-static void mdb_txn_safe_wait_no_active_txns();
-static void mdb_txn_safe_allow_new_txns();
-
 static sig_atomic_t mdb_txn_safe_num_active_txns;
 // static std::atomic<uint64_t> num_active_txns;
 
 // could use a mutex here, but this should be sufficient.
 static sig_atomic_t mdb_txn_safe_creation_gate;
 // static std::atomic_flag creation_gate;
+/*
+ * What lmdb_pop_blocks removed: blocks [height, old_height) with their
+ * hashes, the hashes of their txs (miner txs included) and the key images
+ * those txs spent, each sorted.
+ */
+typedef struct lmdb_popped {
+  uint64_t height;
+  uint64_t old_height;
+  const hash* blocks;
+  size_t blocks_size;
+  const hash* txs;
+  size_t txs_size;
+  const key_image* key_images;
+  size_t key_images_size;
+} lmdb_popped;
+
+typedef void (*lmdb_pop_func)(const lmdb_popped* popped, void* user);
+
+/*
+ * Where a migration is, reported after every write txn of it: records of
+ * the current phase converted so far, out of total.
+ */
+typedef struct lmdb_migrate_progress {
+  uint32_t version;   // migrating from this version to the next
+  uint32_t phase;
+  uint64_t done;
+  uint64_t total;
+  double records_per_sec;
+} lmdb_migrate_progress;
+
+// false stops the migration: lmdb_open fails with -17 and the next open resumes it
+typedef bool (*lmdb_migrate_progress_func)(const lmdb_migrate_progress* progress, void* user);
+
+/*
+ * What lmdb_verify checked, and how many findings it had. first_bad_height
+ * is the lowest block a finding was at, UINT64_MAX if none was.
+ */
+typedef struct lmdb_verify_report {
+  uint64_t blocks;
+  uint64_t txs;
+  uint64_t outputs;
+  uint64_t key_images;
+  uint64_t errors;
+  uint64_t first_bad_height;
+} lmdb_verify_report;
+
+/*
+ * The reader table of the environment, which every process sharing it
+ * fills: slots held now (by idle threads and dead processes too), the most
+ * ever held, slots lmdb_check_readers cleared and read txns refused with
+ * MDB_READERS_FULL by this handle.
+ */
+typedef struct lmdb_reader_stats {
+  unsigned int max_readers;
+  unsigned int used;
+  unsigned int high_water;
+  uint64_t reaped;
+  uint64_t full;
+} lmdb_reader_stats;
+
+/*
+ * The top of the chain as of a commit: the number of blocks, the hash,
+ * cumulative difficulty and hard fork version of the top one (all zero
+ * for an empty chain), and the id of the write txn that made it so.
+ */
+typedef struct lmdb_tip {
+  uint64_t height;
+  hash top;
+  difficulty_type cumulative_difficulty;
+  uint8_t hf_version;
+  uint64_t commit;
+} lmdb_tip;
+
+/*
+ * Where the writer is, as a replica last saw it: its height and top block,
+ * and the lowest height whose block was added or replaced since the
+ * refresh before (height if none was). reorg is set when blocks the
+ * replica had were replaced.
+ */
+typedef struct lmdb_replica_tip {
+  uint64_t height;
+  hash top;
+  uint64_t changed_from;
+  bool reorg;
+} lmdb_replica_tip;
+
+/*
+ * How the map is read and written. Each profile picks the readahead hint
+ * on the map, for solid state and spinning disks apart, and the
+ * MDB_NOMEMINIT and MDB_WRITEMAP flags of the environment.
+ */
+typedef enum lmdb_io_profile {
+  LMDB_IO_DEFAULT,     // no readahead, as before there were profiles
+  LMDB_IO_SYNC,        // a sync from scratch: appends, and lookups of recent keys
+  LMDB_IO_SERVE,       // the random reads of an RPC server
+  LMDB_IO_LOW_MEMORY,  // as little of the map resident as can be
+  LMDB_IO_PROFILES
+} lmdb_io_profile;
+
+/*
+ * What read ahead did for lmdb_for_blocks_range_blobs: blocks read with it
+ * on, those the reader did not stall on, its stalls, as major faults looking
+ * a block up and pages of the tx blobs not in memory when handed to the
+ * callback, and the stalls taken off it, as major faults of the read ahead
+ * thread and pages it had read in the background.
+ */
+typedef struct lmdb_prefetch_stats {
+  uint64_t blocks;
+  uint64_t hits;
+  uint64_t stalls;
+  uint64_t stalls_avoided;
+} lmdb_prefetch_stats;
+
 //TODO refactor all data to pointer
 typedef struct BlockchainLMDB {
   BlockchainDB* db;
@@ -180,6 +298,72 @@ typedef struct BlockchainLMDB {
   //TODO thread safe
   mdb_threadinfo* m_tinfo;
 
+  // bi_cum_rct of every block, loaded at open
+  output_distribution m_rct_distribution;
+  // hf_versions, checked against the blocks at open
+  hf_version_map m_hf_version_map;
+
+  // plain mdb_put without MDB_APPEND or MDB_RESERVE in lmdb_add_block, a baseline for benchmarks
+  bool m_plain_puts;
+
+  // the map a new environment starts with, set before open, 0 for DEFAULT_MAPSIZE; it grows as the db does
+  uint64_t m_map_size;
+
+  // records per write txn when migrating, 0 for the default
+  size_t m_migrate_batch;
+  lmdb_migrate_progress_func m_migrate_progress;
+  void* m_migrate_progress_user;
+
+  // told once per pop, after the commit
+  lmdb_pop_func m_pop_notify;
+  void* m_pop_notify_user;
+  // bumped with __atomic builtins whenever blocks leave the chain: pops, replica reorgs and close
+  uint64_t m_generation;
+
+  // threads of the caller's own that read the db, on top of the shared pool's, for sizing the reader table
+  guint m_reader_threads;
+  // seconds between sweeps of the reader table for slots of dead processes, 0 for the default
+  guint m_reader_check_interval;
+  GThread* m_reader_reaper;
+  GMutex m_reaper_lock;
+  GCond m_reaper_cond;
+  bool m_reaper_stop;
+  // counted with __atomic builtins, they outlive gint on a long running node
+  uint64_t m_readers_reaped;
+  uint64_t m_readers_full;
+
+  // read txns hold it shared, moving the map takes it exclusive
+  GRWLock m_map_lock;
+
+  // opened with DBF_REPLICA
+  bool m_replica;
+  GMutex m_refresh_lock;
+  // the hashes of the top blocks the mirrors were loaded with, by height modulo LMDB_TIP_HASHES
+  hash m_tip_hashes[LMDB_TIP_HASHES];
+
+  // set before open, then changed with lmdb_set_io_profile
+  lmdb_io_profile m_io_profile;
+  // of the device the db is on, from sysfs at open: 1, 0, or -1 if unknown
+  int m_rotational;
+
+  // blocks lmdb_for_blocks_range_blobs reads ahead on a thread of its own, 0 for none
+  uint64_t m_prefetch_distance;
+  // blocks it reads in one snapshot before it renews its read txn, 0 for the default
+  uint64_t m_range_renew;
+  GMutex m_prefetch_lock;
+  lmdb_prefetch_stats m_prefetch_stats;
+
+  // blocks added and popped, published after their write txns commit
+  event_feed m_events;
+
+  // published after every commit that moves it, a seqlock: m_tip_seq is odd while m_tip is written
+  volatile gint m_tip_seq;
+  lmdb_tip m_tip;
+  GMutex m_tip_lock;
+
+  // a header_record per block next to data.mdb, checked against the db at open; left stale, not appended to, if it fails to keep up
+  header_file m_headers;
+
 } BlockchainLMDB;
 
 /*
@@ -206,6 +390,22 @@ bool lmdb_lock(BlockchainLMDB* lmdb);
 
 void lmdb_unlock(BlockchainLMDB* lmdb);
 
+/*
+ * The tip as of the last commit, without a read txn: a copy of the state
+ * the writer published after it, retried if the writer was publishing.
+ * Read txns opened after this returns see at least that commit.
+ */
+int lmdb_get_tip(BlockchainLMDB* lmdb, lmdb_tip *tip);
+
+/*
+ * Copies the headers of n blocks from height start to records, from the
+ * header file: no read txn and nothing parsed. Each copy is whole, retried
+ * if blocks were popped or added under it, though a pop right after it
+ * returns can make it stale. -2 if there is no header file, -3 if the
+ * range is not all in it.
+ */
+int lmdb_get_headers(BlockchainLMDB* lmdb, uint64_t start, uint64_t n, header_record *records);
+
 bool lmdb_block_exists(BlockchainLMDB* lmdb, const hash* h, uint64_t *height);
 
 int lmdb_get_block_height(BlockchainLMDB* lmdb, const hash* h, uint64_t* height);
@@ -216,7 +416,158 @@ int lmdb_get_block_header(BlockchainLMDB* lmdb, const hash* h, block_header* hea
 
 int lmdb_batch_abort(BlockchainLMDB* lmdb);
 
+/*
+ * Calls f for every block in [h1, h2] with its blob and the pruned blobs of
+ * its non-miner txs, in tx_hashes order. The blobs point into the map and
+ * stay valid until f returns: the read txn is renewed every few thousand
+ * blocks so a long scan does not hold off a resize or pin old pages, and
+ * -8 if blocks were popped in between. Stops early when f returns false.
+ * With m_prefetch_distance set, ranges longer than it are read ahead, see
+ * lmdb_get_prefetch_stats.
+ */
+typedef bool (*lmdb_block_blobs_func)(uint64_t height, const MDB_val *block, const MDB_val *txs, size_t txs_size, void *user);
+int lmdb_for_blocks_range_blobs(BlockchainLMDB* lmdb, uint64_t h1, uint64_t h2, lmdb_block_blobs_func f, void *user);
+
+void lmdb_get_prefetch_stats(BlockchainLMDB *lmdb, lmdb_prefetch_stats *stats);
+
+/*
+ * Resets w to the top of the chain from block_info: the timestamps and
+ * cumulative difficulties of the last w->capacity blocks, in one read txn.
+ * Afterwards the caller keeps w current with push/pop as blocks come and go.
+ */
+int lmdb_get_difficulty_window(BlockchainLMDB* lmdb, difficulty_window *w);
+
+/*
+ * Reads the output_data_t of n outputs in one read txn. The outputs should
+ * be sorted by amount then index: runs of consecutive indices are then read
+ * by stepping the cursor instead of searching. Pre-rct outputs get a zero
+ * commitment. -4 if an output does not exist.
+ */
+int lmdb_get_output_data(BlockchainLMDB* lmdb, const output_index_t *outputs, size_t n, output_data_t *data);
+
+/*
+ * The hard fork version of the block at height, from the in memory copy of
+ * hf_versions: no read txn. -2 if height is above the chain.
+ */
+int lmdb_get_hard_fork_version(BlockchainLMDB* lmdb, uint64_t height, uint8_t *version);
+
+/*
+ * Adds a block on top of the chain with its txs (the blobs of the non-miner
+ * txs, in tx_hashes order) in one write txn. Block heights, tx ids and
+ * output ids only grow, so those tables are written with MDB_APPEND or
+ * MDB_APPENDDUP, and blobs are copied straight into the map through
+ * MDB_RESERVE. coins_generated and cumulative_difficulty are the totals up
+ * to this block. -4 if the block does not parse, -5 if it is not on top of
+ * the chain, -6 if the txs are not the ones the block names, -7 if a write
+ * failed and -8 if a tx or key image is already in the db.
+ */
+int lmdb_add_block(BlockchainLMDB* lmdb, const MDB_val *blob, const MDB_val *txs, size_t txs_size, uint64_t weight,
+                   difficulty_type cumulative_difficulty, uint64_t coins_generated);
+
+/*
+ * The in memory mirrors of the chain (height indexes, filters, caches) learn
+ * about pops through a single callback, set here. The rct distribution is
+ * truncated by lmdb_pop_blocks itself.
+ */
+void lmdb_set_pop_notify(BlockchainLMDB* lmdb, lmdb_pop_func f, void* user);
+
+/*
+ * The chain generation, for caches that are not told about pops: it changes
+ * after every commit that removes blocks (a pop, a reorg a replica refresh
+ * finds, a close), so anything read at an older generation may be gone.
+ */
+uint64_t lmdb_get_generation(BlockchainLMDB* lmdb);
+
+/*
+ * Removes every block from height up, with their txs, outputs and key
+ * images, in one write txn. Each table is walked backwards from its tail
+ * with a cursor, and the records keyed by hash are deleted in sorted order,
+ * so no table sees random seeks. The pop notify callback is then called
+ * once. -3 if a write txn is active, -6 if height is above the chain, -7
+ * if the tables disagree about what to remove (nothing is removed then).
+ */
+int lmdb_pop_blocks(BlockchainLMDB* lmdb, uint64_t height);
+
+/*
+ * Checks that the tables agree with each other. The chain is cut into
+ * ranges of range_size heights (0 for a few per thread of pool, the shared
+ * pool if NULL), each checked on the pool in its own read txn: every block
+ * against m_block_info, m_block_heights and m_hf_versions, every tx it
+ * names against m_tx_indices, m_txs_pruned and m_tx_outputs, every output
+ * against m_output_amounts and m_output_txs, and bi_cum_rct against the rct
+ * outputs below it. The sizes of the tables are then compared with the
+ * records reached from the blocks. Findings are logged and counted in
+ * report: -4 if there were any, -2 if a range could not be read. The
+ * ranges must all see the snapshot the sizes were taken in: -5, and no
+ * findings, if a write txn committed before the last range started.
+ */
+int lmdb_verify(BlockchainLMDB* lmdb, threadpool *pool, uint64_t range_size, lmdb_verify_report *report);
+
+/*
+ * Walks a table with integer keys in nparts key ranges on pool (the shared
+ * pool if NULL), each range in its own read txn and cursor. f sees the
+ * records of a range in key order, dups included, with the state of its
+ * part: the part_size bytes at parts + index * part_size. A false from f
+ * stops that range only. Once every range is done, merge (if not NULL) is
+ * called for each part in key order, so results can be combined as if the
+ * table had been walked in one go. Ranges are split off the key span and
+ * may come out empty on sparse keys; the zerokval tables have a single key
+ * and are walked by one range. Each range sees its own snapshot. -4 if the
+ * table does not have integer keys, -5 if a range failed.
+ */
+typedef bool (*lmdb_record_func)(uint64_t key, const MDB_val *data, void *part);
+typedef void (*lmdb_part_merge_func)(size_t index, void *part, void *user);
+int lmdb_for_each_partitioned(BlockchainLMDB* lmdb, MDB_dbi dbi, threadpool *pool, void *parts, size_t part_size,
+                              size_t nparts, lmdb_record_func f, lmdb_part_merge_func merge, void *user);
+
+/*
+ * Clears the reader slots of processes that are gone, which would
+ * otherwise stay taken and pin the pages of their snapshot. Runs at open,
+ * every m_reader_check_interval seconds from a thread of the handle, and
+ * when a read txn finds the table full. The number of slots cleared, -1 on
+ * error.
+ */
+int lmdb_check_readers(BlockchainLMDB *lmdb);
+
+int lmdb_get_reader_stats(BlockchainLMDB *lmdb, lmdb_reader_stats *stats);
+
+/*
+ * Catches the in memory mirrors of a replica (the rct distribution and
+ * hf_versions) up with the writer. An unchanged tip costs one read of
+ * block_info. Blocks the writer added are loaded from the replica's height
+ * up; after a reorg the mirrors are cut back to the fork point first,
+ * which is found from the hashes of the top LMDB_TIP_HASHES blocks, and
+ * reloaded from scratch if it is deeper than that. Caches keyed by height
+ * drop their entries from tip->changed_from up. -3 if the db was not
+ * opened with DBF_REPLICA.
+ */
+int lmdb_replica_refresh(BlockchainLMDB* lmdb, lmdb_replica_tip *tip);
+
+// lmdb_set_io_profile: the caller reopens the db for MDB_WRITEMAP to follow the profile
+#define LMDB_IO_REOPEN 1
+
+/*
+ * Switches the I/O profile of an open db, e.g. from LMDB_IO_SYNC to
+ * LMDB_IO_SERVE once the initial sync is done. The readahead hint and
+ * MDB_NOMEMINIT change at once, MDB_WRITEMAP only at the next open. A
+ * writable map would outlive the switch to a profile without it, so that
+ * is -4 unless flags has LMDB_IO_REOPEN. Not to be called while a write
+ * txn is open. -2 if the flags could not be changed, -3 for an unknown
+ * profile.
+ */
+int lmdb_set_io_profile(BlockchainLMDB *lmdb, lmdb_io_profile profile, unsigned int flags);
+
+const char *lmdb_io_profile_name(lmdb_io_profile profile);
+
+bool lmdb_io_profile_from_name(const char *name, lmdb_io_profile *profile);
+
+/*
+ * The read txn of this thread, kept across calls and renewed, or the write
+ * txn when this thread has one. True when it is the read txn, which holds
+ * m_map_lock until lmdb_block_rtxn_stop resets it.
+ */
 bool lmdb_block_rtxn_start(BlockchainLMDB* lmdb, MDB_txn **mtxn, mdb_txn_cursors **mcur);
+void lmdb_block_rtxn_stop(BlockchainLMDB* lmdb);
 
 /*
  * LMDB PRIVATE METHOD
@@ -230,14 +581,14 @@ bool lmdb_need_resize(BlockchainLMDB *lmdb, uint64_t threshold_size);
 
 void lmdb_do_resize(BlockchainLMDB *lmdb, uint64_t increase_size);
 
-void lmdb_migrate(BlockchainLMDB *lmdb, const uint32_t oldversion);
-
-// migrate from DB version 0 to 1
-//void lmdb_migrate_0_1();
-// migrate from DB version 1 to 2
-//void lmdb_migrate_1_2();
-// migrate from DB version 2 to 3
-//void lmdb_migrate_2_3();
+/*
+ * Brings a database from oldversion up to VERSION, one version at a time.
+ * Each version is converted in write txns of m_migrate_batch records, with
+ * a checkpoint in m_properties committed alongside, so memory does not
+ * grow with the chain and a crash resumes from the last txn. There is no
+ * migration from version 0 (-1).
+ */
+int lmdb_migrate(BlockchainLMDB *lmdb, const uint32_t oldversion);
 
 
 #if defined(ENABLE_AUTO_RESIZE)
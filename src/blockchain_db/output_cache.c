@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "output_cache.h"
+
+#define NO_ENTRY UINT32_MAX
+
+typedef struct cache_entry {
+    output_index_t key;
+    output_data_t data;
+    // the LRU list, most recently used first
+    uint32_t prev;
+    uint32_t next;
+} cache_entry;
+
+struct output_cache {
+    GMutex lock;
+    GHashTable *map;        // &entry->key -> entry
+    cache_entry *entries;
+    size_t capacity;
+    size_t size;
+    uint32_t head;
+    uint32_t tail;
+    uint64_t generation;    // lmdb_get_generation when the entries were read
+    output_cache_stats stats;
+};
+
+// an output referenced by the batch, and where in the batch
+typedef struct batch_ref {
+    output_index_t key;
+    size_t pos;
+} batch_ref;
+
+static guint output_index_hash(gconstpointer p) {
+    const output_index_t *o = p;
+    return (guint)(((o->index ^ (o->amount * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL) >> 32);
+}
+
+static gboolean output_index_equal(gconstpointer a, gconstpointer b) {
+    const output_index_t *x = a, *y = b;
+    return x->amount == y->amount && x->index == y->index;
+}
+
+static int compare_batch_ref(const void *a, const void *b) {
+    const batch_ref *x = a, *y = b;
+    if (x->key.amount != y->key.amount) {
+        return x->key.amount < y->key.amount ? -1 : 1;
+    }
+    if (x->key.index != y->key.index) {
+        return x->key.index < y->key.index ? -1 : 1;
+    }
+    return 0;
+}
+
+output_cache *output_cache_new(size_t capacity) {
+    output_cache *c = g_new0(output_cache, 1);
+    g_mutex_init(&c->lock);
+    c->map = g_hash_table_new(output_index_hash, output_index_equal);
+    c->capacity = MIN(capacity, (size_t)NO_ENTRY);
+    c->entries = g_new(cache_entry, c->capacity);
+    c->head = c->tail = NO_ENTRY;
+    return c;
+}
+
+void output_cache_free(output_cache *c) {
+    g_hash_table_destroy(c->map);
+    g_free(c->entries);
+    g_mutex_clear(&c->lock);
+    g_free(c);
+}
+
+// with the lock held
+static void cache_reset(output_cache *c) {
+    g_hash_table_remove_all(c->map);
+    c->size = 0;
+    c->head = c->tail = NO_ENTRY;
+}
+
+void output_cache_clear(output_cache *c) {
+    g_mutex_lock(&c->lock);
+    cache_reset(c);
+    g_mutex_unlock(&c->lock);
+}
+
+static void lru_unlink(output_cache *c, uint32_t i) {
+    cache_entry *e = &c->entries[i];
+    if (e->prev != NO_ENTRY) {
+        c->entries[e->prev].next = e->next;
+    } else {
+        c->head = e->next;
+    }
+    if (e->next != NO_ENTRY) {
+        c->entries[e->next].prev = e->prev;
+    } else {
+        c->tail = e->prev;
+    }
+}
+
+static void lru_push_front(output_cache *c, uint32_t i) {
+    cache_entry *e = &c->entries[i];
+    e->prev = NO_ENTRY;
+    e->next = c->head;
+    if (c->head != NO_ENTRY) {
+        c->entries[c->head].prev = i;
+    } else {
+        c->tail = i;
+    }
+    c->head = i;
+}
+
+// with the lock held
+static bool cache_get(output_cache *c, const output_index_t *key, output_data_t *data) {
+    cache_entry *e = g_hash_table_lookup(c->map, key);
+    if (!e) {
+        return false;
+    }
+    const uint32_t i = (uint32_t)(e - c->entries);
+    if (c->head != i) {
+        lru_unlink(c, i);
+        lru_push_front(c, i);
+    }
+    *data = e->data;
+    return true;
+}
+
+// with the lock held
+static void cache_put(output_cache *c, const output_index_t *key, const output_data_t *data) {
+    uint32_t i;
+
+    if (c->capacity == 0 || g_hash_table_contains(c->map, key)) {
+        return;
+    }
+    if (c->size < c->capacity) {
+        i = (uint32_t)c->size++;
+    } else {
+        i = c->tail;
+        g_hash_table_remove(c->map, &c->entries[i].key);
+        lru_unlink(c, i);
+    }
+    c->entries[i].key = *key;
+    c->entries[i].data = *data;
+    g_hash_table_insert(c->map, &c->entries[i].key, &c->entries[i]);
+    lru_push_front(c, i);
+}
+
+int output_cache_resolve(output_cache *c, BlockchainLMDB *lmdb, const output_index_t *outputs, size_t n, output_data_t *data) {
+    const uint64_t generation = lmdb_get_generation(lmdb);
+    batch_ref *refs;
+    GArray *misses, *miss_refs;
+    output_data_t *miss_data = NULL;
+    size_t unique = 0, hits = 0;
+    int ret = 0;
+
+    if (n == 0) {
+        return 0;
+    }
+    refs = g_new(batch_ref, n);
+    for (size_t i = 0; i < n; i++) {
+        refs[i].key = outputs[i];
+        refs[i].pos = i;
+    }
+    qsort(refs, n, sizeof(batch_ref), compare_batch_ref);
+
+    // the first ref of every run of equal outputs stands for the run
+    misses = g_array_new(FALSE, FALSE, sizeof(output_index_t));
+    miss_refs = g_array_new(FALSE, FALSE, sizeof(size_t));
+    g_mutex_lock(&c->lock);
+    if (c->generation != generation) {
+        cache_reset(c);
+        c->generation = generation;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && compare_batch_ref(&refs[i - 1], &refs[i]) == 0) {
+            continue;
+        }
+        unique++;
+        if (cache_get(c, &refs[i].key, &data[refs[i].pos])) {
+            hits++;
+        } else {
+            g_array_append_val(misses, refs[i].key);
+            g_array_append_val(miss_refs, i);
+        }
+    }
+    g_mutex_unlock(&c->lock);
+
+    if (misses->len > 0) {
+        miss_data = g_new(output_data_t, misses->len);
+        ret = lmdb_get_output_data(lmdb, (const output_index_t *)misses->data, misses->len, miss_data);
+    }
+    if (ret == 0) {
+        // a read that raced a pop may have seen the popped outputs, keep it out of the cache
+        const bool current = lmdb_get_generation(lmdb) == generation;
+        g_mutex_lock(&c->lock);
+        for (guint j = 0; j < misses->len; j++) {
+            const batch_ref *r = &refs[g_array_index(miss_refs, size_t, j)];
+            if (current && c->generation == generation) {
+                cache_put(c, &r->key, &miss_data[j]);
+            }
+            data[r->pos] = miss_data[j];
+        }
+        g_mutex_unlock(&c->lock);
+        for (size_t i = 1, first = 0; i < n; i++) {
+            if (compare_batch_ref(&refs[first], &refs[i]) == 0) {
+                data[refs[i].pos] = data[refs[first].pos];
+            } else {
+                first = i;
+            }
+        }
+    }
+
+    g_mutex_lock(&c->lock);
+    c->stats.lookups += n;
+    c->stats.unique += unique;
+    c->stats.hits += hits;
+    c->stats.misses += misses->len;
+    g_mutex_unlock(&c->lock);
+
+    g_free(miss_data);
+    g_array_free(miss_refs, TRUE);
+    g_array_free(misses, TRUE);
+    g_free(refs);
+    return ret;
+}
+
+int output_cache_resolve_inputs(output_cache *c, BlockchainLMDB *lmdb, txin_to_key_soa *ins, output_data_t *data) {
+    const size_t n = ins->key_offsets_begin[ins->size];
+    output_index_t *outputs;
+    int ret;
+
+    if (!txin_to_key_soa_absolute_offsets(ins)) {
+        g_info("Key offsets overflow");
+        return -5;
+    }
+    outputs = g_new(output_index_t, n);
+    for (size_t k = 0; k < ins->size; k++) {
+        for (size_t j = ins->key_offsets_begin[k]; j < ins->key_offsets_begin[k + 1]; j++) {
+            outputs[j].amount = ins->amount[k];
+            outputs[j].index = ins->key_offsets[j];
+        }
+    }
+    ret = output_cache_resolve(c, lmdb, outputs, n, data);
+    g_free(outputs);
+    return ret;
+}
+
+void output_cache_get_stats(output_cache *c, output_cache_stats *stats) {
+    g_mutex_lock(&c->lock);
+    *stats = c->stats;
+    g_mutex_unlock(&c->lock);
+}
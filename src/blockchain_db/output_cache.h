@@ -0,0 +1,48 @@
+#ifndef MONERO_BLOCKCHAIN_DB_OUTPUT_CACHE_H_
+#define MONERO_BLOCKCHAIN_DB_OUTPUT_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+#include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+
+/*
+ * Resolves ring members to their output_data_t for verification and the
+ * wallet. The outputs a batch references are sorted and deduplicated, so a
+ * decoy used by many inputs of a block is looked up once; hits come from a
+ * bounded LRU cache keyed by (amount, index) shared between threads, and
+ * the misses are read from m_output_amounts in one sorted batch.
+ *
+ * Outputs never change once written, but popped blocks take theirs away
+ * and the blocks added in their place reuse the indices. The entries are
+ * stamped with the lmdb chain generation they were read at, and a batch
+ * that finds the generation moved drops them all first.
+ */
+typedef struct output_cache output_cache;
+
+typedef struct output_cache_stats {
+    uint64_t lookups;   // outputs asked for
+    uint64_t unique;    // of them after deduplication
+    uint64_t hits;
+    uint64_t misses;    // read from the db
+} output_cache_stats;
+
+output_cache *output_cache_new(size_t capacity);
+void output_cache_free(output_cache *c);
+void output_cache_clear(output_cache *c);
+
+// fills data[i] for every outputs[i], in any order and with duplicates
+int output_cache_resolve(output_cache *c, BlockchainLMDB *lmdb, const output_index_t *outputs, size_t n, output_data_t *data);
+
+/*
+ * Resolves every ring member of a batch of inputs, converting their key
+ * offsets to absolute indices in place first. data needs
+ * ins->key_offsets_begin[ins->size] entries, in key_offsets order.
+ */
+int output_cache_resolve_inputs(output_cache *c, BlockchainLMDB *lmdb, txin_to_key_soa *ins, output_data_t *data);
+
+void output_cache_get_stats(output_cache *c, output_cache_stats *stats);
+
+#endif //MONERO_BLOCKCHAIN_DB_OUTPUT_CACHE_H_
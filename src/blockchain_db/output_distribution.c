@@ -0,0 +1,141 @@
+#include <string.h>
+#include "common/varint.h"
+#include "output_distribution.h"
+
+void output_distribution_init(output_distribution *d) {
+    g_rw_lock_init(&d->lock);
+    d->cumulative = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+}
+
+void output_distribution_clear(output_distribution *d) {
+    g_array_free(d->cumulative, TRUE);
+    d->cumulative = NULL;
+    g_rw_lock_clear(&d->lock);
+}
+
+void output_distribution_reset(output_distribution *d) {
+    g_rw_lock_writer_lock(&d->lock);
+    g_array_set_size(d->cumulative, 0);
+    g_rw_lock_writer_unlock(&d->lock);
+}
+
+void output_distribution_push(output_distribution *d, uint64_t cum_rct) {
+    g_rw_lock_writer_lock(&d->lock);
+    g_array_append_val(d->cumulative, cum_rct);
+    g_rw_lock_writer_unlock(&d->lock);
+}
+
+bool output_distribution_pop(output_distribution *d) {
+    bool ret = false;
+    g_rw_lock_writer_lock(&d->lock);
+    if (d->cumulative->len > 0) {
+        g_array_set_size(d->cumulative, d->cumulative->len - 1);
+        ret = true;
+    }
+    g_rw_lock_writer_unlock(&d->lock);
+    return ret;
+}
+
+bool output_distribution_truncate(output_distribution *d, uint64_t height) {
+    bool ret = false;
+    g_rw_lock_writer_lock(&d->lock);
+    if (height <= d->cumulative->len) {
+        g_array_set_size(d->cumulative, height);
+        ret = true;
+    }
+    g_rw_lock_writer_unlock(&d->lock);
+    return ret;
+}
+
+uint64_t output_distribution_height(output_distribution *d) {
+    uint64_t height;
+    g_rw_lock_reader_lock(&d->lock);
+    height = d->cumulative->len;
+    g_rw_lock_reader_unlock(&d->lock);
+    return height;
+}
+
+// with the lock held
+static inline uint64_t cumulative_before(const output_distribution *d, uint64_t height) {
+    return height == 0 ? 0 : g_array_index(d->cumulative, uint64_t, height - 1);
+}
+
+static inline bool valid_range(const output_distribution *d, uint64_t from, uint64_t to) {
+    return from <= to && to < d->cumulative->len;
+}
+
+bool output_distribution_count(output_distribution *d, uint64_t from, uint64_t to, uint64_t *count) {
+    bool ret;
+    g_rw_lock_reader_lock(&d->lock);
+    ret = valid_range(d, from, to);
+    if (ret) {
+        *count = g_array_index(d->cumulative, uint64_t, to) - cumulative_before(d, from);
+    }
+    g_rw_lock_reader_unlock(&d->lock);
+    return ret;
+}
+
+bool output_distribution_get(output_distribution *d, uint64_t from, uint64_t to, bool cumulative, uint64_t *out, uint64_t *base) {
+    bool ret;
+    g_rw_lock_reader_lock(&d->lock);
+    ret = valid_range(d, from, to);
+    if (ret) {
+        const uint64_t *cum = &g_array_index(d->cumulative, uint64_t, 0);
+        *base = cumulative_before(d, from);
+        memcpy(out, cum + from, (to - from + 1) * sizeof(uint64_t));
+        if (!cumulative) {
+            for (uint64_t h = to; h > from; h--) {
+                out[h - from] -= cum[h - 1];
+            }
+            out[0] -= *base;
+        }
+    }
+    g_rw_lock_reader_unlock(&d->lock);
+    return ret;
+}
+
+static void put_varint(GByteArray *b, uint64_t v) {
+    uint8_t buf[VARINT_MAX_SIZE];
+    g_byte_array_append(b, buf, write_varint(buf, v));
+}
+
+bool output_distribution_encode(output_distribution *d, uint64_t from, uint64_t to, GByteArray *out) {
+    bool ret;
+    g_rw_lock_reader_lock(&d->lock);
+    ret = valid_range(d, from, to);
+    if (ret) {
+        uint64_t prev = cumulative_before(d, from);
+        put_varint(out, prev);
+        put_varint(out, to - from + 1);
+        for (uint64_t h = from; h <= to; h++) {
+            const uint64_t cum = g_array_index(d->cumulative, uint64_t, h);
+            put_varint(out, cum - prev);
+            prev = cum;
+        }
+    }
+    g_rw_lock_reader_unlock(&d->lock);
+    return ret;
+}
+
+bool output_distribution_decode(const uint8_t *data, size_t size, GArray *cumulative) {
+    const uint8_t *pos = data, *end = data + size;
+    uint64_t total, n, count;
+    int len;
+
+    if ((len = read_varint(pos, end, &total)) < 0) {
+        return false;
+    }
+    pos += len;
+    if ((len = read_varint(pos, end, &n)) < 0 || n > (uint64_t)(end - pos)) {
+        return false;
+    }
+    pos += len;
+    for (uint64_t i = 0; i < n; i++) {
+        if ((len = read_varint(pos, end, &count)) < 0 || __builtin_add_overflow(total, count, &total)) {
+            return false;
+        }
+        pos += len;
+        g_array_append_val(cumulative, total);
+    }
+    return pos == end;
+}
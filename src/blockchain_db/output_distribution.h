@@ -0,0 +1,50 @@
+#ifndef MONERO_BLOCKCHAIN_DB_OUTPUT_DISTRIBUTION_H_
+#define MONERO_BLOCKCHAIN_DB_OUTPUT_DISTRIBUTION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * The rct output distribution kept in memory: for every height, the number
+ * of rct outputs created up to and including that block (bi_cum_rct). It is
+ * loaded from block_info when the db opens and follows blocks as they are
+ * added and popped, so queries never touch the db. Readers and the writer
+ * may run on different threads.
+ */
+typedef struct output_distribution {
+    GRWLock lock;
+    GArray *cumulative;     // uint64_t per height
+} output_distribution;
+
+void output_distribution_init(output_distribution *d);
+void output_distribution_clear(output_distribution *d);
+// forget every height, as when the db is reset
+void output_distribution_reset(output_distribution *d);
+
+void output_distribution_push(output_distribution *d, uint64_t cum_rct);
+bool output_distribution_pop(output_distribution *d);
+// drop every height from height up, false if there are fewer
+bool output_distribution_truncate(output_distribution *d, uint64_t height);
+uint64_t output_distribution_height(output_distribution *d);
+
+// rct outputs created from height from to height to, inclusive, in O(1)
+bool output_distribution_count(output_distribution *d, uint64_t from, uint64_t to, uint64_t *count);
+
+/*
+ * Per height counts of heights from to to into out (to - from + 1 entries),
+ * or cumulative totals when cumulative is set. base is the cumulative total
+ * before from.
+ */
+bool output_distribution_get(output_distribution *d, uint64_t from, uint64_t to, bool cumulative, uint64_t *out, uint64_t *base);
+
+/*
+ * The same range as varints, for the wire: base, the number of heights,
+ * then the per height counts, which are small. decode appends the
+ * cumulative totals to a uint64_t array.
+ */
+bool output_distribution_encode(output_distribution *d, uint64_t from, uint64_t to, GByteArray *out);
+bool output_distribution_decode(const uint8_t *data, size_t size, GArray *cumulative);
+
+#endif //MONERO_BLOCKCHAIN_DB_OUTPUT_DISTRIBUTION_H_
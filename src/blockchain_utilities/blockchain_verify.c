@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "common/threadpool.h"
+
+/*
+ * blockchain_verify [--threads N] [--range BLOCKS] [--salvage] <data dir>
+ *
+ * Opens the database read only and checks that its tables agree with each
+ * other, see lmdb_verify. Exits with 0 if they do, 1 if they do not and 2
+ * if the check could not run.
+ */
+
+static void usage(void) {
+    fprintf(stderr, "usage: blockchain_verify [--threads N] [--range BLOCKS] [--salvage] <data dir>\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = NULL;
+    guint threads = 0;
+    uint64_t range_size = 0;
+    int flags = DBF_RDONLY;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (guint)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--range") == 0 && i + 1 < argc) {
+            range_size = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--salvage") == 0) {
+            flags |= DBF_SALVAGE;
+        } else if (argv[i][0] != '-' && !dir) {
+            dir = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!dir) {
+        usage();
+        return 2;
+    }
+
+    // lmdb_open takes the directory's parent from its path
+    char *path = realpath(dir, NULL);
+    if (!path) {
+        fprintf(stderr, "No database in %s\n", dir);
+        return 2;
+    }
+    BlockchainLMDB *lmdb = g_new0(BlockchainLMDB, 1);
+    lmdb->db = g_new0(BlockchainDB, 1);
+    // a pool of its own reads on top of the shared one's slots
+    lmdb->m_reader_threads = threads;
+    int result = lmdb_open(lmdb, path, flags);
+    free(path);
+    if (result != 0) {
+        fprintf(stderr, "Failed to open the database in %s: %d\n", dir, result);
+        return 2;
+    }
+
+    threadpool *pool = threads ? threadpool_new(threads) : threadpool_get_instance();
+    lmdb_verify_report report;
+    gint64 start = g_get_monotonic_time();
+    result = lmdb_verify(lmdb, pool, range_size, &report);
+    double seconds = (g_get_monotonic_time() - start) / 1e6;
+
+    printf("%llu blocks, %llu txs, %llu outputs, %llu key images checked in %.1f s on %u threads\n",
+           (unsigned long long)report.blocks, (unsigned long long)report.txs, (unsigned long long)report.outputs,
+           (unsigned long long)report.key_images, seconds, threadpool_get_max_concurrency(pool));
+    if (result == 0) {
+        printf("no errors found\n");
+    } else if (result == -4) {
+        printf("%llu error(s) found", (unsigned long long)report.errors);
+        if (report.first_bad_height != UINT64_MAX) {
+            printf(", the first at block %llu", (unsigned long long)report.first_bad_height);
+        }
+        printf("\n");
+    } else {
+        fprintf(stderr, "Failed to verify the database: %d\n", result);
+    }
+
+    if (threads) {
+        threadpool_free(pool);
+    }
+    lmdb_close(lmdb);
+    g_free(lmdb->db);
+    g_free(lmdb);
+    return result == 0 ? 0 : result == -4 ? 1 : 2;
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define MAGIC 0xaa0817161500ff84
+// what reset memory is filled with in debug builds
+#define POISON 0xdd
+
+struct arena_chunk {
+    arena_chunk *next;
+    size_t size;
+#ifndef NDEBUG
+    uint64_t magic;
+#endif
+    max_align_t data[];
+};
+
+#ifndef NDEBUG
+// only the debug checks abort
+static void local_abort(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    abort();
+}
+#endif
+
+static arena_chunk *arena_chunk_new(size_t size) {
+    arena_chunk *c = g_malloc(sizeof(arena_chunk) + size);
+    c->next = NULL;
+    c->size = size;
+#ifndef NDEBUG
+    c->magic = MAGIC;
+#endif
+    return c;
+}
+
+static inline void arena_chunk_check(arena_chunk *c) {
+#ifndef NDEBUG
+    if (c->magic != MAGIC) {
+        local_abort("arena: corrupted chunk header");
+    }
+#else
+    (void)c;
+#endif
+}
+
+static void arena_chunks_free(arena_chunk *c) {
+    while (c) {
+        arena_chunk *next = c->next;
+        arena_chunk_check(c);
+        g_free(c);
+        c = next;
+    }
+}
+
+static void arena_use(arena *a, arena_chunk *c) {
+    a->current = c;
+    a->pos = (uint8_t *)c->data;
+    a->end = a->pos + c->size;
+}
+
+void arena_init(arena *a, size_t chunk_size) {
+    a->chunk_size = chunk_size;
+    a->first = arena_chunk_new(chunk_size);
+    a->large = NULL;
+    arena_use(a, a->first);
+}
+
+void arena_clear(arena *a) {
+    arena_chunks_free(a->large);
+    arena_chunks_free(a->first);
+    a->first = a->current = a->large = NULL;
+    a->pos = a->end = NULL;
+}
+
+void arena_reset(arena *a) {
+#ifndef NDEBUG
+    // anything still pointing into the arena now reads garbage
+    for (arena_chunk *c = a->first; c; c = c->next) {
+        arena_chunk_check(c);
+        memset(c->data, POISON, c == a->current ? (size_t)(a->pos - (uint8_t *)c->data) : c->size);
+        if (c == a->current) {
+            break;
+        }
+    }
+#endif
+    arena_chunks_free(a->large);
+    a->large = NULL;
+    arena_use(a, a->first);
+}
+
+void *arena_alloc(arena *a, size_t size, size_t align) {
+#ifndef NDEBUG
+    if (!align || (align & (align - 1))) {
+        local_abort("arena_alloc: alignment is not a power of 2");
+    }
+#endif
+    uint8_t *p = (uint8_t *)(((uintptr_t)a->pos + align - 1) & ~(uintptr_t)(align - 1));
+
+    if (p <= a->end && size <= (size_t)(a->end - p)) {
+        a->pos = p + size;
+        return p;
+    }
+    // big blocks get a chunk of their own so they do not waste the current one
+    if (size + align > a->chunk_size / 4) {
+        arena_chunk *c = arena_chunk_new(size + align);
+        c->next = a->large;
+        a->large = c;
+        return (void *)(((uintptr_t)c->data + align - 1) & ~(uintptr_t)(align - 1));
+    }
+    if (!a->current->next) {
+        a->current->next = arena_chunk_new(a->chunk_size);
+    }
+    arena_use(a, a->current->next);
+    return arena_alloc(a, size, align);
+}
@@ -0,0 +1,37 @@
+#ifndef MONERO_COMMON_ARENA_H_
+#define MONERO_COMMON_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * A bump allocator for data that dies together, such as everything parsed
+ * from one block. Allocations are never freed one by one: arena_reset()
+ * releases them all at once and keeps the chunks for reuse.
+ *
+ * Without NDEBUG chunk headers are checked and reset memory is poisoned.
+ */
+typedef struct arena_chunk arena_chunk;
+
+typedef struct arena {
+    arena_chunk *first;   // chunks of chunk_size, reused across resets
+    arena_chunk *current;
+    arena_chunk *large;   // allocations too big for a chunk, freed on reset
+    uint8_t *pos;
+    uint8_t *end;
+    size_t chunk_size;
+} arena;
+
+void arena_init(arena *a, size_t chunk_size);
+// frees everything, including the chunks
+void arena_clear(arena *a);
+// frees every allocation at once
+void arena_reset(arena *a);
+
+// size bytes aligned to align (a power of 2); never NULL
+void *arena_alloc(arena *a, size_t size, size_t align);
+
+#define arena_new(a, type, n) ((type *)arena_alloc((a), sizeof(type) * (n), G_ALIGNOF(type)))
+
+#endif //MONERO_COMMON_ARENA_H_
@@ -1,3 +1,5 @@
+#include <stdio.h>
+#include <sys/sysmacros.h>
 #include "file_util.h"
 
 bool is_dir_exists(char* filename) {
@@ -33,3 +35,31 @@ long get_available_space(const char* path) {
     // the available size is f_bsize * f_bavail
     return stat.f_bsize * stat.f_bavail;
 }
+
+static int read_rotational(const char* queue) {
+    FILE *f = fopen(queue, "r");
+    int c;
+    if (f == NULL) {
+        return -1;
+    }
+    c = fgetc(f);
+    fclose(f);
+    return c == '0' || c == '1' ? c - '0' : -1;
+}
+
+int is_rotational(const char* path) {
+    struct stat sb;
+    char queue[96];
+    int result;
+
+    if (stat(path, &sb) != 0) {
+        return -1;
+    }
+    snprintf(queue, sizeof(queue), "/sys/dev/block/%u:%u/queue/rotational", major(sb.st_dev), minor(sb.st_dev));
+    if ((result = read_rotational(queue)) >= 0) {
+        return result;
+    }
+    // a partition has no queue of its own, the disk it is on does
+    snprintf(queue, sizeof(queue), "/sys/dev/block/%u:%u/../queue/rotational", major(sb.st_dev), minor(sb.st_dev));
+    return read_rotational(queue);
+}
@@ -12,4 +12,7 @@ bool is_file_exists(char* filename);
 
 long get_available_space(const char* path);
 
+// 1 if the device holding path spins, 0 if not, -1 if sysfs does not say
+int is_rotational(const char* path);
+
 #endif //MONERO_COMMON_FILE_UTIL_H_
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "slab.h"
+
+#define SLAB_SIZE (64 * 1024)
+// objects a thread keeps per pool, and moves at once to or from the pool
+#define SLAB_CACHE_SIZE 64
+#define SLAB_BATCH (SLAB_CACHE_SIZE / 2)
+
+#define MAGIC_FREED 0xaa0817161500ff83
+
+typedef struct slab_object {
+    struct slab_object *next;
+#ifndef NDEBUG
+    uint64_t magic;
+#endif
+} slab_object;
+
+struct slab_pool {
+    GMutex lock;
+    slab_object *free;   // guarded by lock
+    GSList *slabs;
+    size_t object_size;
+    guint id;
+    guint generation;    // of the id when the pool took it
+};
+
+// free objects of one pool held by one thread
+typedef struct slab_cache {
+    slab_pool *pool;
+    guint generation;
+    guint count;
+    void *objects[SLAB_CACHE_SIZE];
+} slab_cache;
+
+static slab_pool *pools[SLAB_MAX_POOLS];
+/*
+ * Bumped when the pool with the id is freed. A new pool may take both the
+ * id and the address of a freed one, the generation tells their caches
+ * apart.
+ */
+static guint pool_generations[SLAB_MAX_POOLS];
+static GMutex pools_lock;
+
+static void slab_caches_flush(gpointer data);
+static GPrivate thread_caches = G_PRIVATE_INIT(slab_caches_flush);
+
+static void local_abort(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+#ifdef NDEBUG
+    _exit(1);
+#else
+    abort();
+#endif
+}
+
+static inline void mark_freed(void *p) {
+#ifndef NDEBUG
+    slab_object *o = p;
+    if (o->magic == MAGIC_FREED) {
+        local_abort("slab_free: double free");
+    }
+    o->magic = MAGIC_FREED;
+#else
+    (void)p;
+#endif
+}
+
+static inline void mark_allocated(void *p) {
+#ifndef NDEBUG
+    ((slab_object *)p)->magic = 0;
+#else
+    (void)p;
+#endif
+}
+
+slab_pool *slab_pool_new(size_t object_size) {
+    slab_pool *pool = g_new0(slab_pool, 1);
+
+    g_mutex_init(&pool->lock);
+    pool->object_size = MAX((object_size + 15) & ~(size_t)15, sizeof(slab_object));
+    g_mutex_lock(&pools_lock);
+    for (pool->id = 0; pool->id < SLAB_MAX_POOLS && pools[pool->id]; pool->id++) {
+    }
+    if (pool->id == SLAB_MAX_POOLS) {
+        g_mutex_unlock(&pools_lock);
+        local_abort("slab_pool_new: too many pools");
+    }
+    pools[pool->id] = pool;
+    pool->generation = pool_generations[pool->id];
+    g_mutex_unlock(&pools_lock);
+    return pool;
+}
+
+void slab_pool_free(slab_pool *pool) {
+    slab_cache *caches = g_private_get(&thread_caches);
+
+    // the calling thread's cache may still hold objects of the pool
+    if (caches && caches[pool->id].pool == pool) {
+        caches[pool->id].pool = NULL;
+        caches[pool->id].count = 0;
+    }
+    g_mutex_lock(&pools_lock);
+    pools[pool->id] = NULL;
+    pool_generations[pool->id]++;
+    g_mutex_unlock(&pools_lock);
+    g_slist_free_full(pool->slabs, g_free);
+    g_mutex_clear(&pool->lock);
+    g_free(pool);
+}
+
+size_t slab_pool_get_size(slab_pool *pool) {
+    size_t n;
+    g_mutex_lock(&pool->lock);
+    n = g_slist_length(pool->slabs) * (size_t)SLAB_SIZE;
+    g_mutex_unlock(&pool->lock);
+    return n;
+}
+
+// moves up to SLAB_BATCH objects from the pool to the cache, carving a new
+// slab when the pool is empty
+static void slab_cache_refill(slab_cache *cache) {
+    slab_pool *pool = cache->pool;
+
+    g_mutex_lock(&pool->lock);
+    if (!pool->free) {
+        uint8_t *slab = g_malloc(SLAB_SIZE);
+        const size_t n = SLAB_SIZE / pool->object_size;
+        pool->slabs = g_slist_prepend(pool->slabs, slab);
+        for (size_t i = n; i-- > 0; ) {
+            slab_object *o = (slab_object *)(slab + i * pool->object_size);
+            o->next = pool->free;
+#ifndef NDEBUG
+            o->magic = MAGIC_FREED;
+#endif
+            pool->free = o;
+        }
+    }
+    while (cache->count < SLAB_BATCH && pool->free) {
+        slab_object *o = pool->free;
+        pool->free = o->next;
+        cache->objects[cache->count++] = o;
+    }
+    g_mutex_unlock(&pool->lock);
+}
+
+// gives count objects from the top of the cache back to the pool
+static void slab_cache_drain(slab_cache *cache, guint count) {
+    slab_pool *pool = cache->pool;
+
+    g_mutex_lock(&pool->lock);
+    while (count-- > 0) {
+        slab_object *o = cache->objects[--cache->count];
+        o->next = pool->free;
+        pool->free = o;
+    }
+    g_mutex_unlock(&pool->lock);
+}
+
+// at thread exit, returns the cached objects of the pools still alive
+static void slab_caches_flush(gpointer data) {
+    slab_cache *caches = data;
+    g_mutex_lock(&pools_lock);
+    for (guint i = 0; i < SLAB_MAX_POOLS; i++) {
+        if (caches[i].pool && caches[i].pool == pools[i] && caches[i].generation == pools[i]->generation
+            && caches[i].count) {
+            slab_cache_drain(&caches[i], caches[i].count);
+        }
+    }
+    g_mutex_unlock(&pools_lock);
+    g_free(caches);
+}
+
+static inline slab_cache *slab_get_cache(slab_pool *pool) {
+    slab_cache *caches = g_private_get(&thread_caches);
+    if (G_UNLIKELY(!caches)) {
+        caches = g_new0(slab_cache, SLAB_MAX_POOLS);
+        g_private_set(&thread_caches, caches);
+    }
+    // a pool reusing the id, or the id and address, of a freed one starts with an empty cache
+    if (G_UNLIKELY(caches[pool->id].pool != pool || caches[pool->id].generation != pool->generation)) {
+        caches[pool->id].pool = pool;
+        caches[pool->id].generation = pool->generation;
+        caches[pool->id].count = 0;
+    }
+    return &caches[pool->id];
+}
+
+void *slab_alloc(slab_pool *pool) {
+    slab_cache *cache = slab_get_cache(pool);
+    void *p;
+
+    if (G_UNLIKELY(cache->count == 0)) {
+        slab_cache_refill(cache);
+    }
+    p = cache->objects[--cache->count];
+    mark_allocated(p);
+    return p;
+}
+
+void slab_free(slab_pool *pool, void *p) {
+    slab_cache *cache = slab_get_cache(pool);
+
+    if (!p) {
+        return;
+    }
+    mark_freed(p);
+    if (G_UNLIKELY(cache->count == SLAB_CACHE_SIZE)) {
+        slab_cache_drain(cache, SLAB_BATCH);
+    }
+    cache->objects[cache->count++] = p;
+}
+
+slab_pool *slab_pool_32(void) {
+    static gsize pool = 0;
+    if (g_once_init_enter(&pool)) {
+        g_once_init_leave(&pool, (gsize)slab_pool_new(32));
+    }
+    return (slab_pool *)pool;
+}
+
+slab_pool *slab_pool_64(void) {
+    static gsize pool = 0;
+    if (g_once_init_enter(&pool)) {
+        g_once_init_leave(&pool, (gsize)slab_pool_new(64));
+    }
+    return (slab_pool *)pool;
+}
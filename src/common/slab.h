@@ -0,0 +1,34 @@
+#ifndef MONERO_COMMON_SLAB_H_
+#define MONERO_COMMON_SLAB_H_
+
+#include <stddef.h>
+#include <glib.h>
+
+/*
+ * Pools of fixed size objects carved from large slabs. Every thread keeps
+ * a small cache of free objects per pool and only takes the pool lock to
+ * move a batch of them in or out, so allocation is lock free in the common
+ * case. Memory goes back to the system when the pool is freed.
+ *
+ * Without NDEBUG freed objects are marked and a double free aborts.
+ */
+typedef struct slab_pool slab_pool;
+
+#define SLAB_MAX_POOLS 16
+
+// object_size is rounded up to a multiple of 16
+slab_pool *slab_pool_new(size_t object_size);
+// every object must have been freed, and no thread may use the pool anymore
+void slab_pool_free(slab_pool *pool);
+
+void *slab_alloc(slab_pool *pool);
+void slab_free(slab_pool *pool, void *p);
+
+// bytes held in slabs, allocated or not
+size_t slab_pool_get_size(slab_pool *pool);
+
+// process-wide pools for 32 byte keys, hashes and points, and 64 byte ctkeys
+slab_pool *slab_pool_32(void);
+slab_pool *slab_pool_64(void);
+
+#endif //MONERO_COMMON_SLAB_H_
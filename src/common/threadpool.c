@@ -0,0 +1,232 @@
+#include "threadpool.h"
+
+typedef struct tpool_entry {
+    tpool_waiter *waiter;
+    tpool_job fn;
+    gpointer data;
+} tpool_entry;
+
+/*
+ * Every worker owns a deque. It pushes and pops its own jobs at the tail, so
+ * nested jobs run depth first while they are hot in cache, and idle workers
+ * steal from the head of the others.
+ */
+typedef struct tpool_worker {
+    GMutex lock;
+    GQueue deque;
+    threadpool *pool;
+    GThread *thread;
+} tpool_worker;
+
+struct threadpool {
+    GMutex mutex;       // guards sleeping workers
+    GCond has_work;
+    gint pending;       // jobs queued in any deque
+    gint next;          // round robin for jobs from outside the pool
+    gint steals;
+    tpool_worker *workers;
+    guint max;
+    bool running;
+};
+
+static GPrivate current_worker;
+
+static void tpool_waiter_inc(tpool_waiter *waiter) {
+    g_mutex_lock(&waiter->mt);
+    waiter->num++;
+    g_mutex_unlock(&waiter->mt);
+}
+
+static void tpool_waiter_dec(tpool_waiter *waiter) {
+    g_mutex_lock(&waiter->mt);
+    if (--waiter->num == 0) {
+        g_cond_broadcast(&waiter->cv);
+    }
+    g_mutex_unlock(&waiter->mt);
+}
+
+static void threadpool_run_entry(tpool_entry *e) {
+    e->fn(e->data);
+    if (e->waiter) {
+        tpool_waiter_dec(e->waiter);
+    }
+    g_free(e);
+}
+
+static tpool_worker *threadpool_self(threadpool *pool) {
+    tpool_worker *self = g_private_get(&current_worker);
+    return self && self->pool == pool ? self : NULL;
+}
+
+static tpool_entry *threadpool_take(threadpool *pool, tpool_worker *self) {
+    tpool_entry *e = NULL;
+    guint start = 0;
+
+    if (g_atomic_int_get(&pool->pending) == 0) {
+        return NULL;
+    }
+    if (self) {
+        g_mutex_lock(&self->lock);
+        e = g_queue_pop_tail(&self->deque);
+        g_mutex_unlock(&self->lock);
+        start = self - pool->workers;
+    }
+    for (guint k = 0; !e && k < pool->max; k++) {
+        tpool_worker *victim = &pool->workers[(start + k) % pool->max];
+        if (victim == self) {
+            continue;
+        }
+        g_mutex_lock(&victim->lock);
+        e = g_queue_pop_head(&victim->deque);
+        g_mutex_unlock(&victim->lock);
+        if (e && self) {
+            g_atomic_int_inc(&pool->steals);
+        }
+    }
+    if (e) {
+        g_atomic_int_add(&pool->pending, -1);
+    }
+    return e;
+}
+
+static gpointer threadpool_worker(gpointer arg) {
+    tpool_worker *self = arg;
+    threadpool *pool = self->pool;
+
+    g_private_set(&current_worker, self);
+    for (;;) {
+        tpool_entry *e = threadpool_take(pool, self);
+        if (e) {
+            threadpool_run_entry(e);
+            continue;
+        }
+        g_mutex_lock(&pool->mutex);
+        while (pool->running && g_atomic_int_get(&pool->pending) == 0) {
+            g_cond_wait(&pool->has_work, &pool->mutex);
+        }
+        if (!pool->running && g_atomic_int_get(&pool->pending) == 0) {
+            g_mutex_unlock(&pool->mutex);
+            break;
+        }
+        g_mutex_unlock(&pool->mutex);
+    }
+    return NULL;
+}
+
+threadpool *threadpool_new(guint max_threads) {
+    threadpool *pool = g_new0(threadpool, 1);
+    if (max_threads == 0) {
+        max_threads = g_get_num_processors();
+    }
+    g_mutex_init(&pool->mutex);
+    g_cond_init(&pool->has_work);
+    pool->max = max_threads;
+    pool->running = true;
+    pool->workers = g_new0(tpool_worker, max_threads);
+    for (guint i = 0; i < max_threads; i++) {
+        g_mutex_init(&pool->workers[i].lock);
+        g_queue_init(&pool->workers[i].deque);
+        pool->workers[i].pool = pool;
+    }
+    for (guint i = 0; i < max_threads; i++) {
+        pool->workers[i].thread = g_thread_new("tpool", threadpool_worker, &pool->workers[i]);
+    }
+    return pool;
+}
+
+void threadpool_free(threadpool *pool) {
+    if (!pool) {
+        return;
+    }
+    g_mutex_lock(&pool->mutex);
+    pool->running = false;
+    g_cond_broadcast(&pool->has_work);
+    g_mutex_unlock(&pool->mutex);
+    for (guint i = 0; i < pool->max; i++) {
+        g_thread_join(pool->workers[i].thread);
+    }
+    for (guint i = 0; i < pool->max; i++) {
+        g_queue_clear(&pool->workers[i].deque);
+        g_mutex_clear(&pool->workers[i].lock);
+    }
+    g_free(pool->workers);
+    g_cond_clear(&pool->has_work);
+    g_mutex_clear(&pool->mutex);
+    g_free(pool);
+}
+
+threadpool *threadpool_get_instance(void) {
+    static gsize instance = 0;
+    if (g_once_init_enter(&instance)) {
+        g_once_init_leave(&instance, (gsize)threadpool_new(0));
+    }
+    return (threadpool *)instance;
+}
+
+guint threadpool_get_max_concurrency(const threadpool *pool) {
+    return pool->max;
+}
+
+guint threadpool_get_steals(threadpool *pool) {
+    return (guint)g_atomic_int_get(&pool->steals);
+}
+
+void tpool_waiter_init(tpool_waiter *waiter) {
+    g_mutex_init(&waiter->mt);
+    g_cond_init(&waiter->cv);
+    waiter->num = 0;
+}
+
+void tpool_waiter_clear(tpool_waiter *waiter) {
+    g_cond_clear(&waiter->cv);
+    g_mutex_clear(&waiter->mt);
+}
+
+void threadpool_submit(threadpool *pool, tpool_waiter *waiter, tpool_job fn, gpointer data) {
+    tpool_entry *e = g_new(tpool_entry, 1);
+    tpool_worker *w = threadpool_self(pool);
+
+    e->waiter = waiter;
+    e->fn = fn;
+    e->data = data;
+    if (waiter) {
+        tpool_waiter_inc(waiter);
+    }
+    if (!w) {
+        w = &pool->workers[(guint)g_atomic_int_add(&pool->next, 1) % pool->max];
+    }
+    g_mutex_lock(&w->lock);
+    g_queue_push_tail(&w->deque, e);
+    g_mutex_unlock(&w->lock);
+    g_atomic_int_inc(&pool->pending);
+
+    g_mutex_lock(&pool->mutex);
+    g_cond_signal(&pool->has_work);
+    g_mutex_unlock(&pool->mutex);
+}
+
+void threadpool_wait(threadpool *pool, tpool_waiter *waiter) {
+    tpool_worker *self = threadpool_self(pool);
+    for (;;) {
+        g_mutex_lock(&waiter->mt);
+        const bool done = waiter->num == 0;
+        g_mutex_unlock(&waiter->mt);
+        if (done) {
+            return;
+        }
+
+        tpool_entry *e = threadpool_take(pool, self);
+        if (e) {
+            threadpool_run_entry(e);
+            continue;
+        }
+
+        // everything left is already running on a worker
+        g_mutex_lock(&waiter->mt);
+        while (waiter->num > 0) {
+            g_cond_wait(&waiter->cv, &waiter->mt);
+        }
+        g_mutex_unlock(&waiter->mt);
+        return;
+    }
+}
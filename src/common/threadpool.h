@@ -0,0 +1,41 @@
+#ifndef MONERO_COMMON_THREADPOOL_H_
+#define MONERO_COMMON_THREADPOOL_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+/*
+ * A work-stealing pool of worker threads for verification work.
+ *
+ * Jobs are grouped by a waiter; threadpool_wait() runs queued jobs on the
+ * calling thread while it waits, so a job may submit and wait on nested
+ * jobs without starving the pool.
+ */
+typedef struct threadpool threadpool;
+
+typedef struct tpool_waiter {
+    GMutex mt;
+    GCond cv;
+    gint num;
+} tpool_waiter;
+
+typedef void (*tpool_job)(gpointer data);
+
+// max_threads == 0 uses one worker per core
+threadpool *threadpool_new(guint max_threads);
+void threadpool_free(threadpool *pool);
+// shared process-wide pool, created on first use
+threadpool *threadpool_get_instance(void);
+guint threadpool_get_max_concurrency(const threadpool *pool);
+// number of jobs a worker took from another worker's deque
+guint threadpool_get_steals(threadpool *pool);
+
+void tpool_waiter_init(tpool_waiter *waiter);
+void tpool_waiter_clear(tpool_waiter *waiter);
+
+// run fn(data) on the pool, accounted to waiter (may be NULL)
+void threadpool_submit(threadpool *pool, tpool_waiter *waiter, tpool_job fn, gpointer data);
+// block until every job of waiter is done, helping with queued jobs meanwhile
+void threadpool_wait(threadpool *pool, tpool_waiter *waiter);
+
+#endif //MONERO_COMMON_THREADPOOL_H_
@@ -0,0 +1,53 @@
+#ifndef MONERO_COMMON_VARINT_H_
+#define MONERO_COMMON_VARINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Variable length integers: 7 bits per byte, least significant group first,
+ * the high bit set on every byte but the last.
+ */
+
+#define VARINT_MAX_SIZE 10
+
+// the integer is too large for 64 bits
+#define EVARINT_OVERFLOW -1
+// the integer has a non canonical encoding (a trailing zero group)
+#define EVARINT_REPRESENT -2
+// the buffer ends inside the integer
+#define EVARINT_TRUNCATED -3
+
+// writes v to dest, which must hold VARINT_MAX_SIZE bytes; returns the size
+static inline size_t write_varint(uint8_t *dest, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        dest[n++] = (uint8_t)(v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    dest[n++] = (uint8_t)v;
+    return n;
+}
+
+// reads from [begin, end) into v; returns the bytes consumed or an EVARINT_ error
+static inline int read_varint(const uint8_t *begin, const uint8_t *end, uint64_t *v) {
+    uint64_t read = 0;
+    int shift = 0;
+    for (const uint8_t *p = begin; p < end; p++, shift += 7) {
+        const uint8_t byte = *p;
+        if (shift > 63 || (shift == 63 && byte > 1)) {
+            return EVARINT_OVERFLOW;
+        }
+        if (byte == 0 && shift != 0) {
+            return EVARINT_REPRESENT;
+        }
+        read |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *v = read;
+            return (int)(p - begin) + 1;
+        }
+    }
+    return EVARINT_TRUNCATED;
+}
+
+#endif //MONERO_COMMON_VARINT_H_
@@ -0,0 +1,995 @@
+// Field, group and scalar arithmetic for ed25519, following the ref10 layout
+// used by Monero's crypto-ops.c but with radix 2^51 field elements.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crypto-ops.h"
+
+typedef unsigned __int128 uint128_t;
+
+#define MASK51 ((uint64_t)0x7ffffffffffff)
+
+static inline uint64_t load_8(const unsigned char *in) {
+  uint64_t r = 0;
+  for (int i = 7; i >= 0; i--) {
+    r = (r << 8) | in[i];
+  }
+  return r;
+}
+
+static inline void store_8(unsigned char *out, uint64_t v) {
+  for (int i = 0; i < 8; i++) {
+    out[i] = (unsigned char)(v >> (8 * i));
+  }
+}
+
+/* From fe_*.c */
+
+const fe fe_d = { 0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029, 0x739c663a03cbb, 0x52036cee2b6ff }; /* d */
+const fe fe_d2 = { 0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977, 0x2406d9dc56dff }; /* 2 * d */
+const fe fe_sqrtm1 = { 0x61b274a0ea0b0, 0x0d5a5fc8f189d, 0x7ef5e9cbd0c60, 0x78595a6804c9e, 0x2b8324804fc1d }; /* sqrt(-1) */
+
+static const fe fe_ma2 = { 0x7ffc8db3de3c9, 0x7ffffffffffff, 0x7ffffffffffff, 0x7ffffffffffff, 0x7ffffffffffff }; /* -A^2 */
+static const fe fe_ma = { 0x7fffffff892e7, 0x7ffffffffffff, 0x7ffffffffffff, 0x7ffffffffffff, 0x7ffffffffffff }; /* -A */
+static const fe fe_fffb1 = { 0x0968acde3bdff, 0x2e8dab18e5bab, 0x0139870b9afed, 0x2746fab1d645f, 0x018e04102529e }; /* sqrt(-2 * A * (A + 2)) */
+static const fe fe_fffb2 = { 0x19b7c9f83650d, 0x73f75210405a4, 0x7a68106b887f2, 0x184b715d7241f, 0x32f9e1f5fba5d }; /* sqrt(2 * A * (A + 2)) */
+static const fe fe_fffb3 = { 0x37d8717302c66, 0x1d4b2c8452b03, 0x4368bb50093fd, 0x477dc4aa3201f, 0x674a110d14c20 }; /* sqrt(-sqrt(-1) * A * (A + 2)) */
+static const fe fe_fffb4 = { 0x2e6fc494c6e67, 0x6ebd816b6cf58, 0x422f34446e40f, 0x2036c9f85bbc0, 0x65bc0cfcef982 }; /* sqrt(sqrt(-1) * A * (A + 2)) */
+
+void fe_0(fe h) {
+  h[0] = h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+void fe_1(fe h) {
+  h[0] = 1;
+  h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+void fe_copy(fe h, const fe f) {
+  memmove(h, f, sizeof(fe));
+}
+
+static inline void fe_carry(fe h) {
+  uint64_t c;
+  c = h[0] >> 51; h[0] &= MASK51; h[1] += c;
+  c = h[1] >> 51; h[1] &= MASK51; h[2] += c;
+  c = h[2] >> 51; h[2] &= MASK51; h[3] += c;
+  c = h[3] >> 51; h[3] &= MASK51; h[4] += c;
+  c = h[4] >> 51; h[4] &= MASK51; h[0] += 19 * c;
+}
+
+void fe_add(fe h, const fe f, const fe g) {
+  for (int i = 0; i < 5; i++) {
+    h[i] = f[i] + g[i];
+  }
+  fe_carry(h);
+}
+
+/* 4 * p, large enough for any carried limb of g */
+void fe_sub(fe h, const fe f, const fe g) {
+  h[0] = f[0] + 0x1fffffffffffb4 - g[0];
+  h[1] = f[1] + 0x1ffffffffffffc - g[1];
+  h[2] = f[2] + 0x1ffffffffffffc - g[2];
+  h[3] = f[3] + 0x1ffffffffffffc - g[3];
+  h[4] = f[4] + 0x1ffffffffffffc - g[4];
+  fe_carry(h);
+}
+
+void fe_neg(fe h, const fe f) {
+  fe zero;
+  fe_0(zero);
+  fe_sub(h, zero, f);
+}
+
+void fe_mul(fe h, const fe f, const fe g) {
+  const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  const uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+  uint128_t r0, r1, r2, r3, r4, t;
+
+  r0 = (uint128_t)f0 * g0 + (uint128_t)f1 * g4_19 + (uint128_t)f2 * g3_19 + (uint128_t)f3 * g2_19 + (uint128_t)f4 * g1_19;
+  r1 = (uint128_t)f0 * g1 + (uint128_t)f1 * g0 + (uint128_t)f2 * g4_19 + (uint128_t)f3 * g3_19 + (uint128_t)f4 * g2_19;
+  r2 = (uint128_t)f0 * g2 + (uint128_t)f1 * g1 + (uint128_t)f2 * g0 + (uint128_t)f3 * g4_19 + (uint128_t)f4 * g3_19;
+  r3 = (uint128_t)f0 * g3 + (uint128_t)f1 * g2 + (uint128_t)f2 * g1 + (uint128_t)f3 * g0 + (uint128_t)f4 * g4_19;
+  r4 = (uint128_t)f0 * g4 + (uint128_t)f1 * g3 + (uint128_t)f2 * g2 + (uint128_t)f3 * g1 + (uint128_t)f4 * g0;
+
+  r1 += r0 >> 51; h[0] = (uint64_t)r0 & MASK51;
+  r2 += r1 >> 51; h[1] = (uint64_t)r1 & MASK51;
+  r3 += r2 >> 51; h[2] = (uint64_t)r2 & MASK51;
+  r4 += r3 >> 51; h[3] = (uint64_t)r3 & MASK51;
+  h[4] = (uint64_t)r4 & MASK51;
+  t = (uint128_t)h[0] + (r4 >> 51) * 19;
+  h[0] = (uint64_t)t & MASK51;
+  h[1] += (uint64_t)(t >> 51);
+}
+
+void fe_sq(fe h, const fe f) {
+  const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+  const uint64_t f1_38 = 38 * f1, f2_38 = 38 * f2, f3_38 = 38 * f3;
+  const uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+  uint128_t r0, r1, r2, r3, r4, t;
+
+  r0 = (uint128_t)f0 * f0 + (uint128_t)f1_38 * f4 + (uint128_t)f2_38 * f3;
+  r1 = (uint128_t)f0_2 * f1 + (uint128_t)f2_38 * f4 + (uint128_t)f3_19 * f3;
+  r2 = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1 + (uint128_t)f3_38 * f4;
+  r3 = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2 + (uint128_t)f4_19 * f4;
+  r4 = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3 + (uint128_t)f2 * f2;
+
+  r1 += r0 >> 51; h[0] = (uint64_t)r0 & MASK51;
+  r2 += r1 >> 51; h[1] = (uint64_t)r1 & MASK51;
+  r3 += r2 >> 51; h[2] = (uint64_t)r2 & MASK51;
+  r4 += r3 >> 51; h[3] = (uint64_t)r3 & MASK51;
+  h[4] = (uint64_t)r4 & MASK51;
+  t = (uint128_t)h[0] + (r4 >> 51) * 19;
+  h[0] = (uint64_t)t & MASK51;
+  h[1] += (uint64_t)(t >> 51);
+}
+
+static void fe_sq2(fe h, const fe f) {
+  fe_sq(h, f);
+  fe_add(h, h, h);
+}
+
+static void fe_sqn(fe h, const fe f, int n) {
+  fe_sq(h, f);
+  for (int i = 1; i < n; i++) {
+    fe_sq(h, h);
+  }
+}
+
+/* z^(2^250 - 1), and z^11 on the side */
+static void fe_pow2_250_1(fe out, fe z11, const fe z) {
+  fe t0, t1, t2;
+
+  fe_sq(t0, z);             /* z^2 */
+  fe_sqn(t1, t0, 2);        /* z^8 */
+  fe_mul(t1, z, t1);        /* z^9 */
+  fe_mul(z11, t0, t1);      /* z^11 */
+  fe_sq(t0, z11);           /* z^22 */
+  fe_mul(t0, t1, t0);       /* z^(2^5 - 1) */
+  fe_sqn(t1, t0, 5);
+  fe_mul(t0, t1, t0);       /* z^(2^10 - 1) */
+  fe_sqn(t1, t0, 10);
+  fe_mul(t1, t1, t0);       /* z^(2^20 - 1) */
+  fe_sqn(t2, t1, 20);
+  fe_mul(t1, t2, t1);       /* z^(2^40 - 1) */
+  fe_sqn(t1, t1, 10);
+  fe_mul(t0, t1, t0);       /* z^(2^50 - 1) */
+  fe_sqn(t1, t0, 50);
+  fe_mul(t1, t1, t0);       /* z^(2^100 - 1) */
+  fe_sqn(t2, t1, 100);
+  fe_mul(t1, t2, t1);       /* z^(2^200 - 1) */
+  fe_sqn(t1, t1, 50);
+  fe_mul(out, t1, t0);      /* z^(2^250 - 1) */
+}
+
+void fe_invert(fe out, const fe z) {
+  fe t, z11;
+  fe_pow2_250_1(t, z11, z);
+  fe_sqn(t, t, 5);          /* z^(2^255 - 32) */
+  fe_mul(out, t, z11);      /* z^(2^255 - 21) */
+}
+
+void fe_pow22523(fe out, const fe z) {
+  fe t, z11;
+  fe_pow2_250_1(t, z11, z);
+  fe_sqn(t, t, 2);          /* z^(2^252 - 4) */
+  fe_mul(out, t, z);        /* z^(2^252 - 3) */
+}
+
+/* (u / v)^(m + 1) where m = (p - 5) / 8 */
+static void fe_divpowm1(fe r, const fe u, const fe v) {
+  fe v3, uv7, t0;
+
+  fe_sq(v3, v);
+  fe_mul(v3, v3, v);        /* v^3 */
+  fe_sq(uv7, v3);
+  fe_mul(uv7, uv7, v);
+  fe_mul(uv7, uv7, u);      /* u * v^7 */
+  fe_pow22523(t0, uv7);
+  fe_mul(t0, t0, v3);
+  fe_mul(r, t0, u);         /* u * v^3 * (u * v^7)^m */
+}
+
+void fe_frombytes(fe h, const unsigned char *s) {
+  h[0] = load_8(s) & MASK51;
+  h[1] = (load_8(s + 6) >> 3) & MASK51;
+  h[2] = (load_8(s + 12) >> 6) & MASK51;
+  h[3] = (load_8(s + 19) >> 1) & MASK51;
+  h[4] = (load_8(s + 24) >> 12) & MASK51;
+}
+
+void fe_tobytes(unsigned char *s, const fe h) {
+  uint64_t t[5];
+  uint64_t q;
+
+  memcpy(t, h, sizeof(t));
+  fe_carry(t);
+  fe_carry(t);
+
+  /* t < 2p here; q = 1 iff t >= p */
+  q = (t[0] + 19) >> 51;
+  q = (t[1] + q) >> 51;
+  q = (t[2] + q) >> 51;
+  q = (t[3] + q) >> 51;
+  q = (t[4] + q) >> 51;
+
+  t[0] += 19 * q;
+  t[1] += t[0] >> 51; t[0] &= MASK51;
+  t[2] += t[1] >> 51; t[1] &= MASK51;
+  t[3] += t[2] >> 51; t[2] &= MASK51;
+  t[4] += t[3] >> 51; t[3] &= MASK51;
+  t[4] &= MASK51;
+
+  store_8(s, t[0] | (t[1] << 51));
+  store_8(s + 8, (t[1] >> 13) | (t[2] << 38));
+  store_8(s + 16, (t[2] >> 26) | (t[3] << 25));
+  store_8(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+int fe_isnegative(const fe f) {
+  unsigned char s[32];
+  fe_tobytes(s, f);
+  return s[0] & 1;
+}
+
+int fe_isnonzero(const fe f) {
+  unsigned char s[32];
+  unsigned char r = 0;
+  fe_tobytes(s, f);
+  for (int i = 0; i < 32; i++) {
+    r |= s[i];
+  }
+  return r != 0;
+}
+
+void fe_batch_invert(fe *out, const fe *in, size_t n) {
+  fe acc, tmp;
+  fe *prefix;
+
+  if (n == 0) {
+    return;
+  }
+  prefix = malloc(n * sizeof(fe));
+  if (!prefix) {
+    abort();
+  }
+  fe_1(acc);
+  for (size_t i = 0; i < n; i++) {
+    fe_copy(prefix[i], acc);
+    fe_mul(acc, acc, in[i]);
+  }
+  fe_invert(acc, acc);
+  for (size_t i = n; i-- > 0; ) {
+    fe_mul(tmp, acc, prefix[i]);
+    fe_mul(acc, acc, in[i]);
+    fe_copy(out[i], tmp);
+  }
+  free(prefix);
+}
+
+/* From ge_*.c */
+
+const unsigned char ge_base_bytes[32] = {
+  0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+  0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+};
+
+static const ge_p3 ge_base_p3 = {
+  { 0x62d608f25d51a, 0x412a4b4f6592a, 0x75b7171a4b31d, 0x1ff60527118fe, 0x216936d3cd6e5 },
+  { 0x6666666666658, 0x4cccccccccccc, 0x1999999999999, 0x3333333333333, 0x6666666666666 },
+  { 1, 0, 0, 0, 0 },
+  { 0x68ab3a5b7dda3, 0x00eea2a5eadbb, 0x2af8df483c27e, 0x332b375274732, 0x67875f0fd78b7 }
+};
+
+/* G, 3G, 5G, ..., 15G */
+static const ge_dsmp ge_base_dsmp = {
+  { { 0x493c6f58c3b85, 0x0df7181c325f7, 0x0f50b0b3e4cb7, 0x5329385a44c32, 0x07cf9d3a33d4b },
+    { 0x03905d740913e, 0x0ba2817d673a2, 0x23e2827f4e67c, 0x133d2e0c21a34, 0x44fd2f9298f81 },
+    { 1, 0, 0, 0, 0 },
+    { 0x11205877aaa68, 0x479955893d579, 0x50d66309b67a0, 0x2d42d0dbee5ee, 0x6f117b689f0c6 } },
+  { { 0x5b0a84cee9730, 0x61d10c97155e4, 0x4059cc8096a10, 0x47a608da8014f, 0x7a164e1b9a80f },
+    { 0x11fe8a4fcd265, 0x7bcb8374faacc, 0x52f5af4ef4d4f, 0x5314098f98d10, 0x2ab91587555bd },
+    { 1, 0, 0, 0, 0 },
+    { 0x6933f0dd0d889, 0x44386bb4c4295, 0x3cb6d3162508c, 0x26368b872a2c6, 0x5a2826af12b9b } },
+  { { 0x2bc4408a5bb33, 0x078ebdda05442, 0x2ffb112354123, 0x375ee8df5862d, 0x2945ccf146e20 },
+    { 0x182c3a447d6ba, 0x22964e536eff2, 0x192821f540053, 0x2f9f19e788e5c, 0x154a7e73eb1b5 },
+    { 1, 0, 0, 0, 0 },
+    { 0x3dbf1812a8285, 0x0fa17ba3f9797, 0x6f69cb49c3820, 0x34d5a0db3858d, 0x43aabe696b3bb } },
+  { { 0x25cd0944ea3bf, 0x75673b81a4d63, 0x150b925d1c0d4, 0x13f38d9294114, 0x461bea69283c9 },
+    { 0x72c9aaa3221b1, 0x267774474f74d, 0x064b0e9b28085, 0x3f04ef53b27c9, 0x1d6edd5d2e531 },
+    { 1, 0, 0, 0, 0 },
+    { 0x36dc801b8b3a2, 0x0e0a7d4935e30, 0x1deb7cecc0d7d, 0x053a94e20dd2c, 0x7a9fbb1c6a0f9 } },
+  { { 0x6678aa6a8632f, 0x5ea3788d8b365, 0x21bd6d6994279, 0x7ace75919e4e3, 0x34b9ed338add7 },
+    { 0x6217e039d8064, 0x6dea408337e6d, 0x57ac112628206, 0x647cb65e30473, 0x49c05a51fadc9 },
+    { 1, 0, 0, 0, 0 },
+    { 0x4e8bf9045af1b, 0x514e33a45e0d6, 0x7533c5b8bfe0f, 0x583557b7e14c9, 0x73c172021b008 } },
+  { { 0x700848a802ade, 0x1e04605c4e5f7, 0x5c0d01b9767fb, 0x7d7889f42388b, 0x4275aae2546d8 },
+    { 0x75b0249864348, 0x52ee11070262b, 0x237ae54fb5acd, 0x3bfd1d03aaab5, 0x18ab598029d5c },
+    { 1, 0, 0, 0, 0 },
+    { 0x32cc5fd6089e9, 0x426505c949b05, 0x46a18880c7ad2, 0x4a4221888ccda, 0x3dc65522b53df } },
+  { { 0x0c222a2007f6d, 0x356b79bdb77ee, 0x41ee81efe12ce, 0x120a9bd07097d, 0x234fd7eec346f },
+    { 0x7013b327fbf93, 0x1336eeded6a0d, 0x2b565a2bbf3af, 0x253ce89591955, 0x0267882d17602 },
+    { 1, 0, 0, 0, 0 },
+    { 0x0a119732ea378, 0x63bf1ba8e2a6c, 0x69f94cc90df9a, 0x431d1779bfc48, 0x497ba6fdaa097 } },
+  { { 0x6cc0313cfeaa0, 0x1a313848da499, 0x7cb534219230a, 0x39596dedefd60, 0x61e22917f12de },
+    { 0x3cd86468ccf0b, 0x48553221ac081, 0x6c9464b4e0a6e, 0x75fba84180403, 0x43b5cd4218d05 },
+    { 1, 0, 0, 0, 0 },
+    { 0x2762f9bd0b516, 0x1c6e7fbddcbb3, 0x75909c3ace2bd, 0x42101972d3ec9, 0x511d61210ae4d } }
+};
+
+const ge_p3 *ge_base(void) {
+  return &ge_base_p3;
+}
+
+const ge_cached *ge_base_precomp(void) {
+  return ge_base_dsmp;
+}
+
+void ge_p3_0(ge_p3 *h) {
+  fe_0(h->X);
+  fe_1(h->Y);
+  fe_1(h->Z);
+  fe_0(h->T);
+}
+
+static void ge_p2_0(ge_p2 *h) {
+  fe_0(h->X);
+  fe_1(h->Y);
+  fe_1(h->Z);
+}
+
+void ge_tobytes(unsigned char *s, const ge_p2 *h) {
+  fe recip, x, y;
+
+  fe_invert(recip, h->Z);
+  fe_mul(x, h->X, recip);
+  fe_mul(y, h->Y, recip);
+  fe_tobytes(s, y);
+  s[31] ^= fe_isnegative(x) << 7;
+}
+
+void ge_p3_tobytes(unsigned char *s, const ge_p3 *h) {
+  fe recip, x, y;
+
+  fe_invert(recip, h->Z);
+  fe_mul(x, h->X, recip);
+  fe_mul(y, h->Y, recip);
+  fe_tobytes(s, y);
+  s[31] ^= fe_isnegative(x) << 7;
+}
+
+#define GE_BATCH_TOBYTES(name, type) \
+void name(unsigned char *s, const type *p, size_t n) { \
+  fe *z, x, y; \
+  if (n == 0) { \
+    return; \
+  } \
+  z = malloc(n * sizeof(fe)); \
+  if (!z) { \
+    abort(); \
+  } \
+  for (size_t i = 0; i < n; i++) { \
+    fe_copy(z[i], p[i].Z); \
+  } \
+  fe_batch_invert(z, z, n); \
+  for (size_t i = 0; i < n; i++) { \
+    fe_mul(x, p[i].X, z[i]); \
+    fe_mul(y, p[i].Y, z[i]); \
+    fe_tobytes(s + 32 * i, y); \
+    s[32 * i + 31] ^= fe_isnegative(x) << 7; \
+  } \
+  free(z); \
+}
+
+GE_BATCH_TOBYTES(ge_p3_batch_tobytes, ge_p3)
+GE_BATCH_TOBYTES(ge_p2_batch_tobytes, ge_p2)
+
+int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
+  fe u, v, vxx, check;
+  unsigned char canon[32];
+
+  fe_frombytes(h->Y, s);
+  /* Validate the number to be canonical */
+  fe_tobytes(canon, h->Y);
+  if (memcmp(canon, s, 31) != 0 || canon[31] != (s[31] & 0x7f)) {
+    return -1;
+  }
+  fe_1(h->Z);
+  fe_sq(u, h->Y);
+  fe_mul(v, u, fe_d);
+  fe_sub(u, u, h->Z);       /* u = y^2 - 1 */
+  fe_add(v, v, h->Z);       /* v = dy^2 + 1 */
+
+  fe_divpowm1(h->X, u, v);  /* x = uv^3(uv^7)^((q-5)/8) */
+
+  fe_sq(vxx, h->X);
+  fe_mul(vxx, vxx, v);
+  fe_sub(check, vxx, u);    /* vx^2 - u */
+  if (fe_isnonzero(check)) {
+    fe_add(check, vxx, u);  /* vx^2 + u */
+    if (fe_isnonzero(check)) {
+      return -1;
+    }
+    fe_mul(h->X, h->X, fe_sqrtm1);
+  }
+
+  if (fe_isnegative(h->X) != (s[31] >> 7)) {
+    /* If x = 0, the sign must be positive */
+    if (!fe_isnonzero(h->X)) {
+      return -1;
+    }
+    fe_neg(h->X, h->X);
+  }
+
+  fe_mul(h->T, h->X, h->Y);
+  return 0;
+}
+
+void ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
+  fe_add(r->YplusX, p->Y, p->X);
+  fe_sub(r->YminusX, p->Y, p->X);
+  fe_copy(r->Z, p->Z);
+  fe_mul(r->T2d, p->T, fe_d2);
+}
+
+void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p) {
+  fe_copy(r->X, p->X);
+  fe_copy(r->Y, p->Y);
+  fe_copy(r->Z, p->Z);
+}
+
+void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p) {
+  fe_mul(r->X, p->X, p->T);
+  fe_mul(r->Y, p->Y, p->Z);
+  fe_mul(r->Z, p->Z, p->T);
+}
+
+void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p) {
+  fe_mul(r->X, p->X, p->T);
+  fe_mul(r->Y, p->Y, p->Z);
+  fe_mul(r->Z, p->Z, p->T);
+  fe_mul(r->T, p->X, p->Y);
+}
+
+void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
+  fe t0;
+  fe_add(r->X, p->Y, p->X);
+  fe_sub(r->Y, p->Y, p->X);
+  fe_mul(r->Z, r->X, q->YplusX);
+  fe_mul(r->Y, r->Y, q->YminusX);
+  fe_mul(r->T, q->T2d, p->T);
+  fe_mul(r->X, p->Z, q->Z);
+  fe_add(t0, r->X, r->X);
+  fe_sub(r->X, r->Z, r->Y);
+  fe_add(r->Y, r->Z, r->Y);
+  fe_add(r->Z, t0, r->T);
+  fe_sub(r->T, t0, r->T);
+}
+
+void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
+  fe t0;
+  fe_add(r->X, p->Y, p->X);
+  fe_sub(r->Y, p->Y, p->X);
+  fe_mul(r->Z, r->X, q->YminusX);
+  fe_mul(r->Y, r->Y, q->YplusX);
+  fe_mul(r->T, q->T2d, p->T);
+  fe_mul(r->X, p->Z, q->Z);
+  fe_add(t0, r->X, r->X);
+  fe_sub(r->X, r->Z, r->Y);
+  fe_add(r->Y, r->Z, r->Y);
+  fe_sub(r->Z, t0, r->T);
+  fe_add(r->T, t0, r->T);
+}
+
+void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p) {
+  fe t0;
+  fe_sq(r->X, p->X);
+  fe_sq(r->Z, p->Y);
+  fe_sq2(r->T, p->Z);
+  fe_add(r->Y, p->X, p->Y);
+  fe_sq(t0, r->Y);
+  fe_add(r->Y, r->Z, r->X);
+  fe_sub(r->Z, r->Z, r->X);
+  fe_sub(r->X, t0, r->Y);
+  fe_sub(r->T, r->T, r->Z);
+}
+
+void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p) {
+  ge_p2 q;
+  ge_p3_to_p2(&q, p);
+  ge_p2_dbl(r, &q);
+}
+
+void ge_mul8(ge_p1p1 *r, const ge_p2 *t) {
+  ge_p2 u;
+  ge_p2_dbl(r, t);
+  ge_p1p1_to_p2(&u, r);
+  ge_p2_dbl(r, &u);
+  ge_p1p1_to_p2(&u, r);
+  ge_p2_dbl(r, &u);
+}
+
+int ge_p3_is_point_at_infinity(const ge_p3 *p) {
+  fe t;
+  if (fe_isnonzero(p->X)) {
+    return 0;
+  }
+  fe_sub(t, p->Y, p->Z);
+  return !fe_isnonzero(t);
+}
+
+void ge_dsm_precomp(ge_dsmp r, const ge_p3 *s) {
+  ge_p1p1 t;
+  ge_p3 s2, u;
+
+  ge_p3_to_cached(&r[0], s);
+  ge_p3_dbl(&t, s);
+  ge_p1p1_to_p3(&s2, &t);
+  for (int i = 0; i < 7; i++) {
+    ge_add(&t, &s2, &r[i]);
+    ge_p1p1_to_p3(&u, &t);
+    ge_p3_to_cached(&r[i + 1], &u);
+  }
+}
+
+/* signed sliding window recoding, digits are odd and in [-15, 15] */
+static void slide(signed char *r, const unsigned char *a) {
+  int i, b, k;
+
+  for (i = 0; i < 256; ++i) {
+    r[i] = 1 & (a[i >> 3] >> (i & 7));
+  }
+
+  for (i = 0; i < 256; ++i) {
+    if (r[i]) {
+      for (b = 1; b <= 6 && i + b < 256; ++b) {
+        if (r[i + b]) {
+          if (r[i] + (r[i + b] << b) <= 15) {
+            r[i] += r[i + b] << b; r[i + b] = 0;
+          } else if (r[i] - (r[i + b] << b) >= -15) {
+            r[i] -= r[i + b] << b;
+            for (k = i + b; k < 256; ++k) {
+              if (!r[k]) {
+                r[k] = 1;
+                break;
+              }
+              r[k] = 0;
+            }
+          } else
+            break;
+        }
+      }
+    }
+  }
+}
+
+static inline void ge_p1p1_add_digit(ge_p1p1 *t, signed char d, const ge_dsmp Ai) {
+  ge_p3 u;
+  if (d > 0) {
+    ge_p1p1_to_p3(&u, t);
+    ge_add(t, &u, &Ai[d / 2]);
+  } else if (d < 0) {
+    ge_p1p1_to_p3(&u, t);
+    ge_sub(t, &u, &Ai[(-d) / 2]);
+  }
+}
+
+/* returns 0 if both scalars are zero and t was left untouched */
+static int ge_double_scalarmult_core(ge_p1p1 *t, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
+  signed char aslide[256];
+  signed char bslide[256];
+  ge_p2 r;
+  int i;
+
+  slide(aslide, a);
+  if (b) {
+    slide(bslide, b);
+  } else {
+    memset(bslide, 0, sizeof(bslide));
+  }
+  ge_p2_0(&r);
+
+  for (i = 255; i >= 0; --i) {
+    if (aslide[i] || bslide[i]) break;
+  }
+  if (i < 0) {
+    return 0;
+  }
+
+  for (; i >= 0; --i) {
+    ge_p2_dbl(t, &r);
+    ge_p1p1_add_digit(t, aslide[i], Ai);
+    if (Bi) {
+      ge_p1p1_add_digit(t, bslide[i], Bi);
+    }
+    if (i > 0) {
+      ge_p1p1_to_p2(&r, t);
+    }
+  }
+  return 1;
+}
+
+void ge_scalarmult_vartime(ge_p3 *r, const unsigned char *a, const ge_p3 *A) {
+  ge_dsmp Ai;
+  ge_p1p1 t;
+
+  ge_dsm_precomp(Ai, A);
+  if (ge_double_scalarmult_core(&t, a, Ai, NULL, NULL)) {
+    ge_p1p1_to_p3(r, &t);
+  } else {
+    ge_p3_0(r);
+  }
+}
+
+void ge_scalarmult_base_vartime(ge_p3 *r, const unsigned char *a) {
+  ge_p1p1 t;
+
+  if (ge_double_scalarmult_core(&t, a, ge_base_dsmp, NULL, NULL)) {
+    ge_p1p1_to_p3(r, &t);
+  } else {
+    ge_p3_0(r);
+  }
+}
+
+void ge_double_scalarmult_precomp_vartime2(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
+  ge_p1p1 t;
+
+  if (ge_double_scalarmult_core(&t, a, Ai, b, Bi)) {
+    ge_p1p1_to_p2(r, &t);
+  } else {
+    ge_p2_0(r);
+  }
+}
+
+void ge_double_scalarmult_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b, const ge_dsmp Bi) {
+  ge_dsmp Ai;
+
+  ge_dsm_precomp(Ai, A);
+  ge_double_scalarmult_precomp_vartime2(r, a, Ai, b, Bi);
+}
+
+void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge_double_scalarmult_precomp_vartime(r, a, A, b, ge_base_dsmp);
+}
+
+/* constant time scalar multiplication */
+
+static void fe_cmov(fe f, const fe g, uint64_t b) {
+  const uint64_t mask = (uint64_t)0 - b;
+  for (int i = 0; i < 5; i++) {
+    f[i] ^= mask & (f[i] ^ g[i]);
+  }
+}
+
+static void ge_cached_0(ge_cached *h) {
+  fe_1(h->YplusX);
+  fe_1(h->YminusX);
+  fe_1(h->Z);
+  fe_0(h->T2d);
+}
+
+static void ge_cached_cmov(ge_cached *t, const ge_cached *u, uint64_t b) {
+  fe_cmov(t->YplusX, u->YplusX, b);
+  fe_cmov(t->YminusX, u->YminusX, b);
+  fe_cmov(t->Z, u->Z, b);
+  fe_cmov(t->T2d, u->T2d, b);
+}
+
+static uint64_t equal(signed char b, signed char c) {
+  const uint64_t x = (uint8_t)(b ^ c);  /* 0: yes; 1..255: no */
+  return (x - 1) >> 63;
+}
+
+static uint64_t negative(signed char b) {
+  return (uint64_t)(int64_t)b >> 63;
+}
+
+/* t = b * A, b in [-8, 8], without branching on b */
+static void ge_smp_select(ge_cached *t, const ge_smp Ai, signed char b) {
+  ge_cached minust;
+  const uint64_t bnegative = negative(b);
+  const signed char babs = b - (((-bnegative) & b) << 1);
+
+  ge_cached_0(t);
+  for (int i = 0; i < 8; i++) {
+    ge_cached_cmov(t, &Ai[i], equal(babs, i + 1));
+  }
+  fe_copy(minust.YplusX, t->YminusX);
+  fe_copy(minust.YminusX, t->YplusX);
+  fe_copy(minust.Z, t->Z);
+  fe_neg(minust.T2d, t->T2d);
+  ge_cached_cmov(t, &minust, bnegative);
+}
+
+void ge_sm_precomp(ge_smp r, const ge_p3 *A) {
+  ge_p1p1 t;
+  ge_p3 u;
+
+  ge_p3_to_cached(&r[0], A);
+  for (int i = 1; i < 8; i++) {
+    ge_add(&t, A, &r[i - 1]);
+    ge_p1p1_to_p3(&u, &t);
+    ge_p3_to_cached(&r[i], &u);
+  }
+}
+
+void ge_scalarmult_precomp(ge_p2 *r, const unsigned char *a, const ge_smp Ai) {
+  signed char e[64];
+  int carry = 0;
+  ge_cached cur;
+  ge_p1p1 t;
+  ge_p3 u;
+
+  for (int i = 0; i < 32; i++) {
+    e[2 * i + 0] = (a[i] >> 0) & 15;
+    e[2 * i + 1] = (a[i] >> 4) & 15;
+  }
+  /* each e[i] is between 0 and 15, e[63] between 0 and 7 */
+  for (int i = 0; i < 63; i++) {
+    e[i] += carry;
+    carry = e[i] + 8;
+    carry >>= 4;
+    e[i] -= carry << 4;
+  }
+  e[63] += carry;
+  /* each e[i] is between -8 and 8 */
+
+  ge_p2_0(r);
+  for (int i = 63; i >= 0; i--) {
+    ge_smp_select(&cur, Ai, e[i]);
+    ge_p2_dbl(&t, r);
+    ge_p1p1_to_p2(r, &t);
+    ge_p2_dbl(&t, r);
+    ge_p1p1_to_p2(r, &t);
+    ge_p2_dbl(&t, r);
+    ge_p1p1_to_p2(r, &t);
+    ge_p2_dbl(&t, r);
+    ge_p1p1_to_p3(&u, &t);
+    ge_add(&t, &u, &cur);
+    ge_p1p1_to_p2(r, &t);
+  }
+}
+
+void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
+  ge_smp Ai;
+  ge_sm_precomp(Ai, A);
+  ge_scalarmult_precomp(r, a, Ai);
+}
+
+void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
+  fe u, v, w, x, y, z;
+  unsigned char sign;
+
+  /* like fe_frombytes, but keeps the top bit */
+  u[0] = load_8(s) & MASK51;
+  u[1] = (load_8(s + 6) >> 3) & MASK51;
+  u[2] = (load_8(s + 12) >> 6) & MASK51;
+  u[3] = (load_8(s + 19) >> 1) & MASK51;
+  u[4] = load_8(s + 24) >> 12;
+  fe_carry(u);
+
+  fe_sq2(v, u);             /* 2 * u^2 */
+  fe_1(w);
+  fe_add(w, v, w);          /* w = 2 * u^2 + 1 */
+  fe_sq(x, w);              /* w^2 */
+  fe_mul(y, fe_ma2, v);     /* -2 * A^2 * u^2 */
+  fe_add(x, x, y);          /* x = w^2 - 2 * A^2 * u^2 */
+  fe_divpowm1(r->X, w, x);  /* (w / x)^(m + 1) */
+  fe_sq(y, r->X);
+  fe_mul(x, y, x);
+  fe_sub(y, w, x);
+  fe_copy(z, fe_ma);
+  if (fe_isnonzero(y)) {
+    fe_add(y, w, x);
+    if (fe_isnonzero(y)) {
+      goto negative;
+    } else {
+      fe_mul(r->X, r->X, fe_fffb1);
+    }
+  } else {
+    fe_mul(r->X, r->X, fe_fffb2);
+  }
+  fe_mul(r->X, r->X, u);    /* u * sqrt(2 * A * (A + 2) * w / x) */
+  fe_mul(z, z, v);          /* -2 * A * u^2 */
+  sign = 0;
+  goto setsign;
+negative:
+  fe_mul(x, x, fe_sqrtm1);
+  fe_sub(y, w, x);
+  if (fe_isnonzero(y)) {
+    assert((fe_add(y, w, x), !fe_isnonzero(y)));
+    fe_mul(r->X, r->X, fe_fffb3);
+  } else {
+    fe_mul(r->X, r->X, fe_fffb4);
+  }
+  /* r->X = sqrt(A * (A + 2) * w / x) */
+  /* z = -A */
+  sign = 1;
+setsign:
+  if (fe_isnegative(r->X) != sign) {
+    assert(fe_isnonzero(r->X));
+    fe_neg(r->X, r->X);
+  }
+  fe_add(r->Z, z, w);
+  fe_sub(r->Y, z, w);
+  fe_mul(r->X, r->X, r->Z);
+}
+
+/* From sc_*.c
+ *
+ * Scalars are kept as four 64-bit limbs and multiplied in Montgomery form,
+ * R = 2^256.
+ */
+
+static const uint64_t sc_l[4] = { 0x5812631a5cf5d3ed, 0x14def9dea2f79cd6, 0x0000000000000000, 0x1000000000000000 };
+static const uint64_t sc_r2[4] = { 0xa40611e3449c0f01, 0xd00e1ba768859347, 0xceec73d217f5be65, 0x0399411b7c309a3d }; /* R^2 mod l */
+static const uint64_t sc_one[4] = { 1, 0, 0, 0 };
+#define SC_N0 0xd2b51da312547e1bULL /* -l^-1 mod 2^64 */
+
+static inline void sc_load(uint64_t r[4], const unsigned char *s) {
+  for (int i = 0; i < 4; i++) {
+    r[i] = load_8(s + 8 * i);
+  }
+}
+
+static inline void sc_store(unsigned char *s, const uint64_t r[4]) {
+  for (int i = 0; i < 4; i++) {
+    store_8(s + 8 * i, r[i]);
+  }
+}
+
+/* r = a - l if a >= l, a has an extra top word */
+static inline void sc_cond_sub_l(uint64_t r[4], const uint64_t a[4], uint64_t top) {
+  uint64_t t[4];
+  uint128_t borrow = 0;
+  for (int i = 0; i < 4; i++) {
+    uint128_t d = (uint128_t)a[i] - sc_l[i] - borrow;
+    t[i] = (uint64_t)d;
+    borrow = (d >> 64) & 1;
+  }
+  if (top || !borrow) {
+    memcpy(r, t, sizeof(t));
+  } else {
+    memmove(r, a, 4 * sizeof(uint64_t));
+  }
+}
+
+/* CIOS Montgomery multiplication: r = a * b / R mod l, needs a < 2^256 and b < l */
+static void sc_montmul(uint64_t r[4], const uint64_t a[4], const uint64_t b[4]) {
+  uint64_t t[6] = { 0, 0, 0, 0, 0, 0 };
+
+  for (int i = 0; i < 4; i++) {
+    uint128_t c = 0;
+    for (int j = 0; j < 4; j++) {
+      c = (uint128_t)a[j] * b[i] + t[j] + (uint64_t)(c >> 64);
+      t[j] = (uint64_t)c;
+    }
+    c = (uint128_t)t[4] + (uint64_t)(c >> 64);
+    t[4] = (uint64_t)c;
+    t[5] = (uint64_t)(c >> 64);
+
+    uint64_t m = t[0] * SC_N0;
+    c = (uint128_t)m * sc_l[0] + t[0];
+    for (int j = 1; j < 4; j++) {
+      c = (uint128_t)m * sc_l[j] + t[j] + (uint64_t)(c >> 64);
+      t[j - 1] = (uint64_t)c;
+    }
+    c = (uint128_t)t[4] + (uint64_t)(c >> 64);
+    t[3] = (uint64_t)c;
+    t[4] = t[5] + (uint64_t)(c >> 64);
+  }
+  sc_cond_sub_l(r, t, t[4]);
+}
+
+/* r = a mod l for any 256-bit a */
+static void sc_reduce_limbs(uint64_t r[4], const uint64_t a[4]) {
+  uint64_t t[4];
+  sc_montmul(t, a, sc_r2);
+  sc_montmul(r, sc_one, t);
+}
+
+static void sc_add_limbs(uint64_t r[4], const uint64_t a[4], const uint64_t b[4]) {
+  uint64_t t[4];
+  uint128_t c = 0;
+  for (int i = 0; i < 4; i++) {
+    c = (uint128_t)a[i] + b[i] + (uint64_t)(c >> 64);
+    t[i] = (uint64_t)c;
+  }
+  sc_cond_sub_l(r, t, (uint64_t)(c >> 64));
+}
+
+void sc_0(unsigned char *s) {
+  memset(s, 0, 32);
+}
+
+void sc_reduce(unsigned char *s) {
+  uint64_t lo[4], hi[4];
+  sc_load(lo, s);
+  sc_load(hi, s + 32);
+  sc_montmul(hi, hi, sc_r2);      /* hi * 2^256 mod l */
+  sc_reduce_limbs(lo, lo);
+  sc_add_limbs(lo, lo, hi);
+  sc_store(s, lo);
+}
+
+void sc_reduce32(unsigned char *s) {
+  uint64_t a[4];
+  sc_load(a, s);
+  sc_reduce_limbs(a, a);
+  sc_store(s, a);
+}
+
+void sc_add(unsigned char *s, const unsigned char *a, const unsigned char *b) {
+  uint64_t x[4], y[4];
+  sc_load(x, a);
+  sc_load(y, b);
+  sc_reduce_limbs(x, x);
+  sc_reduce_limbs(y, y);
+  sc_add_limbs(x, x, y);
+  sc_store(s, x);
+}
+
+void sc_sub(unsigned char *s, const unsigned char *a, const unsigned char *b) {
+  uint64_t x[4], y[4], t[4];
+  uint128_t borrow = 0;
+  sc_load(x, a);
+  sc_load(y, b);
+  sc_reduce_limbs(x, x);
+  sc_reduce_limbs(y, y);
+  for (int i = 0; i < 4; i++) {
+    uint128_t d = (uint128_t)x[i] - y[i] - borrow;
+    t[i] = (uint64_t)d;
+    borrow = (d >> 64) & 1;
+  }
+  if (borrow) {
+    uint128_t c = 0;
+    for (int i = 0; i < 4; i++) {
+      c = (uint128_t)t[i] + sc_l[i] + (uint64_t)(c >> 64);
+      t[i] = (uint64_t)c;
+    }
+  }
+  sc_store(s, t);
+}
+
+void sc_mul(unsigned char *s, const unsigned char *a, const unsigned char *b) {
+  uint64_t x[4], y[4];
+  sc_load(x, a);
+  sc_load(y, b);
+  sc_montmul(x, x, sc_r2);        /* x * R mod l */
+  sc_montmul(x, y, x);            /* x * y mod l */
+  sc_store(s, x);
+}
+
+void sc_muladd(unsigned char *s, const unsigned char *a, const unsigned char *b, const unsigned char *c) {
+  unsigned char t[32];
+  sc_mul(t, a, b);
+  sc_add(s, t, c);
+}
+
+/* s = c - a * b */
+void sc_mulsub(unsigned char *s, const unsigned char *a, const unsigned char *b, const unsigned char *c) {
+  unsigned char t[32];
+  sc_mul(t, a, b);
+  sc_sub(s, c, t);
+}
+
+int sc_check(const unsigned char *s) {
+  uint64_t a[4];
+  sc_load(a, s);
+  for (int i = 3; i >= 0; i--) {
+    if (a[i] < sc_l[i]) return 0;
+    if (a[i] > sc_l[i]) return -1;
+  }
+  return -1;
+}
+
+int sc_isnonzero(const unsigned char *s) {
+  unsigned char r = 0;
+  for (int i = 0; i < 32; i++) {
+    r |= s[i];
+  }
+  return r != 0;
+}
@@ -0,0 +1,122 @@
+#ifndef MONERO_CRYPTO_CRYPTO_OPS_H_
+#define MONERO_CRYPTO_CRYPTO_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* From fe.h */
+
+// field elements of GF(2^255 - 19) in radix 2^51
+typedef uint64_t fe[5];
+
+/* From ge.h */
+
+typedef struct {
+  fe X;
+  fe Y;
+  fe Z;
+} ge_p2;
+
+typedef struct {
+  fe X;
+  fe Y;
+  fe Z;
+  fe T;
+} ge_p3;
+
+typedef struct {
+  fe X;
+  fe Y;
+  fe Z;
+  fe T;
+} ge_p1p1;
+
+typedef struct {
+  fe YplusX;
+  fe YminusX;
+  fe Z;
+  fe T2d;
+} ge_cached;
+
+// odd multiples A, 3A, ..., 15A for sliding-window multiplication
+typedef ge_cached ge_dsmp[8];
+// multiples A, 2A, ..., 8A for constant time multiplication
+typedef ge_cached ge_smp[8];
+
+void fe_0(fe h);
+void fe_1(fe h);
+void fe_copy(fe h, const fe f);
+void fe_add(fe h, const fe f, const fe g);
+void fe_sub(fe h, const fe f, const fe g);
+void fe_neg(fe h, const fe f);
+void fe_mul(fe h, const fe f, const fe g);
+void fe_sq(fe h, const fe f);
+void fe_invert(fe out, const fe z);
+void fe_pow22523(fe out, const fe z);
+void fe_frombytes(fe h, const unsigned char *s);
+void fe_tobytes(unsigned char *s, const fe h);
+int fe_isnegative(const fe f);
+int fe_isnonzero(const fe f);
+// invert n elements in place with one field inversion (Montgomery's trick)
+void fe_batch_invert(fe *out, const fe *in, size_t n);
+
+extern const fe fe_d;
+extern const fe fe_d2;
+extern const fe fe_sqrtm1;
+
+void ge_p3_0(ge_p3 *h);
+void ge_p3_tobytes(unsigned char *s, const ge_p3 *h);
+void ge_tobytes(unsigned char *s, const ge_p2 *h);
+int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s);
+void ge_p3_to_cached(ge_cached *r, const ge_p3 *p);
+void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p);
+void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p);
+void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p);
+void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
+void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
+void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p);
+void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p);
+void ge_mul8(ge_p1p1 *r, const ge_p2 *t);
+int ge_p3_is_point_at_infinity(const ge_p3 *p);
+// serialize n points with a single shared inversion of the Z coordinates
+void ge_p3_batch_tobytes(unsigned char *s, const ge_p3 *p, size_t n);
+void ge_p2_batch_tobytes(unsigned char *s, const ge_p2 *p, size_t n);
+
+void ge_dsm_precomp(ge_dsmp r, const ge_p3 *s);
+// r = a * A (variable time)
+void ge_scalarmult_vartime(ge_p3 *r, const unsigned char *a, const ge_p3 *A);
+// r = a * G (variable time)
+void ge_scalarmult_base_vartime(ge_p3 *r, const unsigned char *a);
+// r = a * A + b * G (variable time)
+void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b);
+// r = a * A + b * B with precomputed odd multiples (variable time)
+void ge_double_scalarmult_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b, const ge_dsmp Bi);
+void ge_double_scalarmult_precomp_vartime2(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi);
+
+void ge_sm_precomp(ge_smp r, const ge_p3 *A);
+// r = a * A in constant time, for secret a below 2^255
+void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A);
+void ge_scalarmult_precomp(ge_p2 *r, const unsigned char *a, const ge_smp Ai);
+
+// the base point G
+extern const unsigned char ge_base_bytes[32];
+const ge_p3 *ge_base(void);
+// odd multiples of G, for ge_double_scalarmult_precomp_vartime2
+const ge_cached *ge_base_precomp(void);
+
+// Monero's hash-to-curve map (without the cofactor clearing)
+void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s);
+
+/* scalars modulo l = 2^252 + 27742317777372353535851937790883648493 */
+void sc_0(unsigned char *s);
+void sc_reduce(unsigned char *s);   // 64 bytes in, 32 bytes out
+void sc_reduce32(unsigned char *s);
+void sc_add(unsigned char *s, const unsigned char *a, const unsigned char *b);
+void sc_sub(unsigned char *s, const unsigned char *a, const unsigned char *b);
+void sc_mul(unsigned char *s, const unsigned char *a, const unsigned char *b);
+void sc_muladd(unsigned char *s, const unsigned char *a, const unsigned char *b, const unsigned char *c);
+void sc_mulsub(unsigned char *s, const unsigned char *a, const unsigned char *b, const unsigned char *c);
+int sc_check(const unsigned char *s);
+int sc_isnonzero(const unsigned char *s);
+
+#endif //MONERO_CRYPTO_CRYPTO_OPS_H_
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "common/varint.h"
+#include "crypto-ops.h"
+#include "hash-ops.h"
+#include "crypto.h"
+
+static void hash_to_scalar(const void *data, size_t length, ec_scalar *res) {
+    cn_fast_hash(data, length, res->data);
+    sc_reduce32((unsigned char *)res->data);
+}
+
+bool secret_key_to_public_key(const secret_key *sec, public_key *pub) {
+    ge_p2 point;
+    if (sc_check((const unsigned char *)sec->data) != 0) {
+        return false;
+    }
+    ge_scalarmult(&point, (const unsigned char *)sec->data, ge_base());
+    ge_tobytes((unsigned char *)pub->data, &point);
+    return true;
+}
+
+bool generate_key_derivation(const public_key *key1, const secret_key *key2, key_derivation *derivation) {
+    ge_p3 point;
+    ge_p2 point2;
+    ge_p1p1 point3;
+    if (ge_frombytes_vartime(&point, (const unsigned char *)key1->data) != 0) {
+        return false;
+    }
+    ge_scalarmult(&point2, (const unsigned char *)key2->data, &point);
+    ge_mul8(&point3, &point2);
+    ge_p1p1_to_p2(&point2, &point3);
+    ge_tobytes((unsigned char *)derivation->data, &point2);
+    return true;
+}
+
+void derivation_to_scalar(const key_derivation *derivation, size_t output_index, ec_scalar *res) {
+    uint8_t buf[sizeof(key_derivation) + VARINT_MAX_SIZE];
+    size_t len = sizeof(key_derivation);
+    memcpy(buf, derivation->data, sizeof(key_derivation));
+    len += write_varint(buf + len, output_index);
+    hash_to_scalar(buf, len, res);
+}
+
+bool derive_public_key(const key_derivation *derivation, size_t output_index, const public_key *base, public_key *derived_key) {
+    ec_scalar scalar;
+    ge_p3 point1, point2;
+    ge_cached point3;
+    ge_p1p1 point4;
+    ge_p2 point5;
+    if (ge_frombytes_vartime(&point1, (const unsigned char *)base->data) != 0) {
+        return false;
+    }
+    derivation_to_scalar(derivation, output_index, &scalar);
+    ge_scalarmult_base_vartime(&point2, (const unsigned char *)scalar.data);
+    ge_p3_to_cached(&point3, &point2);
+    ge_add(&point4, &point1, &point3);
+    ge_p1p1_to_p2(&point5, &point4);
+    ge_tobytes((unsigned char *)derived_key->data, &point5);
+    return true;
+}
+
+bool derive_subaddress_public_key(const public_key *out_key, const key_derivation *derivation, size_t output_index, public_key *derived_key) {
+    ec_scalar scalar;
+    ge_p3 point1, point2;
+    ge_cached point3;
+    ge_p1p1 point4;
+    ge_p2 point5;
+    if (ge_frombytes_vartime(&point1, (const unsigned char *)out_key->data) != 0) {
+        return false;
+    }
+    derivation_to_scalar(derivation, output_index, &scalar);
+    ge_scalarmult_base_vartime(&point2, (const unsigned char *)scalar.data);
+    ge_p3_to_cached(&point3, &point2);
+    ge_sub(&point4, &point1, &point3);
+    ge_p1p1_to_p2(&point5, &point4);
+    ge_tobytes((unsigned char *)derived_key->data, &point5);
+    return true;
+}
@@ -1,6 +1,8 @@
 #ifndef MONERO_CRYPTO_CRYPTO_H_
 #define MONERO_CRYPTO_CRYPTO_H_
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <glib.h>
 
 //#pragma pack(push, 1)
@@ -15,6 +17,7 @@
 typedef ec_point public_key;
 
 //  using secret_key = epee::mlocked<tools::scrubbed<ec_scalar>>;
+typedef ec_scalar secret_key;
 
   typedef struct public_keyV {
     //public_key
@@ -49,4 +52,14 @@ typedef ec_point key_image;
 //#pragma pack(pop)
 
 
+bool secret_key_to_public_key(const secret_key *sec, public_key *pub);
+// derivation = 8 * key2 * key1, key2 is secret and handled in constant time
+bool generate_key_derivation(const public_key *key1, const secret_key *key2, key_derivation *derivation);
+// res = Hs(derivation || varint(output_index))
+void derivation_to_scalar(const key_derivation *derivation, size_t output_index, ec_scalar *res);
+// derived_key = Hs(derivation || output_index) * G + base
+bool derive_public_key(const key_derivation *derivation, size_t output_index, const public_key *base, public_key *derived_key);
+// derived_key = out_key - Hs(derivation || output_index) * G, the spend key the output was sent to
+bool derive_subaddress_public_key(const public_key *out_key, const key_derivation *derivation, size_t output_index, public_key *derived_key);
+
 #endif //MONERO_CRYPTO_CRYPTO_H_
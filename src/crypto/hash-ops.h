@@ -1,8 +1,26 @@
 #ifndef MONERO_CRYPTO_HASH_OPS_H_
 #define MONERO_CRYPTO_HASH_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma pack(push, 1)
+union hash_state {
+  uint8_t b[200];
+  uint64_t w[25];
+};
+#pragma pack(pop)
+
+void hash_permutation(union hash_state *state);
+void hash_process(union hash_state *state, const uint8_t *buf, size_t count);
+
 enum {
   HASH_SIZE = 32,
   HASH_DATA_AREA = 136
 };
 
+void cn_fast_hash(const void *data, size_t length, char *hash);
+// merkle root of count > 0 hashes, as committed to by block headers
+void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash);
+
 #endif //MONERO_CRYPTO_HASH_OPS_H_
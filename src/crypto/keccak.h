@@ -0,0 +1,23 @@
+#ifndef MONERO_CRYPTO_KECCAK_H_
+#define MONERO_CRYPTO_KECCAK_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef KECCAK_ROUNDS
+#define KECCAK_ROUNDS 24
+#endif
+
+#ifndef ROTL64
+#define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
+#endif
+
+// compute a keccak hash (md) of given byte length from "in"
+void keccak(const uint8_t *in, size_t inlen, uint8_t *md, int mdlen);
+
+// update the state
+void keccakf(uint64_t st[25], int norounds);
+
+void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
+
+#endif //MONERO_CRYPTO_KECCAK_H_
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "random.h"
+
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+void generate_random_bytes(size_t n, void *result) {
+    unsigned char *out = result;
+#if defined(__linux__)
+    while (n > 0) {
+        ssize_t r = getrandom(out, n, 0);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "getrandom failed: %d\n", errno);
+            abort();
+        }
+        out += r;
+        n -= (size_t)r;
+    }
+#else
+    arc4random_buf(out, n);
+#endif
+}
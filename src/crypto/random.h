@@ -0,0 +1,9 @@
+#ifndef MONERO_CRYPTO_RANDOM_H_
+#define MONERO_CRYPTO_RANDOM_H_
+
+#include <stddef.h>
+
+// fill result with n bytes from the OS CSPRNG, safe to call from any thread
+void generate_random_bytes(size_t n, void *result);
+
+#endif //MONERO_CRYPTO_RANDOM_H_
@@ -0,0 +1,44 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash-ops.h"
+
+// the largest power of two below count
+static size_t tree_hash_cnt(size_t count) {
+    size_t pow = 2;
+    assert(count >= 3);
+    while (pow < count) {
+        pow <<= 1;
+    }
+    return pow >> 1;
+}
+
+void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
+    assert(count > 0);
+    if (count == 1) {
+        memcpy(root_hash, hashes, HASH_SIZE);
+    } else if (count == 2) {
+        cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
+    } else {
+        size_t cnt = tree_hash_cnt(count);
+        char (*ints)[HASH_SIZE] = malloc(cnt * HASH_SIZE);
+        size_t i, j;
+
+        // the first 2 * cnt - count hashes go up a level unpaired
+        memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
+        for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, j++) {
+            cn_fast_hash(hashes[i], 2 * HASH_SIZE, ints[j]);
+        }
+        assert(i == count);
+        while (cnt > 2) {
+            cnt >>= 1;
+            for (i = 0, j = 0; j < cnt; i += 2, j++) {
+                cn_fast_hash(ints[i], 2 * HASH_SIZE, ints[j]);
+            }
+        }
+        cn_fast_hash(ints[0], 2 * HASH_SIZE, root_hash);
+        free(ints);
+    }
+}
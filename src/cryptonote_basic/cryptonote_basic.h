@@ -1,6 +1,9 @@
 #ifndef MONERO_CRYPTONOTE_BASIC_CRYPTONOTE_BASIC_H_
 #define MONERO_CRYPTONOTE_BASIC_CRYPTONOTE_BASIC_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "crypto/crypto.h"
 #include "crypto/hash.h"
 #include <glib.h>
 
@@ -51,23 +54,34 @@ typedef struct txin_to_scripthash
 typedef struct txin_to_key
 {
     uint64_t amount;
-    uint64_t key_offsets;
+    uint64_t *key_offsets;
     size_t key_offsets_size;
     //    std::vector<uint64_t> key_offsets;
     key_image k_image;      // double spending protection
 } txin_to_key;
 
+/*
+ * Tagged unions: tag (TXIN_*_TAG / TXOUT_*_TAG) says which member is in use.
+ * The script inputs never appear on chain and are held out of line, so an
+ * input is no bigger than a txin_to_key.
+ */
 typedef struct txin_v {
-    txin_gen gen;
-    txin_to_script script;
-    txin_to_scripthash scripthash;
-    txin_to_key key;
+    uint8_t tag;
+    union {
+        txin_gen gen;
+        txin_to_script *script;
+        txin_to_scripthash *scripthash;
+        txin_to_key key;
+    };
 } txin_v;
 
 typedef struct txout_target_v {
-    txout_to_script script;
-    txout_to_scripthash scripthash;
-    txout_to_key key;
+    uint8_t tag;
+    union {
+        txout_to_script script;
+        txout_to_scripthash scripthash;
+        txout_to_key key;
+    };
 } txout_target_v;
 
 //typedef std::pair<uint64_t, txout> out_t;
@@ -104,12 +118,29 @@ typedef struct transaction {
     
     //crpto.h signature
     //std::vector<std::vector<crypto::signature> > signatures; //count signatures  always the same as inputs count
-    GArray* signatures;
+    // v1: the ring signatures of all inputs back to back, key_offsets_size per input
+    signature* signatures;
+    size_t signatures_size;
+    
+    // v2: the serialized ringct signature, base and prunable parts
+    uint8_t rct_type;
+    const uint8_t* rct_signatures;
+    size_t rct_signatures_size;
+    
+    // the blob the tx was parsed from, its prefix and rctSigBase (with the type byte) come first
+    const uint8_t* blob;
+    size_t prefix_size;
+    size_t rct_base_size;
     
-    bool hash_valid;
-    bool blob_size_valid;
+    // hash cash, see get_transaction_hash()
+    hash prefix_hash;
+    hash prunable_hash;
     //    mutable std::atomic<bool> hash_valid;
     //    mutable std::atomic<bool> blob_size_valid;
+    gint hash_valid;
+    gint prefix_hash_valid;
+    gint prunable_hash_valid;
+    gint blob_size_valid;
     
     //    rct::rctSig rct_signatures;
     
@@ -117,6 +148,26 @@ typedef struct transaction {
 
 
 
+/*
+ * Structure of arrays copies of the key inputs and outputs of many txs, for
+ * batch verification: each field is contiguous across all of them.
+ */
+typedef struct txin_to_key_soa {
+    size_t size;
+    uint32_t *tx;                 // index of the tx in the batch
+    uint64_t *amount;
+    key_image *k_image;
+    size_t *key_offsets_begin;    // size + 1 entries into key_offsets
+    uint64_t *key_offsets;        // of every input back to back
+} txin_to_key_soa;
+
+typedef struct txout_to_key_soa {
+    size_t size;
+    uint32_t *tx;
+    uint64_t *amount;
+    public_key *key;
+} txout_to_key_soa;
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
@@ -137,11 +188,13 @@ typedef struct block {
     //    std::vector<crypto::hash> tx_hashes;
     hash* tx_hashes;
     size_t tx_hashes_size;
-    // hash cash
-    hash hash;
+    const uint8_t* blob;
+    size_t blob_size;
     
-    // hash cash
-    bool hash_valid;
+    // hash cash, see get_block_hash()
+    hash hash;
+    gint hash_valid;
+    gint blob_size_valid;
 } block;
 
 
@@ -0,0 +1,756 @@
+#include <string.h>
+#include "common/varint.h"
+#include "cryptonote_format_utils.h"
+
+enum {
+    CACHE_EMPTY,
+    CACHE_BUSY,
+    CACHE_VALID
+};
+
+void blob_reader_init(blob_reader *r, const void *data, size_t size) {
+    r->pos = data;
+    r->end = r->pos + size;
+}
+
+bool blob_read_varint(blob_reader *r, uint64_t *v) {
+    const int n = read_varint(r->pos, r->end, v);
+    if (n < 0) {
+        return false;
+    }
+    r->pos += n;
+    return true;
+}
+
+const uint8_t *blob_read_bytes(blob_reader *r, size_t n) {
+    const uint8_t *p = r->pos;
+    if ((size_t)(r->end - r->pos) < n) {
+        return NULL;
+    }
+    r->pos += n;
+    return p;
+}
+
+static inline bool blob_read_byte(blob_reader *r, uint8_t *b) {
+    const uint8_t *p = blob_read_bytes(r, 1);
+    if (!p) {
+        return false;
+    }
+    *b = *p;
+    return true;
+}
+
+// a varint count of items of at least item_size bytes each, bounded by the blob
+static bool blob_read_count(blob_reader *r, size_t item_size, uint64_t *count) {
+    if (!blob_read_varint(r, count)) {
+        return false;
+    }
+    return *count <= (uint64_t)(r->end - r->pos) / (item_size ? item_size : 1);
+}
+
+static bool skip_varints(blob_reader *r, uint64_t n) {
+    uint64_t v;
+    for (uint64_t i = 0; i < n; i++) {
+        if (!blob_read_varint(r, &v)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool skip_byte_vector(blob_reader *r) {
+    uint64_t n;
+    return blob_read_count(r, 1, &n) && blob_read_bytes(r, n);
+}
+
+static bool skip_txout_to_script(blob_reader *r) {
+    uint64_t n;
+    if (!blob_read_count(r, sizeof(public_key), &n) || !blob_read_bytes(r, n * sizeof(public_key))) {
+        return false;
+    }
+    return skip_byte_vector(r);
+}
+
+static bool parse_txin(blob_reader *r, tx_prefix_ref *tx) {
+    uint8_t tag;
+    uint64_t v;
+
+    if (!blob_read_byte(r, &tag)) {
+        return false;
+    }
+    switch (tag) {
+    case TXIN_GEN_TAG:
+        return blob_read_varint(r, &v);
+    case TXIN_TO_KEY_TAG:
+        if (!blob_read_varint(r, &v) || !blob_read_count(r, 1, &v) || !skip_varints(r, v)) {
+            return false;
+        }
+        tx->key_offsets_size += v;
+        return blob_read_bytes(r, sizeof(key_image)) != NULL;
+    case TXIN_TO_SCRIPT_TAG:
+        return blob_read_bytes(r, sizeof(hash)) && blob_read_varint(r, &v) && skip_byte_vector(r);
+    case TXIN_TO_SCRIPTHASH_TAG:
+        return blob_read_bytes(r, sizeof(hash)) && blob_read_varint(r, &v) && skip_txout_to_script(r) && skip_byte_vector(r);
+    default:
+        return false;
+    }
+}
+
+static bool parse_txout(blob_reader *r, tx_out_ref *out) {
+    uint8_t tag;
+
+    if (!blob_read_varint(r, &out->amount) || !blob_read_byte(r, &tag)) {
+        return false;
+    }
+    out->key = NULL;
+    switch (tag) {
+    case TXOUT_TO_KEY_TAG:
+        out->key = (const public_key *)blob_read_bytes(r, sizeof(public_key));
+        return out->key != NULL;
+    case TXOUT_TO_SCRIPT_TAG:
+        return skip_txout_to_script(r);
+    case TXOUT_TO_SCRIPTHASH_TAG:
+        return blob_read_bytes(r, sizeof(hash)) != NULL;
+    default:
+        return false;
+    }
+}
+
+bool parse_tx_prefix_ref(blob_reader *r, tx_prefix_ref *tx) {
+    uint64_t n;
+    tx_out_ref out;
+
+    if (!blob_read_varint(r, &tx->version) || !blob_read_varint(r, &tx->unlock_time)) {
+        return false;
+    }
+    tx->key_offsets_size = 0;
+    if (!blob_read_count(r, 1, &n)) {
+        return false;
+    }
+    tx->vin_size = n;
+    for (uint64_t i = 0; i < n; i++) {
+        if (!parse_txin(r, tx)) {
+            return false;
+        }
+    }
+    if (!blob_read_count(r, 2, &n)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        if (!parse_txout(r, &out)) {
+            return false;
+        }
+        g_array_append_val(tx->vout, out);
+    }
+    if (!blob_read_count(r, 1, &n)) {
+        return false;
+    }
+    tx->extra_size = n;
+    tx->extra = blob_read_bytes(r, n);
+    return tx->extra != NULL;
+}
+
+bool parse_block_header(blob_reader *r, block_header *header) {
+    uint64_t v;
+    const uint8_t *p;
+
+    if (!blob_read_varint(r, &v) || v > UINT8_MAX) {
+        return false;
+    }
+    header->major_version = (uint8_t)v;
+    if (!blob_read_varint(r, &v) || v > UINT8_MAX) {
+        return false;
+    }
+    header->minor_version = (uint8_t)v;
+    if (!blob_read_varint(r, &header->timestamp)) {
+        return false;
+    }
+    if (!(p = blob_read_bytes(r, sizeof(hash)))) {
+        return false;
+    }
+    memcpy(&header->prev_id, p, sizeof(hash));
+    if (!(p = blob_read_bytes(r, sizeof(uint32_t)))) {
+        return false;
+    }
+    header->nonce = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return true;
+}
+
+bool parse_block_ref(blob_reader *r, block_ref *b) {
+    uint64_t v;
+
+    if (!parse_block_header(r, &b->header)) {
+        return false;
+    }
+    if (!parse_tx_prefix_ref(r, &b->miner_tx)) {
+        return false;
+    }
+    // miner txs have no v1 signatures and a null ringct signature
+    if (b->miner_tx.version >= 2) {
+        uint8_t rct_type;
+        if (!blob_read_byte(r, &rct_type) || rct_type != 0) {
+            return false;
+        }
+    }
+
+    if (!blob_read_count(r, sizeof(hash), &v)) {
+        return false;
+    }
+    b->tx_hashes_size = v;
+    b->tx_hashes = (const hash *)blob_read_bytes(r, v * sizeof(hash));
+    return b->tx_hashes != NULL;
+}
+
+/* arena parser: vin, vout and key offsets in the arena, the rest in place */
+
+static bool read_byte_vector(blob_reader *r, uint8_t **data, size_t *size) {
+    uint64_t n;
+    if (!blob_read_count(r, 1, &n)) {
+        return false;
+    }
+    *size = n;
+    *data = (uint8_t *)blob_read_bytes(r, n);
+    return *data != NULL;
+}
+
+static bool read_txout_to_script(blob_reader *r, txout_to_script *script) {
+    uint64_t n;
+    if (!blob_read_count(r, sizeof(public_key), &n)) {
+        return false;
+    }
+    script->keys_size = n;
+    script->keys = (public_key *)blob_read_bytes(r, n * sizeof(public_key));
+    return script->keys && read_byte_vector(r, &script->script, &script->script_size);
+}
+
+static bool read_hash(blob_reader *r, hash *h) {
+    const uint8_t *p = blob_read_bytes(r, sizeof(hash));
+    if (!p) {
+        return false;
+    }
+    memcpy(h, p, sizeof(hash));
+    return true;
+}
+
+static bool read_size(blob_reader *r, size_t *v) {
+    uint64_t u;
+    if (!blob_read_varint(r, &u) || u > SIZE_MAX) {
+        return false;
+    }
+    *v = (size_t)u;
+    return true;
+}
+
+static bool read_txin_v(blob_reader *r, arena *a, txin_v *in) {
+    uint64_t n;
+
+    if (!blob_read_byte(r, &in->tag)) {
+        return false;
+    }
+    switch (in->tag) {
+    case TXIN_GEN_TAG:
+        return read_size(r, &in->gen.height);
+    case TXIN_TO_KEY_TAG:
+        if (!blob_read_varint(r, &in->key.amount) || !blob_read_count(r, 1, &n)) {
+            return false;
+        }
+        in->key.key_offsets_size = n;
+        in->key.key_offsets = arena_new(a, uint64_t, n);
+        for (uint64_t i = 0; i < n; i++) {
+            if (!blob_read_varint(r, &in->key.key_offsets[i])) {
+                return false;
+            }
+        }
+        return read_hash(r, (hash *)&in->key.k_image);
+    case TXIN_TO_SCRIPT_TAG:
+        in->script = arena_new(a, txin_to_script, 1);
+        return read_hash(r, &in->script->prev) && read_size(r, &in->script->prevout)
+            && read_byte_vector(r, &in->script->sigset, &in->script->sigset_size);
+    case TXIN_TO_SCRIPTHASH_TAG:
+        in->scripthash = arena_new(a, txin_to_scripthash, 1);
+        return read_hash(r, &in->scripthash->prev) && read_size(r, &in->scripthash->prevout)
+            && read_txout_to_script(r, &in->scripthash->script)
+            && read_byte_vector(r, &in->scripthash->sigset, &in->scripthash->sigset_size);
+    default:
+        return false;
+    }
+}
+
+static bool read_tx_out(blob_reader *r, tx_out *out) {
+    if (!blob_read_varint(r, &out->amount) || !blob_read_byte(r, &out->target.tag)) {
+        return false;
+    }
+    switch (out->target.tag) {
+    case TXOUT_TO_KEY_TAG:
+        return read_hash(r, (hash *)&out->target.key.key);
+    case TXOUT_TO_SCRIPT_TAG:
+        return read_txout_to_script(r, &out->target.script);
+    case TXOUT_TO_SCRIPTHASH_TAG:
+        return read_hash(r, &out->target.scripthash.hash);
+    default:
+        return false;
+    }
+}
+
+static bool read_transaction_prefix(blob_reader *r, arena *a, transaction_prefix *prefix) {
+    uint64_t n;
+
+    if (!read_size(r, &prefix->version) || !blob_read_varint(r, &prefix->unlock_time)) {
+        return false;
+    }
+    if (!blob_read_count(r, 1, &n)) {
+        return false;
+    }
+    prefix->vin_size = n;
+    prefix->vin = arena_new(a, txin_v, n);
+    for (uint64_t i = 0; i < n; i++) {
+        if (!read_txin_v(r, a, &prefix->vin[i])) {
+            return false;
+        }
+    }
+    if (!blob_read_count(r, 2, &n)) {
+        return false;
+    }
+    prefix->vout_size = n;
+    prefix->vout = arena_new(a, tx_out, n);
+    for (uint64_t i = 0; i < n; i++) {
+        if (!read_tx_out(r, &prefix->vout[i])) {
+            return false;
+        }
+    }
+    return read_byte_vector(r, &prefix->extra, &prefix->extra_size);
+}
+
+// the rest of a rctSigBase after the type byte, the prunable part follows it
+static bool skip_rct_base(blob_reader *r, uint8_t type, size_t inputs, size_t outputs) {
+    uint64_t fee;
+    size_t ecdh_size;
+
+    switch (type) {
+    case RCT_TYPE_FULL:
+    case RCT_TYPE_SIMPLE:
+    case RCT_TYPE_BULLETPROOF:
+        ecdh_size = 2 * sizeof(ec_scalar);
+        break;
+    case RCT_TYPE_BULLETPROOF2:
+    case RCT_TYPE_CLSAG:
+    case RCT_TYPE_BULLETPROOF_PLUS:
+        ecdh_size = sizeof(hash8);
+        break;
+    default:
+        return false;
+    }
+    if (!blob_read_varint(r, &fee)) {
+        return false;
+    }
+    // pseudo outs moved to the prunable part after RCTTypeSimple
+    if (type == RCT_TYPE_SIMPLE && !blob_read_bytes(r, inputs * sizeof(public_key))) {
+        return false;
+    }
+    return blob_read_bytes(r, outputs * (ecdh_size + sizeof(public_key))) != NULL;
+}
+
+// in a block only the miner tx is serialized, and it has no ringct data
+static bool read_transaction(blob_reader *r, arena *a, transaction *tx, bool in_block) {
+    const uint8_t *begin = r->pos;
+
+    if (!read_transaction_prefix(r, a, &tx->prefix)) {
+        return false;
+    }
+    tx->blob = begin;
+    tx->prefix_size = r->pos - begin;
+    tx->rct_base_size = 0;
+    tx->signatures = NULL;
+    tx->signatures_size = 0;
+    tx->rct_type = 0;
+    tx->rct_signatures = NULL;
+    tx->rct_signatures_size = 0;
+
+    if (tx->prefix.version == 1) {
+        uint64_t n = 0;
+        for (size_t i = 0; i < tx->prefix.vin_size; i++) {
+            if (tx->prefix.vin[i].tag == TXIN_TO_KEY_TAG) {
+                n += tx->prefix.vin[i].key.key_offsets_size;
+            }
+        }
+        if (n > (uint64_t)(r->end - r->pos) / sizeof(signature)) {
+            return false;
+        }
+        tx->signatures_size = n;
+        tx->signatures = (signature *)blob_read_bytes(r, n * sizeof(signature));
+    } else if (tx->prefix.version == 2) {
+        if (!blob_read_byte(r, &tx->rct_type) || (in_block && tx->rct_type != 0)) {
+            return false;
+        }
+        tx->rct_base_size = 1;
+        if (tx->rct_type != RCT_TYPE_NULL) {
+            const uint8_t *base = r->pos;
+            if (!skip_rct_base(r, tx->rct_type, tx->prefix.vin_size, tx->prefix.vout_size)) {
+                return false;
+            }
+            tx->rct_base_size += r->pos - base;
+            tx->rct_signatures = base;
+            tx->rct_signatures_size = r->end - base;
+            r->pos = r->end;
+        }
+    } else {
+        return false;
+    }
+
+    tx->blob_size = r->pos - begin;
+    tx->blob_size_valid = CACHE_VALID;
+    tx->hash_valid = CACHE_EMPTY;
+    tx->prefix_hash_valid = CACHE_EMPTY;
+    tx->prunable_hash_valid = CACHE_EMPTY;
+    return true;
+}
+
+bool parse_and_validate_tx_from_blob(const void *blob, size_t size, arena *a, transaction *tx) {
+    blob_reader r;
+    blob_reader_init(&r, blob, size);
+    return read_transaction(&r, a, tx, false) && r.pos == r.end;
+}
+
+bool parse_tx_prefix_from_blob(const void *blob, size_t size, arena *a, transaction_prefix *prefix) {
+    blob_reader r;
+    blob_reader_init(&r, blob, size);
+    return read_transaction_prefix(&r, a, prefix);
+}
+
+bool parse_and_validate_block_from_blob(const void *blob, size_t size, arena *a, block *b) {
+    blob_reader r;
+    uint64_t n;
+
+    blob_reader_init(&r, blob, size);
+    if (!parse_block_header(&r, &b->header) || !read_transaction(&r, a, &b->miner_tx, true)) {
+        return false;
+    }
+    if (!blob_read_count(&r, sizeof(hash), &n)) {
+        return false;
+    }
+    b->tx_hashes_size = n;
+    b->tx_hashes = (hash *)blob_read_bytes(&r, n * sizeof(hash));
+    b->blob = blob;
+    b->blob_size = size;
+    b->blob_size_valid = CACHE_VALID;
+    b->hash_valid = CACHE_EMPTY;
+    return b->tx_hashes != NULL && r.pos == r.end;
+}
+
+/*
+ * The hashes below are computed at most once per tx or block. The first
+ * caller moves the valid flag from CACHE_EMPTY to CACHE_BUSY, computes the
+ * value and publishes it with CACHE_VALID; concurrent callers wait for that
+ * instead of hashing again.
+ */
+static bool cache_claim(gint *valid) {
+    for (;;) {
+        const gint state = g_atomic_int_get(valid);
+        if (state == CACHE_VALID) {
+            return false;
+        }
+        if (state == CACHE_EMPTY && g_atomic_int_compare_and_exchange(valid, CACHE_EMPTY, CACHE_BUSY)) {
+            return true;
+        }
+        if (state == CACHE_BUSY) {
+            g_thread_yield();
+        }
+    }
+}
+
+static inline void cache_publish(gint *valid) {
+    g_atomic_int_set(valid, CACHE_VALID);
+}
+
+bool get_transaction_prefix_hash(transaction *tx, hash *h) {
+    if (!tx->blob) {
+        return false;
+    }
+    if (cache_claim(&tx->prefix_hash_valid)) {
+        cn_fast_hash(tx->blob, tx->prefix_size, tx->prefix_hash.data);
+        cache_publish(&tx->prefix_hash_valid);
+    }
+    *h = tx->prefix_hash;
+    return true;
+}
+
+bool get_transaction_prunable_hash(transaction *tx, hash *h) {
+    if (!tx->blob || tx->prefix.version < 2) {
+        return false;
+    }
+    if (cache_claim(&tx->prunable_hash_valid)) {
+        const size_t offset = tx->prefix_size + tx->rct_base_size;
+        if (tx->rct_type == RCT_TYPE_NULL) {
+            memset(&tx->prunable_hash, 0, sizeof(hash));
+        } else {
+            cn_fast_hash(tx->blob + offset, tx->blob_size - offset, tx->prunable_hash.data);
+        }
+        cache_publish(&tx->prunable_hash_valid);
+    }
+    *h = tx->prunable_hash;
+    return true;
+}
+
+// v1: the hash of the blob, v2: the hash of the prefix, rctSigBase and prunable hashes
+bool get_transaction_hash(transaction *tx, hash *h) {
+    if (!tx->blob) {
+        return false;
+    }
+    if (cache_claim(&tx->hash_valid)) {
+        if (tx->prefix.version == 1) {
+            cn_fast_hash(tx->blob, tx->blob_size, tx->hash.data);
+        } else {
+            hash hashes[3];
+            get_transaction_prefix_hash(tx, &hashes[0]);
+            cn_fast_hash(tx->blob + tx->prefix_size, tx->rct_base_size, hashes[1].data);
+            get_transaction_prunable_hash(tx, &hashes[2]);
+            cn_fast_hash(hashes, sizeof(hashes), tx->hash.data);
+        }
+        cache_publish(&tx->hash_valid);
+    }
+    *h = tx->hash;
+    return true;
+}
+
+bool get_transaction_blob_size(const transaction *tx, size_t *size) {
+    if (g_atomic_int_get(&tx->blob_size_valid) != CACHE_VALID) {
+        return false;
+    }
+    *size = tx->blob_size;
+    return true;
+}
+
+// the block 202612 that was mined with a different hash because of a tree hash bug
+static const hash block_202612_hash = { {
+    0x84, 0xf6, 0x47, 0x66, 0x47, 0x5d, 0x51, 0x83, 0x7a, 0xc9, 0xef, 0xbe, 0xf1, 0x92, 0x64, 0x86,
+    0xe5, 0x85, 0x63, 0xc9, 0x5a, 0x19, 0xfe, 0xf4, 0xae, 0xc3, 0x25, 0x4f, 0x03, 0x00, 0x00, 0x00
+} };
+
+// the header, the tree hash of the miner tx and tx hashes, and the number of txs
+static size_t get_block_hashing_blob(block *b, uint8_t *out, size_t out_size) {
+    const size_t header_size = b->miner_tx.blob - b->blob;
+    hash *hashes;
+    size_t n;
+
+    if (header_size + sizeof(hash) + VARINT_MAX_SIZE > out_size) {
+        return 0;
+    }
+    hashes = g_new(hash, b->tx_hashes_size + 1);
+    get_transaction_hash(&b->miner_tx, &hashes[0]);
+    memcpy(hashes + 1, b->tx_hashes, b->tx_hashes_size * sizeof(hash));
+    memcpy(out, b->blob, header_size);
+    tree_hash((const char (*)[HASH_SIZE])hashes, b->tx_hashes_size + 1, (char *)out + header_size);
+    n = header_size + sizeof(hash);
+    n += write_varint(out + n, b->tx_hashes_size + 1);
+    g_free(hashes);
+    return n;
+}
+
+bool get_block_hash(block *b, hash *h) {
+    if (!b->blob) {
+        return false;
+    }
+    if (cache_claim(&b->hash_valid)) {
+        uint8_t buf[VARINT_MAX_SIZE + 256];
+        const size_t n = get_block_hashing_blob(b, buf + VARINT_MAX_SIZE, sizeof(buf) - VARINT_MAX_SIZE);
+        const transaction_prefix *miner = &b->miner_tx.prefix;
+
+        if (n != 0) {
+            // hashed as a length prefixed string
+            uint8_t prefix[VARINT_MAX_SIZE];
+            const size_t m = write_varint(prefix, n);
+            memcpy(buf + VARINT_MAX_SIZE - m, prefix, m);
+            cn_fast_hash(buf + VARINT_MAX_SIZE - m, m + n, b->hash.data);
+        } else {
+            memset(&b->hash, 0, sizeof(hash));
+        }
+        if (miner->vin_size == 1 && miner->vin[0].tag == TXIN_GEN_TAG && miner->vin[0].gen.height == 202612) {
+            b->hash = block_202612_hash;
+        }
+        cache_publish(&b->hash_valid);
+    }
+    *h = b->hash;
+    return true;
+}
+
+bool get_block_blob_size(const block *b, size_t *size) {
+    if (g_atomic_int_get(&b->blob_size_valid) != CACHE_VALID) {
+        return false;
+    }
+    *size = b->blob_size;
+    return true;
+}
+
+void get_txin_to_key_soa(const transaction_prefix *const *txs, size_t n, arena *a, txin_to_key_soa *soa) {
+    size_t inputs = 0, offsets = 0, k = 0;
+
+    for (size_t t = 0; t < n; t++) {
+        for (size_t i = 0; i < txs[t]->vin_size; i++) {
+            if (txs[t]->vin[i].tag == TXIN_TO_KEY_TAG) {
+                inputs++;
+                offsets += txs[t]->vin[i].key.key_offsets_size;
+            }
+        }
+    }
+    soa->size = inputs;
+    soa->tx = arena_new(a, uint32_t, inputs);
+    soa->amount = arena_new(a, uint64_t, inputs);
+    soa->k_image = arena_new(a, key_image, inputs);
+    soa->key_offsets_begin = arena_new(a, size_t, inputs + 1);
+    soa->key_offsets = arena_new(a, uint64_t, offsets);
+
+    soa->key_offsets_begin[0] = 0;
+    for (size_t t = 0; t < n; t++) {
+        for (size_t i = 0; i < txs[t]->vin_size; i++) {
+            const txin_to_key *in = &txs[t]->vin[i].key;
+            if (txs[t]->vin[i].tag != TXIN_TO_KEY_TAG) {
+                continue;
+            }
+            soa->tx[k] = (uint32_t)t;
+            soa->amount[k] = in->amount;
+            soa->k_image[k] = in->k_image;
+            memcpy(soa->key_offsets + soa->key_offsets_begin[k], in->key_offsets, in->key_offsets_size * sizeof(uint64_t));
+            soa->key_offsets_begin[k + 1] = soa->key_offsets_begin[k] + in->key_offsets_size;
+            k++;
+        }
+    }
+}
+
+void get_txout_to_key_soa(const transaction_prefix *const *txs, size_t n, arena *a, txout_to_key_soa *soa) {
+    size_t outputs = 0, k = 0;
+
+    for (size_t t = 0; t < n; t++) {
+        for (size_t i = 0; i < txs[t]->vout_size; i++) {
+            outputs += txs[t]->vout[i].target.tag == TXOUT_TO_KEY_TAG;
+        }
+    }
+    soa->size = outputs;
+    soa->tx = arena_new(a, uint32_t, outputs);
+    soa->amount = arena_new(a, uint64_t, outputs);
+    soa->key = arena_new(a, public_key, outputs);
+
+    for (size_t t = 0; t < n; t++) {
+        for (size_t i = 0; i < txs[t]->vout_size; i++) {
+            const tx_out *out = &txs[t]->vout[i];
+            if (out->target.tag != TXOUT_TO_KEY_TAG) {
+                continue;
+            }
+            soa->tx[k] = (uint32_t)t;
+            soa->amount[k] = out->amount;
+            soa->key[k] = out->target.key.key;
+            k++;
+        }
+    }
+}
+
+bool relative_output_offsets_to_absolute(uint64_t *offsets, size_t n) {
+    uint64_t sum = 0;
+    bool overflow = false;
+
+    // no early exit, so the loop stays a straight add chain
+    for (size_t i = 0; i < n; i++) {
+        overflow |= __builtin_add_overflow(sum, offsets[i], &sum);
+        offsets[i] = sum;
+    }
+    return !overflow;
+}
+
+bool txin_to_key_soa_absolute_offsets(txin_to_key_soa *soa) {
+    bool ok = true;
+    for (size_t k = 0; k < soa->size; k++) {
+        const size_t begin = soa->key_offsets_begin[k];
+        ok &= relative_output_offsets_to_absolute(soa->key_offsets + begin, soa->key_offsets_begin[k + 1] - begin);
+    }
+    return ok;
+}
+
+/* walks the tx extra fields, calling f on each with its payload */
+typedef bool (*tx_extra_field_func)(uint8_t tag, blob_reader *field, void *user);
+
+static bool for_each_tx_extra_field(const uint8_t *extra, size_t extra_size, tx_extra_field_func f, void *user) {
+    blob_reader r;
+    uint8_t tag;
+    uint64_t n;
+
+    blob_reader_init(&r, extra, extra_size);
+    while (blob_read_byte(&r, &tag)) {
+        blob_reader field = r;
+        switch (tag) {
+        case TX_EXTRA_TAG_PADDING:
+            // zeros up to the end
+            return true;
+        case TX_EXTRA_TAG_PUBKEY:
+            if (!blob_read_bytes(&r, sizeof(public_key))) {
+                return false;
+            }
+            break;
+        case TX_EXTRA_NONCE:
+            // a string, so its length is a varint
+            if (!skip_byte_vector(&r)) {
+                return false;
+            }
+            break;
+        case TX_EXTRA_TAG_ADDITIONAL_PUBKEYS:
+            if (!blob_read_count(&r, sizeof(public_key), &n) || !blob_read_bytes(&r, n * sizeof(public_key))) {
+                return false;
+            }
+            break;
+        case TX_EXTRA_MERGE_MINING_TAG:
+        case TX_EXTRA_MYSTERIOUS_MINERGATE_TAG:
+            if (!skip_byte_vector(&r)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+        field.end = r.pos;
+        if (!f(tag, &field, user)) {
+            return true;
+        }
+    }
+    return true;
+}
+
+static bool find_pub_key(uint8_t tag, blob_reader *field, void *user) {
+    const uint8_t **found = user;
+    if (tag == TX_EXTRA_TAG_PUBKEY) {
+        *found = field->pos;
+        return false;
+    }
+    return true;
+}
+
+bool get_tx_pub_key_from_extra(const uint8_t *extra, size_t extra_size, public_key *pub) {
+    const uint8_t *found = NULL;
+    for_each_tx_extra_field(extra, extra_size, find_pub_key, &found);
+    if (!found) {
+        return false;
+    }
+    memcpy(pub->data, found, sizeof(public_key));
+    return true;
+}
+
+static bool find_additional_pub_keys(uint8_t tag, blob_reader *field, void *user) {
+    blob_reader *found = user;
+    if (tag == TX_EXTRA_TAG_ADDITIONAL_PUBKEYS) {
+        *found = *field;
+        return false;
+    }
+    return true;
+}
+
+bool get_additional_tx_pub_keys_from_extra(const uint8_t *extra, size_t extra_size, const public_key **keys, size_t *keys_size) {
+    blob_reader found = { NULL, NULL };
+    uint64_t n;
+
+    for_each_tx_extra_field(extra, extra_size, find_additional_pub_keys, &found);
+    if (!found.pos || !blob_read_varint(&found, &n)) {
+        *keys = NULL;
+        *keys_size = 0;
+        return false;
+    }
+    *keys = (const public_key *)found.pos;
+    *keys_size = n;
+    return true;
+}
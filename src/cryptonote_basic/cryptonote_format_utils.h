@@ -0,0 +1,122 @@
+#ifndef MONERO_CRYPTONOTE_BASIC_CRYPTONOTE_FORMAT_UTILS_H_
+#define MONERO_CRYPTONOTE_BASIC_CRYPTONOTE_FORMAT_UTILS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+#include "common/arena.h"
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+
+#define TX_EXTRA_TAG_PADDING                0x00
+#define TX_EXTRA_TAG_PUBKEY                 0x01
+#define TX_EXTRA_NONCE                      0x02
+#define TX_EXTRA_MERGE_MINING_TAG           0x03
+#define TX_EXTRA_TAG_ADDITIONAL_PUBKEYS     0x04
+#define TX_EXTRA_MYSTERIOUS_MINERGATE_TAG   0xDE
+
+#define TXIN_GEN_TAG            0xff
+#define TXIN_TO_SCRIPT_TAG      0x00
+#define TXIN_TO_SCRIPTHASH_TAG  0x01
+#define TXIN_TO_KEY_TAG         0x02
+#define TXOUT_TO_SCRIPT_TAG     0x00
+#define TXOUT_TO_SCRIPTHASH_TAG 0x01
+#define TXOUT_TO_KEY_TAG        0x02
+
+#define RCT_TYPE_NULL             0
+#define RCT_TYPE_FULL             1
+#define RCT_TYPE_SIMPLE           2
+#define RCT_TYPE_BULLETPROOF      3
+#define RCT_TYPE_BULLETPROOF2     4
+#define RCT_TYPE_CLSAG            5
+#define RCT_TYPE_BULLETPROOF_PLUS 6
+
+// a read position in a serialized blob
+typedef struct blob_reader {
+    const uint8_t *pos;
+    const uint8_t *end;
+} blob_reader;
+
+void blob_reader_init(blob_reader *r, const void *data, size_t size);
+bool blob_read_varint(blob_reader *r, uint64_t *v);
+// n bytes in place, NULL if the blob is shorter
+const uint8_t *blob_read_bytes(blob_reader *r, size_t n);
+
+/*
+ * Views of serialized txs and blocks. Keys, hashes and extra point into the
+ * blob, which must outlive the view.
+ */
+typedef struct tx_out_ref {
+    uint64_t amount;
+    const public_key *key;  // NULL unless the target is txout_to_key
+} tx_out_ref;
+
+typedef struct tx_prefix_ref {
+    uint64_t version;
+    uint64_t unlock_time;
+    size_t vin_size;
+    size_t key_offsets_size;  // summed over the txin_to_key inputs
+    GArray *vout;             // tx_out_ref, owned by the caller
+    const uint8_t *extra;
+    size_t extra_size;
+} tx_prefix_ref;
+
+typedef struct block_ref {
+    block_header header;
+    tx_prefix_ref miner_tx;
+    const hash *tx_hashes;
+    size_t tx_hashes_size;
+} block_ref;
+
+// parses only the header at the start of a block blob
+bool parse_block_header(blob_reader *r, block_header *header);
+// parses a tx prefix, appending its outputs to tx->vout
+bool parse_tx_prefix_ref(blob_reader *r, tx_prefix_ref *tx);
+// parses a block, miner tx outputs are appended to b->miner_tx.vout
+bool parse_block_ref(blob_reader *r, block_ref *b);
+
+/*
+ * Parse a whole tx or block blob into the structs of cryptonote_basic.h.
+ * Arrays that need decoding (vin, vout, key offsets) are allocated in a,
+ * while extra, scripts, signatures and tx hashes point into the blob, so
+ * the blob must outlive the result and a single arena_reset() frees what a
+ * block needed. Trailing bytes are an error.
+ */
+bool parse_and_validate_tx_from_blob(const void *blob, size_t size, arena *a, transaction *tx);
+bool parse_and_validate_block_from_blob(const void *blob, size_t size, arena *a, block *b);
+// only the prefix, so the rest of the blob may be anything (a pruned tx)
+bool parse_tx_prefix_from_blob(const void *blob, size_t size, arena *a, transaction_prefix *prefix);
+
+/*
+ * Hashes and blob sizes of parsed txs and blocks, computed on first use from
+ * the blob and cached in the struct. Safe to call from several threads on
+ * the same tx or block; each value is computed once. False if the tx or
+ * block was not parsed from a blob (or, for the prunable hash, is v1).
+ */
+bool get_transaction_prefix_hash(transaction *tx, hash *h);
+bool get_transaction_prunable_hash(transaction *tx, hash *h);
+bool get_transaction_hash(transaction *tx, hash *h);
+bool get_transaction_blob_size(const transaction *tx, size_t *size);
+bool get_block_hash(block *b, hash *h);
+bool get_block_blob_size(const block *b, size_t *size);
+
+// copy the to_key inputs / outputs of n txs into structure of arrays form in a
+void get_txin_to_key_soa(const transaction_prefix *const *txs, size_t n, arena *a, txin_to_key_soa *soa);
+void get_txout_to_key_soa(const transaction_prefix *const *txs, size_t n, arena *a, txout_to_key_soa *soa);
+
+/*
+ * Key offsets are stored relative, the first absolute and each later one a
+ * delta from the previous; these turn them into absolute amount indices in
+ * place. False if an index overflows. The soa version converts every input
+ * of the batch in one pass over the flattened offsets.
+ */
+bool relative_output_offsets_to_absolute(uint64_t *offsets, size_t n);
+bool txin_to_key_soa_absolute_offsets(txin_to_key_soa *soa);
+
+bool get_tx_pub_key_from_extra(const uint8_t *extra, size_t extra_size, public_key *pub);
+// the per output tx keys of txs to subaddresses, in place
+bool get_additional_tx_pub_keys_from_extra(const uint8_t *extra, size_t extra_size, const public_key **keys, size_t *keys_size);
+
+#endif //MONERO_CRYPTONOTE_BASIC_CRYPTONOTE_FORMAT_UTILS_H_
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cryptonote_config.h"
+#include "difficulty.h"
+
+G_STATIC_ASSERT(DIFFICULTY_WINDOW >= 2);
+G_STATIC_ASSERT(2 * DIFFICULTY_CUT <= DIFFICULTY_WINDOW - 2);
+
+// the sorted positions [*cut_begin, *cut_end) left after cutting the outliers
+static void difficulty_cut(size_t length, size_t *cut_begin, size_t *cut_end) {
+    if (length <= DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT) {
+        *cut_begin = 0;
+        *cut_end = length;
+    } else {
+        *cut_begin = (length - (DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT) + 1) / 2;
+        *cut_end = *cut_begin + (DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT);
+    }
+    g_assert(*cut_begin + 2 <= *cut_end && *cut_end <= length);
+}
+
+static difficulty_type difficulty_from_work(difficulty_type total_work, uint64_t time_span, size_t target_seconds) {
+    const unsigned __int128 work = (unsigned __int128)total_work * target_seconds;
+
+    if (time_span == 0) {
+        time_span = 1;
+    }
+    // the rounding term must fit in 64 bits as well, as in the reference
+    // implementation, or the result would differ near the limit
+    if (work > UINT64_MAX - (time_span - 1)) {
+        return 0;
+    }
+    return (difficulty_type)((work + time_span - 1) / time_span);
+}
+
+static int compare_timestamps(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+difficulty_type next_difficulty(const uint64_t *timestamps, const difficulty_type *cumulative_difficulties, size_t length, size_t target_seconds) {
+    uint64_t *sorted;
+    size_t cut_begin, cut_end;
+    uint64_t time_span;
+
+    if (length > DIFFICULTY_WINDOW) {
+        length = DIFFICULTY_WINDOW;
+    }
+    if (length <= 1) {
+        return 1;
+    }
+
+    sorted = g_memdup2(timestamps, length * sizeof(uint64_t));
+    qsort(sorted, length, sizeof(uint64_t), compare_timestamps);
+    difficulty_cut(length, &cut_begin, &cut_end);
+    time_span = sorted[cut_end - 1] - sorted[cut_begin];
+    g_free(sorted);
+
+    return difficulty_from_work(cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin], time_span, target_seconds);
+}
+
+static inline difficulty_entry *window_entry(const difficulty_window *w, uint64_t height) {
+    return &w->ring[height % w->capacity];
+}
+
+static gint compare_entries(gconstpointer a, gconstpointer b, gpointer user) {
+    const difficulty_entry *x = a, *y = b;
+    (void)user;
+    return x->timestamp < y->timestamp ? -1 : x->timestamp > y->timestamp;
+}
+
+// the heights next_difficulty looks at for a chain of the given height:
+// the first DIFFICULTY_WINDOW of the last DIFFICULTY_BLOCKS_COUNT blocks,
+// never the genesis block
+static void window_range(uint64_t height, uint64_t *begin, uint64_t *end) {
+    const uint64_t length = height > 1 ? MIN(height - 1, DIFFICULTY_BLOCKS_COUNT) : 0;
+    *begin = height - length;
+    *end = *begin + MIN(length, DIFFICULTY_WINDOW);
+}
+
+static void window_insert(difficulty_window *w, uint64_t height) {
+    difficulty_entry *e = window_entry(w, height);
+    e->sorted = g_sequence_insert_sorted(w->sorted, e, compare_entries, NULL);
+}
+
+static void window_remove(difficulty_window *w, uint64_t height) {
+    difficulty_entry *e = window_entry(w, height);
+    g_sequence_remove(e->sorted);
+    e->sorted = NULL;
+}
+
+// moves the sorted window to the range of the current height, each bound
+// moves by at most one block per push or pop
+static void window_update(difficulty_window *w) {
+    const uint64_t oldest = w->height - w->count;
+    uint64_t begin, end;
+
+    // until enough blocks are pushed after a reset, the window holds what is kept
+    window_range(w->height, &begin, &end);
+    begin = MAX(begin, oldest);
+    end = MAX(end, begin);
+    while (w->end > end && w->end > w->begin) {
+        window_remove(w, --w->end);
+    }
+    while (w->begin < begin && w->begin < w->end) {
+        window_remove(w, w->begin++);
+    }
+    if (w->begin == w->end) {
+        w->begin = w->end = begin;
+    }
+    while (w->begin > begin) {
+        window_insert(w, --w->begin);
+    }
+    while (w->end < end) {
+        window_insert(w, w->end++);
+    }
+}
+
+void difficulty_window_init(difficulty_window *w, size_t target_seconds) {
+    w->capacity = DIFFICULTY_BLOCKS_COUNT + DIFFICULTY_WINDOW_RESERVE;
+    w->ring = g_new0(difficulty_entry, w->capacity);
+    w->sorted = g_sequence_new(NULL);
+    w->target_seconds = target_seconds;
+    w->count = 0;
+    w->height = w->begin = w->end = 0;
+}
+
+void difficulty_window_clear(difficulty_window *w) {
+    g_sequence_free(w->sorted);
+    g_free(w->ring);
+}
+
+void difficulty_window_reset(difficulty_window *w, uint64_t height) {
+    g_sequence_free(w->sorted);
+    w->sorted = g_sequence_new(NULL);
+    memset(w->ring, 0, w->capacity * sizeof(difficulty_entry));
+    w->count = 0;
+    w->height = w->begin = w->end = height;
+}
+
+void difficulty_window_push(difficulty_window *w, uint64_t timestamp, difficulty_type cumulative_difficulty) {
+    difficulty_entry *e = window_entry(w, w->height);
+
+    // the slot is reused from capacity blocks back, far outside the window
+    g_assert(e->sorted == NULL);
+    e->timestamp = timestamp;
+    e->cumulative_difficulty = cumulative_difficulty;
+    w->height++;
+    w->count = MIN(w->count + 1, w->capacity);
+    window_update(w);
+}
+
+bool difficulty_window_pop(difficulty_window *w) {
+    uint64_t begin, end;
+
+    if (w->count == 0) {
+        return false;
+    }
+    window_range(w->height - 1, &begin, &end);
+    if (begin < end && begin < w->height - w->count) {
+        return false;
+    }
+    w->height--;
+    w->count--;
+    window_update(w);
+    return true;
+}
+
+bool difficulty_window_ready(const difficulty_window *w) {
+    uint64_t begin, end;
+    window_range(w->height, &begin, &end);
+    return begin == w->begin && end == w->end;
+}
+
+difficulty_type difficulty_window_next(const difficulty_window *w) {
+    const size_t length = w->end - w->begin;
+    size_t cut_begin, cut_end;
+    const difficulty_entry *lo, *hi;
+
+    if (length <= 1) {
+        return 1;
+    }
+    g_assert(difficulty_window_ready(w));
+    difficulty_cut(length, &cut_begin, &cut_end);
+    lo = g_sequence_get(g_sequence_get_iter_at_pos(w->sorted, (gint)cut_begin));
+    hi = g_sequence_get(g_sequence_get_iter_at_pos(w->sorted, (gint)(cut_end - 1)));
+
+    // the cumulative difficulties are taken by height, not in timestamp order
+    return difficulty_from_work(window_entry(w, w->begin + cut_end - 1)->cumulative_difficulty - window_entry(w, w->begin + cut_begin)->cumulative_difficulty,
+                                hi->timestamp - lo->timestamp, w->target_seconds);
+}
@@ -1,7 +1,59 @@
 #ifndef MONERO_CRYPTONOTE_BASIC_DIFFICULTY_H_
 #define MONERO_CRYPTONOTE_BASIC_DIFFICULTY_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
 typedef uint64_t difficulty_type;
 
+/*
+ * Difficulty of the next block from the timestamps and cumulative
+ * difficulties of the previous blocks, oldest first. Only the first
+ * DIFFICULTY_WINDOW entries are used; their timestamps are sorted and the
+ * DIFFICULTY_CUT outliers on each side dropped. Returns 0 on overflow.
+ */
+difficulty_type next_difficulty(const uint64_t *timestamps, const difficulty_type *cumulative_difficulties, size_t length, size_t target_seconds);
+
+// blocks kept beyond DIFFICULTY_BLOCKS_COUNT so short reorgs pop without a reload
+#define DIFFICULTY_WINDOW_RESERVE 256
+
+typedef struct difficulty_entry {
+    uint64_t timestamp;
+    difficulty_type cumulative_difficulty;
+    GSequenceIter *sorted;  // in the sorted window, NULL if outside of it
+} difficulty_entry;
+
+/*
+ * The inputs of next_difficulty kept up to date block by block: the last
+ * blocks of the chain in a ring and the timestamps of the difficulty window
+ * in a balanced tree, so pushing or popping a block costs O(log n) and
+ * next_difficulty needs no sort.
+ */
+typedef struct difficulty_window {
+    difficulty_entry *ring;
+    size_t capacity;
+    size_t count;          // blocks in the ring, the last one at height - 1
+    uint64_t height;       // chain height, the height of the next block
+    uint64_t begin, end;   // heights of the blocks in the sorted window
+    GSequence *sorted;     // difficulty_entry, by timestamp
+    size_t target_seconds;
+} difficulty_window;
+
+void difficulty_window_init(difficulty_window *w, size_t target_seconds);
+void difficulty_window_clear(difficulty_window *w);
+// empties the window of a chain whose next block is at height
+void difficulty_window_reset(difficulty_window *w, uint64_t height);
+
+// appends the block at w->height
+void difficulty_window_push(difficulty_window *w, uint64_t timestamp, difficulty_type cumulative_difficulty);
+// removes the top block; false (and no change) if a block that would
+// re-enter the window is no longer kept, the window must be reloaded then
+bool difficulty_window_pop(difficulty_window *w);
+
+// whether every block of the window is kept, as needed by difficulty_window_next
+bool difficulty_window_ready(const difficulty_window *w);
+difficulty_type difficulty_window_next(const difficulty_window *w);
 
 #endif //MONERO_CRYPTONOTE_BASIC_DIFFICULTY_H_
@@ -3,4 +3,13 @@
 #define CRYPTONOTE_BLOCKCHAINDATA_FILENAME      "data.mdb"
 #define CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME "lock.mdb"
 #define P2P_NET_DATA_FILENAME                   "p2pstate.bin"
-#define MINER_CONFIG_FILE_NAME                  "miner_conf.json"
\ No newline at end of file
+#define MINER_CONFIG_FILE_NAME                  "miner_conf.json"
+
+#define CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE     10   // blocks
+
+#define DIFFICULTY_TARGET_V2                    120  // seconds
+#define DIFFICULTY_TARGET_V1                    60   // seconds - before first fork
+#define DIFFICULTY_WINDOW                       720  // blocks
+#define DIFFICULTY_LAG                          15   // !!!
+#define DIFFICULTY_CUT                          60   // timestamps to cut after sorting
+#define DIFFICULTY_BLOCKS_COUNT                 (DIFFICULTY_WINDOW + DIFFICULTY_LAG)
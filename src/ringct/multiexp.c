@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "multiexp.h"
+
+bool multiexp_data_init(multiexp_data *data, const key *scalar, const key *point) {
+    data->scalar = *scalar;
+    return ge_frombytes_vartime(&data->point, point->bytes) == 0;
+}
+
+void multiexp_data_init_p3(multiexp_data *data, const key *scalar, const ge_p3 *point) {
+    data->scalar = *scalar;
+    data->point = *point;
+}
+
+static inline void ge_p3_add_cached(ge_p3 *r, const ge_p3 *p, const ge_cached *q) {
+    ge_p1p1 t;
+    ge_add(&t, p, q);
+    ge_p1p1_to_p3(r, &t);
+}
+
+static inline void ge_p3_sub_cached(ge_p3 *r, const ge_p3 *p, const ge_cached *q) {
+    ge_p1p1 t;
+    ge_sub(&t, p, q);
+    ge_p1p1_to_p3(r, &t);
+}
+
+static inline void ge_p3_add_p3(ge_p3 *r, const ge_p3 *p, const ge_p3 *q) {
+    ge_cached c;
+    ge_p3_to_cached(&c, q);
+    ge_p3_add_cached(r, p, &c);
+}
+
+static void ge_p3_dbl_n(ge_p3 *r, size_t n) {
+    ge_p2 p2;
+    ge_p1p1 t;
+    ge_p3_to_p2(&p2, r);
+    for (size_t i = 0; i < n; i++) {
+        ge_p2_dbl(&t, &p2);
+        if (i + 1 < n) {
+            ge_p1p1_to_p2(&p2, &t);
+        }
+    }
+    ge_p1p1_to_p3(r, &t);
+}
+
+/* signed radix-16 digits in [-8, 8), valid for scalars below 2^255 */
+static void recode_radix16(signed char *e, const unsigned char *a) {
+    int carry = 0;
+    for (int i = 0; i < 32; i++) {
+        e[2 * i + 0] = a[i] & 15;
+        e[2 * i + 1] = (a[i] >> 4) & 15;
+    }
+    for (int i = 0; i < 63; i++) {
+        e[i] += carry;
+        carry = (e[i] + 8) >> 4;
+        e[i] -= carry << 4;
+    }
+    e[63] += carry;
+}
+
+void straus(ge_p3 *r, const multiexp_data *data, size_t n) {
+    ge_cached *pre;
+    signed char *digits;
+    bool started = false;
+
+    ge_p3_0(r);
+    if (n == 0) {
+        return;
+    }
+
+    // P, 2P, ..., 8P for every term
+    pre = g_new(ge_cached, n * 8);
+    digits = g_new(signed char, n * 64);
+    for (size_t j = 0; j < n; j++) {
+        ge_cached *pj = pre + j * 8;
+        ge_p3 acc = data[j].point;
+        ge_p3_to_cached(&pj[0], &acc);
+        for (int k = 1; k < 8; k++) {
+            ge_p3_add_cached(&acc, &acc, &pj[0]);
+            ge_p3_to_cached(&pj[k], &acc);
+        }
+        recode_radix16(digits + j * 64, data[j].scalar.bytes);
+    }
+
+    for (int i = 63; i >= 0; i--) {
+        if (started) {
+            ge_p3_dbl_n(r, 4);
+        }
+        for (size_t j = 0; j < n; j++) {
+            const signed char d = digits[j * 64 + i];
+            if (d > 0) {
+                ge_p3_add_cached(r, r, &pre[j * 8 + d - 1]);
+                started = true;
+            } else if (d < 0) {
+                ge_p3_sub_cached(r, r, &pre[j * 8 - d - 1]);
+                started = true;
+            }
+        }
+    }
+
+    g_free(digits);
+    g_free(pre);
+}
+
+size_t get_pippenger_c(size_t n) {
+    if (n <= 13) return 2;
+    if (n <= 29) return 3;
+    if (n <= 83) return 4;
+    if (n <= 185) return 5;
+    if (n <= 465) return 6;
+    if (n <= 1180) return 7;
+    if (n <= 2295) return 8;
+    return 9;
+}
+
+static inline unsigned int get_window(const unsigned char *s, size_t start, size_t c) {
+    const size_t byte = start >> 3;
+    uint32_t v = 0;
+    for (size_t k = 0; k < 3 && byte + k < 32; k++) {
+        v |= (uint32_t)s[byte + k] << (8 * k);
+    }
+    return (v >> (start & 7)) & ((1u << c) - 1);
+}
+
+static int top_bit(const multiexp_data *data, size_t n) {
+    unsigned char all[32] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        for (int k = 0; k < 32; k++) {
+            all[k] |= data[i].scalar.bytes[k];
+        }
+    }
+    for (int k = 31; k >= 0; k--) {
+        if (all[k]) {
+            return k * 8 + 31 - __builtin_clz(all[k]);
+        }
+    }
+    return -1;
+}
+
+void pippenger(ge_p3 *r, const multiexp_data *data, size_t n, size_t c) {
+    const size_t nbuckets = (size_t)1 << c;
+    ge_cached *cache;
+    ge_p3 *buckets;
+    bool *used;
+    bool result_set = false;
+    int top;
+
+    ge_p3_0(r);
+    top = top_bit(data, n);
+    if (n == 0 || top < 0) {
+        return;
+    }
+
+    cache = g_new(ge_cached, n);
+    for (size_t i = 0; i < n; i++) {
+        ge_p3_to_cached(&cache[i], &data[i].point);
+    }
+    buckets = g_new(ge_p3, nbuckets);
+    used = g_new(bool, nbuckets);
+
+    for (size_t start = ((size_t)top / c) * c; ; start -= c) {
+        ge_p3 running, total;
+        bool running_set = false, total_set = false;
+
+        if (result_set) {
+            ge_p3_dbl_n(r, c);
+        }
+
+        memset(used, 0, nbuckets * sizeof(bool));
+        for (size_t i = 0; i < n; i++) {
+            const unsigned int d = get_window(data[i].scalar.bytes, start, c);
+            if (d == 0) {
+                continue;
+            }
+            if (!used[d]) {
+                buckets[d] = data[i].point;
+                used[d] = true;
+            } else {
+                ge_p3_add_cached(&buckets[d], &buckets[d], &cache[i]);
+            }
+        }
+
+        // sum_j j * bucket[j] as a running sum of running sums
+        for (size_t j = nbuckets - 1; j > 0; j--) {
+            if (used[j]) {
+                if (running_set) {
+                    ge_p3_add_p3(&running, &running, &buckets[j]);
+                } else {
+                    running = buckets[j];
+                    running_set = true;
+                }
+            }
+            if (running_set) {
+                if (total_set) {
+                    ge_p3_add_p3(&total, &total, &running);
+                } else {
+                    total = running;
+                    total_set = true;
+                }
+            }
+        }
+
+        if (total_set) {
+            if (result_set) {
+                ge_p3_add_p3(r, r, &total);
+            } else {
+                *r = total;
+                result_set = true;
+            }
+        }
+
+        if (start == 0) {
+            break;
+        }
+    }
+
+    g_free(used);
+    g_free(buckets);
+    g_free(cache);
+}
+
+void multiexp_p3(ge_p3 *r, const multiexp_data *data, size_t n) {
+    if (n <= STRAUS_SIZE_LIMIT) {
+        straus(r, data, n);
+    } else {
+        pippenger(r, data, n, get_pippenger_c(n));
+    }
+}
+
+void multiexp(key *r, const multiexp_data *data, size_t n) {
+    ge_p3 p;
+    multiexp_p3(&p, data, n);
+    ge_p3_tobytes(r->bytes, &p);
+}
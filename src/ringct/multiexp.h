@@ -0,0 +1,35 @@
+#ifndef MONERO_RINGCT_MULTIEXP_H_
+#define MONERO_RINGCT_MULTIEXP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "crypto/crypto-ops.h"
+#include "ringct/rctTypes.h"
+
+// above this many terms pippenger beats straus
+#define STRAUS_SIZE_LIMIT 232
+
+typedef struct multiexp_data {
+    key scalar;
+    ge_p3 point;
+} multiexp_data;
+
+// false if point does not decompress
+bool multiexp_data_init(multiexp_data *data, const key *scalar, const key *point);
+void multiexp_data_init_p3(multiexp_data *data, const key *scalar, const ge_p3 *point);
+
+/*
+ * sum(data[i].scalar * data[i].point), all scalars must be reduced mod l.
+ *
+ * straus interleaves signed 4-bit windows of every term and wins for small n;
+ * pippenger sorts the window digits into 2^c buckets so each term costs one
+ * addition per window instead of one per digit, c being picked from n.
+ */
+void straus(ge_p3 *r, const multiexp_data *data, size_t n);
+void pippenger(ge_p3 *r, const multiexp_data *data, size_t n, size_t c);
+size_t get_pippenger_c(size_t n);
+
+void multiexp_p3(ge_p3 *r, const multiexp_data *data, size_t n);
+void multiexp(key *r, const multiexp_data *data, size_t n);
+
+#endif //MONERO_RINGCT_MULTIEXP_H_
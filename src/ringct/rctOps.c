@@ -0,0 +1,152 @@
+#include <string.h>
+#include <glib.h>
+#include "crypto/hash-ops.h"
+#include "crypto/random.h"
+#include "rctOps.h"
+
+const key rct_G = { { 0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+                      0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66 } };
+const key rct_H = { { 0x8b, 0x65, 0x59, 0x70, 0x15, 0x37, 0x99, 0xaf, 0x2a, 0xea, 0xdc, 0x9f, 0xf1, 0xad, 0xd0, 0xea,
+                      0x6c, 0x72, 0x51, 0xd5, 0x41, 0x54, 0xcf, 0xa9, 0x2c, 0x17, 0x3a, 0x0d, 0xd3, 0x9c, 0x1f, 0x94 } };
+
+static const ge_p3 rct_H_point = {
+    { 0x46649386fd873, 0x1d0c4fddf4d0e, 0x73cddc5ab32b3, 0x65c2eab55bf7c, 0x6188ae4072004 },
+    { 0x137157059658b, 0x633fb9d4555f3, 0x545c9b3ab42b7, 0x39654e7aa20ea, 0x141f9cd30d3a1 },
+    { 1, 0, 0, 0, 0 },
+    { 0x6c8160965b85d, 0x6f6cb437a16a2, 0x47e1f8869205f, 0x0c82358720e9a, 0x6391430de06ee }
+};
+
+const ge_p3 *rct_H_p3(void) {
+    return &rct_H_point;
+}
+
+const key *rct_H2(void) {
+    static key H2[ATOMS];
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        ge_p3 p = rct_H_point;
+        ge_p1p1 t;
+        for (int i = 0; i < ATOMS; i++) {
+            ge_p3_tobytes(H2[i].bytes, &p);
+            ge_p3_dbl(&t, &p);
+            ge_p1p1_to_p3(&p, &t);
+        }
+        g_once_init_leave(&initialized, 1);
+    }
+    return H2;
+}
+
+void zero(key *k) {
+    memset(k->bytes, 0, sizeof(k->bytes));
+}
+
+void identity(key *k) {
+    memset(k->bytes, 0, sizeof(k->bytes));
+    k->bytes[0] = 1;
+}
+
+void d2h(key *amounth, xmr_amount val) {
+    zero(amounth);
+    for (int i = 0; val != 0; i++) {
+        amounth->bytes[i] = (unsigned char)(val & 0xff);
+        val >>= 8;
+    }
+}
+
+bool equalKeys(const key *a, const key *b) {
+    return memcmp(a->bytes, b->bytes, sizeof(a->bytes)) == 0;
+}
+
+void skGen(key *sk) {
+    unsigned char tmp[64];
+    generate_random_bytes(sizeof(tmp), tmp);
+    sc_reduce(tmp);
+    memcpy(sk->bytes, tmp, 32);
+}
+
+void weightGen(key *w) {
+    memset(w->bytes, 0, sizeof(w->bytes));
+    generate_random_bytes(16, w->bytes);
+}
+
+void scalarmultBase(key *aG, const key *a) {
+    ge_p3 point;
+    ge_scalarmult_base_vartime(&point, a->bytes);
+    ge_p3_tobytes(aG->bytes, &point);
+}
+
+void zeroCommit(key *C, xmr_amount amount) {
+    const key one = { { 1 } };
+    key am;
+    ge_p2 R;
+    d2h(&am, amount);
+    ge_double_scalarmult_base_vartime(&R, am.bytes, rct_H_p3(), one.bytes);
+    ge_tobytes(C->bytes, &R);
+}
+
+bool scalarmultKey(key *aP, const key *P, const key *a) {
+    ge_p3 A, R;
+    if (ge_frombytes_vartime(&A, P->bytes) != 0) {
+        return false;
+    }
+    ge_scalarmult_vartime(&R, a->bytes, &A);
+    ge_p3_tobytes(aP->bytes, &R);
+    return true;
+}
+
+bool addKeys(key *AB, const key *A, const key *B) {
+    ge_p3 A2, B2;
+    ge_cached tmp2;
+    ge_p1p1 tmp3;
+    if (ge_frombytes_vartime(&A2, A->bytes) != 0 || ge_frombytes_vartime(&B2, B->bytes) != 0) {
+        return false;
+    }
+    ge_p3_to_cached(&tmp2, &B2);
+    ge_add(&tmp3, &A2, &tmp2);
+    ge_p1p1_to_p3(&A2, &tmp3);
+    ge_p3_tobytes(AB->bytes, &A2);
+    return true;
+}
+
+bool subKeys(key *AB, const key *A, const key *B) {
+    ge_p3 A2, B2;
+    ge_cached tmp2;
+    ge_p1p1 tmp3;
+    if (ge_frombytes_vartime(&A2, A->bytes) != 0 || ge_frombytes_vartime(&B2, B->bytes) != 0) {
+        return false;
+    }
+    ge_p3_to_cached(&tmp2, &B2);
+    ge_sub(&tmp3, &A2, &tmp2);
+    ge_p1p1_to_p3(&A2, &tmp3);
+    ge_p3_tobytes(AB->bytes, &A2);
+    return true;
+}
+
+void p3_tobytes(key *out, const ge_p3 *p) {
+    ge_p3_tobytes(out->bytes, p);
+}
+
+bool p3_frombytes(ge_p3 *out, const key *in) {
+    return ge_frombytes_vartime(out, in->bytes) == 0;
+}
+
+void hash_to_scalar(key *out, const void *data, size_t length) {
+    cn_fast_hash(data, length, (char *)out->bytes);
+    sc_reduce32(out->bytes);
+}
+
+void hash_to_p3(ge_p3 *hash8_p3, const key *k) {
+    key hash_key;
+    ge_p2 hash_p2;
+    ge_p1p1 hash8_p1p1;
+    cn_fast_hash(k->bytes, sizeof(key), (char *)hash_key.bytes);
+    ge_fromfe_frombytes_vartime(&hash_p2, hash_key.bytes);
+    ge_mul8(&hash8_p1p1, &hash_p2);
+    ge_p1p1_to_p3(hash8_p3, &hash8_p1p1);
+}
+
+void hashToPoint(key *pointk, const key *hh) {
+    ge_p3 p;
+    hash_to_p3(&p, hh);
+    ge_p3_tobytes(pointk->bytes, &p);
+}
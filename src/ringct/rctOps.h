@@ -0,0 +1,48 @@
+#ifndef MONERO_RINGCT_RCTOPS_H_
+#define MONERO_RINGCT_RCTOPS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "crypto/crypto-ops.h"
+#include "ringct/rctTypes.h"
+
+// the basepoint G and the commitment generator H = 8 * to_point(cn_fast_hash(G))
+extern const key rct_G;
+extern const key rct_H;
+const ge_p3 *rct_H_p3(void);
+// H2[i] = 2^i * H, the per-bit generators of Borromean range proofs
+const key *rct_H2(void);
+
+void zero(key *k);
+void identity(key *k);
+bool equalKeys(const key *a, const key *b);
+// amount as a little endian scalar
+void d2h(key *amounth, xmr_amount val);
+
+// generates a random scalar which can be used as a secret key or mask
+void skGen(key *sk);
+// random 128-bit scalar, enough to weight the equations of a batch
+void weightGen(key *w);
+
+// aG = a * G
+void scalarmultBase(key *aG, const key *a);
+// C = G + amount * H, the commitment of a coinbase or non rct output with a zero mask
+void zeroCommit(key *C, xmr_amount amount);
+// aP = a * P, false if P does not decompress
+bool scalarmultKey(key *aP, const key *P, const key *a);
+// AB = A + B
+bool addKeys(key *AB, const key *A, const key *B);
+// AB = A - B
+bool subKeys(key *AB, const key *A, const key *B);
+
+void p3_tobytes(key *out, const ge_p3 *p);
+bool p3_frombytes(ge_p3 *out, const key *in);
+
+// hash to a scalar mod l
+void hash_to_scalar(key *out, const void *data, size_t length);
+// 8 * to_point(cn_fast_hash(k)), the base of key images
+void hash_to_p3(ge_p3 *hash8_p3, const key *k);
+void hashToPoint(key *pointk, const key *hh);
+
+#endif //MONERO_RINGCT_RCTOPS_H_
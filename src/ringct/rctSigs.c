@@ -0,0 +1,674 @@
+#include <string.h>
+#include "crypto/hash-ops.h"
+#include "rctOps.h"
+#include "rctSigs.h"
+#include "common/arena.h"
+#include "common/threadpool.h"
+
+void rct_equation_init(rct_equation *eq) {
+    zero(&eq->g_scalar);
+    zero(&eq->h_scalar);
+    eq->terms = g_array_new(FALSE, FALSE, sizeof(multiexp_data));
+}
+
+void rct_equation_free(rct_equation *eq) {
+    if (eq->terms) {
+        g_array_free(eq->terms, TRUE);
+        eq->terms = NULL;
+    }
+}
+
+void rct_equation_add_term(rct_equation *eq, const key *scalar, const ge_p3 *point) {
+    multiexp_data data;
+    multiexp_data_init_p3(&data, scalar, point);
+    g_array_append_val(eq->terms, data);
+}
+
+static bool rct_batch_check_range(const rct_equation *eqs, size_t begin, size_t end) {
+    GArray *data;
+    key g_scalar, h_scalar, weight, tmp;
+    multiexp_data term;
+    ge_p3 result;
+    size_t count = 0;
+    const bool single = end - begin == 1;
+
+    for (size_t i = begin; i < end; i++) {
+        count += eqs[i].terms->len;
+    }
+    data = g_array_sized_new(FALSE, FALSE, sizeof(multiexp_data), count + 2);
+
+    zero(&g_scalar);
+    zero(&h_scalar);
+    for (size_t i = begin; i < end; i++) {
+        const rct_equation *eq = &eqs[i];
+        // a lone equation needs no weight
+        if (single) {
+            identity(&weight);
+        } else {
+            weightGen(&weight);
+        }
+        sc_muladd(g_scalar.bytes, eq->g_scalar.bytes, weight.bytes, g_scalar.bytes);
+        sc_muladd(h_scalar.bytes, eq->h_scalar.bytes, weight.bytes, h_scalar.bytes);
+        for (guint j = 0; j < eq->terms->len; j++) {
+            const multiexp_data *src = &g_array_index(eq->terms, multiexp_data, j);
+            sc_mul(tmp.bytes, src->scalar.bytes, weight.bytes);
+            multiexp_data_init_p3(&term, &tmp, &src->point);
+            g_array_append_val(data, term);
+        }
+    }
+    if (sc_isnonzero(g_scalar.bytes)) {
+        multiexp_data_init_p3(&term, &g_scalar, ge_base());
+        g_array_append_val(data, term);
+    }
+    if (sc_isnonzero(h_scalar.bytes)) {
+        multiexp_data_init_p3(&term, &h_scalar, rct_H_p3());
+        g_array_append_val(data, term);
+    }
+
+    multiexp_p3(&result, (const multiexp_data *)data->data, data->len);
+    g_array_free(data, TRUE);
+    return ge_p3_is_point_at_infinity(&result);
+}
+
+bool rct_batch_check(const rct_equation *eqs, size_t n) {
+    if (n == 0) {
+        return true;
+    }
+    return rct_batch_check_range(eqs, 0, n);
+}
+
+/* eqs[begin, end) failed as a whole, find which ones */
+static void rct_batch_bisect(const rct_equation *eqs, const size_t *index, size_t begin, size_t end, GArray *failed) {
+    if (end - begin == 1) {
+        if (failed) {
+            g_array_append_val(failed, index[begin]);
+        }
+        return;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    if (!rct_batch_check_range(eqs, begin, mid)) {
+        rct_batch_bisect(eqs, index, begin, mid, failed);
+    }
+    if (!rct_batch_check_range(eqs, mid, end)) {
+        rct_batch_bisect(eqs, index, mid, end, failed);
+    }
+}
+
+bool rct_batch_verify(const void *const *proofs, size_t n, rct_equation_builder build, void *user, GArray *failed) {
+    rct_equation *eqs;
+    size_t *index;
+    size_t built = 0;
+    bool ret = true;
+
+    if (n == 0) {
+        return true;
+    }
+
+    eqs = g_new(rct_equation, n);
+    index = g_new(size_t, n);
+    for (size_t i = 0; i < n; i++) {
+        rct_equation_init(&eqs[built]);
+        if (!build(proofs[i], &eqs[built], user)) {
+            g_debug("rct_batch_verify: proof %zu is malformed", i);
+            rct_equation_free(&eqs[built]);
+            ret = false;
+            if (failed) {
+                g_array_append_val(failed, i);
+            }
+            continue;
+        }
+        index[built++] = i;
+    }
+
+    if (built > 0 && !rct_batch_check_range(eqs, 0, built)) {
+        ret = false;
+        if (built == 1) {
+            if (failed) {
+                g_array_append_val(failed, index[0]);
+            }
+        } else {
+            rct_batch_bisect(eqs, index, 0, built, failed);
+        }
+    }
+
+    for (size_t i = 0; i < built; i++) {
+        rct_equation_free(&eqs[i]);
+    }
+    g_free(index);
+    g_free(eqs);
+    return ret;
+}
+
+/* Commitment balance */
+
+// sum(pseudoOuts) - sum(outPk.mask) - txnFee * H == 0
+static bool balance_equation(const void *proof, rct_equation *eq, void *user) {
+    const rctSigBase *rv = proof;
+    key one, minus_one, fee;
+    ge_p3 P;
+
+    (void)user;
+    if (rv->pseudoOuts.keysSize == 0) {
+        return false;
+    }
+    identity(&one);
+    zero(&minus_one);
+    sc_sub(minus_one.bytes, minus_one.bytes, one.bytes);
+    for (size_t i = 0; i < rv->pseudoOuts.keysSize; i++) {
+        if (!p3_frombytes(&P, &rv->pseudoOuts.keys[i])) {
+            return false;
+        }
+        rct_equation_add_term(eq, &one, &P);
+    }
+    for (size_t i = 0; i < rv->outPk.keysSize; i++) {
+        if (!p3_frombytes(&P, &rv->outPk.keys[i].mask)) {
+            return false;
+        }
+        rct_equation_add_term(eq, &minus_one, &P);
+    }
+    d2h(&fee, rv->txnFee);
+    sc_sub(eq->h_scalar.bytes, eq->h_scalar.bytes, fee.bytes);
+    return true;
+}
+
+bool verRctBalance(const rctSigBase *rv) {
+    return verRctBalances(&rv, 1, NULL);
+}
+
+bool verRctBalances(const rctSigBase *const *rvs, size_t n, GArray *failed) {
+    return rct_batch_verify((const void *const *)rvs, n, balance_equation, NULL, failed);
+}
+
+/* Borromean range proofs */
+
+#define BORROMEAN_CHUNK 8
+#define BORROMEAN_CHUNKS (ATOMS / BORROMEAN_CHUNK)
+
+// Lv1[i] for bits [begin, begin + count) of bb, P1/P2 indexed from begin
+static void borromean_bits(const boroSig *bb, const ge_p3 *P1, const ge_p3 *P2, size_t begin, size_t count, key *Lv1) {
+    ge_p2 L[ATOMS];
+    key LL[ATOMS];
+    key chash;
+
+    for (size_t i = 0; i < count; i++) {
+        ge_double_scalarmult_base_vartime(&L[i], bb->ee.bytes, &P1[i], bb->s0[begin + i].bytes);
+    }
+    ge_p2_batch_tobytes(LL[0].bytes, L, count);
+    for (size_t i = 0; i < count; i++) {
+        hash_to_scalar(&chash, &LL[i], sizeof(key));
+        ge_double_scalarmult_base_vartime(&L[i], chash.bytes, &P2[i], bb->s1[begin + i].bytes);
+    }
+    ge_p2_batch_tobytes(Lv1[0].bytes, L, count);
+}
+
+static bool borromean_challenge(const boroSig *bb, const key *Lv1) {
+    key eeComputed;
+    hash_to_scalar(&eeComputed, Lv1, ATOMS * sizeof(key));
+    return equalKeys(&eeComputed, &bb->ee);
+}
+
+bool verifyBorromean(const boroSig *bb, const ge_p3 *P1, const ge_p3 *P2) {
+    key Lv1[ATOMS];
+    borromean_bits(bb, P1, P2, 0, ATOMS, Lv1);
+    return borromean_challenge(bb, Lv1);
+}
+
+typedef struct range_job {
+    const key *C;
+    const rangeSig *as;
+    key Lv1[ATOMS];
+    ge_p3 sum[BORROMEAN_CHUNKS];  // per chunk sum of the Ci
+    gint bad;                     // a Ci did not decompress
+} range_job;
+
+typedef struct range_task {
+    range_job *job;
+    size_t chunk;
+} range_task;
+
+static const ge_cached *rct_H2_cached(void) {
+    static ge_cached H2[ATOMS];
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        const key *H2k = rct_H2();
+        ge_p3 p;
+        for (size_t i = 0; i < ATOMS; i++) {
+            p3_frombytes(&p, &H2k[i]);
+            ge_p3_to_cached(&H2[i], &p);
+        }
+        g_once_init_leave(&initialized, 1);
+    }
+    return H2;
+}
+
+static void range_chunk(gpointer data) {
+    const range_task *task = data;
+    range_job *job = task->job;
+    const rangeSig *as = job->as;
+    const ge_cached *H2 = rct_H2_cached();
+    const size_t begin = task->chunk * BORROMEAN_CHUNK;
+    ge_p3 Ci[BORROMEAN_CHUNK], CiH[BORROMEAN_CHUNK];
+    ge_cached c;
+    ge_p1p1 t;
+
+    ge_p3_0(&job->sum[task->chunk]);
+    for (size_t i = 0; i < BORROMEAN_CHUNK; i++) {
+        if (ge_frombytes_vartime(&Ci[i], as->Ci[begin + i].bytes) != 0) {
+            g_atomic_int_set(&job->bad, 1);
+            return;
+        }
+        ge_sub(&t, &Ci[i], &H2[begin + i]);
+        ge_p1p1_to_p3(&CiH[i], &t);
+        ge_p3_to_cached(&c, &Ci[i]);
+        ge_add(&t, &job->sum[task->chunk], &c);
+        ge_p1p1_to_p3(&job->sum[task->chunk], &t);
+    }
+    borromean_bits(&as->asig, Ci, CiH, begin, BORROMEAN_CHUNK, &job->Lv1[begin]);
+}
+
+static bool range_finish(const range_job *job) {
+    ge_p3 C;
+    ge_cached c;
+    ge_p1p1 t;
+    key Ctmp;
+
+    if (g_atomic_int_get(&job->bad)) {
+        return false;
+    }
+    C = job->sum[0];
+    for (size_t i = 1; i < BORROMEAN_CHUNKS; i++) {
+        ge_p3_to_cached(&c, &job->sum[i]);
+        ge_add(&t, &C, &c);
+        ge_p1p1_to_p3(&C, &t);
+    }
+    p3_tobytes(&Ctmp, &C);
+    if (!equalKeys(&Ctmp, job->C)) {
+        return false;
+    }
+    return borromean_challenge(&job->as->asig, job->Lv1);
+}
+
+static bool verRanges(const key *const *C, const rangeSig *sigs, size_t n) {
+    threadpool *pool = threadpool_get_instance();
+    tpool_waiter waiter;
+    range_job *jobs;
+    range_task *tasks;
+    bool ret = true;
+
+    if (n == 0) {
+        return true;
+    }
+
+    jobs = g_new0(range_job, n);
+    tasks = g_new(range_task, n * BORROMEAN_CHUNKS);
+    tpool_waiter_init(&waiter);
+    for (size_t i = 0; i < n; i++) {
+        jobs[i].C = C[i];
+        jobs[i].as = &sigs[i];
+        for (size_t k = 0; k < BORROMEAN_CHUNKS; k++) {
+            range_task *task = &tasks[i * BORROMEAN_CHUNKS + k];
+            task->job = &jobs[i];
+            task->chunk = k;
+            threadpool_submit(pool, &waiter, range_chunk, task);
+        }
+    }
+    threadpool_wait(pool, &waiter);
+    tpool_waiter_clear(&waiter);
+
+    for (size_t i = 0; i < n; i++) {
+        if (!range_finish(&jobs[i])) {
+            g_debug("verRange: proof %zu failed", i);
+            ret = false;
+            break;
+        }
+    }
+
+    g_free(tasks);
+    g_free(jobs);
+    return ret;
+}
+
+bool verRange(const key *C, const rangeSig *as) {
+    return verRanges(&C, as, 1);
+}
+
+void rct_range_cache_key(hash *cache_key, const ctkeyV *outPk, const rangeSig *sigs) {
+    size_t n = outPk->keysSize;
+    uint8_t *buf = g_malloc(n * (sizeof(key) + sizeof(rangeSig)) + 1);
+    uint8_t *p = buf;
+
+    for (size_t i = 0; i < n; i++) {
+        memcpy(p, &outPk->keys[i].mask, sizeof(key));
+        p += sizeof(key);
+    }
+    memcpy(p, sigs, n * sizeof(rangeSig));
+    p += n * sizeof(rangeSig);
+    cn_fast_hash(buf, p - buf, (char *)cache_key->data);
+    g_free(buf);
+}
+
+bool verRangeSigs(const ctkeyV *outPk, const rangeSig *sigs, bool cached) {
+    const key **C;
+    hash proof_hash;
+    bool ret;
+
+    if (cached) {
+        rct_range_cache_key(&proof_hash, outPk, sigs);
+        if (rct_verified_cache_contains(&proof_hash)) {
+            return true;
+        }
+    }
+
+    C = g_new(const key *, outPk->keysSize + 1);
+    for (size_t i = 0; i < outPk->keysSize; i++) {
+        C[i] = &outPk->keys[i].mask;
+    }
+    ret = verRanges(C, sigs, outPk->keysSize);
+    g_free(C);
+
+    if (ret && cached) {
+        rct_verified_cache_add(&proof_hash);
+    }
+    return ret;
+}
+
+/*
+ * Verified proof cache, a fixed ring of hashes with FIFO eviction. It only
+ * has to bridge mempool admission and the block that mines the tx, and a
+ * miss costs one more verification, never a wrong answer.
+ */
+
+#define RCT_VERIFIED_CACHE_SIZE 8192
+
+static GMutex verified_cache_lock;
+static GHashTable *verified_cache;
+static hash verified_ring[RCT_VERIFIED_CACHE_SIZE];
+static size_t verified_ring_pos;
+static size_t verified_ring_len;
+
+static guint proof_hash_hash(gconstpointer v) {
+    guint h;
+    memcpy(&h, ((const hash *)v)->data, sizeof(h));
+    return h;
+}
+
+static gboolean proof_hash_equal(gconstpointer a, gconstpointer b) {
+    return memcmp(a, b, sizeof(hash)) == 0;
+}
+
+bool rct_verified_cache_contains(const hash *proof_hash) {
+    bool found = false;
+    g_mutex_lock(&verified_cache_lock);
+    if (verified_cache) {
+        found = g_hash_table_contains(verified_cache, proof_hash);
+    }
+    g_mutex_unlock(&verified_cache_lock);
+    return found;
+}
+
+void rct_verified_cache_add(const hash *proof_hash) {
+    g_mutex_lock(&verified_cache_lock);
+    if (!verified_cache) {
+        verified_cache = g_hash_table_new(proof_hash_hash, proof_hash_equal);
+    }
+    if (!g_hash_table_contains(verified_cache, proof_hash)) {
+        hash *slot = &verified_ring[verified_ring_pos];
+        if (verified_ring_len == RCT_VERIFIED_CACHE_SIZE) {
+            g_hash_table_remove(verified_cache, slot);
+        } else {
+            verified_ring_len++;
+        }
+        *slot = *proof_hash;
+        g_hash_table_add(verified_cache, slot);
+        verified_ring_pos = (verified_ring_pos + 1) % RCT_VERIFIED_CACHE_SIZE;
+    }
+    g_mutex_unlock(&verified_cache_lock);
+}
+
+void rct_verified_cache_clear(void) {
+    g_mutex_lock(&verified_cache_lock);
+    if (verified_cache) {
+        g_hash_table_remove_all(verified_cache);
+    }
+    verified_ring_pos = 0;
+    verified_ring_len = 0;
+    g_mutex_unlock(&verified_cache_lock);
+}
+
+/* MLSAG ring signatures */
+
+#define MG_CACHE_CHUNK 16
+// mg_points are a few KB each
+#define MG_ARENA_CHUNK (256 * 1024)
+
+// a ring member key, decoded once per batch
+typedef struct mg_point {
+    const key *k;
+    ge_p3 P;
+    ge_dsmp Pi;  // odd multiples of P and of hash_to_p3(P), dest keys only
+    ge_dsmp Hi;
+    bool is_dest;
+    bool valid;
+} mg_point;
+
+typedef struct mg_batch {
+    const rct_mg_input *inputs;
+    GHashTable *cache;  // key -> mg_point
+    GPtrArray *points;
+    arena arena;        // the mg_points, freed with the batch
+    gboolean *ok;
+} mg_batch;
+
+typedef struct mg_task {
+    mg_batch *batch;
+    size_t begin;
+    size_t end;
+} mg_task;
+
+static guint rct_key_hash(gconstpointer v) {
+    guint h;
+    memcpy(&h, ((const key *)v)->bytes, sizeof(h));
+    return h;
+}
+
+static gboolean rct_key_equal(gconstpointer a, gconstpointer b) {
+    return memcmp(a, b, sizeof(key)) == 0;
+}
+
+static void mg_cache_add(mg_batch *batch, const key *k, bool is_dest) {
+    mg_point *e = g_hash_table_lookup(batch->cache, k);
+    if (!e) {
+        e = arena_new(&batch->arena, mg_point, 1);
+        memset(e, 0, sizeof(*e));
+        e->k = k;
+        g_hash_table_insert(batch->cache, (gpointer)k, e);
+        g_ptr_array_add(batch->points, e);
+    }
+    e->is_dest |= is_dest;
+}
+
+static void mg_cache_fill(gpointer data) {
+    const mg_task *task = data;
+    ge_p3 hp;
+
+    for (size_t i = task->begin; i < task->end; i++) {
+        mg_point *e = g_ptr_array_index(task->batch->points, i);
+        e->valid = ge_frombytes_vartime(&e->P, e->k->bytes) == 0;
+        if (e->valid && e->is_dest) {
+            ge_dsm_precomp(e->Pi, &e->P);
+            hash_to_p3(&hp, e->k);
+            ge_dsm_precomp(e->Hi, &hp);
+        }
+    }
+}
+
+static bool mg_verify_input(const rct_mg_input *in, GHashTable *cache) {
+    const mgSig *mg = in->mg;
+    const size_t cols = in->pubs->keysSize;
+    ge_p3 I, C, *pk1;
+    ge_dsmp Ii;
+    ge_cached Cc;
+    ge_p1p1 t;
+    ge_p2 L[3];
+    key LR[3], *pk1b, c;
+    key toHash[6];  // message, dest, L, R, mask - C, L
+    const mg_point **dests;
+    bool ret = false;
+
+    if (cols == 0 || mg->ss.keysSize != cols || mg->II.keysSize != 1) {
+        return false;
+    }
+    if (sc_check(mg->cc.bytes) != 0) {
+        return false;
+    }
+    if (ge_frombytes_vartime(&I, mg->II.keys[0].bytes) != 0 || ge_p3_is_point_at_infinity(&I)) {
+        return false;
+    }
+    if (ge_frombytes_vartime(&C, in->C->bytes) != 0) {
+        return false;
+    }
+    ge_dsm_precomp(Ii, &I);
+    ge_p3_to_cached(&Cc, &C);
+
+    dests = g_new(const mg_point *, cols);
+    pk1 = g_new(ge_p3, cols);
+    pk1b = g_new(key, cols);
+    for (size_t i = 0; i < cols; i++) {
+        const keyV *ss = &mg->ss.keys[i];
+        const mg_point *mask = g_hash_table_lookup(cache, &in->pubs->keys[i].mask);
+        dests[i] = g_hash_table_lookup(cache, &in->pubs->keys[i].dest);
+        if (!dests[i]->valid || !mask->valid) {
+            goto done;
+        }
+        if (ss->keysSize != 2 || sc_check(ss->keys[0].bytes) != 0 || sc_check(ss->keys[1].bytes) != 0) {
+            goto done;
+        }
+        ge_sub(&t, &mask->P, &Cc);
+        ge_p1p1_to_p3(&pk1[i], &t);
+    }
+    // the second row does not depend on the challenge, serialize it at once
+    ge_p3_batch_tobytes(pk1b[0].bytes, pk1, cols);
+
+    toHash[0] = *in->message;
+    c = mg->cc;
+    for (size_t i = 0; i < cols; i++) {
+        const key *ss = mg->ss.keys[i].keys;
+        ge_double_scalarmult_precomp_vartime2(&L[0], c.bytes, dests[i]->Pi, ss[0].bytes, ge_base_precomp());
+        ge_double_scalarmult_precomp_vartime2(&L[1], ss[0].bytes, dests[i]->Hi, c.bytes, Ii);
+        ge_double_scalarmult_base_vartime(&L[2], c.bytes, &pk1[i], ss[1].bytes);
+        ge_p2_batch_tobytes(LR[0].bytes, L, 3);
+        toHash[1] = in->pubs->keys[i].dest;
+        toHash[2] = LR[0];
+        toHash[3] = LR[1];
+        toHash[4] = pk1b[i];
+        toHash[5] = LR[2];
+        hash_to_scalar(&c, toHash, sizeof(toHash));
+    }
+    ret = equalKeys(&c, &mg->cc);
+
+done:
+    g_free(pk1b);
+    g_free(pk1);
+    g_free(dests);
+    return ret;
+}
+
+static void mg_verify_task(gpointer data) {
+    const mg_task *task = data;
+    mg_batch *batch = task->batch;
+    for (size_t i = task->begin; i < task->end; i++) {
+        batch->ok[i] = mg_verify_input(&batch->inputs[i], batch->cache);
+    }
+}
+
+bool verRctMGs(const rct_mg_input *inputs, size_t n, threadpool *pool, GArray *failed) {
+    mg_batch batch;
+    mg_task *tasks;
+    tpool_waiter waiter;
+    size_t ntasks;
+    bool ret = true;
+
+    if (n == 0) {
+        return true;
+    }
+    if (!pool) {
+        pool = threadpool_get_instance();
+    }
+
+    batch.inputs = inputs;
+    batch.cache = g_hash_table_new(rct_key_hash, rct_key_equal);
+    batch.points = g_ptr_array_new();
+    arena_init(&batch.arena, MG_ARENA_CHUNK);
+    batch.ok = g_new0(gboolean, n);
+    for (size_t i = 0; i < n; i++) {
+        const ctkeyV *pubs = inputs[i].pubs;
+        for (size_t j = 0; j < pubs->keysSize; j++) {
+            mg_cache_add(&batch, &pubs->keys[j].dest, true);
+            mg_cache_add(&batch, &pubs->keys[j].mask, false);
+        }
+    }
+
+    ntasks = (batch.points->len + MG_CACHE_CHUNK - 1) / MG_CACHE_CHUNK;
+    ntasks = MAX(ntasks, n);
+    tasks = g_new(mg_task, ntasks);
+    tpool_waiter_init(&waiter);
+
+    // decode the distinct ring members, then verify one input per job
+    for (size_t k = 0, i = 0; i < batch.points->len; k++, i += MG_CACHE_CHUNK) {
+        tasks[k].batch = &batch;
+        tasks[k].begin = i;
+        tasks[k].end = MIN(i + MG_CACHE_CHUNK, batch.points->len);
+        threadpool_submit(pool, &waiter, mg_cache_fill, &tasks[k]);
+    }
+    threadpool_wait(pool, &waiter);
+    for (size_t i = 0; i < n; i++) {
+        tasks[i].batch = &batch;
+        tasks[i].begin = i;
+        tasks[i].end = i + 1;
+        threadpool_submit(pool, &waiter, mg_verify_task, &tasks[i]);
+    }
+    threadpool_wait(pool, &waiter);
+    tpool_waiter_clear(&waiter);
+
+    for (size_t i = 0; i < n; i++) {
+        if (!batch.ok[i]) {
+            g_debug("verRctMGs: input %zu failed", i);
+            ret = false;
+            if (failed) {
+                g_array_append_val(failed, i);
+            }
+        }
+    }
+
+    g_free(tasks);
+    g_free(batch.ok);
+    g_ptr_array_free(batch.points, TRUE);
+    arena_clear(&batch.arena);
+    g_hash_table_destroy(batch.cache);
+    return ret;
+}
+
+bool verRctMGSimple(const key *message, const mgSig *mg, const ctkeyV *pubs, const key *C) {
+    const rct_mg_input in = { message, mg, pubs, C };
+    return verRctMGs(&in, 1, NULL, NULL);
+}
+
+bool verRctMGsSimple(const key *message, const rctSigBase *rv, const mgSig *MGs, threadpool *pool) {
+    rct_mg_input *inputs;
+    bool ret;
+
+    if (rv->mixRing.keysSize != rv->pseudoOuts.keysSize) {
+        return false;
+    }
+    inputs = g_new(rct_mg_input, rv->mixRing.keysSize);
+    for (size_t i = 0; i < rv->mixRing.keysSize; i++) {
+        inputs[i].message = message;
+        inputs[i].mg = &MGs[i];
+        inputs[i].pubs = &rv->mixRing.keys[i];
+        inputs[i].C = &rv->pseudoOuts.keys[i];
+    }
+    ret = verRctMGs(inputs, rv->mixRing.keysSize, pool, NULL);
+    g_free(inputs);
+    return ret;
+}
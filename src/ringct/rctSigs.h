@@ -0,0 +1,106 @@
+#ifndef MONERO_RINGCT_RCTSIGS_H_
+#define MONERO_RINGCT_RCTSIGS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <glib.h>
+#include "common/threadpool.h"
+#include "crypto/hash.h"
+#include "ringct/rctTypes.h"
+#include "ringct/multiexp.h"
+
+/*
+ * Batch verification
+ *
+ * A proof whose check is linear in curve points (bulletproofs, commitment
+ * balance) is reduced to an equation
+ *     g_scalar * G + h_scalar * H + sum(terms[i].scalar * terms[i].point) == 0
+ * Equations of many proofs are checked together by weighting each with a
+ * random scalar and summing them into one multiexp. G and H coefficients are
+ * folded so those generators cost a single term for the whole batch.
+ */
+typedef struct rct_equation {
+    key g_scalar;
+    key h_scalar;
+    GArray *terms;  // multiexp_data
+} rct_equation;
+
+void rct_equation_init(rct_equation *eq);
+void rct_equation_free(rct_equation *eq);
+// terms += scalar * point
+void rct_equation_add_term(rct_equation *eq, const key *scalar, const ge_p3 *point);
+
+// fills eq for proof, false if the proof is malformed
+typedef bool (*rct_equation_builder)(const void *proof, rct_equation *eq, void *user);
+
+// true if every equation holds
+bool rct_batch_check(const rct_equation *eqs, size_t n);
+
+/*
+ * Verifies n proofs (a block, or a burst of mempool txs) in one multiexp.
+ * On failure the set is bisected until the bad proofs are isolated; their
+ * indices are appended to failed (size_t) when it is not NULL.
+ */
+bool rct_batch_verify(const void *const *proofs, size_t n, rct_equation_builder build, void *user, GArray *failed);
+
+/*
+ * Borromean range proofs
+ *
+ * The 64 rings of a proof are independent until the final challenge hash,
+ * so verification is split in chunks of bits run on the shared thread pool.
+ * Each chunk serializes its ring points with a single field inversion.
+ */
+bool verifyBorromean(const boroSig *bb, const ge_p3 *P1, const ge_p3 *P2);
+// C is the commitment the proof is for
+bool verRange(const key *C, const rangeSig *as);
+/*
+ * Verifies the range proofs of every output of a tx, all bits of all outputs
+ * in parallel. When cached is set a tx whose proofs already verified
+ * (mempool admission, then the block) is not checked again; the cache is
+ * keyed on every commitment and proof byte the check reads.
+ */
+bool verRangeSigs(const ctkeyV *outPk, const rangeSig *sigs, bool cached);
+
+// cache_key = cn_fast_hash(outPk masks || sigs)
+void rct_range_cache_key(hash *cache_key, const ctkeyV *outPk, const rangeSig *sigs);
+// cache of range proof keys that verified
+bool rct_verified_cache_contains(const hash *proof_hash);
+void rct_verified_cache_add(const hash *proof_hash);
+void rct_verified_cache_clear(void);
+
+/*
+ * Commitment balance: sum(pseudoOuts) == sum(outPk.mask) + txnFee * H
+ *
+ * The equations of every tx of a block are folded into one randomized
+ * multiexp; when it fails the set is bisected down to the offending txs,
+ * whose indices are appended to failed (size_t) when it is not NULL.
+ */
+bool verRctBalance(const rctSigBase *rv);
+bool verRctBalances(const rctSigBase *const *rvs, size_t n, GArray *failed);
+
+/*
+ * MLSAG ring signatures (simple rct: one signature per input, rows
+ * [dest, mask - pseudoOut])
+ *
+ * Inputs are independent and are scheduled on a work-stealing pool. Ring
+ * members shared by several inputs of a batch are decompressed, and their
+ * hash_to_p3 computed, once per batch.
+ */
+typedef struct rct_mg_input {
+    const key *message;
+    const mgSig *mg;
+    const ctkeyV *pubs;  // the ring
+    const key *C;        // pseudo output commitment of the input
+} rct_mg_input;
+
+bool verRctMGSimple(const key *message, const mgSig *mg, const ctkeyV *pubs, const key *C);
+/*
+ * Verifies n inputs, possibly of many txs, on pool (NULL for the shared
+ * pool). Indices of bad inputs are appended to failed (size_t) when it is
+ * not NULL.
+ */
+bool verRctMGs(const rct_mg_input *inputs, size_t n, threadpool *pool, GArray *failed);
+// every input of a simple rct tx, MGs[i] signs rv->mixRing.keys[i]
+bool verRctMGsSimple(const key *message, const rctSigBase *rv, const mgSig *MGs, threadpool *pool);
+
+#endif //MONERO_RINGCT_RCTSIGS_H_
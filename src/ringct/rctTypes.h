@@ -1,6 +1,9 @@
 #ifndef MONERO_RINGCT_RCTTYPES_H_
 #define MONERO_RINGCT_RCTTYPES_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 //Define this flag when debugging to get additional info on the console
 #ifdef DBG
 #define DP(x) dp(x)
@@ -76,6 +79,19 @@ typedef struct boroSig {
     key ee;
 } boroSig;
 
+// MLSAG signature: ss is cols x rows, II holds the key images
+typedef struct mgSig {
+    keyM ss;
+    key cc;
+    keyV II;
+} mgSig;
+
+//Container for precomp
+typedef struct rangeSig {
+    boroSig asig;
+    key64 Ci;
+} rangeSig;
+
 typedef struct rctSigBase {
     uint8_t type;
     key message;
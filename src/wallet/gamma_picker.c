@@ -0,0 +1,112 @@
+#include <math.h>
+#include "gamma_picker.h"
+
+// uniform in [0, n)
+static uint64_t rand_below(GRand *rng, uint64_t n) {
+    const uint64_t limit = UINT64_MAX - UINT64_MAX % n;
+    uint64_t v;
+    do {
+        v = ((uint64_t)g_rand_int(rng) << 32) | g_rand_int(rng);
+    } while (v >= limit);
+    return v % n;
+}
+
+static double rand_normal(GRand *rng) {
+    double u;
+    do {
+        u = g_rand_double(rng);
+    } while (u == 0);
+    return sqrt(-2 * log(u)) * cos(2 * G_PI * g_rand_double(rng));
+}
+
+// Marsaglia and Tsang's method, for shape >= 1
+static double rand_gamma(GRand *rng, double shape, double scale) {
+    const double d = shape - 1.0 / 3;
+    const double c = 1 / sqrt(9 * d);
+    for (;;) {
+        const double x = rand_normal(rng);
+        double v = 1 + c * x, u;
+        if (v <= 0) {
+            continue;
+        }
+        v = v * v * v;
+        u = g_rand_double(rng);
+        if (u > 0 && log(u) < 0.5 * x * x + d - d * v + d * log(v)) {
+            return d * v * scale;
+        }
+    }
+}
+
+bool gamma_picker_init(gamma_picker *p, output_distribution *d, double shape, double scale, GRand *rng) {
+    const uint64_t blocks_in_a_year = 86400 * 365 / DIFFICULTY_TARGET_V2;
+    bool ret = false;
+
+    p->d = d;
+    p->shape = shape;
+    p->scale = scale;
+    p->rng = rng;
+    g_rw_lock_reader_lock(&d->lock);
+    p->height = d->cumulative->len;
+    if (p->height > CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE) {
+        const uint64_t *cum = &g_array_index(d->cumulative, uint64_t, 0);
+        uint64_t blocks = MIN(p->height, blocks_in_a_year);
+        uint64_t outputs = cum[p->height - 1] - (blocks < p->height ? cum[p->height - blocks - 1] : 0);
+        if (outputs == 0) {
+            // none in the last year, the time is averaged over the whole chain
+            blocks = p->height;
+            outputs = cum[p->height - 1];
+        }
+        p->end = p->height - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+        p->num_rct_outputs = cum[p->end - 1];
+        // this assumes a constant target over the whole range
+        p->average_output_time = outputs ? DIFFICULTY_TARGET_V2 * blocks / (double)outputs : 0;
+        // outputs covers num_rct_outputs, so the time is never 0 when there are some
+        ret = p->num_rct_outputs > 0;
+    }
+    g_rw_lock_reader_unlock(&d->lock);
+    return ret;
+}
+
+uint64_t gamma_picker_pick(gamma_picker *p) {
+    double x = exp(rand_gamma(p->rng, p->shape, p->scale));
+    uint64_t output_index, lo, hi, first, n;
+
+    if (x > DEFAULT_UNLOCK_TIME) {
+        // an output that was spent once it unlocked
+        x -= DEFAULT_UNLOCK_TIME;
+    } else {
+        // an output spent as soon as it could be, uniformly
+        x = (double)rand_below(p->rng, RECENT_SPEND_WINDOW);
+    }
+    output_index = (uint64_t)(x / p->average_output_time);
+    if (output_index >= p->num_rct_outputs) {
+        return GAMMA_PICK_FAILED;
+    }
+    output_index = p->num_rct_outputs - 1 - output_index;
+
+    g_rw_lock_reader_lock(&p->d->lock);
+    if (p->d->cumulative->len < p->height) {
+        g_rw_lock_reader_unlock(&p->d->lock);
+        return GAMMA_PICK_FAILED;
+    }
+    // the first block whose cumulative count passes output_index
+    const uint64_t *cum = &g_array_index(p->d->cumulative, uint64_t, 0);
+    lo = 0;
+    hi = p->end;
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (cum[mid] <= output_index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    first = lo == 0 ? 0 : cum[lo - 1];
+    n = lo < p->end ? cum[lo] - first : 0;
+    g_rw_lock_reader_unlock(&p->d->lock);
+
+    if (n == 0) {
+        return GAMMA_PICK_FAILED;
+    }
+    return first + rand_below(p->rng, n);
+}
@@ -0,0 +1,44 @@
+#ifndef MONERO_WALLET_GAMMA_PICKER_H_
+#define MONERO_WALLET_GAMMA_PICKER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+#include "blockchain_db/output_distribution.h"
+#include "cryptonote_config.h"
+
+// the spend age model of the decoy selection, log(seconds) ~ gamma
+#define GAMMA_SHAPE 19.28
+#define GAMMA_SCALE (1 / 1.61)
+#define DEFAULT_UNLOCK_TIME (CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE * DIFFICULTY_TARGET_V2)
+#define RECENT_SPEND_WINDOW (15 * DIFFICULTY_TARGET_V2)
+
+#define GAMMA_PICK_FAILED UINT64_MAX
+
+/*
+ * Picks rct decoys with gamma distributed ages. Ages are turned into output
+ * indices with the average output time of the last year, then into a block
+ * with a binary search over the cumulative distribution, and a random
+ * output of that block is picked. Only the in memory distribution is read.
+ *
+ * Blocks from the distribution's height at init on are not picked from; if
+ * the chain is popped below it, picks fail until the picker is made again.
+ */
+typedef struct gamma_picker {
+    output_distribution *d;
+    uint64_t height;            // of the distribution at init
+    uint64_t end;               // blocks old enough to pick from: [0, end)
+    uint64_t num_rct_outputs;   // in those blocks
+    double average_output_time;
+    double shape;
+    double scale;
+    GRand *rng;
+} gamma_picker;
+
+// false if there are no spendable rct outputs yet
+bool gamma_picker_init(gamma_picker *p, output_distribution *d, double shape, double scale, GRand *rng);
+
+// a global rct output index, or GAMMA_PICK_FAILED for a pick to retry
+uint64_t gamma_picker_pick(gamma_picker *p);
+
+#endif //MONERO_WALLET_GAMMA_PICKER_H_
@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+#include "crypto/crypto-ops.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet_scanner.h"
+
+// outputs parsed before a chunk of txs is handed to the pool
+#define SCAN_CHUNK_OUTPUTS 4096
+
+typedef struct scan_tx {
+    uint64_t height;
+    uint32_t tx_index;
+    public_key pub;
+    size_t additional_begin;
+    size_t additional_size;
+    size_t vout_begin;
+    size_t vout_size;
+} scan_tx;
+
+// an output copied out of its blob, which only lives as long as the read txn
+typedef struct scan_out {
+    uint64_t amount;
+    public_key key;
+    bool has_key;  // false unless the target is txout_to_key
+} scan_out;
+
+typedef struct scan_chunk {
+    GArray *txs;         // scan_tx
+    GArray *vout;        // scan_out
+    GArray *additional;  // public_key
+    tpool_waiter waiter;
+    bool in_flight;
+} scan_chunk;
+
+typedef struct scan_ctx {
+    const wallet_account *accounts;
+    ge_p3 *spend;  // decompressed spend keys
+    size_t num_accounts;
+    threadpool *pool;
+    scan_chunk chunks[2];  // one is checked on the pool while the next blocks fill the other
+    scan_chunk *cur;
+    GArray *found;
+    GMutex found_lock;
+    GArray *vout_tmp;
+    wallet_scan_stats *stats;
+    bool failed;
+} scan_ctx;
+
+typedef struct scan_task {
+    scan_ctx *ctx;
+    scan_chunk *chunk;
+    size_t tx;
+} scan_task;
+
+static void scan_chunk_init(scan_chunk *chunk) {
+    chunk->txs = g_array_new(FALSE, FALSE, sizeof(scan_tx));
+    chunk->vout = g_array_new(FALSE, FALSE, sizeof(scan_out));
+    chunk->additional = g_array_new(FALSE, FALSE, sizeof(public_key));
+    tpool_waiter_init(&chunk->waiter);
+    chunk->in_flight = false;
+}
+
+static void scan_chunk_clear(scan_chunk *chunk) {
+    tpool_waiter_clear(&chunk->waiter);
+    g_array_free(chunk->additional, TRUE);
+    g_array_free(chunk->vout, TRUE);
+    g_array_free(chunk->txs, TRUE);
+}
+
+// 8 * a * R with the multiples of R precomputed
+static void scan_derivation(key_derivation *derivation, const secret_key *a, const ge_smp Ri) {
+    ge_p2 p2;
+    ge_p1p1 p1;
+    ge_scalarmult_precomp(&p2, (const unsigned char *)a->data, Ri);
+    ge_mul8(&p1, &p2);
+    ge_p1p1_to_p2(&p2, &p1);
+    ge_tobytes((unsigned char *)derivation->data, &p2);
+}
+
+// P - Hs(derivation || index) * G == B, compared in projective coordinates
+static bool scan_output_is_to(const key_derivation *derivation, size_t index, const ge_p3 *P, const ge_p3 *B) {
+    ec_scalar s;
+    ge_p3 sG;
+    ge_cached c;
+    ge_p1p1 t;
+    ge_p2 Q;
+    fe l, r;
+
+    derivation_to_scalar(derivation, index, &s);
+    ge_scalarmult_base_vartime(&sG, (const unsigned char *)s.data);
+    ge_p3_to_cached(&c, &sG);
+    ge_sub(&t, P, &c);
+    ge_p1p1_to_p2(&Q, &t);
+
+    fe_mul(l, Q.X, B->Z);
+    fe_mul(r, B->X, Q.Z);
+    fe_sub(l, l, r);
+    if (fe_isnonzero(l)) {
+        return false;
+    }
+    fe_mul(l, Q.Y, B->Z);
+    fe_mul(r, B->Y, Q.Z);
+    fe_sub(l, l, r);
+    return !fe_isnonzero(l);
+}
+
+static void scan_found(scan_ctx *ctx, const scan_tx *tx, const scan_out *out, size_t index, size_t account) {
+    wallet_output o;
+    o.height = tx->height;
+    o.tx_index = tx->tx_index;
+    o.output_index = (uint32_t)index;
+    o.account = (uint32_t)account;
+    o.amount = out->amount;
+    o.key = out->key;
+    g_mutex_lock(&ctx->found_lock);
+    g_array_append_val(ctx->found, o);
+    g_mutex_unlock(&ctx->found_lock);
+}
+
+static void scan_tx_job(gpointer data) {
+    const scan_task *task = data;
+    scan_ctx *ctx = task->ctx;
+    const scan_tx *tx = &g_array_index(task->chunk->txs, scan_tx, task->tx);
+    const scan_out *vout = &g_array_index(task->chunk->vout, scan_out, tx->vout_begin);
+    const public_key *additional = &g_array_index(task->chunk->additional, public_key, tx->additional_begin);
+    const bool use_additional = tx->additional_size == tx->vout_size;
+    ge_p3 R, *P;
+    ge_smp Ri, *Ai = NULL;
+    bool *valid;
+    key_derivation derivation;
+
+    if (ge_frombytes_vartime(&R, (const unsigned char *)tx->pub.data) != 0) {
+        return;
+    }
+    ge_sm_precomp(Ri, &R);
+
+    // output keys and additional tx keys are shared by every account
+    P = g_new(ge_p3, tx->vout_size);
+    valid = g_new(bool, tx->vout_size);
+    for (size_t i = 0; i < tx->vout_size; i++) {
+        valid[i] = vout[i].has_key && ge_frombytes_vartime(&P[i], (const unsigned char *)vout[i].key.data) == 0;
+    }
+    if (use_additional) {
+        Ai = g_new(ge_smp, tx->vout_size);
+        for (size_t i = 0; i < tx->vout_size; i++) {
+            ge_p3 A;
+            if (ge_frombytes_vartime(&A, (const unsigned char *)additional[i].data) != 0) {
+                ge_p3_0(&A);
+            }
+            ge_sm_precomp(Ai[i], &A);
+        }
+    }
+
+    for (size_t a = 0; a < ctx->num_accounts; a++) {
+        const secret_key *view = &ctx->accounts[a].view_secret_key;
+        scan_derivation(&derivation, view, Ri);
+        for (size_t i = 0; i < tx->vout_size; i++) {
+            if (!valid[i]) {
+                continue;
+            }
+            if (scan_output_is_to(&derivation, i, &P[i], &ctx->spend[a])) {
+                scan_found(ctx, tx, &vout[i], i, a);
+            } else if (use_additional) {
+                key_derivation additional;
+                scan_derivation(&additional, view, Ai[i]);
+                if (scan_output_is_to(&additional, i, &P[i], &ctx->spend[a])) {
+                    scan_found(ctx, tx, &vout[i], i, a);
+                }
+            }
+        }
+    }
+
+    g_free(Ai);
+    g_free(valid);
+    g_free(P);
+}
+
+static void scan_chunk_wait(scan_ctx *ctx, scan_chunk *chunk) {
+    if (chunk->in_flight) {
+        threadpool_wait(ctx->pool, &chunk->waiter);
+        chunk->in_flight = false;
+    }
+    g_array_set_size(chunk->txs, 0);
+    g_array_set_size(chunk->vout, 0);
+    g_array_set_size(chunk->additional, 0);
+}
+
+static void scan_drain(scan_ctx *ctx) {
+    scan_chunk_wait(ctx, &ctx->chunks[0]);
+    scan_chunk_wait(ctx, &ctx->chunks[1]);
+}
+
+// hands the current chunk to the pool and switches to the other one
+static void scan_chunk_submit(scan_ctx *ctx, scan_task **tasks) {
+    scan_chunk *chunk = ctx->cur;
+    scan_chunk *next = chunk == &ctx->chunks[0] ? &ctx->chunks[1] : &ctx->chunks[0];
+    scan_task *t;
+
+    scan_chunk_wait(ctx, next);
+    g_free(tasks[next - ctx->chunks]);
+    tasks[next - ctx->chunks] = NULL;
+
+    t = g_new(scan_task, chunk->txs->len);
+    for (guint i = 0; i < chunk->txs->len; i++) {
+        t[i].ctx = ctx;
+        t[i].chunk = chunk;
+        t[i].tx = i;
+        threadpool_submit(ctx->pool, &chunk->waiter, scan_tx_job, &t[i]);
+    }
+    tasks[chunk - ctx->chunks] = t;
+    chunk->in_flight = true;
+    ctx->cur = next;
+}
+
+static void scan_add_tx(scan_ctx *ctx, uint64_t height, uint32_t tx_index, const tx_prefix_ref *prefix) {
+    scan_chunk *chunk = ctx->cur;
+    const public_key *additional;
+    scan_tx tx;
+
+    ctx->stats->txs++;
+    ctx->stats->outputs += prefix->vout->len;
+    if (!get_tx_pub_key_from_extra(prefix->extra, prefix->extra_size, &tx.pub)) {
+        return;
+    }
+    get_additional_tx_pub_keys_from_extra(prefix->extra, prefix->extra_size, &additional, &tx.additional_size);
+    tx.height = height;
+    tx.tx_index = tx_index;
+    tx.additional_begin = chunk->additional->len;
+    g_array_append_vals(chunk->additional, additional, tx.additional_size);
+    tx.vout_begin = chunk->vout->len;
+    tx.vout_size = prefix->vout->len;
+    for (guint i = 0; i < prefix->vout->len; i++) {
+        const tx_out_ref *ref = &g_array_index(prefix->vout, tx_out_ref, i);
+        scan_out out;
+        out.amount = ref->amount;
+        out.has_key = ref->key != NULL;
+        if (out.has_key) {
+            out.key = *ref->key;
+        } else {
+            memset(&out.key, 0, sizeof(out.key));
+        }
+        g_array_append_val(chunk->vout, out);
+    }
+    g_array_append_val(chunk->txs, tx);
+    ctx->stats->derivations += ctx->num_accounts * (1 + (tx.additional_size == tx.vout_size ? tx.vout_size : 0));
+}
+
+typedef struct scan_reader {
+    scan_ctx *ctx;
+    scan_task *tasks[2];
+} scan_reader;
+
+static bool scan_block(uint64_t height, const MDB_val *block, const MDB_val *txs, size_t txs_size, void *user) {
+    scan_reader *reader = user;
+    scan_ctx *ctx = reader->ctx;
+    blob_reader r;
+    block_ref b;
+    tx_prefix_ref prefix;
+
+    ctx->stats->blocks++;
+    b.miner_tx.vout = ctx->vout_tmp;
+    g_array_set_size(ctx->vout_tmp, 0);
+    blob_reader_init(&r, block->mv_data, block->mv_size);
+    if (!parse_block_ref(&r, &b)) {
+        g_info("wallet_scan: failed to parse block %llu", (unsigned long long)height);
+        ctx->failed = true;
+        return false;
+    }
+    scan_add_tx(ctx, height, 0, &b.miner_tx);
+
+    prefix.vout = ctx->vout_tmp;
+    for (size_t i = 0; i < txs_size; i++) {
+        g_array_set_size(ctx->vout_tmp, 0);
+        blob_reader_init(&r, txs[i].mv_data, txs[i].mv_size);
+        if (!parse_tx_prefix_ref(&r, &prefix)) {
+            g_info("wallet_scan: failed to parse tx %zu of block %llu", i, (unsigned long long)height);
+            ctx->failed = true;
+            return false;
+        }
+        scan_add_tx(ctx, height, (uint32_t)(i + 1), &prefix);
+    }
+
+    if (ctx->cur->vout->len >= SCAN_CHUNK_OUTPUTS) {
+        scan_chunk_submit(ctx, reader->tasks);
+    }
+    return true;
+}
+
+static int wallet_output_compare(const void *a, const void *b) {
+    const wallet_output *x = a, *y = b;
+    if (x->height != y->height) return x->height < y->height ? -1 : 1;
+    if (x->tx_index != y->tx_index) return x->tx_index < y->tx_index ? -1 : 1;
+    if (x->output_index != y->output_index) return x->output_index < y->output_index ? -1 : 1;
+    if (x->account != y->account) return x->account < y->account ? -1 : 1;
+    return 0;
+}
+
+int wallet_scan(BlockchainLMDB *lmdb, uint64_t h1, uint64_t h2, const wallet_account *accounts, size_t num_accounts, threadpool *pool, GArray *found, wallet_scan_stats *stats) {
+    const gint64 start = g_get_monotonic_time();
+    const guint found_before = found->len;
+    wallet_scan_stats local_stats;
+    scan_ctx ctx;
+    scan_reader reader;
+    int ret;
+
+    if (!stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    ctx.accounts = accounts;
+    ctx.num_accounts = num_accounts;
+    ctx.spend = g_new(ge_p3, num_accounts);
+    for (size_t a = 0; a < num_accounts; a++) {
+        if (ge_frombytes_vartime(&ctx.spend[a], (const unsigned char *)accounts[a].spend_public_key.data) != 0) {
+            g_info("wallet_scan: account %zu has an invalid spend public key", a);
+            g_free(ctx.spend);
+            return -1;
+        }
+    }
+    ctx.pool = pool ? pool : threadpool_get_instance();
+    scan_chunk_init(&ctx.chunks[0]);
+    scan_chunk_init(&ctx.chunks[1]);
+    ctx.cur = &ctx.chunks[0];
+    ctx.found = found;
+    g_mutex_init(&ctx.found_lock);
+    ctx.vout_tmp = g_array_new(FALSE, FALSE, sizeof(tx_out_ref));
+    ctx.stats = stats;
+    ctx.failed = false;
+    reader.ctx = &ctx;
+    reader.tasks[0] = reader.tasks[1] = NULL;
+
+    ret = lmdb_for_blocks_range_blobs(lmdb, h1, h2, scan_block, &reader);
+    if (ret == 0 && !ctx.failed && ctx.cur->txs->len > 0) {
+        scan_chunk_submit(&ctx, reader.tasks);
+    }
+    scan_drain(&ctx);
+    if (ctx.failed && ret == 0) {
+        ret = -2;
+    }
+    if (ret != 0) {
+        // a scan that stopped early reports nothing, not a prefix
+        g_array_set_size(found, found_before);
+    }
+
+    g_free(reader.tasks[0]);
+    g_free(reader.tasks[1]);
+    g_array_free(ctx.vout_tmp, TRUE);
+    g_mutex_clear(&ctx.found_lock);
+    scan_chunk_clear(&ctx.chunks[1]);
+    scan_chunk_clear(&ctx.chunks[0]);
+    g_free(ctx.spend);
+
+    if (found->len > found_before) {
+        qsort(found->data + (gsize)found_before * sizeof(wallet_output), found->len - found_before, sizeof(wallet_output), wallet_output_compare);
+    }
+    stats->elapsed_us = g_get_monotonic_time() - start;
+    return ret;
+}
+
+double wallet_scan_outputs_per_sec(const wallet_scan_stats *stats) {
+    if (stats->elapsed_us <= 0) {
+        return 0;
+    }
+    return stats->outputs * 1e6 / stats->elapsed_us;
+}
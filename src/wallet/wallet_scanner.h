@@ -0,0 +1,52 @@
+#ifndef MONERO_WALLET_WALLET_SCANNER_H_
+#define MONERO_WALLET_WALLET_SCANNER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "common/threadpool.h"
+#include "crypto/crypto.h"
+
+/*
+ * Scans the chain for outputs sent to a set of accounts.
+ *
+ * Blocks are read in one LMDB read txn and their txs parsed in place. For
+ * each tx the key derivation is computed once per account and checked
+ * against every output, on a thread pool. The keys are copied out of the
+ * blobs in chunks, so the pool checks one chunk while the next blocks are
+ * parsed. Scanning many accounts at once reads and parses each block once
+ * for all of them.
+ */
+typedef struct wallet_account {
+    secret_key view_secret_key;
+    public_key spend_public_key;
+} wallet_account;
+
+typedef struct wallet_output {
+    uint64_t height;
+    uint32_t tx_index;      // 0 for the miner tx, i + 1 for tx_hashes[i]
+    uint32_t output_index;
+    uint32_t account;       // index in the scanned accounts
+    uint64_t amount;        // clear amount, 0 for ringct outputs
+    public_key key;
+} wallet_output;
+
+typedef struct wallet_scan_stats {
+    uint64_t blocks;
+    uint64_t txs;
+    uint64_t outputs;
+    uint64_t derivations;
+    gint64 elapsed_us;
+} wallet_scan_stats;
+
+/*
+ * Scans blocks [h1, h2] on pool (NULL for the shared pool). Owned outputs
+ * are appended to found (wallet_output) in chain order. Returns 0 or a
+ * negative error.
+ */
+int wallet_scan(BlockchainLMDB *lmdb, uint64_t h1, uint64_t h2, const wallet_account *accounts, size_t num_accounts, threadpool *pool, GArray *found, wallet_scan_stats *stats);
+
+double wallet_scan_outputs_per_sec(const wallet_scan_stats *stats);
+
+#endif //MONERO_WALLET_WALLET_SCANNER_H_
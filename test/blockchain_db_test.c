@@ -0,0 +1,1659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "glib.h"
+#include "common/arena.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "blockchain_db/output_cache.h"
+#include "ringct/rctOps.h"
+#include "chain_gen.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+#define TEST_TXS 4
+#define TEST_OUTPUTS 3
+// a miner output and TEST_TXS txs of TEST_OUTPUTS outputs per block
+#define OUTPUTS_PER_BLOCK (1 + TEST_TXS * TEST_OUTPUTS)
+
+static bool add_blocks(chain_gen *gen, int blocks) {
+    wallet_account account;
+    chain_gen_account(&account);
+    for (int h = 0; h < blocks; h++) {
+        if (!chain_gen_add_block(gen, &account, TEST_TXS, TEST_OUTPUTS, false, NULL, NULL)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool open_chain(chain_gen *gen, int blocks) {
+    return chain_gen_open(gen) && add_blocks(gen, blocks);
+}
+
+void test_absolute_offsets() {
+    uint64_t offsets[] = { 5, 1, 2, 0 };
+    uint64_t overflow[] = { UINT64_MAX, 1 };
+
+    CHECK(relative_output_offsets_to_absolute(offsets, 4));
+    CHECK(offsets[0] == 5 && offsets[1] == 6 && offsets[2] == 8 && offsets[3] == 8);
+    CHECK(!relative_output_offsets_to_absolute(overflow, 2));
+    CHECK(relative_output_offsets_to_absolute(offsets, 0));
+}
+
+void test_output_data() {
+    chain_gen gen;
+    output_index_t outputs[5] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 50 }, { 0, 0 } };
+    output_data_t data[5], one;
+
+    if (!open_chain(&gen, 8)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(gen.num_outputs == 8 * OUTPUTS_PER_BLOCK);
+    outputs[4].index = gen.num_outputs - 1;
+    CHECK(lmdb_get_output_data(gen.lmdb, outputs, 5, data) == 0);
+    for (int i = 0; i < 5; i++) {
+        CHECK(data[i].height == outputs[i].index / OUTPUTS_PER_BLOCK);
+        CHECK(lmdb_get_output_data(gen.lmdb, &outputs[i], 1, &one) == 0);
+        CHECK(memcmp(&one, &data[i], sizeof(one)) == 0);
+    }
+    CHECK(memcmp(&data[0].pubkey, &data[1].pubkey, sizeof(public_key)) != 0);
+
+    outputs[1].index = gen.num_outputs;
+    CHECK(lmdb_get_output_data(gen.lmdb, outputs, 2, data) == -4);
+    outputs[1].amount = 1;
+    CHECK(lmdb_get_output_data(gen.lmdb, outputs + 1, 1, data) == -4);
+
+    chain_gen_close(&gen);
+}
+
+void test_output_cache() {
+    chain_gen gen;
+    output_cache *c;
+    output_cache_stats stats;
+    output_index_t outputs[22];
+    output_data_t data[22], direct[22];
+    uint64_t hits;
+
+    if (!open_chain(&gen, 4)) {
+        CHECK(false);
+        return;
+    }
+    // 11 outputs twice, out of order
+    for (int i = 0; i < 22; i++) {
+        outputs[i].amount = 0;
+        outputs[i].index = 10 - i % 11;
+    }
+    CHECK(lmdb_get_output_data(gen.lmdb, outputs, 22, direct) == 0);
+
+    c = output_cache_new(8);
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 22, data) == 0);
+    CHECK(memcmp(data, direct, sizeof(data)) == 0);
+    output_cache_get_stats(c, &stats);
+    CHECK(stats.lookups == 22 && stats.unique == 11 && stats.hits == 0 && stats.misses == 11);
+
+    // the 8 most recently read stay cached
+    memset(data, 0, sizeof(data));
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 22, data) == 0);
+    CHECK(memcmp(data, direct, sizeof(data)) == 0);
+    output_cache_get_stats(c, &stats);
+    CHECK(stats.unique == 22 && stats.hits == 8 && stats.misses == 14);
+
+    output_cache_clear(c);
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 1, data) == 0);
+    output_cache_get_stats(c, &stats);
+    CHECK(stats.hits == 8 && stats.misses == 15);
+
+    outputs[3].index = gen.num_outputs;
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 22, data) == -4);
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 0, data) == 0);
+
+    // a popped output is not served after another block reuses its index
+    outputs[0].index = gen.num_outputs - 1;
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 1, &data[0]) == 0);
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 1, &data[1]) == 0);
+    output_cache_get_stats(c, &stats);
+    hits = stats.hits;
+    CHECK(chain_gen_pop(&gen, 3) && add_blocks(&gen, 1));
+    CHECK(outputs[0].index == gen.num_outputs - 1);
+    CHECK(lmdb_get_output_data(gen.lmdb, outputs, 1, direct) == 0);
+    CHECK(memcmp(&direct[0].pubkey, &data[0].pubkey, sizeof(public_key)) != 0);
+    CHECK(output_cache_resolve(c, gen.lmdb, outputs, 1, &data[1]) == 0);
+    CHECK(memcmp(&data[1], &direct[0], sizeof(output_data_t)) == 0);
+    output_cache_get_stats(c, &stats);
+    CHECK(stats.hits == hits);
+
+    output_cache_free(c);
+    chain_gen_close(&gen);
+}
+
+typedef struct ring_collect {
+    arena a;
+    GArray *ins;    // txin_to_key_soa of every block
+    bool ok;
+} ring_collect;
+
+static bool collect_rings(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    ring_collect *c = user;
+    transaction tx[TEST_TXS];
+    const transaction_prefix *prefixes[TEST_TXS];
+    txin_to_key_soa ins;
+
+    if (txs_size != TEST_TXS) {
+        c->ok = false;
+        return false;
+    }
+    for (size_t i = 0; i < txs_size; i++) {
+        c->ok = c->ok && parse_and_validate_tx_from_blob(txs[i].mv_data, txs[i].mv_size, &c->a, &tx[i]);
+        prefixes[i] = &tx[i].prefix;
+    }
+    // the soa copies outlive the blobs
+    get_txin_to_key_soa(prefixes, txs_size, &c->a, &ins);
+    g_array_append_val(c->ins, ins);
+    return c->ok;
+}
+
+void test_resolve_inputs() {
+    chain_gen gen;
+    ring_collect c;
+    output_cache *cache;
+    output_cache_stats stats;
+    bool ok = true;
+
+    if (!open_chain(&gen, 8)) {
+        CHECK(false);
+        return;
+    }
+    arena_init(&c.a, 4096);
+    c.ins = g_array_new(FALSE, FALSE, sizeof(txin_to_key_soa));
+    c.ok = true;
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, gen.height - 1, collect_rings, &c) == 0);
+    CHECK(c.ok && c.ins->len == 8);
+
+    // every ring member resolves to what the db holds for it
+    cache = output_cache_new(1024);
+    for (guint h = 0; h < c.ins->len; h++) {
+        txin_to_key_soa *ins = &g_array_index(c.ins, txin_to_key_soa, h);
+        const size_t n = ins->key_offsets_begin[ins->size];
+        output_data_t *data = g_new(output_data_t, n);
+        ok = ok && output_cache_resolve_inputs(cache, gen.lmdb, ins, data) == 0;
+        for (size_t j = 0; j < n; j++) {
+            const uint64_t index = h * 7 + j % 11;
+            ok = ok && ins->key_offsets[j] == index && data[j].height == index / OUTPUTS_PER_BLOCK;
+        }
+        g_free(data);
+    }
+    CHECK(ok);
+    // the txs of a block share a ring, and 4 of its members with the previous block
+    output_cache_get_stats(cache, &stats);
+    CHECK(stats.lookups == 8 * TEST_TXS * 11 && stats.unique == 8 * 11);
+    CHECK(stats.hits == 7 * 4 && stats.misses == 8 * 11 - 7 * 4);
+
+    output_cache_free(cache);
+    g_array_free(c.ins, TRUE);
+    arena_clear(&c.a);
+    chain_gen_close(&gen);
+}
+
+void test_output_distribution() {
+    chain_gen gen;
+    output_distribution *d;
+    uint64_t count, base, out[4];
+    GByteArray *wire = g_byte_array_new();
+    GArray *decoded = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+
+    if (!open_chain(&gen, 6)) {
+        CHECK(false);
+        return;
+    }
+    // loaded again from block_info at open
+    lmdb_close(gen.lmdb);
+    free(gen.lmdb->m_folder);
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == 0);
+    d = &gen.lmdb->m_rct_distribution;
+    CHECK(output_distribution_height(d) == 6);
+
+    CHECK(output_distribution_count(d, 0, 5, &count) && count == 6 * OUTPUTS_PER_BLOCK);
+    CHECK(output_distribution_count(d, 2, 3, &count) && count == 2 * OUTPUTS_PER_BLOCK);
+    CHECK(!output_distribution_count(d, 3, 6, &count) && !output_distribution_count(d, 3, 2, &count));
+
+    CHECK(output_distribution_get(d, 2, 5, false, out, &base));
+    CHECK(base == 2 * OUTPUTS_PER_BLOCK && out[0] == OUTPUTS_PER_BLOCK && out[3] == OUTPUTS_PER_BLOCK);
+    CHECK(output_distribution_get(d, 2, 5, true, out, &base));
+    CHECK(out[0] == 3 * OUTPUTS_PER_BLOCK && out[3] == 6 * OUTPUTS_PER_BLOCK);
+
+    // one byte per height on the wire
+    CHECK(output_distribution_encode(d, 2, 5, wire));
+    CHECK(wire->len == 2 + 4);
+    CHECK(output_distribution_decode(wire->data, wire->len, decoded));
+    CHECK(decoded->len == 4 && memcmp(decoded->data, out, sizeof(out)) == 0);
+    CHECK(!output_distribution_decode(wire->data, wire->len - 1, decoded));
+
+    // blocks added after open are followed
+    CHECK(add_blocks(&gen, 1));
+    CHECK(output_distribution_height(d) == 7);
+    CHECK(output_distribution_count(d, 6, 6, &count) && count == OUTPUTS_PER_BLOCK);
+    CHECK(output_distribution_pop(d) && output_distribution_height(d) == 6);
+
+    CHECK(lmdb_reset(gen.lmdb) == 0);
+    CHECK(output_distribution_height(d) == 0);
+
+    g_array_free(decoded, TRUE);
+    g_byte_array_free(wire, TRUE);
+    chain_gen_close(&gen);
+}
+
+// entries of every table pop_blocks touches
+static void table_entries(chain_gen *gen, size_t entries[13]) {
+    BlockchainLMDB *lmdb = gen->lmdb;
+    const MDB_dbi dbis[13] = {
+        lmdb->m_blocks, lmdb->m_block_info, lmdb->m_block_heights, lmdb->m_hf_versions, lmdb->m_txs,
+        lmdb->m_txs_pruned, lmdb->m_txs_prunable, lmdb->m_txs_prunable_hash, lmdb->m_tx_indices,
+        lmdb->m_tx_outputs, lmdb->m_output_txs, lmdb->m_output_amounts, lmdb->m_spent_keys
+    };
+    MDB_txn *txn;
+    MDB_stat st;
+
+    memset(entries, 0, 13 * sizeof(size_t));
+    if (mdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn)) {
+        CHECK(false);
+        return;
+    }
+    for (int i = 0; i < 13; i++) {
+        if (mdb_stat(txn, dbis[i], &st) == 0) {
+            entries[i] = st.ms_entries;
+        }
+    }
+    mdb_txn_abort(txn);
+}
+
+static bool block_height_exists(chain_gen *gen, const hash *h) {
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    MDB_val k = { 8, (void *)"\0\0\0\0\0\0\0" }, v = { sizeof(hash), (void *)h };
+    bool found = false;
+
+    if (mdb_txn_begin(gen->lmdb->m_env, NULL, MDB_RDONLY, &txn)) {
+        return false;
+    }
+    if (mdb_cursor_open(txn, gen->lmdb->m_block_heights, &cur) == 0) {
+        found = mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH) == 0;
+        mdb_cursor_close(cur);
+    }
+    mdb_txn_abort(txn);
+    return found;
+}
+
+typedef struct pop_record {
+    int calls;
+    lmdb_popped popped;
+    hash first_block;
+} pop_record;
+
+static void record_pop(const lmdb_popped *popped, void *user) {
+    pop_record *r = user;
+    r->calls++;
+    r->popped = *popped;
+    if (popped->blocks_size > 0) {
+        r->first_block = popped->blocks[0];
+    }
+}
+
+void test_pop_blocks() {
+    chain_gen gen;
+    pop_record r;
+    size_t at6[13], after[13], empty[13];
+    output_index_t output;
+    output_data_t data;
+
+    if (!open_chain(&gen, 6)) {
+        CHECK(false);
+        return;
+    }
+    table_entries(&gen, at6);
+    CHECK(at6[0] == 6 && at6[5] == 6 * (1 + TEST_TXS) && at6[11] == 6 * OUTPUTS_PER_BLOCK && at6[12] == 6 * TEST_TXS);
+
+    memset(&r, 0, sizeof(r));
+    lmdb_set_pop_notify(gen.lmdb, record_pop, &r);
+    CHECK(add_blocks(&gen, 4));
+    CHECK(chain_gen_pop(&gen, 9));
+    CHECK(r.calls == 1 && r.popped.blocks_size == 1);
+    CHECK(!block_height_exists(&gen, &r.first_block));
+    CHECK(add_blocks(&gen, 1));
+    r.calls = 0;
+    CHECK(chain_gen_pop(&gen, 6));
+    CHECK(r.calls == 1);
+    CHECK(r.popped.height == 6 && r.popped.old_height == 10);
+    CHECK(r.popped.blocks_size == 4 && r.popped.txs_size == 4 * (1 + TEST_TXS));
+    CHECK(r.popped.key_images_size == 4 * TEST_TXS);
+    CHECK(!block_height_exists(&gen, &r.first_block));
+
+    table_entries(&gen, after);
+    CHECK(memcmp(at6, after, sizeof(at6)) == 0);
+    CHECK(output_distribution_height(&gen.lmdb->m_rct_distribution) == 6);
+    CHECK(gen.tx_id == 6 * (1 + TEST_TXS) && gen.num_outputs == 6 * OUTPUTS_PER_BLOCK);
+    output.amount = 0;
+    output.index = gen.num_outputs - 1;
+    CHECK(lmdb_get_output_data(gen.lmdb, &output, 1, &data) == 0 && data.height == 5);
+    output.index = gen.num_outputs;
+    CHECK(lmdb_get_output_data(gen.lmdb, &output, 1, &data) == -4);
+
+    // nothing to pop, or not that many blocks
+    CHECK(lmdb_pop_blocks(gen.lmdb, 6) == 0);
+    CHECK(lmdb_pop_blocks(gen.lmdb, 7) == -6);
+    CHECK(r.calls == 1);
+
+    // the tails are gone, so appending works again
+    CHECK(add_blocks(&gen, 2));
+    table_entries(&gen, after);
+    CHECK(after[0] == 8 && after[12] == 8 * TEST_TXS && after[11] == 8 * OUTPUTS_PER_BLOCK);
+    output.index = gen.num_outputs - 1;
+    CHECK(lmdb_get_output_data(gen.lmdb, &output, 1, &data) == 0 && data.height == 7);
+
+    CHECK(chain_gen_pop(&gen, 0));
+    CHECK(r.calls == 2 && r.popped.blocks_size == 8);
+    table_entries(&gen, after);
+    memset(empty, 0, sizeof(empty));
+    CHECK(memcmp(after, empty, sizeof(empty)) == 0);
+    CHECK(output_distribution_height(&gen.lmdb->m_rct_distribution) == 0);
+    CHECK(add_blocks(&gen, 1));
+
+    chain_gen_close(&gen);
+}
+
+void test_add_block() {
+    chain_gen gen;
+    output_index_t output = { 0, 0 };
+    output_data_t data;
+    MDB_val junk = { 3, "abc" };
+    size_t entries[13];
+    const size_t txs = 6 * (1 + TEST_TXS);
+    key C;
+    hash top;
+
+    if (!open_chain(&gen, 3)) {
+        CHECK(false);
+        return;
+    }
+    // the miner output is output 0, committed to with a zero mask
+    CHECK(lmdb_get_output_data(gen.lmdb, &output, 1, &data) == 0);
+    zeroCommit(&C, 600000000000ull);
+    CHECK(memcmp(&C, &data.commitment, sizeof(C)) == 0);
+
+    CHECK(lmdb_add_block(gen.lmdb, &junk, NULL, 0, 0, 0, 0) == -4);
+    top = gen.top_hash;
+    gen.top_hash.data[0] ^= 1;
+    CHECK(!add_blocks(&gen, 1));
+    gen.top_hash = top;
+
+    // the baseline writes the same records
+    gen.lmdb->m_plain_puts = true;
+    CHECK(add_blocks(&gen, 2));
+    gen.lmdb->m_plain_puts = false;
+    CHECK(add_blocks(&gen, 1));
+    table_entries(&gen, entries);
+    CHECK(entries[0] == 6 && entries[1] == 6 && entries[2] == 6 && entries[3] == 6 && entries[4] == 0);
+    CHECK(entries[5] == txs && entries[6] == txs && entries[7] == txs && entries[8] == txs && entries[9] == txs);
+    CHECK(entries[10] == 6 * OUTPUTS_PER_BLOCK && entries[11] == 6 * OUTPUTS_PER_BLOCK && entries[12] == 6 * TEST_TXS);
+    CHECK(output_distribution_height(&gen.lmdb->m_rct_distribution) == 6);
+    output.index = gen.num_outputs - 1;
+    CHECK(lmdb_get_output_data(gen.lmdb, &output, 1, &data) == 0 && data.height == 5);
+
+    chain_gen_close(&gen);
+}
+
+// deletes or puts back the hard fork version of height, behind the closed db
+static bool edit_hf_version(chain_gen *gen, uint64_t height, bool del) {
+    MDB_env *env;
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    MDB_val k = { sizeof(height), &height }, v = { 1, "\7" };
+    bool ok = false;
+
+    if (mdb_env_create(&env) || mdb_env_set_maxdbs(env, 20) || mdb_env_open(env, gen->dir, 0, 0644)) {
+        return false;
+    }
+    if (!mdb_txn_begin(env, NULL, 0, &txn)) {
+        ok = !mdb_dbi_open(txn, "hf_versions", MDB_INTEGERKEY, &dbi)
+             && !(del ? mdb_del(txn, dbi, &k, NULL) : mdb_put(txn, dbi, &k, &v, 0))
+             && !mdb_txn_commit(txn);
+        if (!ok) {
+            mdb_txn_abort(txn);
+        }
+    }
+    mdb_env_close(env);
+    return ok;
+}
+
+static int reopen(chain_gen *gen) {
+    lmdb_close(gen->lmdb);
+    g_free(gen->lmdb->m_folder);
+    gen->lmdb->m_folder = NULL;
+    return lmdb_open(gen->lmdb, gen->dir, DBF_FAST);
+}
+
+// a new chain in an environment made with a map of map_size, which LMDB keeps once it has one
+static bool open_small_map(chain_gen *gen, uint64_t map_size) {
+    if (!chain_gen_open(gen)) {
+        return false;
+    }
+    lmdb_close(gen->lmdb);
+    char *data = g_build_filename(gen->dir, CRYPTONOTE_BLOCKCHAINDATA_FILENAME, NULL);
+    char *lock = g_build_filename(gen->dir, CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME, NULL);
+    const bool removed = remove(data) == 0 && remove(lock) == 0;
+    g_free(data);
+    g_free(lock);
+    gen->lmdb->m_map_size = map_size;
+    g_free(gen->lmdb->m_folder);
+    gen->lmdb->m_folder = NULL;
+    return removed && lmdb_open(gen->lmdb, gen->dir, DBF_FAST) == 0;
+}
+
+static size_t map_size(chain_gen *gen) {
+    MDB_envinfo mei;
+    mdb_env_info(gen->lmdb->m_env, &mei);
+    return mei.me_mapsize;
+}
+
+void test_map_growth() {
+    chain_gen gen;
+    const size_t small = 1 << 20;
+    lmdb_tip tip;
+
+    if (!open_small_map(&gen, small)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(map_size(&gen) == small);
+    // well past the map it started with, grown between the adds
+    CHECK(add_blocks(&gen, 150));
+    CHECK(map_size(&gen) > small && lmdb_get_tip(gen.lmdb, &tip) == 0 && tip.height == 150);
+    CHECK(reopen(&gen) == 0 && gen.lmdb->db->m_open);
+    chain_gen_close(&gen);
+}
+
+void test_hf_versions() {
+    chain_gen gen;
+    uint8_t version;
+
+    if (!open_chain(&gen, 4)) {
+        CHECK(false);
+        return;
+    }
+    for (uint64_t h = 0; h < 4; h++) {
+        CHECK(lmdb_get_hard_fork_version(gen.lmdb, h, &version) == 0 && version == 7);
+    }
+    CHECK(lmdb_get_hard_fork_version(gen.lmdb, 4, &version) == -2);
+    CHECK(chain_gen_pop(&gen, 3));
+    CHECK(lmdb_get_hard_fork_version(gen.lmdb, 3, &version) == -2);
+    CHECK(add_blocks(&gen, 2));
+    CHECK(lmdb_get_hard_fork_version(gen.lmdb, 4, &version) == 0 && version == 7);
+
+    // loaded again at open, and checked against the blocks
+    CHECK(reopen(&gen) == 0);
+    CHECK(hf_version_map_height(&gen.lmdb->m_hf_version_map) == 5);
+    CHECK(lmdb_get_hard_fork_version(gen.lmdb, 4, &version) == 0 && version == 7);
+    lmdb_close(gen.lmdb);
+    CHECK(edit_hf_version(&gen, 2, true));
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == -16);
+    CHECK(edit_hf_version(&gen, 2, false));
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == 0);
+    CHECK(lmdb_get_hard_fork_version(gen.lmdb, 2, &version) == 0 && version == 7);
+
+    chain_gen_close(&gen);
+}
+
+static int compare_u64(const MDB_val *a, const MDB_val *b) {
+    uint64_t va, vb;
+    memcpy(&va, a->mv_data, sizeof(va));
+    memcpy(&vb, b->mv_data, sizeof(vb));
+    return (va < vb) ? -1 : va > vb;
+}
+
+/*
+ * Rewrites the closed db the way version 1 kept it: block_info without
+ * bi_cum_rct, whole tx blobs in txs and nothing in the pruned tables.
+ */
+static bool downgrade_to_v1(chain_gen *gen, GArray *cum_rct) {
+    MDB_env *env;
+    MDB_txn *txn;
+    MDB_dbi block_info, txs, pruned, prunable, prunable_hash, properties;
+    MDB_cursor *cur;
+    MDB_val k, v, zk = { 8, (void *)"\0\0\0\0\0\0\0" };
+    GArray *infos = g_array_new(FALSE, FALSE, 80);
+    const uint32_t version = 1;
+    MDB_val vk = { sizeof("version"), "version" }, vv = { sizeof(version), (void *)&version };
+    int result;
+
+    if (mdb_env_create(&env) || mdb_env_set_maxdbs(env, 20) || mdb_env_open(env, gen->dir, 0, 0644)) {
+        return false;
+    }
+    result = mdb_txn_begin(env, NULL, 0, &txn);
+    if (!result) {
+        result = mdb_dbi_open(txn, "block_info", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, &block_info)
+                 || mdb_dbi_open(txn, "txs", MDB_INTEGERKEY, &txs)
+                 || mdb_dbi_open(txn, "txs_pruned", MDB_INTEGERKEY, &pruned)
+                 || mdb_dbi_open(txn, "txs_prunable", MDB_INTEGERKEY, &prunable)
+                 || mdb_dbi_open(txn, "txs_prunable_hash", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, &prunable_hash)
+                 || mdb_dbi_open(txn, "properties", 0, &properties);
+    }
+    if (!result) {
+        mdb_set_dupsort(txn, block_info, compare_u64);
+        result = mdb_cursor_open(txn, block_info, &cur);
+    }
+    if (!result) {
+        // the first 72 bytes are the old record, bi_cum_rct comes last
+        for (result = mdb_cursor_get(cur, &zk, &v, MDB_SET); !result; result = mdb_cursor_get(cur, &k, &v, MDB_NEXT_DUP)) {
+            uint64_t cum;
+            memcpy(&cum, (const uint8_t *)v.mv_data + 72, sizeof(cum));
+            g_array_append_val(cum_rct, cum);
+            g_array_append_vals(infos, v.mv_data, 1);
+        }
+        mdb_cursor_close(cur);
+        result = result == MDB_NOTFOUND ? mdb_drop(txn, block_info, 0) : result;
+    }
+    for (guint i = 0; i < infos->len && !result; i++) {
+        MDB_val old = { 72, infos->data + i * 80 };
+        result = mdb_put(txn, block_info, &zk, &old, MDB_APPENDDUP);
+    }
+    if (!result && !(result = mdb_cursor_open(txn, pruned, &cur))) {
+        for (result = mdb_cursor_get(cur, &k, &v, MDB_FIRST); !result; result = mdb_cursor_get(cur, &k, &v, MDB_NEXT)) {
+            MDB_val rest, whole;
+            GByteArray *b = g_byte_array_new();
+            if ((result = mdb_get(txn, prunable, &k, &rest))) {
+                g_byte_array_free(b, TRUE);
+                break;
+            }
+            g_byte_array_append(b, v.mv_data, v.mv_size);
+            g_byte_array_append(b, rest.mv_data, rest.mv_size);
+            whole.mv_size = b->len;
+            whole.mv_data = b->data;
+            result = mdb_put(txn, txs, &k, &whole, MDB_APPEND);
+            g_byte_array_free(b, TRUE);
+            if (result) {
+                break;
+            }
+        }
+        mdb_cursor_close(cur);
+        if (result == MDB_NOTFOUND) {
+            result = mdb_drop(txn, pruned, 0) || mdb_drop(txn, prunable, 0) || mdb_drop(txn, prunable_hash, 0)
+                     || mdb_put(txn, properties, &vk, &vv, 0);
+        }
+    }
+    result = result ? (mdb_txn_abort(txn), result) : mdb_txn_commit(txn);
+    mdb_env_close(env);
+    g_array_free(infos, TRUE);
+    return result == 0;
+}
+
+typedef struct migrate_record {
+    int calls;
+    int stop_after;
+    uint32_t versions_seen;
+    bool done_before_total;
+} migrate_record;
+
+static bool record_migrate(const lmdb_migrate_progress *p, void *user) {
+    migrate_record *r = user;
+    r->calls++;
+    r->versions_seen |= 1u << p->version;
+    r->done_before_total = r->done_before_total || p->done > p->total;
+    return r->calls != r->stop_after;
+}
+
+void test_migrate() {
+    chain_gen gen;
+    GArray *cum_rct = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+    migrate_record r;
+    size_t before[13], after[13];
+    uint64_t got[12], base;
+    output_index_t output = { 0, 0 };
+    output_data_t data;
+    lmdb_verify_report report;
+
+    if (!open_chain(&gen, 12)) {
+        CHECK(false);
+        return;
+    }
+    table_entries(&gen, before);
+    lmdb_close(gen.lmdb);
+    CHECK(downgrade_to_v1(&gen, cum_rct));
+    CHECK(cum_rct->len == 12);
+
+    // stopped halfway through, as if the process died
+    memset(&r, 0, sizeof(r));
+    r.stop_after = 4;
+    gen.lmdb->m_migrate_batch = 5;
+    gen.lmdb->m_migrate_progress = record_migrate;
+    gen.lmdb->m_migrate_progress_user = &r;
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == -17);
+    CHECK(r.calls == 4);
+
+    // and resumed by the next open
+    r.stop_after = 0;
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == 0);
+    // 12 block_info records each way and 60 txs, 5 a txn
+    CHECK(r.calls >= 4 + 3 + 12);
+    CHECK(r.versions_seen == ((1u << 1) | (1u << 2)));
+    CHECK(!r.done_before_total);
+
+    table_entries(&gen, after);
+    CHECK(memcmp(before, after, sizeof(before)) == 0);
+    CHECK(output_distribution_get(&gen.lmdb->m_rct_distribution, 0, 11, true, got, &base));
+    CHECK(memcmp(got, cum_rct->data, sizeof(got)) == 0);
+    CHECK(lmdb_get_output_data(gen.lmdb, &output, 1, &data) == 0 && data.height == 0);
+    CHECK(lmdb_verify(gen.lmdb, NULL, 5, &report) == 0);
+
+    // a migrated db carries on as usual
+    r.calls = 0;
+    CHECK(add_blocks(&gen, 1));
+    CHECK(chain_gen_pop(&gen, 10));
+    CHECK(reopen(&gen) == 0);
+    CHECK(r.calls == 0);
+
+    g_array_free(cum_rct, TRUE);
+    chain_gen_close(&gen);
+}
+
+// copies the closed db without its free pages, into a map only as big as what it holds
+static bool compact_db(chain_gen *gen, size_t *size) {
+    char *copy = g_build_filename(gen->dir, "compact", NULL);
+    char *from = g_build_filename(copy, CRYPTONOTE_BLOCKCHAINDATA_FILENAME, NULL);
+    char *to = g_build_filename(gen->dir, CRYPTONOTE_BLOCKCHAINDATA_FILENAME, NULL);
+    char *lock = g_build_filename(gen->dir, CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME, NULL);
+    MDB_env *env;
+    bool ok = false;
+
+    // LMDB raises a map smaller than the data to the data's size, and the copy keeps the map
+    if (mkdir(copy, 0755) == 0 && !mdb_env_create(&env)) {
+        ok = !mdb_env_set_maxdbs(env, 20) && !mdb_env_set_mapsize(env, 1) && !mdb_env_open(env, gen->dir, MDB_RDONLY, 0644)
+             && !mdb_env_copy2(env, copy, MDB_CP_COMPACT);
+        mdb_env_close(env);
+    }
+    if (ok && size) {
+        struct stat st;
+        ok = stat(from, &st) == 0;
+        *size = (size_t)st.st_size;
+    }
+    ok = ok && rename(from, to) == 0 && remove(lock) == 0 && rmdir(copy) == 0;
+    g_free(lock);
+    g_free(to);
+    g_free(from);
+    g_free(copy);
+    return ok;
+}
+
+// a migration that needs more than the map it starts in, grown as it goes
+void test_migrate_small_map() {
+    chain_gen gen;
+    GArray *cum_rct = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+    size_t compacted = 0;
+    lmdb_tip tip;
+
+    if (!open_chain(&gen, 20)) {
+        CHECK(false);
+        g_array_free(cum_rct, TRUE);
+        return;
+    }
+    lmdb_close(gen.lmdb);
+    // twice, the first copy keeps a map as big as the free pages and all
+    CHECK(downgrade_to_v1(&gen, cum_rct) && compact_db(&gen, NULL) && compact_db(&gen, &compacted));
+    // one txn for all of it, which can not take back the pages it frees
+    gen.lmdb->m_migrate_batch = 1 << 20;
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    // under the 90% open grows a map at, with too little room left for the migration
+    gen.lmdb->m_map_size = (size_t)(compacted / 0.86);
+    if (lmdb_open(gen.lmdb, gen.dir, DBF_FAST) != 0) {
+        // a failed migration closed the environment already
+        CHECK(false);
+        g_array_free(cum_rct, TRUE);
+        return;
+    }
+    CHECK(map_size(&gen) > gen.lmdb->m_map_size && lmdb_get_tip(gen.lmdb, &tip) == 0 && tip.height == 20);
+    g_array_free(cum_rct, TRUE);
+    chain_gen_close(&gen);
+}
+
+/*
+ * Swaps value with the uint64 ending the record of a dupsort table of the
+ * open db that data finds: bh_height in m_block_heights, bi_cum_rct in
+ * m_block_info. The previous bi_hash comes out in hash if not NULL.
+ */
+static bool swap_record_tail(chain_gen *gen, MDB_dbi dbi, const void *data, size_t size, uint64_t *value, hash *h) {
+    const uint64_t zero = 0;
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    MDB_val k = { sizeof(zero), (void *)&zero }, v = { size, (void *)data };
+    bool ok = false;
+
+    if (mdb_txn_begin(gen->lmdb->m_env, NULL, 0, &txn)) {
+        return false;
+    }
+    if (!mdb_cursor_open(txn, dbi, &cur) && !mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH)) {
+        uint8_t record[256];
+        uint64_t old;
+        memcpy(record, v.mv_data, v.mv_size);
+        memcpy(&old, record + v.mv_size - sizeof(old), sizeof(old));
+        memcpy(record + v.mv_size - sizeof(old), value, sizeof(old));
+        if (h) {
+            memcpy(h, record + v.mv_size - sizeof(old) - sizeof(hash), sizeof(hash));
+        }
+        v.mv_data = record;
+        ok = !mdb_cursor_put(cur, &k, &v, MDB_CURRENT);
+        *value = old;
+    }
+    if (ok) {
+        return !mdb_txn_commit(txn);
+    }
+    mdb_txn_abort(txn);
+    return false;
+}
+
+void test_verify() {
+    chain_gen gen;
+    lmdb_verify_report report;
+    uint64_t value, height = 7;
+    hash h;
+
+    if (!open_chain(&gen, 12)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(lmdb_verify(gen.lmdb, NULL, 0, &report) == 0);
+    CHECK(report.blocks == 12 && report.txs == gen.tx_id && report.outputs == gen.num_outputs);
+    CHECK(report.key_images == 12 * TEST_TXS);
+    CHECK(report.errors == 0 && report.first_bad_height == UINT64_MAX);
+    // ranges that cut through the chain pick up where the one below stopped
+    CHECK(lmdb_verify(gen.lmdb, NULL, 5, &report) == 0);
+    CHECK(report.blocks == 12 && report.outputs == gen.num_outputs);
+
+    // a block_heights record that points elsewhere
+    value = 0;
+    CHECK(swap_record_tail(&gen, gen.lmdb->m_block_info, &height, sizeof(height), &value, &h));
+    CHECK(swap_record_tail(&gen, gen.lmdb->m_block_info, &height, sizeof(height), &value, NULL) && value == 0);
+    value = 3;
+    CHECK(swap_record_tail(&gen, gen.lmdb->m_block_heights, &h, sizeof(h), &value, NULL) && value == 7);
+    CHECK(lmdb_verify(gen.lmdb, NULL, 5, &report) == -4);
+    CHECK(report.errors == 1 && report.first_bad_height == 7);
+    CHECK(swap_record_tail(&gen, gen.lmdb->m_block_heights, &h, sizeof(h), &value, NULL));
+
+    // a bi_cum_rct that goes down
+    height = 4;
+    value = 0;
+    CHECK(swap_record_tail(&gen, gen.lmdb->m_block_info, &height, sizeof(height), &value, NULL));
+    CHECK(lmdb_verify(gen.lmdb, NULL, 0, &report) == -4);
+    CHECK(report.errors > 0 && report.first_bad_height == 4);
+    CHECK(swap_record_tail(&gen, gen.lmdb->m_block_info, &height, sizeof(height), &value, NULL));
+
+    // and the way the tool runs it
+    lmdb_close(gen.lmdb);
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_RDONLY) == 0);
+    CHECK(lmdb_verify(gen.lmdb, NULL, 0, &report) == 0);
+    chain_gen_close(&gen);
+}
+
+typedef struct verify_writer {
+    chain_gen *gen;
+    volatile gint stop;
+    int added;
+} verify_writer;
+
+static gpointer verify_write(gpointer data) {
+    verify_writer *w = data;
+    while (!g_atomic_int_get(&w->stop) && w->added < 400 && add_blocks(w->gen, 1)) {
+        w->added++;
+    }
+    return NULL;
+}
+
+// a write that commits under a verify is caught, not reported as findings
+void test_verify_under_writer() {
+    chain_gen gen;
+    lmdb_verify_report report;
+    verify_writer w = { &gen, 0, 0 };
+    GThread *writer;
+    int result = 0;
+
+    if (!open_chain(&gen, 12)) {
+        CHECK(false);
+        return;
+    }
+    writer = g_thread_new("verify_writer", verify_write, &w);
+    for (int i = 0; i < 200 && result != -5; i++) {
+        result = lmdb_verify(gen.lmdb, NULL, 1, &report);
+        CHECK(result == 0 || result == -5);
+    }
+    g_atomic_int_set(&w.stop, 1);
+    g_thread_join(writer);
+    CHECK(result == -5 && report.errors == 0);
+    CHECK(lmdb_verify(gen.lmdb, NULL, 1, &report) == 0 && report.blocks == 12 + (uint64_t)w.added);
+    chain_gen_close(&gen);
+}
+
+typedef struct scan_part {
+    uint64_t first;
+    uint64_t last;
+    uint64_t records;
+    uint64_t stop_at;
+    bool ordered;
+} scan_part;
+
+typedef struct scan_total {
+    uint64_t records;
+    uint64_t next;
+    size_t parts;
+    bool contiguous;
+} scan_total;
+
+static bool scan_record(uint64_t key, const MDB_val *data, void *part) {
+    scan_part *p = part;
+    if (p->records == 0) {
+        p->first = key;
+    } else if (key < p->last) {
+        p->ordered = false;
+    }
+    p->last = key;
+    p->records++;
+    return p->records != p->stop_at;
+}
+
+static void scan_merge(size_t index, void *part, void *user) {
+    scan_part *p = part;
+    scan_total *t = user;
+    CHECK(index == t->parts);
+    CHECK(p->ordered);
+    if (p->records > 0) {
+        t->contiguous = t->contiguous && p->first == t->next;
+        t->next = p->last + 1;
+    }
+    t->records += p->records;
+    t->parts++;
+}
+
+static bool scan_table(chain_gen *gen, MDB_dbi dbi, size_t nparts, uint64_t stop_at, scan_total *t) {
+    scan_part parts[8];
+    memset(parts, 0, sizeof(parts));
+    memset(t, 0, sizeof(*t));
+    for (size_t i = 0; i < nparts; i++) {
+        parts[i].ordered = true;
+        parts[i].stop_at = stop_at;
+    }
+    t->contiguous = true;
+    return lmdb_for_each_partitioned(gen->lmdb, dbi, NULL, parts, sizeof(parts[0]), nparts, scan_record, scan_merge, t) == 0;
+}
+
+void test_partitioned_scan() {
+    chain_gen gen;
+    scan_total t;
+    scan_part part;
+
+    if (!open_chain(&gen, 12)) {
+        CHECK(false);
+        return;
+    }
+    // heights and tx ids, each key in exactly one part
+    CHECK(scan_table(&gen, gen.lmdb->m_blocks, 5, 0, &t));
+    CHECK(t.parts == 5 && t.records == 12 && t.contiguous && t.next == 12);
+    CHECK(scan_table(&gen, gen.lmdb->m_txs_pruned, 8, 0, &t));
+    CHECK(t.parts == 8 && t.records == gen.tx_id && t.contiguous && t.next == gen.tx_id);
+    CHECK(scan_table(&gen, gen.lmdb->m_blocks, 1, 0, &t));
+    CHECK(t.records == 12 && t.contiguous);
+    // more parts than keys, and the dups of the one key of a zerokval table
+    CHECK(scan_table(&gen, gen.lmdb->m_blocks, 8, 0, &t));
+    CHECK(t.records == 12 && t.contiguous);
+    CHECK(scan_table(&gen, gen.lmdb->m_output_amounts, 4, 0, &t));
+    CHECK(t.parts == 4 && t.records == gen.num_outputs);
+    // a part that stops early leaves the others alone
+    CHECK(scan_table(&gen, gen.lmdb->m_blocks, 3, 1, &t));
+    CHECK(t.records == 3);
+
+    CHECK(lmdb_for_each_partitioned(gen.lmdb, gen.lmdb->m_properties, NULL, &part, sizeof(part), 1, scan_record, NULL, NULL) == -4);
+    chain_gen_close(&gen);
+}
+
+// a process that takes a reader slot of the db in dir and dies holding it
+static bool dead_reader(const char *dir) {
+    int fds[2];
+    char c;
+    pid_t pid;
+
+    if (pipe(fds)) {
+        return false;
+    }
+    pid = fork();
+    if (pid == 0) {
+        MDB_env *env;
+        MDB_txn *txn;
+        close(fds[0]);
+        if (!mdb_env_create(&env) && !mdb_env_set_maxdbs(env, 20) && !mdb_env_open(env, dir, MDB_RDONLY, 0644)
+            && !mdb_txn_begin(env, NULL, MDB_RDONLY, &txn)) {
+            (void)!write(fds[1], "r", 1);
+        }
+        pause();
+        _exit(0);
+    }
+    close(fds[1]);
+    const bool ok = pid > 0 && read(fds[0], &c, 1) == 1;
+    close(fds[0]);
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    return ok;
+}
+
+void test_reader_slots() {
+    chain_gen gen;
+    lmdb_reader_stats stats;
+    MDB_txn *txn;
+
+    if (!open_chain(&gen, 2)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(lmdb_get_reader_stats(gen.lmdb, &stats) == 0);
+    CHECK(stats.max_readers == MAX(g_get_num_processors() + 16, 126));
+
+    // sized for the threads the caller says it runs, when it opens the db first
+    gen.lmdb->m_reader_threads = 200;
+    CHECK(reopen(&gen) == 0);
+    CHECK(lmdb_get_reader_stats(gen.lmdb, &stats) == 0);
+    CHECK(stats.max_readers == g_get_num_processors() + 216);
+
+    CHECK(mdb_txn_begin(gen.lmdb->m_env, NULL, MDB_RDONLY, &txn) == 0);
+    CHECK(lmdb_get_reader_stats(gen.lmdb, &stats) == 0);
+    CHECK(stats.used == 1 && stats.high_water >= 1);
+    mdb_txn_abort(txn);
+
+    // a slot of a dead process is taken until it is cleared
+    CHECK(dead_reader(gen.dir));
+    CHECK(lmdb_get_reader_stats(gen.lmdb, &stats) == 0);
+    const unsigned int used = stats.used;
+    CHECK(used >= 2 && stats.reaped == 0);
+    CHECK(lmdb_check_readers(gen.lmdb) == 1);
+    CHECK(lmdb_get_reader_stats(gen.lmdb, &stats) == 0);
+    CHECK(stats.used == used - 1 && stats.reaped == 1 && stats.full == 0);
+    CHECK(lmdb_check_readers(gen.lmdb) == 0);
+
+    // and cleared by the handle's own sweeps
+    gen.lmdb->m_reader_check_interval = 1;
+    CHECK(reopen(&gen) == 0);
+    CHECK(dead_reader(gen.dir));
+    g_usleep(1500000);
+    CHECK(lmdb_get_reader_stats(gen.lmdb, &stats) == 0);
+    CHECK(stats.reaped == 2);
+    chain_gen_close(&gen);
+}
+
+static bool grow_and_add(chain_gen *gen) {
+    lmdb_do_resize(gen->lmdb, 1 << 26);
+    return add_blocks(gen, 3);
+}
+
+static bool pop_and_add(chain_gen *gen) {
+    return chain_gen_pop(gen, 2) && add_blocks(gen, 6);
+}
+
+// f on the chain from another process, the writer a replica follows
+static bool in_writer(chain_gen *gen, bool (*f)(chain_gen *gen)) {
+    int status;
+    pid_t pid = fork();
+    if (pid == 0) {
+        g_free(gen->lmdb->m_folder);
+        gen->lmdb->m_folder = NULL;
+        const bool ok = lmdb_open(gen->lmdb, gen->dir, DBF_FAST) == 0 && f(gen);
+        lmdb_close(gen->lmdb);
+        _exit(ok ? 0 : 1);
+    }
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void test_replica() {
+    chain_gen gen;
+    BlockchainLMDB replica = { 0 };
+    BlockchainDB db = { 0 };
+    lmdb_replica_tip tip;
+    lmdb_verify_report report;
+    MDB_envinfo before, after;
+    output_index_t output = { 0, 7 * OUTPUTS_PER_BLOCK - 1 };
+    output_data_t data;
+    header_record headers[8];
+    uint8_t version;
+    hash top;
+
+    if (!open_chain(&gen, 4)) {
+        CHECK(false);
+        return;
+    }
+    lmdb_close(gen.lmdb);
+    replica.db = &db;
+    CHECK(lmdb_open(&replica, gen.dir, DBF_REPLICA) == 0);
+    CHECK(lmdb_is_read_only(&replica));
+    CHECK(lmdb_replica_refresh(&replica, &tip) == 0);
+    CHECK(tip.height == 4 && tip.changed_from == 4 && !tip.reorg);
+    top = tip.top;
+    // as small as the file, so the writer's growth is past the end of the map
+    CHECK(mdb_env_set_mapsize(replica.m_env, 1) == 0);
+    mdb_env_info(replica.m_env, &before);
+
+    CHECK(in_writer(&gen, grow_and_add));
+    CHECK(lmdb_replica_refresh(&replica, &tip) == 0);
+    CHECK(tip.height == 7 && tip.changed_from == 4 && !tip.reorg);
+    mdb_env_info(replica.m_env, &after);
+    CHECK(after.me_mapsize > before.me_mapsize);
+    CHECK(lmdb_get_hard_fork_version(&replica, 6, &version) == 0 && version == 7);
+    CHECK(output_distribution_height(&replica.m_rct_distribution) == 7);
+    CHECK(lmdb_get_output_data(&replica, &output, 1, &data) == 0 && data.height == 6);
+    CHECK(lmdb_verify(&replica, NULL, 2, &report) == 0 && report.blocks == 7);
+    CHECK(lmdb_get_headers(&replica, 0, 7, headers) == 0 && memcmp(&headers[6].hash, &tip.top, sizeof(hash)) == 0);
+    top = tip.top;
+
+    // the writer replaced blocks 2 up
+    CHECK(in_writer(&gen, pop_and_add));
+    CHECK(lmdb_replica_refresh(&replica, &tip) == 0);
+    CHECK(tip.height == 8 && tip.changed_from == 2 && tip.reorg);
+    CHECK(memcmp(&tip.top, &top, sizeof(top)) != 0);
+    CHECK(hf_version_map_height(&replica.m_hf_version_map) == 8);
+    CHECK(lmdb_verify(&replica, NULL, 0, &report) == 0 && report.blocks == 8);
+    CHECK(lmdb_get_headers(&replica, 0, 8, headers) == 0 && memcmp(&headers[7].hash, &tip.top, sizeof(hash)) == 0);
+    CHECK(memcmp(&headers[2].prev_id, &headers[1].hash, sizeof(hash)) == 0);
+    CHECK(lmdb_replica_refresh(&replica, &tip) == 0);
+    CHECK(tip.height == 8 && tip.changed_from == 8 && !tip.reorg);
+    lmdb_close(&replica);
+    g_free(replica.m_folder);
+
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == 0);
+    CHECK(lmdb_replica_refresh(gen.lmdb, &tip) == -3);
+    chain_gen_close(&gen);
+}
+
+// the map moves while this thread holds a read txn: a second one fails rather than wait on the first
+void test_map_moved_under_rtxn() {
+    chain_gen gen;
+    BlockchainLMDB replica = { 0 };
+    BlockchainDB db = { 0 };
+    lmdb_replica_tip tip;
+    MDB_envinfo before, after;
+    MDB_txn *txn;
+    mdb_txn_cursors *cursors;
+    output_index_t output = { 0, 0 };
+    output_data_t data;
+    uint64_t height;
+
+    if (!open_chain(&gen, 4)) {
+        CHECK(false);
+        return;
+    }
+    lmdb_close(gen.lmdb);
+    replica.db = &db;
+    CHECK(lmdb_open(&replica, gen.dir, DBF_REPLICA) == 0);
+    CHECK(lmdb_replica_refresh(&replica, &tip) == 0);
+    CHECK(mdb_env_set_mapsize(replica.m_env, 1) == 0);
+    mdb_env_info(replica.m_env, &before);
+
+    CHECK(lmdb_block_rtxn_start(&replica, &txn, &cursors) && txn);
+    CHECK(in_writer(&gen, grow_and_add));
+    CHECK(lmdb_get_output_data(&replica, &output, 1, &data) == -2);
+    mdb_env_info(replica.m_env, &after);
+    CHECK(after.me_mapsize == before.me_mapsize);
+
+    // the cached txn lets go of the map when it is stopped, and is renewed on the new one
+    lmdb_block_rtxn_stop(&replica);
+    CHECK(lmdb_get_output_data(&replica, &output, 1, &data) == 0 && data.height == 0);
+    mdb_env_info(replica.m_env, &after);
+    CHECK(after.me_mapsize > before.me_mapsize);
+    CHECK(lmdb_get_block_height(&replica, &tip.top, &height) == 0 && height == 3);
+    CHECK(lmdb_block_exists(&replica, &tip.top, &height) && height == 3);
+    lmdb_close(&replica);
+    g_free(replica.m_folder);
+
+    g_free(gen.lmdb->m_folder);
+    gen.lmdb->m_folder = NULL;
+    CHECK(lmdb_open(gen.lmdb, gen.dir, DBF_FAST) == 0);
+    chain_gen_close(&gen);
+}
+
+void test_io_profiles() {
+    chain_gen gen;
+    lmdb_io_profile profile;
+    lmdb_verify_report report;
+    unsigned int flags;
+
+    if (!open_chain(&gen, 2)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(gen.lmdb->m_io_profile == LMDB_IO_DEFAULT);
+    CHECK(gen.lmdb->m_rotational >= -1 && gen.lmdb->m_rotational <= 1);
+    CHECK(mdb_env_get_flags(gen.lmdb->m_env, &flags) == 0 && (flags & MDB_NORDAHEAD) && !(flags & MDB_WRITEMAP));
+    CHECK(lmdb_io_profile_from_name("low-memory", &profile) && profile == LMDB_IO_LOW_MEMORY);
+    CHECK(!lmdb_io_profile_from_name("fast", &profile));
+    CHECK(strcmp(lmdb_io_profile_name(LMDB_IO_SERVE), "serve") == 0);
+
+    CHECK(lmdb_set_io_profile(gen.lmdb, LMDB_IO_SYNC, 0) == 0);
+    CHECK(mdb_env_get_flags(gen.lmdb->m_env, &flags) == 0 && (flags & MDB_NOMEMINIT));
+    CHECK(add_blocks(&gen, 2));
+    CHECK(lmdb_set_io_profile(gen.lmdb, LMDB_IO_LOW_MEMORY, 0) == 0);
+    CHECK(mdb_env_get_flags(gen.lmdb->m_env, &flags) == 0 && !(flags & MDB_NOMEMINIT));
+    // the map was dropped from memory, reads fault it back in
+    CHECK(lmdb_verify(gen.lmdb, NULL, 0, &report) == 0 && report.blocks == 4);
+    CHECK(lmdb_set_io_profile(gen.lmdb, LMDB_IO_PROFILES, 0) == -3);
+
+    // write map only from the next open on
+    gen.lmdb->m_io_profile = LMDB_IO_SYNC;
+    CHECK(reopen(&gen) == 0);
+    CHECK(mdb_env_get_flags(gen.lmdb->m_env, &flags) == 0 && (flags & MDB_WRITEMAP) && (flags & MDB_NOMEMINIT));
+    CHECK(add_blocks(&gen, 2));
+    // not without a reopen the caller signs up for
+    CHECK(lmdb_set_io_profile(gen.lmdb, LMDB_IO_SERVE, 0) == -4);
+    CHECK(gen.lmdb->m_io_profile == LMDB_IO_SYNC);
+    CHECK(lmdb_set_io_profile(gen.lmdb, LMDB_IO_SERVE, LMDB_IO_REOPEN) == 0);
+    CHECK(mdb_env_get_flags(gen.lmdb->m_env, &flags) == 0 && (flags & MDB_WRITEMAP) && !(flags & MDB_NOMEMINIT));
+    CHECK(lmdb_verify(gen.lmdb, NULL, 0, &report) == 0 && report.blocks == 6);
+    CHECK(reopen(&gen) == 0);
+    CHECK(mdb_env_get_flags(gen.lmdb->m_env, &flags) == 0 && !(flags & MDB_WRITEMAP));
+    chain_gen_close(&gen);
+}
+
+typedef struct blob_sum {
+    uint64_t next;
+    uint64_t stop;
+    uint64_t txs;
+    uint64_t sum;
+} blob_sum;
+
+static void sum_blob(blob_sum *sum, const MDB_val *v) {
+    for (size_t i = 0; i < v->mv_size; i++) {
+        sum->sum = (sum->sum ^ ((const uint8_t *)v->mv_data)[i]) * 1099511628211ULL;
+    }
+}
+
+static bool sum_blobs(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    blob_sum *sum = user;
+    if (height != sum->next++) {
+        sum->sum = 0;
+        return false;
+    }
+    sum_blob(sum, blob);
+    for (size_t i = 0; i < txs_size; i++) {
+        sum_blob(sum, &txs[i]);
+    }
+    sum->txs += txs_size;
+    return height != sum->stop;
+}
+
+// pops the top block while a range is being read
+static bool pop_in_range(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    chain_gen *gen = user;
+    (void)blob;
+    (void)txs;
+    (void)txs_size;
+    return height != 0 || lmdb_pop_blocks(gen->lmdb, gen->height - 1) == 0;
+}
+
+void test_prefetch() {
+    chain_gen gen;
+    blob_sum plain = { 0, UINT64_MAX, 0, 0 }, ahead = { 0, UINT64_MAX, 0, 0 }, part = { 0, 5, 0, 0 };
+    blob_sum renewed = { 0, UINT64_MAX, 0, 0 };
+    lmdb_prefetch_stats stats;
+
+    if (!open_chain(&gen, 12)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, 11, sum_blobs, &plain) == 0);
+    lmdb_get_prefetch_stats(gen.lmdb, &stats);
+    CHECK(stats.blocks == 0);
+
+    gen.lmdb->m_prefetch_distance = 3;
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, 11, sum_blobs, &ahead) == 0);
+    CHECK(ahead.next == 12 && ahead.txs == 12 * TEST_TXS && ahead.sum == plain.sum);
+    lmdb_get_prefetch_stats(gen.lmdb, &stats);
+    CHECK(stats.blocks == 12 && stats.hits <= stats.blocks && (stats.hits == stats.blocks) == (stats.stalls == 0));
+
+    // the reader stops first, and a range within the distance is not read ahead
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, 11, sum_blobs, &part) == 0 && part.next == 6);
+    part.next = 10;
+    part.stop = UINT64_MAX;
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 10, 11, sum_blobs, &part) == 0 && part.next == 12);
+    lmdb_get_prefetch_stats(gen.lmdb, &stats);
+    CHECK(stats.blocks == 18);
+    part.next = 10;
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 10, 12, sum_blobs, &part) == -4);
+
+    // a new snapshot every few blocks reads the same, and stops at a pop
+    gen.lmdb->m_range_renew = 2;
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, 11, sum_blobs, &renewed) == 0);
+    CHECK(renewed.next == 12 && renewed.sum == plain.sum);
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, 10, pop_in_range, &gen) == -8);
+    chain_gen_close(&gen);
+}
+
+#define FEED_EVENTS 200000
+
+typedef struct feed_reader {
+    event_feed *feed;
+    event_cursor cursor;
+    volatile gint *done;
+    uint64_t read;
+    bool ok;
+} feed_reader;
+
+static void feed_event(chain_event *e, uint64_t height) {
+    memset(e, 0, sizeof(*e));
+    e->type = CHAIN_EVENT_BLOCK_ADDED;
+    e->height = height;
+    memset(&e->hash, (int)(height & 0xff), sizeof(e->hash));
+    e->commit = height * 3;
+}
+
+static gpointer feed_read(gpointer data) {
+    feed_reader *r = data;
+    chain_event e, want;
+    for (;;) {
+        const bool done = g_atomic_int_get(r->done);
+        const int result = event_feed_next(r->feed, &r->cursor, &e);
+        if (result == 0) {
+            feed_event(&want, r->cursor.next - 1);
+            r->ok = r->ok && memcmp(&e, &want, sizeof(e)) == 0;
+            r->read++;
+        } else if (result == -1 && done) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static bool bridge_recv(int fd, chain_event *e) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    // a byte over, so a longer packet does not pass as a whole one
+    uint8_t packet[CHAIN_EVENT_WIRE_SIZE + 1];
+    if (poll(&pfd, 1, 2000) != 1) {
+        return false;
+    }
+    const ssize_t n = recv(fd, packet, sizeof(packet), 0);
+    return n >= 0 && chain_event_decode(packet, (size_t)n, e);
+}
+
+void test_event_feed() {
+    event_feed *feed = g_new0(event_feed, 1);
+    event_cursor cursor;
+    chain_event e, want;
+    feed_reader readers[2];
+    volatile gint done = 0;
+    GThread *threads[2];
+    uint8_t packet[CHAIN_EVENT_WIRE_SIZE];
+
+    // the wire layout: little endian, no padding
+    feed_event(&want, 0x0102);
+    chain_event_encode(&want, packet);
+    CHECK(packet[0] == CHAIN_EVENT_BLOCK_ADDED && packet[3] == 0 && packet[4] == 0x02 && packet[5] == 0x01);
+    CHECK(packet[12] == 0x02 && packet[44] == 0x06 && packet[45] == 0x03 && packet[51] == 0);
+    CHECK(chain_event_decode(packet, sizeof(packet), &e) && memcmp(&e, &want, sizeof(e)) == 0);
+    CHECK(!chain_event_decode(packet, sizeof(packet) - 1, &e));
+
+    event_feed_subscribe(feed, &cursor);
+    CHECK(event_feed_next(feed, &cursor, &e) == -1);
+    for (uint64_t h = 0; h < 3; h++) {
+        feed_event(&e, h);
+        event_feed_publish(feed, &e);
+    }
+    for (uint64_t h = 0; h < 3; h++) {
+        feed_event(&want, h);
+        CHECK(event_feed_next(feed, &cursor, &e) == 0 && memcmp(&e, &want, sizeof(e)) == 0);
+    }
+    CHECK(event_feed_next(feed, &cursor, &e) == -1);
+
+    // lapped: the cursor skips to the oldest event left
+    for (uint64_t h = 3; h < 3 + EVENT_FEED_SLOTS + 10; h++) {
+        feed_event(&e, h);
+        event_feed_publish(feed, &e);
+    }
+    CHECK(event_feed_next(feed, &cursor, &e) == -2 && cursor.lost == 10 && cursor.next == 13);
+    CHECK(event_feed_next(feed, &cursor, &e) == 0 && e.height == 13);
+    g_free(feed);
+
+    // readers against a writer that never waits for them: each event whole, none twice
+    feed = g_new0(event_feed, 1);
+    for (int i = 0; i < 2; i++) {
+        readers[i] = (feed_reader){ feed, { 0, 0 }, &done, 0, true };
+        threads[i] = g_thread_new("feed_reader", feed_read, &readers[i]);
+    }
+    for (uint64_t h = 0; h < FEED_EVENTS; h++) {
+        feed_event(&e, h);
+        event_feed_publish(feed, &e);
+    }
+    g_atomic_int_set(&done, 1);
+    for (int i = 0; i < 2; i++) {
+        g_thread_join(threads[i]);
+        CHECK(readers[i].ok && readers[i].read + readers[i].cursor.lost == FEED_EVENTS);
+    }
+    g_free(feed);
+}
+
+void test_block_events() {
+    chain_gen gen;
+    event_cursor cursor;
+    chain_event added[2], e;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    event_bridge *bridge;
+    uint64_t lost = 0, last = 0;
+    int fd;
+
+    if (!open_chain(&gen, 3)) {
+        CHECK(false);
+        return;
+    }
+    event_feed_subscribe(&gen.lmdb->m_events, &cursor);
+    CHECK(add_blocks(&gen, 2));
+    for (uint64_t i = 0; i < 2; i++) {
+        CHECK(event_feed_next(&gen.lmdb->m_events, &cursor, &added[i]) == 0);
+        CHECK(added[i].type == CHAIN_EVENT_BLOCK_ADDED && added[i].height == 3 + i);
+    }
+    CHECK(memcmp(&added[1].hash, &gen.top_hash, sizeof(hash)) == 0 && added[1].commit > added[0].commit);
+    CHECK(event_feed_next(&gen.lmdb->m_events, &cursor, &e) == -1);
+
+    // one txn pops both, from the top down
+    CHECK(lmdb_pop_blocks(gen.lmdb, 3) == 0);
+    for (int i = 1; i >= 0; i--) {
+        CHECK(event_feed_next(&gen.lmdb->m_events, &cursor, &e) == 0);
+        CHECK(e.type == CHAIN_EVENT_BLOCK_POPPED && e.height == added[i].height);
+        CHECK(memcmp(&e.hash, &added[i].hash, sizeof(hash)) == 0 && e.commit > added[1].commit);
+    }
+
+    char *path = g_build_filename(gen.dir, "events.sock", NULL);
+    bridge = event_bridge_new(&gen.lmdb->m_events, path);
+    CHECK(bridge != NULL);
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    CHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    // the bridge sends what was published after it accepted
+    do {
+        feed_event(&e, 0);
+        event_feed_publish(&gen.lmdb->m_events, &e);
+    } while (!bridge_recv(fd, &e) && ++last < 20);
+    CHECK(e.type == CHAIN_EVENT_BLOCK_ADDED);
+
+    // more than the feed holds while the connection is not read
+    for (uint64_t h = 1; h <= 3 * EVENT_FEED_SLOTS; h++) {
+        feed_event(&e, h);
+        event_feed_publish(&gen.lmdb->m_events, &e);
+    }
+    last = 0;
+    while (last < 3 * EVENT_FEED_SLOTS && bridge_recv(fd, &e)) {
+        if (e.type == CHAIN_EVENT_OVERRUN) {
+            lost += e.height;
+        } else if (e.height > 0) {
+            CHECK(e.height > last);
+            last = e.height;
+        }
+    }
+    CHECK(last == 3 * EVENT_FEED_SLOTS && lost > 0);
+    close(fd);
+    event_bridge_free(bridge);
+    CHECK(access(path, F_OK) != 0);
+    g_free(path);
+    chain_gen_close(&gen);
+}
+
+#define TIP_BLOCKS 40
+
+typedef struct tip_reader {
+    BlockchainLMDB *lmdb;
+    volatile gint *done;
+    GArray *seen;       // lmdb_tip, each one the reader saw change to
+} tip_reader;
+
+static gpointer tip_read(gpointer data) {
+    tip_reader *r = data;
+    lmdb_tip tip, last = { 0 };
+    while (!g_atomic_int_get(r->done)) {
+        if (lmdb_get_tip(r->lmdb, &tip) == 0 && tip.commit != last.commit) {
+            g_array_append_val(r->seen, tip);
+            last = tip;
+        }
+    }
+    return NULL;
+}
+
+static bool tip_is(chain_gen *gen, const lmdb_tip *tip) {
+    uint8_t version;
+    return tip->height == gen->height && memcmp(&tip->top, &gen->top_hash, sizeof(hash)) == 0
+        && tip->cumulative_difficulty == gen->cumulative_difficulty
+        && lmdb_get_hard_fork_version(gen->lmdb, gen->height - 1, &version) == 0 && tip->hf_version == version;
+}
+
+void test_tip() {
+    chain_gen gen;
+    lmdb_tip tip, before;
+    volatile gint done = 0;
+    tip_reader reader;
+    GThread *thread;
+
+    if (!chain_gen_open(&gen)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(lmdb_get_tip(gen.lmdb, &tip) == 0 && tip.height == 0 && tip.cumulative_difficulty == 0);
+    CHECK(add_blocks(&gen, 3));
+    CHECK(lmdb_get_tip(gen.lmdb, &before) == 0 && tip_is(&gen, &before) && before.commit > tip.commit);
+    CHECK(chain_gen_pop(&gen, 1));
+    CHECK(lmdb_get_tip(gen.lmdb, &tip) == 0 && tip_is(&gen, &tip) && tip.commit > before.commit);
+    CHECK(reopen(&gen) == 0);
+    CHECK(lmdb_get_tip(gen.lmdb, &tip) == 0 && tip_is(&gen, &tip));
+
+    // a reader never sees a tip half written: each height with the hash and difficulty that block had
+    reader = (tip_reader){ gen.lmdb, &done, g_array_new(FALSE, FALSE, sizeof(lmdb_tip)) };
+    thread = g_thread_new("tip_reader", tip_read, &reader);
+    const uint64_t first = gen.height;
+    hash tops[TIP_BLOCKS];
+    for (int i = 0; i < TIP_BLOCKS; i++) {
+        CHECK(add_blocks(&gen, 1));
+        tops[i] = gen.top_hash;
+    }
+    g_atomic_int_set(&done, 1);
+    g_thread_join(thread);
+    CHECK(reader.seen->len > 0);
+    for (guint i = 0; i < reader.seen->len; i++) {
+        const lmdb_tip *seen = &g_array_index(reader.seen, lmdb_tip, i);
+        CHECK(seen->height >= first && seen->height <= first + TIP_BLOCKS);
+        CHECK(seen->height == first || memcmp(&seen->top, &tops[seen->height - first - 1], sizeof(hash)) == 0);
+        CHECK(seen->cumulative_difficulty == seen->height * gen.difficulty);
+        CHECK(i == 0 || seen->commit > g_array_index(reader.seen, lmdb_tip, i - 1).commit);
+    }
+    CHECK(lmdb_get_tip(gen.lmdb, &tip) == 0 && tip_is(&gen, &tip));
+    g_array_free(reader.seen, TRUE);
+
+    CHECK(lmdb_reset(gen.lmdb) == 0);
+    CHECK(lmdb_get_tip(gen.lmdb, &tip) == 0 && tip.height == 0 && tip.commit > 0);
+    chain_gen_close(&gen);
+}
+
+// the chain_gen made, every record linked to the one before
+static bool headers_match(chain_gen *gen) {
+    header_record *r = g_new(header_record, gen->height);
+    bool match = lmdb_get_headers(gen->lmdb, 0, gen->height, r) == 0;
+    for (uint64_t h = 0; match && h < gen->height; h++) {
+        match = r[h].height == h && (h == 0 || memcmp(&r[h].prev_id, &r[h - 1].hash, sizeof(hash)) == 0);
+    }
+    match = match && memcmp(&r[gen->height - 1].hash, &gen->top_hash, sizeof(hash)) == 0
+        && r[gen->height - 1].cumulative_difficulty == gen->cumulative_difficulty;
+    g_free(r);
+    return match;
+}
+
+// over what the header file has at offset, then reopened
+static bool headers_overwrite(chain_gen *gen, const void *data, size_t size, off_t offset) {
+    char *path = g_build_filename(gen->dir, HEADER_FILE_NAME, NULL);
+    int fd = open(path, O_WRONLY);
+    const bool written = fd >= 0 && pwrite(fd, data, size, offset) == (ssize_t)size;
+    if (fd >= 0) {
+        close(fd);
+    }
+    g_free(path);
+    return written && reopen(gen) == 0;
+}
+
+typedef struct headers_reader {
+    header_file f;
+    header_record r;
+    bool done;
+} headers_reader;
+
+static gpointer headers_read(gpointer arg) {
+    headers_reader *reader = arg;
+    const bool read = header_file_read(&reader->f, 0, 1, &reader->r);
+    __atomic_store_n(&reader->done, true, __ATOMIC_RELEASE);
+    return GINT_TO_POINTER(read);
+}
+
+// a reader started with the sequence odd, as in an append: it waits for the append and copies what it wrote
+static bool headers_read_waits(chain_gen *gen, off_t seq_offset) {
+    char *path = g_build_filename(gen->dir, HEADER_FILE_NAME, NULL);
+    const int fd = open(path, O_RDWR);
+    headers_reader reader = { .done = false };
+    header_record before, after;
+    uint64_t seq;
+    bool ok;
+
+    g_free(path);
+    if (fd < 0 || header_file_open(&reader.f, gen->dir, true) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    header_file_follow(&reader.f, UINT64_MAX);
+    ok = header_file_read(&reader.f, 0, 1, &before) && pread(fd, &seq, sizeof(seq), seq_offset) == sizeof(seq);
+    after = before;
+    after.timestamp++;
+    seq++;
+    ok = ok && pwrite(fd, &seq, sizeof(seq), seq_offset) == sizeof(seq);
+    GThread *thread = g_thread_new("headers_reader", headers_read, &reader);
+    g_usleep(20000);
+    ok = ok && !__atomic_load_n(&reader.done, __ATOMIC_ACQUIRE);
+    ok = pwrite(fd, &after, sizeof(after), HEADER_RECORD_SIZE) == sizeof(after) && ok;
+    seq++;
+    ok = pwrite(fd, &seq, sizeof(seq), seq_offset) == sizeof(seq) && ok;
+    ok = g_thread_join(thread) && ok && reader.r.timestamp == after.timestamp;
+    ok = pwrite(fd, &before, sizeof(before), HEADER_RECORD_SIZE) == sizeof(before) && ok;
+    header_file_close(&reader.f);
+    close(fd);
+    return ok;
+}
+
+void test_header_file() {
+    chain_gen gen;
+    header_record r[16];
+    const hash junk = { { 1 } };
+    const uint64_t behind = 2;
+    // records come after a header of their size, which has the count at 16 and the sequence at 24
+    const off_t count_offset = 16, seq_offset = 24;
+
+    if (!open_chain(&gen, 5)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(headers_match(&gen));
+    CHECK(lmdb_get_headers(gen.lmdb, 3, 3, r) == -3);
+    CHECK(lmdb_get_headers(gen.lmdb, 3, 2, r) == 0 && r[1].major_version > 0 && r[1].timestamp > r[0].timestamp);
+    CHECK(chain_gen_pop(&gen, 3));
+    CHECK(lmdb_get_headers(gen.lmdb, 0, 4, r) == -3);
+    CHECK(add_blocks(&gen, 2));
+    CHECK(headers_match(&gen));
+    CHECK(reopen(&gen) == 0 && headers_match(&gen));
+
+    // a record missed: the file takes no more, and what it has is still read
+    const uint64_t kept = gen.height - 1;
+    CHECK(lmdb_get_headers(gen.lmdb, 0, kept, r) == 0);
+    CHECK(header_file_truncate(&gen.lmdb->m_headers, kept) == 0);
+    CHECK(add_blocks(&gen, 1));
+    CHECK(gen.lmdb->m_headers.stale && r[kept - 1].height == kept - 1);
+    CHECK(lmdb_get_headers(gen.lmdb, kept, 1, r) == -3 && lmdb_get_headers(gen.lmdb, 0, kept, r) == 0);
+    CHECK(chain_gen_pop(&gen, kept + 1));
+    CHECK(reopen(&gen) == 0 && !gen.lmdb->m_headers.stale && headers_match(&gen));
+
+    CHECK(headers_read_waits(&gen, seq_offset));
+    CHECK(headers_match(&gen));
+    // a writer that stopped in an append leaves the sequence odd, the next one moves it on
+    uint64_t seq = 7;
+    CHECK(headers_overwrite(&gen, &seq, sizeof(seq), seq_offset) && headers_match(&gen));
+
+    // a record the db does not agree with, as a pop the header file missed leaves
+    CHECK(headers_overwrite(&gen, &junk, sizeof(junk), HEADER_RECORD_SIZE * 5 + offsetof(header_record, hash)));
+    CHECK(headers_match(&gen));
+    // behind, as after a crash between a commit and the append
+    CHECK(headers_overwrite(&gen, &behind, sizeof(behind), count_offset));
+    CHECK(headers_match(&gen));
+    // another format, and none at all: read from the blocks
+    CHECK(headers_overwrite(&gen, "XXXXXXXX", 8, 0));
+    CHECK(headers_match(&gen));
+    char *path = g_build_filename(gen.dir, HEADER_FILE_NAME, NULL);
+    CHECK(unlink(path) == 0);
+    g_free(path);
+    CHECK(reopen(&gen) == 0 && headers_match(&gen));
+
+    CHECK(lmdb_reset(gen.lmdb) == 0);
+    CHECK(lmdb_get_headers(gen.lmdb, 0, 1, r) == -3);
+    chain_gen_close(&gen);
+}
+
+int main(int argc, char *argv[])
+{
+    test_absolute_offsets();
+    test_output_data();
+    test_output_cache();
+    test_resolve_inputs();
+    test_output_distribution();
+    test_pop_blocks();
+    test_add_block();
+    test_map_growth();
+    test_hf_versions();
+    test_migrate();
+    test_migrate_small_map();
+    test_verify();
+    test_verify_under_writer();
+    test_partitioned_scan();
+    test_reader_slots();
+    test_replica();
+    test_map_moved_under_rtxn();
+    test_io_profiles();
+    test_prefetch();
+    test_event_feed();
+    test_block_events();
+    test_tip();
+    test_header_file();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all blockchain_db tests passed\n");
+    return 0;
+}
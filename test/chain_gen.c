@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <string.h>
+#include "glib.h"
+#include "crypto/crypto-ops.h"
+#include "crypto/hash-ops.h"
+#include "crypto/random.h"
+#include "common/varint.h"
+#include "cryptonote_config.h"
+#include "common/arena.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "chain_gen.h"
+
+// mirrors the block_info record of db_lmdb.c
+typedef struct gen_block_info {
+    uint64_t bi_height;
+    uint64_t bi_timestamp;
+    uint64_t bi_coins;
+    uint64_t bi_weight;
+    difficulty_type bi_diff;
+    hash bi_hash;
+    uint64_t bi_cum_rct;
+} gen_block_info;
+
+static const char zerokey[8] = { 0 };
+
+static void put_varint(GByteArray *b, uint64_t v) {
+    uint8_t buf[VARINT_MAX_SIZE];
+    g_byte_array_append(b, buf, write_varint(buf, v));
+}
+
+static void put_bytes(GByteArray *b, const void *data, size_t size) {
+    g_byte_array_append(b, data, size);
+}
+
+static void random_secret_key(secret_key *sec) {
+    unsigned char tmp[64];
+    generate_random_bytes(sizeof(tmp), tmp);
+    sc_reduce(tmp);
+    memcpy(sec->data, tmp, sizeof(sec->data));
+}
+
+static void random_public_key(public_key *pub) {
+    secret_key sec;
+    random_secret_key(&sec);
+    secret_key_to_public_key(&sec, pub);
+}
+
+void chain_gen_account(wallet_account *account) {
+    random_secret_key(&account->view_secret_key);
+    random_public_key(&account->spend_public_key);
+}
+
+// P = Hs(8 * r * A || index) * G + B
+static void output_key(public_key *P, const wallet_account *to, const secret_key *r, size_t index) {
+    public_key A;
+    key_derivation derivation;
+    secret_key_to_public_key(&to->view_secret_key, &A);
+    generate_key_derivation(&A, r, &derivation);
+    derive_public_key(&derivation, index, &to->spend_public_key, P);
+}
+
+static void write_tx(GByteArray *b, uint64_t height, uint32_t tx_index, size_t num_outputs, bool additional_keys,
+                     const wallet_account *accounts, chain_gen_recipient recipient, void *user) {
+    const bool miner = tx_index == 0;
+    secret_key r;
+    public_key R;
+    secret_key *ri = NULL;
+    public_key *Ri = NULL;
+    GByteArray *extra = g_byte_array_new();
+
+    random_secret_key(&r);
+    secret_key_to_public_key(&r, &R);
+    if (additional_keys) {
+        ri = g_new(secret_key, num_outputs);
+        Ri = g_new(public_key, num_outputs);
+        for (size_t i = 0; i < num_outputs; i++) {
+            random_secret_key(&ri[i]);
+            secret_key_to_public_key(&ri[i], &Ri[i]);
+        }
+    }
+
+    put_varint(b, 2);
+    put_varint(b, miner ? height + 60 : 0);
+    put_varint(b, 1);
+    if (miner) {
+        put_bytes(b, (const uint8_t[]){ TXIN_GEN_TAG }, 1);
+        put_varint(b, height);
+    } else {
+        key_image ki;
+        random_public_key(&ki);
+        put_bytes(b, (const uint8_t[]){ TXIN_TO_KEY_TAG }, 1);
+        put_varint(b, 0);
+        put_varint(b, 11);
+        // relative, the ring is outputs height * 7 to height * 7 + 10
+        put_varint(b, height * 7);
+        for (int i = 1; i < 11; i++) {
+            put_varint(b, 1);
+        }
+        put_bytes(b, &ki, sizeof(ki));
+    }
+
+    put_varint(b, num_outputs);
+    for (size_t i = 0; i < num_outputs; i++) {
+        const int to = recipient ? recipient(height, tx_index, (uint32_t)i, user) : -1;
+        public_key P;
+        if (to < 0) {
+            random_public_key(&P);
+        } else if (additional_keys && (i & 1)) {
+            output_key(&P, &accounts[to], &ri[i], i);
+        } else {
+            output_key(&P, &accounts[to], &r, i);
+        }
+        put_varint(b, miner ? 600000000000ull : 0);
+        put_bytes(b, (const uint8_t[]){ TXOUT_TO_KEY_TAG }, 1);
+        put_bytes(b, &P, sizeof(P));
+    }
+
+    g_byte_array_append(extra, (const uint8_t[]){ TX_EXTRA_TAG_PUBKEY }, 1);
+    put_bytes(extra, &R, sizeof(R));
+    if (additional_keys) {
+        g_byte_array_append(extra, (const uint8_t[]){ TX_EXTRA_TAG_ADDITIONAL_PUBKEYS }, 1);
+        put_varint(extra, num_outputs);
+        put_bytes(extra, Ri, num_outputs * sizeof(public_key));
+    }
+    put_varint(b, extra->len);
+    put_bytes(b, extra->data, extra->len);
+    // null ringct signature
+    put_bytes(b, (const uint8_t[]){ 0 }, 1);
+
+    g_byte_array_free(extra, TRUE);
+    g_free(Ri);
+    g_free(ri);
+}
+
+bool chain_gen_open(chain_gen *gen) {
+    GError *error = NULL;
+
+    gen->dir = g_dir_make_tmp("chain_gen_XXXXXX", &error);
+    if (!gen->dir) {
+        printf("chain_gen: %s\n", error->message);
+        g_error_free(error);
+        return false;
+    }
+    gen->lmdb = g_new0(BlockchainLMDB, 1);
+    gen->lmdb->db = g_new0(BlockchainDB, 1);
+    gen->height = 0;
+    gen->tx_id = 0;
+    gen->num_outputs = 0;
+    gen->timestamp = 1500000000;
+    gen->difficulty = 1000;
+    gen->cumulative_difficulty = 0;
+    memset(&gen->top_hash, 0, sizeof(gen->top_hash));
+    if (lmdb_open(gen->lmdb, gen->dir, DBF_FAST) != 0) {
+        printf("chain_gen: failed to open %s\n", gen->dir);
+        return false;
+    }
+    return true;
+}
+
+void chain_gen_close(chain_gen *gen) {
+    char *data = g_build_filename(gen->dir, CRYPTONOTE_BLOCKCHAINDATA_FILENAME, NULL);
+    char *lock = g_build_filename(gen->dir, CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME, NULL);
+
+    lmdb_close(gen->lmdb);
+    remove(data);
+    remove(lock);
+    remove(gen->dir);
+    g_free(lock);
+    g_free(data);
+    g_free(gen->lmdb->m_folder);
+    g_free(gen->lmdb->db);
+    g_free(gen->lmdb);
+    g_free(gen->dir);
+}
+
+bool chain_gen_add_block(chain_gen *gen, const wallet_account *accounts, size_t num_txs, size_t num_outputs, bool additional_keys, chain_gen_recipient recipient, void *user) {
+    GByteArray *blob = g_byte_array_new();
+    GByteArray **txs = g_new(GByteArray *, num_txs);
+    MDB_val *tx_blobs = g_new(MDB_val, num_txs);
+    hash *tx_hashes = g_new(hash, num_txs);
+    arena a;
+    block b;
+    transaction tx;
+    int result;
+
+    arena_init(&a, 4096);
+    for (size_t i = 0; i < num_txs; i++) {
+        txs[i] = g_byte_array_new();
+        write_tx(txs[i], gen->height, (uint32_t)(i + 1), num_outputs, additional_keys, accounts, recipient, user);
+        parse_and_validate_tx_from_blob(txs[i]->data, txs[i]->len, &a, &tx);
+        get_transaction_hash(&tx, &tx_hashes[i]);
+        tx_blobs[i].mv_data = txs[i]->data;
+        tx_blobs[i].mv_size = txs[i]->len;
+    }
+    put_varint(blob, 7);
+    put_varint(blob, 7);
+    put_varint(blob, gen->timestamp);
+    put_bytes(blob, &gen->top_hash, sizeof(gen->top_hash));
+    put_bytes(blob, zerokey, sizeof(uint32_t));
+    write_tx(blob, gen->height, 0, 1, false, accounts, recipient, user);
+    put_varint(blob, num_txs);
+    put_bytes(blob, tx_hashes, num_txs * sizeof(hash));
+
+    MDB_val block_blob = { blob->len, blob->data };
+    result = lmdb_add_block(gen->lmdb, &block_blob, tx_blobs, num_txs, blob->len,
+                            gen->cumulative_difficulty + gen->difficulty, 0);
+    if (result) {
+        printf("chain_gen: failed to add block %llu: %d\n", (unsigned long long)gen->height, result);
+    } else {
+        parse_and_validate_block_from_blob(blob->data, blob->len, &a, &b);
+        get_block_hash(&b, &gen->top_hash);
+        gen->height++;
+        gen->tx_id += 1 + num_txs;
+        gen->num_outputs += 1 + num_txs * num_outputs;
+        gen->cumulative_difficulty += gen->difficulty;
+        gen->timestamp += DIFFICULTY_TARGET_V2;
+    }
+    for (size_t i = 0; i < num_txs; i++) {
+        g_byte_array_free(txs[i], TRUE);
+    }
+    g_free(txs);
+    g_free(tx_blobs);
+    g_free(tx_hashes);
+    arena_clear(&a);
+    g_byte_array_free(blob, TRUE);
+    return result == 0;
+}
+
+bool chain_gen_pop(chain_gen *gen, uint64_t height) {
+    BlockchainLMDB *lmdb = gen->lmdb;
+    const uint64_t popped = gen->height - height;
+    uint64_t outputs = 0;
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    MDB_stat st;
+    MDB_val k = { sizeof(zerokey), (void *)zerokey }, v;
+    int result;
+
+    if (height > gen->height || lmdb_pop_blocks(lmdb, height) != 0) {
+        return false;
+    }
+    if (mdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn)) {
+        return false;
+    }
+    result = mdb_stat(txn, lmdb->m_txs_pruned, &st);
+    memset(&gen->top_hash, 0, sizeof(gen->top_hash));
+    if (!result && height > 0 && !(result = mdb_cursor_open(txn, lmdb->m_block_info, &cur))) {
+        if (!(result = mdb_cursor_get(cur, &k, &v, MDB_SET)) && !(result = mdb_cursor_get(cur, &k, &v, MDB_LAST_DUP))) {
+            gen->top_hash = ((const gen_block_info *)v.mv_data)->bi_hash;
+        }
+        mdb_cursor_close(cur);
+    }
+    mdb_txn_abort(txn);
+    if (result || (height > 0 && !output_distribution_count(&lmdb->m_rct_distribution, 0, height - 1, &outputs))) {
+        return false;
+    }
+    gen->height = height;
+    gen->tx_id = st.ms_entries;
+    gen->num_outputs = outputs;
+    gen->timestamp -= popped * DIFFICULTY_TARGET_V2;
+    gen->cumulative_difficulty -= popped * gen->difficulty;
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef MONERO_TEST_CHAIN_GEN_H_
+#define MONERO_TEST_CHAIN_GEN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "wallet/wallet_scanner.h"
+
+/*
+ * Builds a synthetic chain and adds it with lmdb_add_block, in a temporary
+ * directory: blocks with a miner tx and v2 txs whose outputs are all rct
+ * ones.
+ */
+typedef struct chain_gen {
+    char *dir;
+    BlockchainLMDB *lmdb;
+    uint64_t height;
+    uint64_t tx_id;
+    uint64_t num_outputs;
+    // of the next block, the timestamp advances by DIFFICULTY_TARGET_V2 by default
+    uint64_t timestamp;
+    difficulty_type difficulty;
+    difficulty_type cumulative_difficulty;
+    // the prev_id of the next block
+    hash top_hash;
+} chain_gen;
+
+// the account output output_index of tx tx_index is sent to, or -1
+typedef int (*chain_gen_recipient)(uint64_t height, uint32_t tx_index, uint32_t output_index, void *user);
+
+bool chain_gen_open(chain_gen *gen);
+void chain_gen_close(chain_gen *gen);
+
+void chain_gen_account(wallet_account *account);
+
+/*
+ * Appends a block with a miner tx and num_txs txs of num_outputs outputs
+ * each. With additional_keys the txs carry one tx key per output.
+ */
+bool chain_gen_add_block(chain_gen *gen, const wallet_account *accounts, size_t num_txs, size_t num_outputs, bool additional_keys, chain_gen_recipient recipient, void *user);
+
+/*
+ * Pops the chain back to height with lmdb_pop_blocks and rewinds the
+ * counters, so blocks can be added again. The difficulty is assumed to
+ * have been gen->difficulty for the popped blocks.
+ */
+bool chain_gen_pop(chain_gen *gen, uint64_t height);
+
+#endif //MONERO_TEST_CHAIN_GEN_H_
@@ -0,0 +1,211 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "glib.h"
+#include "common/arena.h"
+#include "common/file_util.h"
+#include "common/slab.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+void test_arena() {
+    arena a;
+    uint8_t *first;
+
+    arena_init(&a, 256);
+    first = arena_alloc(&a, 1, 1);
+    CHECK(((uintptr_t)arena_alloc(&a, 8, 8) & 7) == 0);
+    CHECK(((uintptr_t)arena_alloc(&a, 32, 32) & 31) == 0);
+    for (int i = 0; i < 100; i++) {
+        memset(arena_alloc(&a, 40, 8), i, 40);
+    }
+    memset(arena_alloc(&a, 10000, 16), 1, 10000);
+    arena_reset(&a);
+    CHECK(arena_alloc(&a, 1, 1) == first);
+    arena_clear(&a);
+}
+
+void test_slab() {
+    slab_pool *pool = slab_pool_new(24);
+    GHashTable *seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+    void *objects[5000];
+    bool distinct = true, aligned = true;
+
+    for (int i = 0; i < 5000; i++) {
+        objects[i] = slab_alloc(pool);
+        distinct = distinct && !g_hash_table_contains(seen, objects[i]);
+        aligned = aligned && ((uintptr_t)objects[i] & 15) == 0;
+        g_hash_table_add(seen, objects[i]);
+        memset(objects[i], 0xff, 24);
+    }
+    CHECK(distinct);
+    CHECK(aligned);
+    for (int i = 0; i < 5000; i++) {
+        slab_free(pool, objects[i]);
+    }
+    // freed objects are reused rather than new slabs carved
+    const size_t size = slab_pool_get_size(pool);
+    for (int i = 0; i < 5000; i++) {
+        objects[i] = slab_alloc(pool);
+    }
+    CHECK(slab_pool_get_size(pool) == size);
+    for (int i = 0; i < 5000; i++) {
+        slab_free(pool, objects[i]);
+    }
+    g_hash_table_destroy(seen);
+    slab_pool_free(pool);
+
+    CHECK(slab_pool_32() == slab_pool_32());
+    CHECK(slab_pool_32() != slab_pool_64());
+}
+
+// objects allocated on one thread and freed on others end up back in the pool
+static gpointer slab_thread(gpointer data) {
+    slab_pool *pool = data;
+    void *objects[1000];
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 1000; i++) {
+            objects[i] = slab_alloc(pool);
+            memset(objects[i], round, 64);
+        }
+        for (int i = 0; i < 1000; i++) {
+            if (((uint8_t *)objects[i])[63] != round) {
+                return GINT_TO_POINTER(1);
+            }
+            slab_free(pool, objects[i]);
+        }
+    }
+    return NULL;
+}
+
+void test_slab_threads() {
+    slab_pool *pool = slab_pool_new(64);
+    GThread *threads[4];
+    bool ok = true;
+
+    for (int i = 0; i < 4; i++) {
+        threads[i] = g_thread_new("slab", slab_thread, pool);
+    }
+    for (int i = 0; i < 4; i++) {
+        ok = ok && g_thread_join(threads[i]) == NULL;
+    }
+    CHECK(ok);
+    // 4 threads never held more than 4000 objects at once
+    CHECK(slab_pool_get_size(pool) <= 5 * 1000 * 64 + 4 * 64 * 1024);
+    slab_pool_free(pool);
+}
+
+typedef struct slab_reuse {
+    GMutex lock;
+    GCond cond;
+    slab_pool *pool;
+    int step;
+    size_t size;
+} slab_reuse;
+
+static void slab_reuse_wait(slab_reuse *r, int step) {
+    g_mutex_lock(&r->lock);
+    while (r->step < step) {
+        g_cond_wait(&r->cond, &r->lock);
+    }
+    g_mutex_unlock(&r->lock);
+}
+
+static void slab_reuse_next(slab_reuse *r) {
+    g_mutex_lock(&r->lock);
+    r->step++;
+    g_cond_broadcast(&r->cond);
+    g_mutex_unlock(&r->lock);
+}
+
+// caches objects of the first pool, then allocates from the one made after it was freed
+static gpointer slab_reuse_thread(gpointer data) {
+    slab_reuse *r = data;
+    slab_free(r->pool, slab_alloc(r->pool));
+    slab_reuse_next(r);
+    slab_reuse_wait(r, 2);
+    slab_free(r->pool, slab_alloc(r->pool));
+    r->size = slab_pool_get_size(r->pool);
+    return NULL;
+}
+
+void test_slab_reuse() {
+    slab_reuse r = { .step = 0 };
+    GThread *thread;
+
+    g_mutex_init(&r.lock);
+    g_cond_init(&r.cond);
+    r.pool = slab_pool_new(48);
+    thread = g_thread_new("slab_reuse", slab_reuse_thread, &r);
+    slab_reuse_wait(&r, 1);
+    // glibc keeps a few freed blocks per size for malloc but not calloc; with those
+    // lists full the freed pool goes where calloc finds it, so the next pool is at its address
+    for (size_t size = 8; size <= 128; size += 8) {
+        void *blocks[8];
+        for (int i = 0; i < 8; i++) {
+            blocks[i] = g_malloc(size);
+        }
+        for (int i = 0; i < 8; i++) {
+            g_free(blocks[i]);
+        }
+    }
+    slab_pool_free(r.pool);
+    // with the id of the freed one, and likely its address
+    r.pool = slab_pool_new(48);
+    slab_reuse_next(&r);
+    g_thread_join(thread);
+    // the object came from a slab of the new pool, not the thread's cache of the old one
+    CHECK(r.size > 0);
+    slab_pool_free(r.pool);
+    g_cond_clear(&r.cond);
+    g_mutex_clear(&r.lock);
+}
+
+void test_slab_double_free() {
+#ifndef NDEBUG
+    pid_t pid = fork();
+    int status = 0;
+    if (pid == 0) {
+        slab_pool *pool = slab_pool_new(32);
+        void *p = slab_alloc(pool);
+        slab_free(pool, p);
+        slab_free(pool, p);
+        _exit(0);
+    }
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+#endif
+}
+
+void test_is_rotational() {
+    const int root = is_rotational("/");
+    CHECK(root >= -1 && root <= 1);
+    CHECK(is_rotational("/nonexistent/dir") == -1);
+}
+
+int main(int argc, char *argv[])
+{
+    test_arena();
+    test_slab();
+    test_slab_threads();
+    test_slab_reuse();
+    test_slab_double_free();
+    test_is_rotational();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all common tests passed\n");
+    return 0;
+}
@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <string.h>
+#include "glib.h"
+#include "crypto/crypto-ops.h"
+#include "crypto/hash-ops.h"
+#include "ringct/rctOps.h"
+#include "ringct/multiexp.h"
+#include "ringct/rctSigs.h"
+#include "rct_gen.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static void hex_to_key(key *k, const char *hex) {
+    for (int i = 0; i < 32; i++) {
+        sscanf(hex + 2 * i, "%2hhx", &k->bytes[i]);
+    }
+}
+
+void test_keccak() {
+    key h, expected;
+    cn_fast_hash("", 0, (char *)h.bytes);
+    hex_to_key(&expected, "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+    CHECK(equalKeys(&h, &expected));
+    cn_fast_hash("abc", 3, (char *)h.bytes);
+    hex_to_key(&expected, "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45");
+    CHECK(equalKeys(&h, &expected));
+}
+
+static void hash2(char *out, const char *a, const char *b) {
+    char buf[2 * HASH_SIZE];
+    memcpy(buf, a, HASH_SIZE);
+    memcpy(buf + HASH_SIZE, b, HASH_SIZE);
+    cn_fast_hash(buf, sizeof(buf), out);
+}
+
+void test_tree_hash() {
+    char hashes[5][HASH_SIZE], root[HASH_SIZE], l[HASH_SIZE], r[HASH_SIZE], expected[HASH_SIZE];
+    for (int i = 0; i < 5; i++) {
+        cn_fast_hash(&i, sizeof(i), hashes[i]);
+    }
+
+    tree_hash(hashes, 1, root);
+    CHECK(memcmp(root, hashes[0], HASH_SIZE) == 0);
+    tree_hash(hashes, 2, root);
+    hash2(expected, hashes[0], hashes[1]);
+    CHECK(memcmp(root, expected, HASH_SIZE) == 0);
+    // the leading hashes are carried up unpaired
+    tree_hash(hashes, 3, root);
+    hash2(r, hashes[1], hashes[2]);
+    hash2(expected, hashes[0], r);
+    CHECK(memcmp(root, expected, HASH_SIZE) == 0);
+    tree_hash(hashes, 5, root);
+    hash2(l, hashes[0], hashes[1]);
+    hash2(r, hashes[3], hashes[4]);
+    hash2(r, hashes[2], r);
+    hash2(expected, l, r);
+    CHECK(memcmp(root, expected, HASH_SIZE) == 0);
+}
+
+void test_H() {
+    // H = 8 * to_point(cn_fast_hash(G))
+    key h, H;
+    ge_p3 p;
+    ge_p2 p2;
+    ge_p1p1 t;
+    cn_fast_hash(rct_G.bytes, 32, (char *)h.bytes);
+    CHECK(ge_frombytes_vartime(&p, h.bytes) == 0);
+    ge_p3_to_p2(&p2, &p);
+    ge_mul8(&t, &p2);
+    ge_p1p1_to_p3(&p, &t);
+    p3_tobytes(&H, &p);
+    CHECK(equalKeys(&H, &rct_H));
+    p3_tobytes(&H, rct_H_p3());
+    CHECK(equalKeys(&H, &rct_H));
+
+    // zeroCommit(a) = G + a * H
+    key C, a, aH, expected;
+    zeroCommit(&C, 0);
+    CHECK(equalKeys(&C, &rct_G));
+    zeroCommit(&C, 600000000000ull);
+    d2h(&a, 600000000000ull);
+    CHECK(scalarmultKey(&aH, &rct_H, &a) && addKeys(&expected, &rct_G, &aH));
+    CHECK(equalKeys(&C, &expected));
+}
+
+void test_scalars() {
+    key a, b, c, d;
+    skGen(&a);
+    skGen(&b);
+    CHECK(sc_check(a.bytes) == 0);
+    sc_add(c.bytes, a.bytes, b.bytes);
+    sc_sub(d.bytes, c.bytes, b.bytes);
+    CHECK(equalKeys(&a, &d));
+    // (a + b) * G == aG + bG
+    key aG, bG, cG, sum;
+    scalarmultBase(&aG, &a);
+    scalarmultBase(&bG, &b);
+    scalarmultBase(&cG, &c);
+    CHECK(addKeys(&sum, &aG, &bG));
+    CHECK(equalKeys(&sum, &cG));
+}
+
+static void naive_multiexp(key *r, const multiexp_data *data, size_t n) {
+    ge_p3 acc, t;
+    ge_cached c;
+    ge_p1p1 p;
+    ge_p3_0(&acc);
+    for (size_t i = 0; i < n; i++) {
+        ge_scalarmult_vartime(&t, data[i].scalar.bytes, &data[i].point);
+        ge_p3_to_cached(&c, &t);
+        ge_add(&p, &acc, &c);
+        ge_p1p1_to_p3(&acc, &p);
+    }
+    p3_tobytes(r, &acc);
+}
+
+void test_multiexp() {
+    const size_t sizes[] = { 1, 2, 7, 64, 300 };
+    for (size_t s = 0; s < G_N_ELEMENTS(sizes); s++) {
+        const size_t n = sizes[s];
+        multiexp_data *data = g_new(multiexp_data, n);
+        key expected, got, sk;
+        ge_p3 r;
+        for (size_t i = 0; i < n; i++) {
+            skGen(&sk);
+            ge_scalarmult_base_vartime(&data[i].point, sk.bytes);
+            skGen(&data[i].scalar);
+        }
+        naive_multiexp(&expected, data, n);
+        straus(&r, data, n);
+        p3_tobytes(&got, &r);
+        CHECK(equalKeys(&expected, &got));
+        for (size_t c = 1; c <= 9; c += 4) {
+            pippenger(&r, data, n, c);
+            p3_tobytes(&got, &r);
+            CHECK(equalKeys(&expected, &got));
+        }
+        multiexp(&got, data, n);
+        CHECK(equalKeys(&expected, &got));
+        g_free(data);
+    }
+}
+
+// proof that P = x * G: the equation x * G - P == 0
+typedef struct dlog_proof {
+    key x;
+    key P;
+} dlog_proof;
+
+static bool dlog_equation(const void *proof, rct_equation *eq, void *user) {
+    const dlog_proof *p = proof;
+    key minus_one, one, z;
+    ge_p3 P;
+    if (!p3_frombytes(&P, &p->P)) {
+        return false;
+    }
+    identity(&one);
+    zero(&z);
+    sc_sub(minus_one.bytes, z.bytes, one.bytes);
+    eq->g_scalar = p->x;
+    rct_equation_add_term(eq, &minus_one, &P);
+    return true;
+}
+
+void test_batch_verify() {
+    const size_t n = 37;
+    dlog_proof *proofs = g_new(dlog_proof, n);
+    const void **ptrs = g_new(const void *, n);
+    GArray *failed = g_array_new(FALSE, FALSE, sizeof(size_t));
+    for (size_t i = 0; i < n; i++) {
+        skGen(&proofs[i].x);
+        scalarmultBase(&proofs[i].P, &proofs[i].x);
+        ptrs[i] = &proofs[i];
+    }
+    CHECK(rct_batch_verify(ptrs, n, dlog_equation, NULL, failed));
+    CHECK(failed->len == 0);
+
+    // two bad proofs must be pinned down by bisection
+    proofs[5].x.bytes[0] ^= 1;
+    proofs[30].x.bytes[3] ^= 1;
+    CHECK(!rct_batch_verify(ptrs, n, dlog_equation, NULL, failed));
+    CHECK(failed->len == 2);
+    CHECK(failed->len == 2 && g_array_index(failed, size_t, 0) == 5 && g_array_index(failed, size_t, 1) == 30);
+
+    g_array_free(failed, TRUE);
+    g_free(ptrs);
+    g_free(proofs);
+}
+
+void test_range_proofs() {
+    const size_t n = 3;
+    rangeSig *sigs = g_new(rangeSig, n);
+    ctkeyV outPk = { g_new0(ctkey, n), n };
+    hash proof_hash;
+    key C;
+
+    for (size_t i = 0; i < n; i++) {
+        proveRange(&sigs[i], &outPk.keys[i].mask, 1000000007ull * (i + 1));
+        CHECK(verRange(&outPk.keys[i].mask, &sigs[i]));
+    }
+    CHECK(verRangeSigs(&outPk, sigs, false));
+
+    // wrong commitment, tampered signature, tampered bit commitment
+    C = outPk.keys[0].mask;
+    addKeys(&C, &C, &rct_H);
+    CHECK(!verRange(&C, &sigs[0]));
+    sigs[1].asig.s1[17].bytes[0] ^= 1;
+    CHECK(!verRange(&outPk.keys[1].mask, &sigs[1]));
+    CHECK(!verRangeSigs(&outPk, sigs, false));
+    sigs[1].asig.s1[17].bytes[0] ^= 1;
+    sigs[2].Ci[63].bytes[5] ^= 1;
+    CHECK(!verRange(&outPk.keys[2].mask, &sigs[2]));
+    sigs[2].Ci[63].bytes[5] ^= 1;
+
+    // a verified tx is remembered by its commitments and proofs
+    rct_verified_cache_clear();
+    rct_range_cache_key(&proof_hash, &outPk, sigs);
+    CHECK(!rct_verified_cache_contains(&proof_hash));
+    CHECK(verRangeSigs(&outPk, sigs, true));
+    CHECK(rct_verified_cache_contains(&proof_hash));
+    CHECK(verRangeSigs(&outPk, sigs, true));
+
+    // a tampered proof or a swapped commitment misses the cache and fails
+    sigs[0].asig.ee.bytes[0] ^= 1;
+    CHECK(!verRangeSigs(&outPk, sigs, true));
+    sigs[0].asig.ee.bytes[0] ^= 1;
+    C = outPk.keys[1].mask;
+    addKeys(&outPk.keys[1].mask, &C, &rct_H);
+    CHECK(!verRangeSigs(&outPk, sigs, true));
+    outPk.keys[1].mask = C;
+    CHECK(verRangeSigs(&outPk, sigs, true));
+    rct_verified_cache_clear();
+    CHECK(!rct_verified_cache_contains(&proof_hash));
+
+    g_free(outPk.keys);
+    g_free(sigs);
+}
+
+void test_hash_to_point() {
+    key p, expected;
+    hashToPoint(&p, &rct_G);
+    hex_to_key(&expected, "d6329b5b1f7c0805b5c345f4957554002a2f557845f64d7645dae0e051a6498a");
+    CHECK(equalKeys(&p, &expected));
+}
+
+void test_mlsag() {
+    const size_t ninputs = 4, ring_size = 11;
+    ctkeyV *rings = g_new(ctkeyV, ninputs);
+    mgSig *MGs = g_new(mgSig, ninputs);
+    key *pseudoOuts = g_new(key, ninputs);
+    rct_mg_input *inputs = g_new(rct_mg_input, ninputs);
+    GArray *failed = g_array_new(FALSE, FALSE, sizeof(size_t));
+    rctSigBase rv;
+    key message, a, tmp;
+
+    skGen(&message);
+    for (size_t i = 0; i < ninputs; i++) {
+        ctkey inSk;
+        const size_t index = (i * 5) % ring_size;
+        genRing(&rings[i], &inSk, ring_size, index, 5000 + i);
+        skGen(&a);
+        commit(&pseudoOuts[i], &a, 5000 + i);
+        proveRctMGSimple(&MGs[i], &message, &rings[i], &inSk, &a, &pseudoOuts[i], index);
+        CHECK(verRctMGSimple(&message, &MGs[i], &rings[i], &pseudoOuts[i]));
+        inputs[i].message = &message;
+        inputs[i].mg = &MGs[i];
+        inputs[i].pubs = &rings[i];
+        inputs[i].C = &pseudoOuts[i];
+    }
+    CHECK(verRctMGs(inputs, ninputs, NULL, failed));
+    // a decoy swapped after signing breaks only the rings it was put in
+    rings[1].keys[3] = rings[0].keys[1];
+    rings[2].keys[3] = rings[0].keys[1];
+    CHECK(!verRctMGs(inputs, ninputs, NULL, failed));
+    CHECK(failed->len == 2 && g_array_index(failed, size_t, 0) == 1 && g_array_index(failed, size_t, 1) == 2);
+    g_array_set_size(failed, 0);
+
+    // rings sharing members, decoded once through the batch point cache
+    for (size_t i = 0; i < ninputs; i++) {
+        ctkey inSk;
+        mgSig_free(&MGs[i]);
+        g_free(rings[i].keys);
+        genRing(&rings[i], &inSk, ring_size, 2, 77);
+        if (i > 0) {
+            rings[i].keys[0] = rings[0].keys[2];
+            rings[i].keys[5] = rings[0].keys[5];
+        }
+        skGen(&a);
+        commit(&pseudoOuts[i], &a, 77);
+        proveRctMGSimple(&MGs[i], &message, &rings[i], &inSk, &a, &pseudoOuts[i], 2);
+    }
+    CHECK(verRctMGs(inputs, ninputs, NULL, failed));
+    CHECK(failed->len == 0);
+
+    memset(&rv, 0, sizeof(rv));
+    rv.mixRing.keys = rings;
+    rv.mixRing.keysSize = ninputs;
+    rv.pseudoOuts.keys = pseudoOuts;
+    rv.pseudoOuts.keysSize = ninputs;
+    CHECK(verRctMGsSimple(&message, &rv, MGs, NULL));
+
+    // wrong amount, wrong message, tampered response, bad key image
+    tmp = pseudoOuts[1];
+    addKeys(&pseudoOuts[1], &pseudoOuts[1], &rct_H);
+    CHECK(!verRctMGsSimple(&message, &rv, MGs, NULL));
+    pseudoOuts[1] = tmp;
+    skGen(&tmp);
+    CHECK(!verRctMGSimple(&tmp, &MGs[0], &rings[0], &pseudoOuts[0]));
+    MGs[2].ss.keys[7].keys[1].bytes[0] ^= 1;
+    CHECK(!verRctMGs(inputs, ninputs, NULL, failed));
+    CHECK(failed->len == 1 && g_array_index(failed, size_t, 0) == 2);
+    MGs[2].ss.keys[7].keys[1].bytes[0] ^= 1;
+    identity(&MGs[3].II.keys[0]);
+    CHECK(!verRctMGSimple(&message, &MGs[3], &rings[3], &pseudoOuts[3]));
+
+    for (size_t i = 0; i < ninputs; i++) {
+        mgSig_free(&MGs[i]);
+        g_free(rings[i].keys);
+    }
+    g_array_free(failed, TRUE);
+    g_free(inputs);
+    g_free(pseudoOuts);
+    g_free(MGs);
+    g_free(rings);
+}
+
+// a tx spending 2 inputs into 3 outputs and the fee
+static void gen_balanced(rctSigBase *rv, xmr_amount fee) {
+    const xmr_amount in[2] = { 7000 + fee, 3000 }, out[3] = { 4000, 5000, 1000 };
+    key a[2], b[3];
+
+    memset(rv, 0, sizeof(*rv));
+    rv->pseudoOuts.keys = g_new(key, 2);
+    rv->pseudoOuts.keysSize = 2;
+    rv->outPk.keys = g_new0(ctkey, 3);
+    rv->outPk.keysSize = 3;
+    rv->txnFee = fee;
+    skGen(&a[0]);
+    skGen(&a[1]);
+    skGen(&b[0]);
+    skGen(&b[1]);
+    sc_add(b[2].bytes, a[0].bytes, a[1].bytes);
+    sc_sub(b[2].bytes, b[2].bytes, b[0].bytes);
+    sc_sub(b[2].bytes, b[2].bytes, b[1].bytes);
+    for (int i = 0; i < 2; i++) {
+        commit(&rv->pseudoOuts.keys[i], &a[i], in[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        commit(&rv->outPk.keys[i].mask, &b[i], out[i]);
+    }
+}
+
+void test_balance() {
+    const size_t n = 6;
+    rctSigBase *txs = g_new(rctSigBase, n);
+    const rctSigBase **rvs = g_new(const rctSigBase *, n);
+    GArray *failed = g_array_new(FALSE, FALSE, sizeof(size_t));
+
+    for (size_t i = 0; i < n; i++) {
+        gen_balanced(&txs[i], 100 * i);
+        rvs[i] = &txs[i];
+        CHECK(verRctBalance(&txs[i]));
+    }
+    CHECK(verRctBalances(rvs, n, failed));
+    CHECK(failed->len == 0);
+
+    // a tx claiming a lower fee creates money
+    txs[4].txnFee -= 1;
+    CHECK(!verRctBalance(&txs[4]));
+    CHECK(!verRctBalances(rvs, n, failed));
+    CHECK(failed->len == 1 && g_array_index(failed, size_t, 0) == 4);
+
+    for (size_t i = 0; i < n; i++) {
+        g_free(txs[i].pseudoOuts.keys);
+        g_free(txs[i].outPk.keys);
+    }
+    g_array_free(failed, TRUE);
+    g_free(rvs);
+    g_free(txs);
+}
+
+int main(int argc, char *argv[])
+{
+    test_keccak();
+    test_tree_hash();
+    test_H();
+    test_scalars();
+    test_multiexp();
+    test_batch_verify();
+    test_range_proofs();
+    test_hash_to_point();
+    test_mlsag();
+    test_balance();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all crypto tests passed\n");
+    return 0;
+}
@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <string.h>
+#include "glib.h"
+#include "common/arena.h"
+#include "common/varint.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "chain_gen.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static void put_varint(GByteArray *b, uint64_t v) {
+    uint8_t buf[VARINT_MAX_SIZE];
+    g_byte_array_append(b, buf, write_varint(buf, v));
+}
+
+static void put_filled(GByteArray *b, uint8_t fill, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        g_byte_array_append(b, &fill, 1);
+    }
+}
+
+static bool points_into(const void *p, const GByteArray *b) {
+    return (const uint8_t *)p >= b->data && (const uint8_t *)p < b->data + b->len;
+}
+
+// a v1 tx with every kind of input and output, and its ring signatures
+static GByteArray *v1_tx_blob(void) {
+    GByteArray *b = g_byte_array_new();
+    put_varint(b, 1);
+    put_varint(b, 5);
+    put_varint(b, 3);
+    put_filled(b, TXIN_TO_KEY_TAG, 1);
+    put_varint(b, 100);
+    put_varint(b, 3);
+    put_varint(b, 300);
+    put_varint(b, 1);
+    put_varint(b, 4);
+    put_filled(b, 0x11, 32);
+    put_filled(b, TXIN_TO_SCRIPT_TAG, 1);
+    put_filled(b, 0x22, 32);
+    put_varint(b, 9);
+    put_varint(b, 2);
+    put_filled(b, 0x23, 2);
+    put_filled(b, TXIN_TO_KEY_TAG, 1);
+    put_varint(b, 200);
+    put_varint(b, 2);
+    put_varint(b, 7);
+    put_varint(b, 8);
+    put_filled(b, 0x12, 32);
+    put_varint(b, 3);
+    put_varint(b, 70);
+    put_filled(b, TXOUT_TO_KEY_TAG, 1);
+    put_filled(b, 0x33, 32);
+    put_varint(b, 80);
+    put_filled(b, TXOUT_TO_SCRIPT_TAG, 1);
+    put_varint(b, 2);
+    put_filled(b, 0x44, 64);
+    put_varint(b, 3);
+    put_filled(b, 0x45, 3);
+    put_varint(b, 90);
+    put_filled(b, TXOUT_TO_SCRIPTHASH_TAG, 1);
+    put_filled(b, 0x55, 32);
+    put_varint(b, 33);
+    put_filled(b, TX_EXTRA_TAG_PUBKEY, 1);
+    put_filled(b, 0x66, 32);
+    // 3 + 2 ring members
+    put_filled(b, 0x77, 5 * sizeof(signature));
+    return b;
+}
+
+void test_parse_tx() {
+    GByteArray *b = v1_tx_blob();
+    arena a;
+    transaction tx;
+    public_key pub;
+
+    arena_init(&a, 4096);
+    CHECK(parse_and_validate_tx_from_blob(b->data, b->len, &a, &tx));
+    CHECK(tx.prefix.version == 1 && tx.prefix.unlock_time == 5);
+    CHECK(tx.prefix.vin_size == 3 && tx.prefix.vout_size == 3);
+    CHECK(tx.prefix.vin[0].tag == TXIN_TO_KEY_TAG);
+    CHECK(tx.prefix.vin[0].key.amount == 100 && tx.prefix.vin[0].key.key_offsets_size == 3);
+    CHECK(tx.prefix.vin[0].key.key_offsets[0] == 300 && tx.prefix.vin[0].key.key_offsets[2] == 4);
+    CHECK(tx.prefix.vin[0].key.k_image.data[31] == 0x11);
+    CHECK(tx.prefix.vin[1].tag == TXIN_TO_SCRIPT_TAG);
+    CHECK(tx.prefix.vin[1].script->prevout == 9 && tx.prefix.vin[1].script->sigset_size == 2);
+    CHECK(points_into(tx.prefix.vin[1].script->sigset, b));
+    CHECK(tx.prefix.vin[2].key.key_offsets_size == 2 && tx.prefix.vin[2].key.key_offsets[1] == 8);
+    CHECK(tx.prefix.vout[0].amount == 70 && tx.prefix.vout[0].target.tag == TXOUT_TO_KEY_TAG);
+    CHECK(tx.prefix.vout[0].target.key.key.data[0] == 0x33);
+    CHECK(tx.prefix.vout[1].target.tag == TXOUT_TO_SCRIPT_TAG);
+    CHECK(tx.prefix.vout[1].target.script.keys_size == 2 && tx.prefix.vout[1].target.script.script_size == 3);
+    CHECK(points_into(tx.prefix.vout[1].target.script.keys, b));
+    CHECK(tx.prefix.vout[2].target.tag == TXOUT_TO_SCRIPTHASH_TAG);
+    CHECK(tx.prefix.vout[2].target.scripthash.hash.data[0] == 0x55);
+    CHECK(tx.prefix.extra_size == 33 && points_into(tx.prefix.extra, b));
+    CHECK(get_tx_pub_key_from_extra(tx.prefix.extra, tx.prefix.extra_size, &pub) && pub.data[0] == 0x66);
+    CHECK(tx.signatures_size == 5 && points_into(tx.signatures, b));
+    CHECK(tx.signatures[4].r.data[31] == 0x77);
+    CHECK(tx.blob_size == b->len);
+
+    // truncated anywhere, or with trailing bytes
+    bool all_rejected = true;
+    for (guint n = 0; n < b->len; n++) {
+        arena_reset(&a);
+        all_rejected = all_rejected && !parse_and_validate_tx_from_blob(b->data, n, &a, &tx);
+    }
+    CHECK(all_rejected);
+    put_filled(b, 0, 1);
+    CHECK(!parse_and_validate_tx_from_blob(b->data, b->len, &a, &tx));
+
+    arena_clear(&a);
+    g_byte_array_free(b, TRUE);
+}
+
+// the structure of arrays copies match the parsed inputs and outputs
+void test_soa() {
+    GByteArray *b = v1_tx_blob();
+    arena a;
+    transaction tx[2];
+    const transaction_prefix *prefixes[2] = { &tx[0].prefix, &tx[1].prefix };
+    txin_to_key_soa ins;
+    txout_to_key_soa outs;
+
+    CHECK(sizeof(txin_v) <= 64 && sizeof(tx_out) <= 48);
+
+    arena_init(&a, 4096);
+    CHECK(parse_and_validate_tx_from_blob(b->data, b->len, &a, &tx[0]));
+    CHECK(parse_and_validate_tx_from_blob(b->data, b->len, &a, &tx[1]));
+    get_txin_to_key_soa(prefixes, 2, &a, &ins);
+    get_txout_to_key_soa(prefixes, 2, &a, &outs);
+
+    // the script input and outputs are left out
+    CHECK(ins.size == 4 && outs.size == 2);
+    CHECK(ins.tx[0] == 0 && ins.tx[1] == 0 && ins.tx[2] == 1 && ins.tx[3] == 1);
+    CHECK(ins.amount[0] == 100 && ins.amount[1] == 200 && ins.amount[3] == 200);
+    CHECK(ins.k_image[1].data[0] == 0x12 && ins.k_image[2].data[0] == 0x11);
+    CHECK(ins.key_offsets_begin[0] == 0 && ins.key_offsets_begin[1] == 3 && ins.key_offsets_begin[2] == 5);
+    CHECK(ins.key_offsets_begin[4] == 10);
+    CHECK(ins.key_offsets[0] == 300 && ins.key_offsets[4] == 8 && ins.key_offsets[5] == 300);
+    CHECK(ins.key_offsets != tx[0].prefix.vin[0].key.key_offsets);
+    CHECK(outs.tx[1] == 1 && outs.amount[0] == 70 && outs.key[1].data[0] == 0x33);
+
+    get_txin_to_key_soa(prefixes, 0, &a, &ins);
+    CHECK(ins.size == 0 && ins.key_offsets_begin[0] == 0);
+
+    arena_clear(&a);
+    g_byte_array_free(b, TRUE);
+}
+
+// a v2 CLSAG tx with one input and two outputs, and where its parts start
+static GByteArray *v2_tx_blob(size_t *prefix_size, size_t *base_size) {
+    GByteArray *b = g_byte_array_new();
+    put_varint(b, 2);
+    put_varint(b, 0);
+    put_varint(b, 1);
+    put_filled(b, TXIN_TO_KEY_TAG, 1);
+    put_varint(b, 0);
+    put_varint(b, 2);
+    put_varint(b, 1000);
+    put_varint(b, 3);
+    put_filled(b, 0x11, 32);
+    put_varint(b, 2);
+    for (int i = 0; i < 2; i++) {
+        put_varint(b, 0);
+        put_filled(b, TXOUT_TO_KEY_TAG, 1);
+        put_filled(b, 0x30 + i, 32);
+    }
+    put_varint(b, 33);
+    put_filled(b, TX_EXTRA_TAG_PUBKEY, 1);
+    put_filled(b, 0x66, 32);
+    *prefix_size = b->len;
+    put_filled(b, RCT_TYPE_CLSAG, 1);
+    put_varint(b, 30000000);
+    put_filled(b, 0x88, 2 * 8 + 2 * 32);
+    *base_size = b->len - *prefix_size;
+    put_filled(b, 0x99, 200);
+    return b;
+}
+
+static void hash_of(hash *h, const void *data, size_t size) {
+    cn_fast_hash(data, size, h->data);
+}
+
+typedef struct hash_job {
+    transaction *tx;
+    hash h;
+} hash_job;
+
+static gpointer hash_thread(gpointer user) {
+    hash_job *job = user;
+    get_transaction_hash(job->tx, &job->h);
+    return NULL;
+}
+
+void test_tx_hash() {
+    size_t prefix_size, base_size, size;
+    GByteArray *b = v1_tx_blob();
+    GByteArray *b2 = v2_tx_blob(&prefix_size, &base_size);
+    arena a;
+    transaction tx, empty;
+    hash h, expected, parts[3];
+    hash_job jobs[4];
+    GThread *threads[4];
+
+    arena_init(&a, 4096);
+    CHECK(parse_and_validate_tx_from_blob(b->data, b->len, &a, &tx));
+    CHECK(get_transaction_hash(&tx, &h));
+    hash_of(&expected, b->data, b->len);
+    CHECK(memcmp(&h, &expected, sizeof(hash)) == 0);
+    CHECK(get_transaction_prefix_hash(&tx, &h));
+    hash_of(&expected, b->data, b->len - 5 * sizeof(signature));
+    CHECK(memcmp(&h, &expected, sizeof(hash)) == 0);
+    CHECK(!get_transaction_prunable_hash(&tx, &h));
+    CHECK(get_transaction_blob_size(&tx, &size) && size == b->len);
+
+    CHECK(parse_and_validate_tx_from_blob(b2->data, b2->len, &a, &tx));
+    CHECK(tx.rct_type == RCT_TYPE_CLSAG && tx.prefix_size == prefix_size && tx.rct_base_size == base_size);
+    hash_of(&parts[0], b2->data, prefix_size);
+    hash_of(&parts[1], b2->data + prefix_size, base_size);
+    hash_of(&parts[2], b2->data + prefix_size + base_size, 200);
+    hash_of(&expected, parts, sizeof(parts));
+
+    // concurrent callers all see the one computed hash
+    for (int i = 0; i < 4; i++) {
+        jobs[i].tx = &tx;
+        threads[i] = g_thread_new("hash", hash_thread, &jobs[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        g_thread_join(threads[i]);
+        CHECK(memcmp(&jobs[i].h, &expected, sizeof(hash)) == 0);
+    }
+    CHECK(get_transaction_prunable_hash(&tx, &h) && memcmp(&h, &parts[2], sizeof(hash)) == 0);
+    // and later calls do not go back to the blob
+    b2->data[0] ^= 1;
+    CHECK(get_transaction_hash(&tx, &h) && memcmp(&h, &expected, sizeof(hash)) == 0);
+    CHECK(get_transaction_prefix_hash(&tx, &h) && memcmp(&h, &parts[0], sizeof(hash)) == 0);
+    b2->data[0] ^= 1;
+
+    // an unknown rct type, or a base cut short, does not parse
+    b2->data[prefix_size] = RCT_TYPE_BULLETPROOF_PLUS + 1;
+    CHECK(!parse_and_validate_tx_from_blob(b2->data, b2->len, &a, &tx));
+    b2->data[prefix_size] = RCT_TYPE_CLSAG;
+    CHECK(!parse_and_validate_tx_from_blob(b2->data, prefix_size + base_size - 1, &a, &tx));
+
+    memset(&empty, 0, sizeof(empty));
+    CHECK(!get_transaction_hash(&empty, &h) && !get_transaction_blob_size(&empty, &size));
+
+    arena_clear(&a);
+    g_byte_array_free(b2, TRUE);
+    g_byte_array_free(b, TRUE);
+}
+
+static GByteArray *block_blob(uint64_t height, size_t *header_size, size_t *miner_size) {
+    GByteArray *b = g_byte_array_new();
+    put_varint(b, 1);
+    put_varint(b, 1);
+    put_varint(b, 1400000000);
+    put_filled(b, 0xaa, 32);
+    put_filled(b, 0x01, 4);
+    *header_size = b->len;
+    put_varint(b, 2);
+    put_varint(b, height + 60);
+    put_varint(b, 1);
+    put_filled(b, TXIN_GEN_TAG, 1);
+    put_varint(b, height);
+    put_varint(b, 1);
+    put_varint(b, 600000000000);
+    put_filled(b, TXOUT_TO_KEY_TAG, 1);
+    put_filled(b, 0xbb, 32);
+    put_varint(b, 0);
+    put_filled(b, RCT_TYPE_NULL, 1);
+    *miner_size = b->len - *header_size;
+    put_varint(b, 2);
+    put_filled(b, 0xcc, 32);
+    put_filled(b, 0xdd, 32);
+    return b;
+}
+
+void test_block_hash() {
+    size_t header_size, miner_size, size;
+    GByteArray *b = block_blob(1000, &header_size, &miner_size);
+    GByteArray *hashing = g_byte_array_new();
+    arena a;
+    block blk;
+    hash h, expected, parts[3], leaves[3], root;
+
+    arena_init(&a, 1024);
+    CHECK(parse_and_validate_block_from_blob(b->data, b->len, &a, &blk));
+    CHECK(get_block_blob_size(&blk, &size) && size == b->len);
+
+    // a v2 miner tx has no rct base beyond the type byte and a null prunable hash
+    hash_of(&parts[0], b->data + header_size, miner_size - 1);
+    hash_of(&parts[1], b->data + header_size + miner_size - 1, 1);
+    memset(&parts[2], 0, sizeof(hash));
+    hash_of(&leaves[0], parts, sizeof(parts));
+    memcpy(&leaves[1], b->data + header_size + miner_size + 1, 2 * sizeof(hash));
+    tree_hash((const char (*)[HASH_SIZE])leaves, 3, root.data);
+    put_varint(hashing, header_size + sizeof(hash) + 1);
+    g_byte_array_append(hashing, b->data, header_size);
+    g_byte_array_append(hashing, (const guint8 *)&root, sizeof(hash));
+    put_varint(hashing, 3);
+    hash_of(&expected, hashing->data, hashing->len);
+    CHECK(get_transaction_hash(&blk.miner_tx, &h) && memcmp(&h, &leaves[0], sizeof(hash)) == 0);
+    CHECK(get_block_hash(&blk, &h) && memcmp(&h, &expected, sizeof(hash)) == 0);
+    CHECK(get_block_hash(&blk, &h) && memcmp(&h, &expected, sizeof(hash)) == 0);
+
+    // block 202612 keeps the hash it was mined with
+    g_byte_array_free(b, TRUE);
+    b = block_blob(202612, &header_size, &miner_size);
+    CHECK(parse_and_validate_block_from_blob(b->data, b->len, &a, &blk));
+    CHECK(get_block_hash(&blk, &h) && (uint8_t)h.data[0] == 0x84 && h.data[31] == 0);
+
+    arena_clear(&a);
+    g_byte_array_free(hashing, TRUE);
+    g_byte_array_free(b, TRUE);
+}
+
+typedef struct parse_check {
+    arena a;
+    GArray *vout;
+    uint64_t txs;
+    bool ok;
+} parse_check;
+
+// the arena parser agrees with the in place views on every block and tx
+static bool check_block(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    parse_check *c = user;
+    block b;
+    block_ref ref;
+    blob_reader r;
+    transaction tx;
+
+    arena_reset(&c->a);
+    g_array_set_size(c->vout, 0);
+    ref.miner_tx.vout = c->vout;
+    blob_reader_init(&r, blob->mv_data, blob->mv_size);
+    if (!parse_and_validate_block_from_blob(blob->mv_data, blob->mv_size, &c->a, &b) || !parse_block_ref(&r, &ref)) {
+        c->ok = false;
+        return false;
+    }
+    c->ok = c->ok && b.header.timestamp == ref.header.timestamp && b.tx_hashes_size == txs_size
+        && b.tx_hashes == ref.tx_hashes && b.miner_tx.prefix.vin[0].tag == TXIN_GEN_TAG
+        && b.miner_tx.prefix.vin[0].gen.height == height && b.miner_tx.prefix.vout_size == c->vout->len
+        && memcmp(&b.miner_tx.prefix.vout[0].target.key.key, g_array_index(c->vout, tx_out_ref, 0).key, sizeof(public_key)) == 0;
+
+    for (size_t i = 0; i < txs_size; i++) {
+        if (!parse_and_validate_tx_from_blob(txs[i].mv_data, txs[i].mv_size, &c->a, &tx)) {
+            c->ok = false;
+            return false;
+        }
+        const txin_to_key *in = &tx.prefix.vin[0].key;
+        c->ok = c->ok && tx.prefix.version == 2 && in->key_offsets_size == 11
+            && in->key_offsets[0] == height * 7 && in->key_offsets[10] == 1
+            && tx.rct_type == 0 && tx.blob_size == txs[i].mv_size;
+        c->txs++;
+    }
+    return true;
+}
+
+void test_parse_chain() {
+    wallet_account account;
+    chain_gen gen;
+    parse_check c;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        CHECK(false);
+        return;
+    }
+    for (int h = 0; h < 8; h++) {
+        CHECK(chain_gen_add_block(&gen, &account, 4, 3, h & 1, NULL, NULL));
+    }
+    arena_init(&c.a, 1024);
+    c.vout = g_array_new(FALSE, FALSE, sizeof(tx_out_ref));
+    c.txs = 0;
+    c.ok = true;
+    CHECK(lmdb_for_blocks_range_blobs(gen.lmdb, 0, gen.height - 1, check_block, &c) == 0);
+    CHECK(c.ok);
+    CHECK(c.txs == 8 * 4);
+
+    g_array_free(c.vout, TRUE);
+    arena_clear(&c.a);
+    chain_gen_close(&gen);
+}
+
+void test_extra_nonce() {
+    // a nonce of 200 bytes, its length a two byte varint, then the tx key
+    uint8_t extra[3 + 200 + 1 + sizeof(public_key)];
+    public_key pub;
+
+    memset(extra, 0, sizeof(extra));
+    extra[0] = TX_EXTRA_NONCE;
+    extra[1] = 0x80 | (200 & 0x7f);
+    extra[2] = 200 >> 7;
+    extra[3 + 200] = TX_EXTRA_TAG_PUBKEY;
+    extra[3 + 200 + 1] = 0x66;
+    CHECK(get_tx_pub_key_from_extra(extra, sizeof(extra), &pub) && pub.data[0] == 0x66);
+    // a length past the end
+    CHECK(!get_tx_pub_key_from_extra(extra, 3 + 100, &pub));
+}
+
+int main(int argc, char *argv[])
+{
+    test_parse_tx();
+    test_soa();
+    test_tx_hash();
+    test_block_hash();
+    test_parse_chain();
+    test_extra_nonce();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all cryptonote tests passed\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <string.h>
+#include "glib.h"
+#include "cryptonote_config.h"
+#include "cryptonote_basic/difficulty.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "chain_gen.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// next_difficulty over the blocks the chain looks at for the next block
+static difficulty_type reference_next(const uint64_t *timestamps, const difficulty_type *cumulative, uint64_t height) {
+    uint64_t offset = height - MIN(height, DIFFICULTY_BLOCKS_COUNT);
+    if (offset == 0) {
+        offset = 1;
+    }
+    if (offset >= height) {
+        return 1;
+    }
+    return next_difficulty(timestamps + offset, cumulative + offset, height - offset, DIFFICULTY_TARGET_V2);
+}
+
+void test_next_difficulty() {
+    uint64_t timestamps[DIFFICULTY_WINDOW + 10];
+    difficulty_type cumulative[DIFFICULTY_WINDOW + 10];
+
+    for (size_t i = 0; i < G_N_ELEMENTS(timestamps); i++) {
+        timestamps[i] = 1000 + i * DIFFICULTY_TARGET_V2;
+        cumulative[i] = (i + 1) * 1000;
+    }
+    CHECK(next_difficulty(timestamps, cumulative, 0, DIFFICULTY_TARGET_V2) == 1);
+    CHECK(next_difficulty(timestamps, cumulative, 1, DIFFICULTY_TARGET_V2) == 1);
+    CHECK(next_difficulty(timestamps, cumulative, 2, DIFFICULTY_TARGET_V2) == 1000);
+    CHECK(next_difficulty(timestamps, cumulative, 100, DIFFICULTY_TARGET_V2) == 1000);
+    CHECK(next_difficulty(timestamps, cumulative, G_N_ELEMENTS(timestamps), DIFFICULTY_TARGET_V2) == 1000);
+    // blocks twice as fast, and timestamps out of order
+    for (size_t i = 0; i < G_N_ELEMENTS(timestamps); i++) {
+        timestamps[i] = 1000 + (i ^ 1) * DIFFICULTY_TARGET_V2 / 2;
+    }
+    CHECK(next_difficulty(timestamps, cumulative, DIFFICULTY_WINDOW, DIFFICULTY_TARGET_V2) == 2000);
+    // equal timestamps count as one second
+    CHECK(next_difficulty((const uint64_t[]){ 5, 5 }, (const difficulty_type[]){ 10, 20 }, 2, DIFFICULTY_TARGET_V2) == 10 * DIFFICULTY_TARGET_V2);
+    // work * target past 64 bits
+    CHECK(next_difficulty((const uint64_t[]){ 0, 1ull << 40 }, (const difficulty_type[]){ 0, 1ull << 60 }, 2, DIFFICULTY_TARGET_V2) == 0);
+    CHECK(next_difficulty((const uint64_t[]){ 0, 1ull << 40 }, (const difficulty_type[]){ 0, 1ull << 56 }, 2, DIFFICULTY_TARGET_V2) == DIFFICULTY_TARGET_V2 << 16);
+}
+
+void test_difficulty_window() {
+    const size_t n = 2 * DIFFICULTY_BLOCKS_COUNT + DIFFICULTY_WINDOW_RESERVE;
+    uint64_t *timestamps = g_new(uint64_t, n);
+    difficulty_type *cumulative = g_new(difficulty_type, n);
+    GRand *rand = g_rand_new_with_seed(31);
+    difficulty_window w;
+    bool same = true;
+
+    for (size_t i = 0; i < n; i++) {
+        timestamps[i] = 1000000 + i * DIFFICULTY_TARGET_V2 + g_rand_int_range(rand, -700, 700);
+        cumulative[i] = (i ? cumulative[i - 1] : 0) + g_rand_int_range(rand, 1, 100000) * 1000000ull;
+    }
+
+    difficulty_window_init(&w, DIFFICULTY_TARGET_V2);
+    for (size_t h = 0; h < n; h++) {
+        CHECK(difficulty_window_ready(&w));
+        same = same && difficulty_window_next(&w) == reference_next(timestamps, cumulative, h);
+        difficulty_window_push(&w, timestamps[h], cumulative[h]);
+    }
+    CHECK(same);
+
+    // pop within the reserve, then push different blocks back
+    for (size_t i = 0; i < DIFFICULTY_WINDOW_RESERVE; i++) {
+        CHECK(difficulty_window_pop(&w));
+        same = same && difficulty_window_next(&w) == reference_next(timestamps, cumulative, w.height);
+    }
+    CHECK(!difficulty_window_pop(&w));
+    CHECK(w.height == n - DIFFICULTY_WINDOW_RESERVE);
+    for (size_t h = w.height; h < n; h++) {
+        timestamps[h] += 60;
+        difficulty_window_push(&w, timestamps[h], cumulative[h]);
+        same = same && difficulty_window_next(&w) == reference_next(timestamps, cumulative, h + 1);
+    }
+    CHECK(same);
+
+    // after a reset at a height, the window fills up before it can be used
+    difficulty_window_reset(&w, 100);
+    for (size_t h = 100; h < 100 + DIFFICULTY_BLOCKS_COUNT; h++) {
+        CHECK(!difficulty_window_ready(&w));
+        difficulty_window_push(&w, timestamps[h], cumulative[h]);
+    }
+    CHECK(difficulty_window_ready(&w));
+    CHECK(difficulty_window_next(&w) == reference_next(timestamps, cumulative, 100 + DIFFICULTY_BLOCKS_COUNT));
+
+    difficulty_window_clear(&w);
+    g_rand_free(rand);
+    g_free(cumulative);
+    g_free(timestamps);
+}
+
+void test_difficulty_window_lmdb() {
+    const size_t n = DIFFICULTY_BLOCKS_COUNT + DIFFICULTY_WINDOW_RESERVE + 20;
+    uint64_t *timestamps = g_new(uint64_t, n);
+    difficulty_type *cumulative = g_new(difficulty_type, n);
+    difficulty_window w;
+    chain_gen gen;
+
+    difficulty_window_init(&w, DIFFICULTY_TARGET_V2);
+    if (!chain_gen_open(&gen)) {
+        CHECK(false);
+        return;
+    }
+    CHECK(lmdb_get_difficulty_window(gen.lmdb, &w) == 0);
+    CHECK(w.height == 0 && difficulty_window_next(&w) == 1);
+
+    for (size_t h = 0; h < n; h++) {
+        gen.timestamp += (h * 7919) % 200;
+        gen.difficulty = 1000 + (h * 104729) % 5000;
+        timestamps[h] = gen.timestamp;
+        cumulative[h] = gen.cumulative_difficulty + gen.difficulty;
+        CHECK(chain_gen_add_block(&gen, NULL, 0, 0, false, NULL, NULL));
+        if (h == 10) {
+            CHECK(lmdb_get_difficulty_window(gen.lmdb, &w) == 0);
+            CHECK(w.height == 11);
+            CHECK(difficulty_window_next(&w) == reference_next(timestamps, cumulative, 11));
+        }
+    }
+    CHECK(lmdb_get_difficulty_window(gen.lmdb, &w) == 0);
+    CHECK(w.height == n);
+    CHECK(w.count == w.capacity);
+    CHECK(difficulty_window_next(&w) == reference_next(timestamps, cumulative, n));
+    CHECK(difficulty_window_pop(&w));
+    CHECK(difficulty_window_next(&w) == reference_next(timestamps, cumulative, n - 1));
+
+    chain_gen_close(&gen);
+    difficulty_window_clear(&w);
+    g_free(cumulative);
+    g_free(timestamps);
+}
+
+int main(int argc, char *argv[])
+{
+    test_next_difficulty();
+    test_difficulty_window();
+    test_difficulty_window_lmdb();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all difficulty tests passed\n");
+    return 0;
+}
@@ -0,0 +1,753 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "glib.h"
+#include "common/arena.h"
+#include "common/slab.h"
+#include "common/threadpool.h"
+#include "cryptonote_config.h"
+#include "cryptonote_basic/difficulty.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/output_cache.h"
+#include "ringct/rctOps.h"
+#include "ringct/rctSigs.h"
+#include "wallet/wallet_scanner.h"
+#include "chain_gen.h"
+#include "rct_gen.h"
+
+/*
+ * Throughput benchmarks, run by hand:
+ *     performance_tests [inputs]
+ */
+
+typedef struct mlsag_data {
+    size_t n;
+    key message;
+    ctkeyV *rings;
+    mgSig *MGs;
+    key *pseudoOuts;
+    rct_mg_input *inputs;
+} mlsag_data;
+
+static void mlsag_data_init(mlsag_data *d, size_t n, size_t ring_size) {
+    d->n = n;
+    d->rings = g_new(ctkeyV, n);
+    d->MGs = g_new(mgSig, n);
+    d->pseudoOuts = g_new(key, n);
+    d->inputs = g_new(rct_mg_input, n);
+    skGen(&d->message);
+    for (size_t i = 0; i < n; i++) {
+        const size_t index = i % ring_size;
+        ctkey inSk;
+        key a;
+        genRing(&d->rings[i], &inSk, ring_size, index, 1000 + i);
+        skGen(&a);
+        commit(&d->pseudoOuts[i], &a, 1000 + i);
+        proveRctMGSimple(&d->MGs[i], &d->message, &d->rings[i], &inSk, &a, &d->pseudoOuts[i], index);
+        d->inputs[i].message = &d->message;
+        d->inputs[i].mg = &d->MGs[i];
+        d->inputs[i].pubs = &d->rings[i];
+        d->inputs[i].C = &d->pseudoOuts[i];
+    }
+}
+
+static void mlsag_data_free(mlsag_data *d) {
+    for (size_t i = 0; i < d->n; i++) {
+        mgSig_free(&d->MGs[i]);
+        g_free(d->rings[i].keys);
+    }
+    g_free(d->inputs);
+    g_free(d->pseudoOuts);
+    g_free(d->MGs);
+    g_free(d->rings);
+}
+
+static void bench_mlsag(size_t n, size_t ring_size) {
+    const guint ncores = g_get_num_processors();
+    mlsag_data d;
+
+    mlsag_data_init(&d, n, ring_size);
+    for (guint threads = 1; ; threads = MIN(threads * 2, ncores)) {
+        threadpool *pool = threadpool_new(threads);
+        const gint64 start = g_get_monotonic_time();
+        const bool ok = verRctMGs(d.inputs, d.n, pool, NULL);
+        const double secs = (g_get_monotonic_time() - start) / 1e6;
+        printf("mlsag ring %3zu, %2u thread(s): %8.1f inputs/s, %7.1f inputs/s per core, %u steals%s\n",
+               ring_size, threads, n / secs, n / secs / threads, threadpool_get_steals(pool), ok ? "" : " (FAILED)");
+        threadpool_free(pool);
+        if (threads == ncores) {
+            break;
+        }
+    }
+    mlsag_data_free(&d);
+}
+
+static int bench_recipient(uint64_t height, uint32_t tx_index, uint32_t output_index, void *user) {
+    return (height + tx_index + output_index) % 16 == 0 ? 0 : -1;
+}
+
+static void bench_wallet_scan(size_t blocks, size_t num_accounts) {
+    const guint ncores = g_get_num_processors();
+    wallet_account *accounts = g_new(wallet_account, num_accounts);
+    GArray *found = g_array_new(FALSE, FALSE, sizeof(wallet_output));
+    chain_gen gen;
+
+    for (size_t i = 0; i < num_accounts; i++) {
+        chain_gen_account(&accounts[i]);
+    }
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, accounts, 8, 2, false, bench_recipient, NULL);
+    }
+    for (guint threads = 1; ; threads = MIN(threads * 2, ncores)) {
+        threadpool *pool = threadpool_new(threads);
+        wallet_scan_stats stats;
+        g_array_set_size(found, 0);
+        const int ret = wallet_scan(gen.lmdb, 0, blocks - 1, accounts, num_accounts, pool, found, &stats);
+        printf("wallet scan %2zu account(s), %2u thread(s): %9.1f outputs/s, %llu derivations, %u found%s\n",
+               num_accounts, threads, wallet_scan_outputs_per_sec(&stats), (unsigned long long)stats.derivations, found->len, ret ? " (FAILED)" : "");
+        threadpool_free(pool);
+        if (threads == ncores) {
+            break;
+        }
+    }
+    chain_gen_close(&gen);
+    g_array_free(found, TRUE);
+    g_free(accounts);
+}
+
+typedef struct parse_bench {
+    arena a;
+    uint64_t txs;
+    uint64_t bytes;
+    bool ok;
+} parse_bench;
+
+static bool parse_bench_block(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    parse_bench *p = user;
+    block b;
+    transaction tx;
+
+    arena_reset(&p->a);
+    p->ok = p->ok && parse_and_validate_block_from_blob(blob->mv_data, blob->mv_size, &p->a, &b);
+    p->bytes += blob->mv_size;
+    for (size_t i = 0; i < txs_size; i++) {
+        p->ok = p->ok && parse_and_validate_tx_from_blob(txs[i].mv_data, txs[i].mv_size, &p->a, &tx);
+        p->bytes += txs[i].mv_size;
+    }
+    p->txs += txs_size + 1;
+    return true;
+}
+
+// blob parsing into one arena per block, blobs read in place from LMDB
+static void bench_parse(size_t blocks) {
+    wallet_account account;
+    chain_gen gen;
+    parse_bench p;
+    gint64 start;
+    double secs;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, &account, 16, 2, h & 1, NULL, NULL);
+    }
+    arena_init(&p.a, 16384);
+    p.txs = p.bytes = 0;
+    p.ok = true;
+    start = g_get_monotonic_time();
+    for (int pass = 0; pass < 10; pass++) {
+        lmdb_for_blocks_range_blobs(gen.lmdb, 0, blocks - 1, parse_bench_block, &p);
+    }
+    secs = (g_get_monotonic_time() - start) / 1e6;
+    printf("parse: %10.1f tx/s, %7.1f MB/s%s\n", p.txs / secs, p.bytes / secs / 1e6, p.ok ? "" : " (FAILED)");
+    arena_clear(&p.a);
+    chain_gen_close(&gen);
+}
+
+typedef struct ring_bench {
+    arena a;
+    GArray *ins;    // txin_to_key_soa per block
+} ring_bench;
+
+static bool ring_bench_block(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    ring_bench *r = user;
+    transaction *tx = arena_new(&r->a, transaction, txs_size);
+    const transaction_prefix **prefixes = arena_new(&r->a, const transaction_prefix *, txs_size);
+    txin_to_key_soa ins;
+
+    for (size_t i = 0; i < txs_size; i++) {
+        if (!parse_and_validate_tx_from_blob(txs[i].mv_data, txs[i].mv_size, &r->a, &tx[i])) {
+            return false;
+        }
+        prefixes[i] = &tx[i].prefix;
+    }
+    get_txin_to_key_soa(prefixes, txs_size, &r->a, &ins);
+    txin_to_key_soa_absolute_offsets(&ins);
+    g_array_append_val(r->ins, ins);
+    return true;
+}
+
+// ring members of every block, one db read per member against the deduplicating cache
+static void bench_output_resolve(size_t blocks) {
+    wallet_account account;
+    chain_gen gen;
+    ring_bench r;
+    output_cache *cache;
+    output_cache_stats stats;
+    uint64_t members = 0;
+    gint64 start;
+    double direct, cached;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, &account, 16, 2, false, NULL, NULL);
+    }
+    arena_init(&r.a, 65536);
+    r.ins = g_array_new(FALSE, FALSE, sizeof(txin_to_key_soa));
+    lmdb_for_blocks_range_blobs(gen.lmdb, 0, blocks - 1, ring_bench_block, &r);
+
+    start = g_get_monotonic_time();
+    for (guint h = 0; h < r.ins->len; h++) {
+        const txin_to_key_soa *ins = &g_array_index(r.ins, txin_to_key_soa, h);
+        for (size_t j = 0; j < ins->key_offsets_begin[ins->size]; j++) {
+            output_index_t o = { 0, ins->key_offsets[j] };
+            output_data_t data;
+            lmdb_get_output_data(gen.lmdb, &o, 1, &data);
+            members++;
+        }
+    }
+    direct = (g_get_monotonic_time() - start) / 1e6;
+
+    cache = output_cache_new(1 << 16);
+    start = g_get_monotonic_time();
+    for (guint h = 0; h < r.ins->len; h++) {
+        const txin_to_key_soa *ins = &g_array_index(r.ins, txin_to_key_soa, h);
+        const size_t n = ins->key_offsets_begin[ins->size];
+        output_index_t *outputs = g_new(output_index_t, n);
+        output_data_t *data = g_new(output_data_t, n);
+        for (size_t j = 0; j < n; j++) {
+            outputs[j].amount = 0;
+            outputs[j].index = ins->key_offsets[j];
+        }
+        output_cache_resolve(cache, gen.lmdb, outputs, n, data);
+        g_free(data);
+        g_free(outputs);
+    }
+    cached = (g_get_monotonic_time() - start) / 1e6;
+    output_cache_get_stats(cache, &stats);
+    printf("ring members: %10.1f /s direct, %10.1f /s cached (%llu unique, %llu hits)\n", members / direct, members / cached,
+           (unsigned long long)stats.unique, (unsigned long long)stats.hits);
+
+    output_cache_free(cache);
+    g_array_free(r.ins, TRUE);
+    arena_clear(&r.a);
+    chain_gen_close(&gen);
+}
+
+#define ALLOC_BATCH 10000
+#define ALLOC_ROUNDS 100
+
+typedef struct alloc_bench {
+    slab_pool *pool;  // NULL for malloc
+    size_t size;
+} alloc_bench;
+
+// allocate a batch of objects, touch them and free them, a few times over
+static gpointer alloc_bench_thread(gpointer data) {
+    const alloc_bench *b = data;
+    void **objects = g_new(void *, ALLOC_BATCH);
+    for (int round = 0; round < ALLOC_ROUNDS; round++) {
+        for (int i = 0; i < ALLOC_BATCH; i++) {
+            objects[i] = b->pool ? slab_alloc(b->pool) : malloc(b->size);
+            *(volatile uint8_t *)objects[i] = (uint8_t)i;
+        }
+        for (int i = 0; i < ALLOC_BATCH; i++) {
+            if (b->pool) {
+                slab_free(b->pool, objects[i]);
+            } else {
+                free(objects[i]);
+            }
+        }
+    }
+    g_free(objects);
+    return NULL;
+}
+
+static double alloc_bench_run(const alloc_bench *b, guint threads) {
+    GThread **t = g_new(GThread *, threads);
+    const gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < threads; i++) {
+        t[i] = g_thread_new("alloc", alloc_bench_thread, (gpointer)b);
+    }
+    for (guint i = 0; i < threads; i++) {
+        g_thread_join(t[i]);
+    }
+    g_free(t);
+    return (double)threads * ALLOC_BATCH * ALLOC_ROUNDS / ((g_get_monotonic_time() - start) / 1e6);
+}
+
+// block lifetime allocations: many small objects, all freed together
+static double arena_bench_run(bool use_arena) {
+    void **objects = g_new(void *, ALLOC_BATCH);
+    arena a;
+    gint64 start;
+
+    arena_init(&a, 64 * 1024);
+    start = g_get_monotonic_time();
+    for (int round = 0; round < ALLOC_ROUNDS; round++) {
+        for (int i = 0; i < ALLOC_BATCH; i++) {
+            const size_t size = 16 + (i % 7) * 24;
+            objects[i] = use_arena ? arena_alloc(&a, size, 8) : malloc(size);
+            *(volatile uint8_t *)objects[i] = (uint8_t)i;
+        }
+        if (use_arena) {
+            arena_reset(&a);
+        } else {
+            for (int i = 0; i < ALLOC_BATCH; i++) {
+                free(objects[i]);
+            }
+        }
+    }
+    const double rate = (double)ALLOC_BATCH * ALLOC_ROUNDS / ((g_get_monotonic_time() - start) / 1e6);
+    arena_clear(&a);
+    g_free(objects);
+    return rate;
+}
+
+static void bench_alloc(void) {
+    const guint ncores = g_get_num_processors();
+    const size_t sizes[] = { 32, 64 };
+
+    for (size_t s = 0; s < G_N_ELEMENTS(sizes); s++) {
+        alloc_bench slab = { sizes[s] == 32 ? slab_pool_32() : slab_pool_64(), sizes[s] };
+        alloc_bench libc = { NULL, sizes[s] };
+        for (guint threads = 1; ; threads = MIN(threads * 2, ncores)) {
+            printf("alloc %2zu bytes, %2u thread(s): %12.1f allocs/s slab, %12.1f allocs/s malloc\n",
+                   sizes[s], threads, alloc_bench_run(&slab, threads), alloc_bench_run(&libc, threads));
+            if (threads == ncores) {
+                break;
+            }
+        }
+    }
+    printf("alloc mixed sizes, freed per block: %12.1f allocs/s arena, %12.1f allocs/s malloc\n",
+           arena_bench_run(true), arena_bench_run(false));
+}
+
+// next difficulty for every block of a chain, from the window vs from scratch
+// the blobs of one block, copied out of the db
+typedef struct write_bench_block {
+    MDB_val blob;
+    MDB_val *txs;
+    size_t txs_size;
+} write_bench_block;
+
+static bool copy_bench_block(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    GArray *blocks = user;
+    write_bench_block b;
+
+    b.blob.mv_size = blob->mv_size;
+    b.blob.mv_data = g_memdup2(blob->mv_data, blob->mv_size);
+    b.txs = g_new(MDB_val, txs_size);
+    b.txs_size = txs_size;
+    for (size_t i = 0; i < txs_size; i++) {
+        b.txs[i].mv_size = txs[i].mv_size;
+        b.txs[i].mv_data = g_memdup2(txs[i].mv_data, txs[i].mv_size);
+    }
+    g_array_append_val(blocks, b);
+    return true;
+}
+
+static double write_bench_run(const GArray *blocks, bool plain) {
+    chain_gen gen;
+    gint64 start;
+    double secs;
+    bool ok = true;
+
+    if (!chain_gen_open(&gen)) {
+        return 0;
+    }
+    gen.lmdb->m_plain_puts = plain;
+    start = g_get_monotonic_time();
+    for (guint h = 0; h < blocks->len && ok; h++) {
+        const write_bench_block *b = &g_array_index(blocks, write_bench_block, h);
+        ok = lmdb_add_block(gen.lmdb, &b->blob, b->txs, b->txs_size, b->blob.mv_size, h + 1, 0) == 0;
+    }
+    secs = (g_get_monotonic_time() - start) / 1e6;
+    chain_gen_close(&gen);
+    return ok ? blocks->len / secs : 0;
+}
+
+// sequential lmdb_add_block with MDB_APPEND and MDB_RESERVE, against plain mdb_put
+static void bench_block_write(size_t blocks) {
+    wallet_account account;
+    chain_gen gen;
+    GArray *copies = g_array_new(FALSE, FALSE, sizeof(write_bench_block));
+    double append, plain;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, &account, 16, 2, false, NULL, NULL);
+    }
+    lmdb_for_blocks_range_blobs(gen.lmdb, 0, blocks - 1, copy_bench_block, copies);
+    chain_gen_close(&gen);
+
+    plain = write_bench_run(copies, true);
+    append = write_bench_run(copies, false);
+    printf("block write: %10.1f blocks/s append and reserve, %10.1f blocks/s plain mdb_put\n", append, plain);
+
+    for (guint h = 0; h < copies->len; h++) {
+        write_bench_block *b = &g_array_index(copies, write_bench_block, h);
+        for (size_t i = 0; i < b->txs_size; i++) {
+            g_free(b->txs[i].mv_data);
+        }
+        g_free(b->txs);
+        g_free(b->blob.mv_data);
+    }
+    g_array_free(copies, TRUE);
+}
+
+// the outputs of every tx, per part of a partitioned walk of txs_pruned
+typedef struct scan_bench_part {
+    arena a;
+    uint64_t outputs;
+} scan_bench_part;
+
+static bool scan_bench_record(uint64_t key, const MDB_val *data, void *part) {
+    scan_bench_part *p = part;
+    transaction_prefix prefix;
+    if (parse_tx_prefix_from_blob(data->mv_data, data->mv_size, &p->a, &prefix)) {
+        p->outputs += prefix.vout_size;
+    }
+    arena_reset(&p->a);
+    return true;
+}
+
+static void scan_bench_merge(size_t index, void *part, void *user) {
+    *(uint64_t *)user += ((scan_bench_part *)part)->outputs;
+}
+
+static double scan_bench_run(chain_gen *gen, size_t nparts, uint64_t *outputs) {
+    scan_bench_part *parts = g_new0(scan_bench_part, nparts);
+    gint64 start;
+
+    for (size_t i = 0; i < nparts; i++) {
+        arena_init(&parts[i].a, 4096);
+    }
+    *outputs = 0;
+    start = g_get_monotonic_time();
+    lmdb_for_each_partitioned(gen->lmdb, gen->lmdb->m_txs_pruned, NULL, parts, sizeof(*parts), nparts,
+                              scan_bench_record, scan_bench_merge, outputs);
+    const double seconds = (g_get_monotonic_time() - start) / 1e6;
+    for (size_t i = 0; i < nparts; i++) {
+        arena_clear(&parts[i].a);
+    }
+    g_free(parts);
+    return gen->tx_id / seconds;
+}
+
+static void bench_partitioned_scan(size_t blocks) {
+    wallet_account account;
+    chain_gen gen;
+    const size_t nparts = 4 * threadpool_get_max_concurrency(threadpool_get_instance());
+    uint64_t one_outputs, parts_outputs;
+    double one, parts;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, &account, 16, 2, false, NULL, NULL);
+    }
+    one = scan_bench_run(&gen, 1, &one_outputs);
+    parts = scan_bench_run(&gen, nparts, &parts_outputs);
+    printf("txs_pruned scan: %10.1f txs/s in %zu parts, %10.1f txs/s in one%s\n", parts, nparts, one,
+           one_outputs == parts_outputs ? "" : " (MISMATCH)");
+    chain_gen_close(&gen);
+}
+
+static bool prefetch_bench_block(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    uint64_t *sum = user;
+    *sum += ((const uint8_t *)blob->mv_data)[blob->mv_size - 1];
+    for (size_t i = 0; i < txs_size; i++) {
+        *sum += ((const uint8_t *)txs[i].mv_data)[txs[i].mv_size - 1];
+    }
+    return true;
+}
+
+// a file of the db out of the page cache, once nothing maps it
+static void bench_drop_cache(chain_gen *gen, const char *name) {
+    char *path = g_build_filename(gen->dir, name, NULL);
+    int fd;
+    if ((fd = open(path, O_RDONLY)) >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    g_free(path);
+}
+
+// closed, so nothing maps the file, and the file out of the page cache: the scan reads the disk
+static void prefetch_bench_evict(chain_gen *gen) {
+    lmdb_close(gen->lmdb);
+    bench_drop_cache(gen, CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
+    g_free(gen->lmdb->m_folder);
+    gen->lmdb->m_folder = NULL;
+    lmdb_open(gen->lmdb, gen->dir, DBF_FAST);
+}
+
+static double prefetch_bench_run(chain_gen *gen, uint64_t distance, uint64_t *sum) {
+    gint64 start;
+    prefetch_bench_evict(gen);
+    gen->lmdb->m_prefetch_distance = distance;
+    start = g_get_monotonic_time();
+    lmdb_for_blocks_range_blobs(gen->lmdb, 0, gen->height - 1, prefetch_bench_block, sum);
+    return gen->height / ((g_get_monotonic_time() - start) / 1e6);
+}
+
+// a cold sequential read of the chain, as an export or a wallet scan does
+static void bench_prefetch(size_t blocks) {
+    wallet_account account;
+    chain_gen gen;
+    lmdb_prefetch_stats stats;
+    uint64_t plain_sum = 0, ahead_sum = 0;
+    double plain, ahead;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, &account, 16, 2, false, NULL, NULL);
+    }
+    plain = prefetch_bench_run(&gen, 0, &plain_sum);
+    ahead = prefetch_bench_run(&gen, 32, &ahead_sum);
+    lmdb_get_prefetch_stats(gen.lmdb, &stats);
+    printf("cold block read: %10.1f blocks/s read ahead, %10.1f blocks/s without; %.1f%% hits, %llu stalls, %llu avoided%s\n",
+           ahead, plain, stats.blocks ? 100.0 * stats.hits / stats.blocks : 0.0, (unsigned long long)stats.stalls,
+           (unsigned long long)stats.stalls_avoided, plain_sum == ahead_sum ? "" : " (MISMATCH)");
+    chain_gen_close(&gen);
+}
+
+typedef struct headers_bench {
+    arena a;
+    uint64_t sum;
+} headers_bench;
+
+static bool headers_bench_block(uint64_t height, const MDB_val *blob, const MDB_val *txs, size_t txs_size, void *user) {
+    headers_bench *hb = user;
+    block b;
+    hash h;
+    arena_reset(&hb->a);
+    if (!parse_and_validate_block_from_blob(blob->mv_data, blob->mv_size, &hb->a, &b) || !get_block_hash(&b, &h)) {
+        return false;
+    }
+    hb->sum += b.header.timestamp + (uint8_t)h.data[0];
+    return true;
+}
+
+// closed and cold, then opened and walked to a header chain with its hashes
+static double headers_bench_run(chain_gen *gen, bool from_file, uint64_t *sum) {
+    headers_bench hb = { .sum = 0 };
+    header_record *r = g_new(header_record, gen->height);
+    gint64 start;
+
+    lmdb_close(gen->lmdb);
+    bench_drop_cache(gen, CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
+    bench_drop_cache(gen, HEADER_FILE_NAME);
+    g_free(gen->lmdb->m_folder);
+    gen->lmdb->m_folder = NULL;
+    arena_init(&hb.a, 4096);
+    start = g_get_monotonic_time();
+    lmdb_open(gen->lmdb, gen->dir, DBF_FAST);
+    if (from_file) {
+        if (lmdb_get_headers(gen->lmdb, 0, gen->height, r) == 0) {
+            for (uint64_t h = 0; h < gen->height; h++) {
+                hb.sum += r[h].timestamp + (uint8_t)r[h].hash.data[0];
+            }
+        }
+    } else {
+        lmdb_for_blocks_range_blobs(gen->lmdb, 0, gen->height - 1, headers_bench_block, &hb);
+    }
+    const double seconds = (g_get_monotonic_time() - start) / 1e6;
+    arena_clear(&hb.a);
+    g_free(r);
+    *sum = hb.sum;
+    return seconds;
+}
+
+// from a cold start to every header and hash in memory, as a node needs before it syncs
+static void bench_headers(size_t blocks) {
+    wallet_account account;
+    chain_gen gen;
+    uint64_t file_sum, walk_sum;
+    double file, walk;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < blocks; h++) {
+        chain_gen_add_block(&gen, &account, 16, 2, false, NULL, NULL);
+    }
+    file = headers_bench_run(&gen, true, &file_sum);
+    walk = headers_bench_run(&gen, false, &walk_sum);
+    printf("cold header chain: %8.1f ms from the header file, %8.1f ms parsing %zu blocks%s\n", file * 1e3, walk * 1e3,
+           blocks, file_sum == walk_sum ? "" : " (MISMATCH)");
+    chain_gen_close(&gen);
+}
+
+typedef struct tip_bench {
+    BlockchainLMDB *lmdb;
+    bool txn;
+    uint64_t ops;
+    uint64_t sum;
+} tip_bench;
+
+// what lmdb_get_tip replaces: the height from mdb_stat and the top from block_info, in a read txn
+static bool tip_bench_txn(BlockchainLMDB *lmdb, uint64_t *sum) {
+    const uint64_t zero = 0;
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    MDB_stat st;
+    MDB_val k = { sizeof(zero), (void *)&zero }, v;
+    bool ok = false;
+
+    if (mdb_txn_begin(lmdb->m_env, NULL, MDB_RDONLY, &txn)) {
+        return false;
+    }
+    if (!mdb_stat(txn, lmdb->m_blocks, &st) && st.ms_entries > 0 && !mdb_cursor_open(txn, lmdb->m_block_info, &cur)) {
+        uint64_t top = st.ms_entries - 1;
+        v = (MDB_val){ sizeof(top), &top };
+        if (!mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH)) {
+            hash top_hash;
+            // bi_hash comes after the height, timestamp, coins, weight and difficulty
+            memcpy(&top_hash, (const uint8_t *)v.mv_data + 5 * sizeof(uint64_t), sizeof(top_hash));
+            *sum += st.ms_entries + top_hash.data[0];
+            ok = true;
+        }
+        mdb_cursor_close(cur);
+    }
+    mdb_txn_abort(txn);
+    return ok;
+}
+
+static gpointer tip_bench_thread(gpointer data) {
+    tip_bench *b = data;
+    lmdb_tip tip;
+    for (uint64_t i = 0; i < b->ops; i++) {
+        if (b->txn) {
+            tip_bench_txn(b->lmdb, &b->sum);
+        } else if (lmdb_get_tip(b->lmdb, &tip) == 0) {
+            b->sum += tip.height + tip.top.data[0];
+        }
+    }
+    return NULL;
+}
+
+static double tip_bench_run(chain_gen *gen, bool txn, guint threads, uint64_t ops, uint64_t *sum) {
+    tip_bench b[threads];
+    GThread *t[threads];
+    gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < threads; i++) {
+        b[i] = (tip_bench){ gen->lmdb, txn, ops, 0 };
+        t[i] = g_thread_new("tip", tip_bench_thread, &b[i]);
+    }
+    for (guint i = 0; i < threads; i++) {
+        g_thread_join(t[i]);
+        *sum += b[i].sum;
+    }
+    return threads * ops / ((g_get_monotonic_time() - start) / 1e6);
+}
+
+// the height and top hash, as asked for on every RPC and p2p handshake
+static void bench_tip(size_t ops) {
+    wallet_account account;
+    chain_gen gen;
+
+    chain_gen_account(&account);
+    if (!chain_gen_open(&gen)) {
+        return;
+    }
+    for (size_t h = 0; h < 16; h++) {
+        chain_gen_add_block(&gen, &account, 1, 2, false, NULL, NULL);
+    }
+    for (guint threads = 1; threads <= 4; threads *= 4) {
+        uint64_t tip_sum = 0, txn_sum = 0;
+        const double tip = tip_bench_run(&gen, false, threads, ops, &tip_sum);
+        const double txn = tip_bench_run(&gen, true, threads, ops, &txn_sum);
+        printf("chain tip, %u thread(s): %12.1f reads/s published, %12.1f reads/s from a read txn%s\n", threads, tip, txn,
+               tip_sum == txn_sum ? "" : " (MISMATCH)");
+    }
+    chain_gen_close(&gen);
+}
+
+static void bench_difficulty(size_t blocks) {
+    uint64_t *timestamps = g_new(uint64_t, blocks);
+    difficulty_type *cumulative = g_new(difficulty_type, blocks);
+    difficulty_window w;
+    difficulty_type check = 0;
+    gint64 start;
+    double incremental, full;
+
+    for (size_t i = 0; i < blocks; i++) {
+        timestamps[i] = i * DIFFICULTY_TARGET_V2 + g_random_int_range(-600, 600);
+        cumulative[i] = (i ? cumulative[i - 1] : 0) + g_random_int_range(1, 1000000);
+    }
+
+    difficulty_window_init(&w, DIFFICULTY_TARGET_V2);
+    start = g_get_monotonic_time();
+    for (size_t h = 0; h < blocks; h++) {
+        check += difficulty_window_next(&w);
+        difficulty_window_push(&w, timestamps[h], cumulative[h]);
+    }
+    incremental = (g_get_monotonic_time() - start) / 1e6;
+    difficulty_window_clear(&w);
+
+    start = g_get_monotonic_time();
+    for (size_t h = 0; h < blocks; h++) {
+        const size_t offset = MAX(h - MIN(h, DIFFICULTY_BLOCKS_COUNT), 1);
+        check -= offset < h ? next_difficulty(timestamps + offset, cumulative + offset, h - offset, DIFFICULTY_TARGET_V2) : 1;
+    }
+    full = (g_get_monotonic_time() - start) / 1e6;
+
+    printf("next difficulty: %10.1f blocks/s incremental, %10.1f blocks/s sorting the window%s\n",
+           blocks / incremental, blocks / full, check ? " (MISMATCH)" : "");
+    g_free(cumulative);
+    g_free(timestamps);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+    const size_t ring_sizes[] = { 11, 16, 32, 64 };
+
+    for (size_t i = 0; i < G_N_ELEMENTS(ring_sizes); i++) {
+        bench_mlsag(n, ring_sizes[i]);
+    }
+    bench_wallet_scan(n * 4, 1);
+    bench_wallet_scan(n * 4, 8);
+    bench_difficulty(n * 1000);
+    bench_parse(n * 16);
+    bench_output_resolve(n * 4);
+    bench_block_write(n * 16);
+    bench_partitioned_scan(n * 16);
+    bench_prefetch(n * 16);
+    bench_tip(n * 10000);
+    bench_headers(n * 16);
+    bench_alloc();
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <string.h>
+#include "glib.h"
+#include "ringct/rctOps.h"
+#include "rct_gen.h"
+
+void addKeys2(key *r, const key *a, const key *A, const key *b) {
+    ge_p3 A3;
+    ge_p2 R;
+    p3_frombytes(&A3, A);
+    ge_double_scalarmult_base_vartime(&R, a->bytes, &A3, b->bytes);
+    ge_tobytes(r->bytes, &R);
+}
+
+// aA + bB
+static void addKeys3(key *r, const key *a, const key *A, const key *b, const key *B) {
+    key aA, bB;
+    scalarmultKey(&aA, A, a);
+    scalarmultKey(&bB, B, b);
+    addKeys(r, &aA, &bB);
+}
+
+void genBorromean(boroSig *bb, const key *x, const key *P1, const key *P2, const bits indices) {
+    key L[2][ATOMS], alpha[ATOMS], c, LL;
+    for (int ii = 0; ii < ATOMS; ii++) {
+        const int naught = indices[ii], prime = (naught + 1) % 2;
+        skGen(&alpha[ii]);
+        scalarmultBase(&L[naught][ii], &alpha[ii]);
+        if (naught == 0) {
+            skGen(&bb->s1[ii]);
+            hash_to_scalar(&c, &L[naught][ii], sizeof(key));
+            addKeys2(&L[prime][ii], &c, &P2[ii], &bb->s1[ii]);
+        }
+    }
+    hash_to_scalar(&bb->ee, L[1], sizeof(L[1]));
+    for (int jj = 0; jj < ATOMS; jj++) {
+        if (!indices[jj]) {
+            sc_mulsub(bb->s0[jj].bytes, x[jj].bytes, bb->ee.bytes, alpha[jj].bytes);
+        } else {
+            skGen(&bb->s0[jj]);
+            addKeys2(&LL, &bb->ee, &P1[jj], &bb->s0[jj]);
+            hash_to_scalar(&c, &LL, sizeof(key));
+            sc_mulsub(bb->s1[jj].bytes, x[jj].bytes, c.bytes, alpha[jj].bytes);
+        }
+    }
+}
+
+void proveRange(rangeSig *sig, key *C, xmr_amount amount) {
+    const key *H2 = rct_H2();
+    key ai[ATOMS], CiH[ATOMS];
+    bits b;
+    for (int i = 0; i < ATOMS; i++) {
+        b[i] = (amount >> i) & 1;
+        skGen(&ai[i]);
+        scalarmultBase(&sig->Ci[i], &ai[i]);
+        if (b[i]) {
+            addKeys(&sig->Ci[i], &sig->Ci[i], &H2[i]);
+        }
+        subKeys(&CiH[i], &sig->Ci[i], &H2[i]);
+        if (i == 0) {
+            *C = sig->Ci[0];
+        } else {
+            addKeys(C, C, &sig->Ci[i]);
+        }
+    }
+    genBorromean(&sig->asig, ai, sig->Ci, CiH, b);
+}
+
+void commit(key *C, const key *mask, xmr_amount amount) {
+    key a, aH;
+    d2h(&a, amount);
+    scalarmultBase(C, mask);
+    scalarmultKey(&aH, &rct_H, &a);
+    addKeys(C, C, &aH);
+}
+
+void genRing(ctkeyV *pubs, ctkey *inSk, size_t n, size_t index, xmr_amount amount) {
+    key sk;
+    pubs->keys = g_new(ctkey, n);
+    pubs->keysSize = n;
+    for (size_t i = 0; i < n; i++) {
+        skGen(&sk);
+        scalarmultBase(&pubs->keys[i].dest, &sk);
+        skGen(&sk);
+        commit(&pubs->keys[i].mask, &sk, i * 1000 + 7);
+    }
+    skGen(&inSk->dest);
+    skGen(&inSk->mask);
+    scalarmultBase(&pubs->keys[index].dest, &inSk->dest);
+    commit(&pubs->keys[index].mask, &inSk->mask, amount);
+}
+
+void proveRctMGSimple(mgSig *mg, const key *message, const ctkeyV *pubs, const ctkey *inSk, const key *a, const key *Cout, size_t index) {
+    const size_t cols = pubs->keysSize;
+    key alpha[2], xx[2], Hi, c, toHash[6];
+    key *pk1 = g_new(key, cols);
+
+    for (size_t i = 0; i < cols; i++) {
+        subKeys(&pk1[i], &pubs->keys[i].mask, Cout);
+    }
+    xx[0] = inSk->dest;
+    sc_sub(xx[1].bytes, inSk->mask.bytes, a->bytes);
+
+    mg->ss.keys = g_new(keyV, cols);
+    mg->ss.keysSize = cols;
+    for (size_t i = 0; i < cols; i++) {
+        mg->ss.keys[i].keys = g_new(key, 2);
+        mg->ss.keys[i].keysSize = 2;
+    }
+    mg->II.keys = g_new(key, 1);
+    mg->II.keysSize = 1;
+
+    hashToPoint(&Hi, &pubs->keys[index].dest);
+    scalarmultKey(&mg->II.keys[0], &Hi, &xx[0]);
+    toHash[0] = *message;
+    skGen(&alpha[0]);
+    skGen(&alpha[1]);
+    toHash[1] = pubs->keys[index].dest;
+    scalarmultBase(&toHash[2], &alpha[0]);
+    scalarmultKey(&toHash[3], &Hi, &alpha[0]);
+    toHash[4] = pk1[index];
+    scalarmultBase(&toHash[5], &alpha[1]);
+    hash_to_scalar(&c, toHash, sizeof(toHash));
+
+    size_t i = (index + 1) % cols;
+    if (i == 0) {
+        mg->cc = c;
+    }
+    while (i != index) {
+        key *ss = mg->ss.keys[i].keys;
+        skGen(&ss[0]);
+        skGen(&ss[1]);
+        hashToPoint(&Hi, &pubs->keys[i].dest);
+        toHash[1] = pubs->keys[i].dest;
+        addKeys2(&toHash[2], &c, &pubs->keys[i].dest, &ss[0]);
+        addKeys3(&toHash[3], &ss[0], &Hi, &c, &mg->II.keys[0]);
+        toHash[4] = pk1[i];
+        addKeys2(&toHash[5], &c, &pk1[i], &ss[1]);
+        hash_to_scalar(&c, toHash, sizeof(toHash));
+        i = (i + 1) % cols;
+        if (i == 0) {
+            mg->cc = c;
+        }
+    }
+    for (int j = 0; j < 2; j++) {
+        sc_mulsub(mg->ss.keys[index].keys[j].bytes, c.bytes, xx[j].bytes, alpha[j].bytes);
+    }
+    g_free(pk1);
+}
+
+void mgSig_free(mgSig *mg) {
+    for (size_t i = 0; i < mg->ss.keysSize; i++) {
+        g_free(mg->ss.keys[i].keys);
+    }
+    g_free(mg->ss.keys);
+    g_free(mg->II.keys);
+    memset(mg, 0, sizeof(*mg));
+}
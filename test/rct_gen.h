@@ -0,0 +1,27 @@
+#ifndef MONERO_TEST_RCT_GEN_H_
+#define MONERO_TEST_RCT_GEN_H_
+
+#include <stddef.h>
+#include "ringct/rctTypes.h"
+
+/*
+ * Signers for the proofs the library verifies. They use the variable time
+ * group operations and exist to produce test and benchmark data only.
+ */
+
+// aA + bG
+void addKeys2(key *r, const key *a, const key *A, const key *b);
+void genBorromean(boroSig *bb, const key *x, const key *P1, const key *P2, const bits indices);
+// range proof for amount, C receives the commitment
+void proveRange(rangeSig *sig, key *C, xmr_amount amount);
+
+// a ring of n random members, the real one at index; C is a commitment to amount with mask inSk->mask
+void genRing(ctkeyV *pubs, ctkey *inSk, size_t n, size_t index, xmr_amount amount);
+// signs the ring for a pseudo output Cout = a * G + amount * H
+void proveRctMGSimple(mgSig *mg, const key *message, const ctkeyV *pubs, const ctkey *inSk, const key *a, const key *Cout, size_t index);
+void mgSig_free(mgSig *mg);
+
+// commitment mask * G + amount * H
+void commit(key *C, const key *mask, xmr_amount amount);
+
+#endif //MONERO_TEST_RCT_GEN_H_
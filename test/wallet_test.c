@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+#include "glib.h"
+#include "common/threadpool.h"
+#include "common/varint.h"
+#include "crypto/crypto-ops.h"
+#include "crypto/random.h"
+#include "wallet/gamma_picker.h"
+#include "wallet/wallet_scanner.h"
+#include "chain_gen.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+void test_varint() {
+    const uint64_t values[] = { 0, 1, 127, 128, 300, 16384, UINT32_MAX, UINT64_MAX };
+    uint8_t buf[VARINT_MAX_SIZE];
+    uint64_t v = 0;
+
+    for (size_t i = 0; i < G_N_ELEMENTS(values); i++) {
+        const size_t n = write_varint(buf, values[i]);
+        CHECK(read_varint(buf, buf + n, &v) == (int)n);
+        CHECK(v == values[i]);
+        CHECK(read_varint(buf, buf + n - 1, &v) == EVARINT_TRUNCATED);
+    }
+    // 0x80 0x00 encodes 0 with a trailing zero group
+    buf[0] = 0x80;
+    buf[1] = 0x00;
+    CHECK(read_varint(buf, buf + 2, &v) == EVARINT_REPRESENT);
+    memset(buf, 0xff, 9);
+    buf[9] = 0x02;
+    CHECK(read_varint(buf, buf + 10, &v) == EVARINT_OVERFLOW);
+}
+
+void test_scalarmult() {
+    unsigned char a[64];
+    ge_p3 A, expected;
+    ge_p2 r;
+    unsigned char e[32], got[32];
+
+    for (int i = 0; i < 16; i++) {
+        generate_random_bytes(64, a);
+        sc_reduce(a);
+        ge_scalarmult_base_vartime(&A, a);
+        generate_random_bytes(64, a);
+        sc_reduce(a);
+        ge_scalarmult_vartime(&expected, a, &A);
+        ge_p3_tobytes(e, &expected);
+        ge_scalarmult(&r, a, &A);
+        ge_tobytes(got, &r);
+        CHECK(memcmp(e, got, 32) == 0);
+    }
+}
+
+void test_derivation() {
+    wallet_account acc;
+    secret_key r;
+    public_key A, R, P, B;
+    key_derivation d1, d2;
+    unsigned char tmp[64];
+
+    chain_gen_account(&acc);
+    generate_random_bytes(64, tmp);
+    sc_reduce(tmp);
+    memcpy(r.data, tmp, 32);
+    CHECK(secret_key_to_public_key(&acc.view_secret_key, &A));
+    CHECK(secret_key_to_public_key(&r, &R));
+    CHECK(generate_key_derivation(&A, &r, &d1));
+    CHECK(generate_key_derivation(&R, &acc.view_secret_key, &d2));
+    CHECK(memcmp(&d1, &d2, sizeof(d1)) == 0);
+    CHECK(derive_public_key(&d1, 3, &acc.spend_public_key, &P));
+    CHECK(derive_subaddress_public_key(&P, &d2, 3, &B));
+    CHECK(memcmp(&B, &acc.spend_public_key, sizeof(B)) == 0);
+    CHECK(derive_subaddress_public_key(&P, &d2, 4, &B));
+    CHECK(memcmp(&B, &acc.spend_public_key, sizeof(B)) != 0);
+}
+
+#define SCAN_ACCOUNTS 3
+#define SCAN_BLOCKS 24
+#define SCAN_TXS 3
+#define SCAN_OUTPUTS 4
+
+static int scan_recipient(uint64_t height, uint32_t tx_index, uint32_t output_index, void *user) {
+    const int r = (int)((height * 31 + tx_index * 7 + output_index) % 5);
+    (void)user;
+    return r < SCAN_ACCOUNTS ? r : -1;
+}
+
+// what the scanner should find in [h1, h2], in chain order
+static GArray *expected_outputs(uint64_t h1, uint64_t h2) {
+    GArray *expected = g_array_new(FALSE, TRUE, sizeof(wallet_output));
+    for (uint64_t h = h1; h <= h2; h++) {
+        for (uint32_t t = 0; t <= SCAN_TXS; t++) {
+            const uint32_t outputs = t == 0 ? 1 : SCAN_OUTPUTS;
+            for (uint32_t o = 0; o < outputs; o++) {
+                const int to = scan_recipient(h, t, o, NULL);
+                if (to >= 0) {
+                    wallet_output w = { .height = h, .tx_index = t, .output_index = o, .account = (uint32_t)to };
+                    g_array_append_val(expected, w);
+                }
+            }
+        }
+    }
+    return expected;
+}
+
+static bool same_outputs(const GArray *found, const GArray *expected) {
+    if (found->len != expected->len) {
+        return false;
+    }
+    for (guint i = 0; i < found->len; i++) {
+        const wallet_output *a = &g_array_index(found, wallet_output, i);
+        const wallet_output *b = &g_array_index(expected, wallet_output, i);
+        if (a->height != b->height || a->tx_index != b->tx_index || a->output_index != b->output_index || a->account != b->account) {
+            return false;
+        }
+        if (a->tx_index == 0 && a->amount != 600000000000ull) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_scan() {
+    wallet_account accounts[SCAN_ACCOUNTS];
+    chain_gen gen;
+    threadpool *pool;
+    GArray *found, *expected;
+    wallet_scan_stats stats;
+
+    for (int i = 0; i < SCAN_ACCOUNTS; i++) {
+        chain_gen_account(&accounts[i]);
+    }
+    if (!chain_gen_open(&gen)) {
+        CHECK(false);
+        return;
+    }
+    for (uint64_t h = 0; h < SCAN_BLOCKS; h++) {
+        CHECK(chain_gen_add_block(&gen, accounts, SCAN_TXS, SCAN_OUTPUTS, h & 1, scan_recipient, NULL));
+    }
+
+    pool = threadpool_new(4);
+    found = g_array_new(FALSE, FALSE, sizeof(wallet_output));
+    expected = expected_outputs(0, SCAN_BLOCKS - 1);
+    CHECK(wallet_scan(gen.lmdb, 0, SCAN_BLOCKS - 1, accounts, SCAN_ACCOUNTS, pool, found, &stats) == 0);
+    CHECK(same_outputs(found, expected));
+    CHECK(stats.blocks == SCAN_BLOCKS);
+    CHECK(stats.txs == SCAN_BLOCKS * (SCAN_TXS + 1));
+    CHECK(stats.outputs == SCAN_BLOCKS * (SCAN_TXS * SCAN_OUTPUTS + 1));
+    g_array_free(expected, TRUE);
+
+    // a sub range with a single account on the shared pool
+    g_array_set_size(found, 0);
+    CHECK(wallet_scan(gen.lmdb, 5, 9, &accounts[1], 1, NULL, found, NULL) == 0);
+    expected = expected_outputs(5, 9);
+    for (guint i = 0; i < expected->len; ) {
+        wallet_output *w = &g_array_index(expected, wallet_output, i);
+        if (w->account != 1) {
+            g_array_remove_index(expected, i);
+        } else {
+            w->account = 0;
+            i++;
+        }
+    }
+    CHECK(same_outputs(found, expected));
+    g_array_free(expected, TRUE);
+
+    // past the tip
+    g_array_set_size(found, 0);
+    CHECK(wallet_scan(gen.lmdb, 0, SCAN_BLOCKS, accounts, SCAN_ACCOUNTS, pool, found, NULL) != 0);
+    CHECK(found->len == 0);
+
+    g_array_free(found, TRUE);
+    threadpool_free(pool);
+    chain_gen_close(&gen);
+}
+
+void test_gamma_picker() {
+    output_distribution d;
+    gamma_picker p;
+    GRand *rng = g_rand_new_with_seed(42);
+    const uint64_t blocks = 5000;
+    uint64_t total = 0, picked = 0, failed = 0, recent = 0;
+    bool in_range = true;
+
+    output_distribution_init(&d);
+    CHECK(!gamma_picker_init(&p, &d, GAMMA_SHAPE, GAMMA_SCALE, rng));
+    // 20 outputs in every other block
+    for (uint64_t h = 0; h < blocks; h++) {
+        total += (h & 1) ? 20 : 0;
+        output_distribution_push(&d, total);
+    }
+    CHECK(gamma_picker_init(&p, &d, GAMMA_SHAPE, GAMMA_SCALE, rng));
+    CHECK(p.end == blocks - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE && p.num_rct_outputs == total - 5 * 20);
+
+    for (int i = 0; i < 10000; i++) {
+        const uint64_t o = gamma_picker_pick(&p);
+        if (o == GAMMA_PICK_FAILED) {
+            failed++;
+            continue;
+        }
+        picked++;
+        in_range = in_range && o < p.num_rct_outputs;
+        recent += o >= p.num_rct_outputs / 2;
+    }
+    CHECK(in_range);
+    CHECK(picked > failed);
+    // the age distribution favours recent outputs
+    CHECK(recent > picked * 3 / 4);
+
+    // popped below the picker's view of the chain
+    output_distribution_pop(&d);
+    CHECK(gamma_picker_pick(&p) == GAMMA_PICK_FAILED);
+
+    // no outputs in the last year: the average is over the whole chain, and picks land in the old blocks
+    const uint64_t blocks_in_a_year = 86400 * 365 / DIFFICULTY_TARGET_V2;
+    while (output_distribution_height(&d) < blocks + blocks_in_a_year) {
+        output_distribution_push(&d, total);
+    }
+    CHECK(gamma_picker_init(&p, &d, GAMMA_SHAPE, GAMMA_SCALE, rng));
+    CHECK(p.average_output_time > 0 && p.num_rct_outputs == total);
+    in_range = true;
+    picked = 0;
+    for (int i = 0; i < 1000; i++) {
+        const uint64_t o = gamma_picker_pick(&p);
+        picked += o != GAMMA_PICK_FAILED;
+        in_range = in_range && (o == GAMMA_PICK_FAILED || o < total);
+    }
+    CHECK(in_range && picked > 0);
+
+    output_distribution_clear(&d);
+    g_rand_free(rng);
+}
+
+int main(int argc, char *argv[])
+{
+    test_varint();
+    test_scalarmult();
+    test_derivation();
+    test_scan();
+    test_gamma_picker();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all wallet tests passed\n");
+    return 0;
+}